@@ -102,12 +102,17 @@ use constant TYPE_GET_CONFIG => 9;
 use constant TYPE_SEND_TICK => 10;
 use constant TYPE_SYNC => 11;
 use constant TYPE_GET_BINDING_STATE => 12;
+use constant TYPE_GET_STATS => 13;
+use constant TYPE_GET_TREE_PATCH => 14;
+use constant TYPE_SET_ENCODING => 15;
+use constant TYPE_GET_TRACE => 16;
 
 our %EXPORT_TAGS = ( 'all' => [
     qw(i3 TYPE_RUN_COMMAND TYPE_COMMAND TYPE_GET_WORKSPACES TYPE_SUBSCRIBE TYPE_GET_OUTPUTS
        TYPE_GET_TREE TYPE_GET_MARKS TYPE_GET_BAR_CONFIG TYPE_GET_VERSION
        TYPE_GET_BINDING_MODES TYPE_GET_CONFIG TYPE_SEND_TICK TYPE_SYNC
-       TYPE_GET_BINDING_STATE)
+       TYPE_GET_BINDING_STATE TYPE_GET_STATS TYPE_GET_TREE_PATCH
+       TYPE_SET_ENCODING TYPE_GET_TRACE)
 ] );
 
 our @EXPORT_OK = ( @{ $EXPORT_TAGS{all} } );
@@ -125,6 +130,7 @@ my %events = (
     binding => ($event_mask | 5),
     shutdown => ($event_mask | 6),
     tick => ($event_mask | 7),
+    tree_patch => ($event_mask | 8),
     _error => 0xFFFFFFFF,
 );
 
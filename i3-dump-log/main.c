@@ -13,29 +13,43 @@
 #include "shmlog.h"
 
 #include <err.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <i3/ipc.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
-#include <sys/socket.h>
-#include <sys/un.h>
-
-static uint32_t wrap_count;
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 static i3_shmlog_header *header;
-static char *logbuffer,
-    *walk;
+static char *logbuffer;
+static size_t logbuffer_size;
 static int ipcfd = -1;
 
+static const char *category_names[] = {I3_SHMLOG_CATEGORY_NAMES};
+#define NUM_CATEGORIES (sizeof(category_names) / sizeof(category_names[0]))
+
+/* Records below this level and debug records of categories which are not in
+ * this bitmask are not printed. */
+static uint8_t min_level = I3_SHMLOG_DEBUG;
+static uint32_t categories = UINT32_MAX;
+
+/* Whether we are waiting for i3 (and counted in notify_waiters). */
+static volatile sig_atomic_t waiting = false;
+
 static void disable_shmlog(void) {
     const char *disablecmd = "debuglog off; shmlog off";
     if (ipc_send_message(ipcfd, strlen(disablecmd),
@@ -53,25 +67,353 @@ static void disable_shmlog(void) {
     free(reply);
 }
 
-static int check_for_wrap(void) {
-    if (wrap_count == header->wrap_count) {
+/*
+ * Checks that the format table and the offsets in the header lie within the
+ * log, so that a corrupt log (e.g. a file given with -i) cannot make us read
+ * beyond it. The version needs to be checked before.
+ *
+ */
+static bool header_is_valid(void) {
+    if (header->size != logbuffer_size) {
+        return false;
+    }
+    if (header->formats_offset < sizeof(i3_shmlog_header) ||
+        header->formats_offset > logbuffer_size ||
+        header->formats_size > logbuffer_size - header->formats_offset ||
+        header->formats_used > header->formats_size) {
+        return false;
+    }
+    if (header->records_offset < header->formats_offset + header->formats_size ||
+        header->records_offset > logbuffer_size) {
+        return false;
+    }
+    const uint32_t offsets[] = {header->offset_next_write, header->offset_last_wrap, header->offset_oldest};
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        if (offsets[i] < header->records_offset || offsets[i] > logbuffer_size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Formats the message of a record like printf() formatted it in i3 before the
+ * log was stored in binary form: the format is split into its conversion
+ * specifications, which are formatted one by one with the stored arguments.
+ * Returns false if the arguments do not match the format.
+ *
+ */
+static bool format_message(char *out, size_t size, const char *fmt, const uint8_t *args, const uint8_t *args_end) {
+    size_t len = 0;
+    const char *walk = fmt;
+    const char *start;
+    const char *end;
+    int stars;
+    int precision;
+    printf_arg_t type;
+
+#define APPEND(n)           \
+    do {                    \
+        if ((n) < 0) {      \
+            return false;   \
+        }                   \
+        len += (n);         \
+        if (len >= size) {  \
+            len = size - 1; \
+        }                   \
+    } while (0)
+#define READ_ARG(ctype, var)                   \
+    ctype var;                                 \
+    do {                                       \
+        if (args + sizeof(ctype) > args_end) { \
+            return false;                      \
+        }                                      \
+        memcpy(&var, args, sizeof(ctype));     \
+        args += sizeof(ctype);                 \
+    } while (0)
+#define FORMAT_ARG(value)                                                           \
+    do {                                                                            \
+        if (stars == 0) {                                                           \
+            APPEND(snprintf(out + len, size - len, spec, value));                   \
+        } else if (stars == 1) {                                                    \
+            APPEND(snprintf(out + len, size - len, spec, star[0], value));          \
+        } else {                                                                    \
+            APPEND(snprintf(out + len, size - len, spec, star[0], star[1], value)); \
+        }                                                                           \
+    } while (0)
+
+    while ((start = printf_next_conversion(walk, &end, &stars, &precision, &type)) != NULL) {
+        APPEND(snprintf(out + len, size - len, "%.*s", (int)(start - walk), walk));
+        walk = end;
+
+        char spec[64];
+        if (type == PRINTF_ARG_INVALID || end - start >= (ptrdiff_t)sizeof(spec) || stars > 2) {
+            return false;
+        }
+        memcpy(spec, start, end - start);
+        spec[end - start] = '\0';
+
+        int star[2];
+        for (int i = 0; i < stars; i++) {
+            READ_ARG(int, value);
+            star[i] = value;
+        }
+
+        switch (type) {
+            case PRINTF_ARG_NONE:
+                APPEND(snprintf(out + len, size - len, "%%"));
+                break;
+            case PRINTF_ARG_INT: {
+                READ_ARG(int, value);
+                FORMAT_ARG(value);
+                break;
+            }
+            case PRINTF_ARG_LONG: {
+                READ_ARG(long, value);
+                FORMAT_ARG(value);
+                break;
+            }
+            case PRINTF_ARG_LLONG: {
+                READ_ARG(long long, value);
+                FORMAT_ARG(value);
+                break;
+            }
+            case PRINTF_ARG_SIZE: {
+                READ_ARG(size_t, value);
+                FORMAT_ARG(value);
+                break;
+            }
+            case PRINTF_ARG_INTMAX: {
+                READ_ARG(intmax_t, value);
+                FORMAT_ARG(value);
+                break;
+            }
+            case PRINTF_ARG_PTRDIFF: {
+                READ_ARG(ptrdiff_t, value);
+                FORMAT_ARG(value);
+                break;
+            }
+            case PRINTF_ARG_DOUBLE: {
+                READ_ARG(double, value);
+                FORMAT_ARG(value);
+                break;
+            }
+            case PRINTF_ARG_POINTER: {
+                READ_ARG(void *, value);
+                FORMAT_ARG(value);
+                break;
+            }
+            case PRINTF_ARG_STRING: {
+                const uint8_t *nul = memchr(args, '\0', args_end - args);
+                if (nul == NULL) {
+                    return false;
+                }
+                FORMAT_ARG((const char *)args);
+                args = nul + 1;
+                break;
+            }
+            case PRINTF_ARG_INVALID:
+                return false;
+        }
+    }
+    APPEND(snprintf(out + len, size - len, "%s", walk));
+
+#undef FORMAT_ARG
+#undef READ_ARG
+#undef APPEND
+    return true;
+}
+
+/*
+ * Prints a record like i3 used to log it: the time, followed by the formatted
+ * message. Returns the size of the record or 0 if it is malformed.
+ *
+ */
+static uint16_t print_record(const char *walk, const char *limit) {
+    /* Copy the record, so that i3 cannot change it while it is formatted. */
+    static uint8_t record[I3_SHMLOG_MAX_RECORD] __attribute__((aligned(8)));
+    if (limit - walk < (ptrdiff_t)sizeof(i3_shmlog_record)) {
         return 0;
     }
+    const uint16_t size = ((const i3_shmlog_record *)walk)->size;
+    if (size < sizeof(i3_shmlog_record) || size > sizeof(record) || size > limit - walk) {
+        return 0;
+    }
+    memcpy(record, walk, size);
+    const i3_shmlog_record *r = (const i3_shmlog_record *)record;
+
+    if (r->level < min_level ||
+        (r->level == I3_SHMLOG_DEBUG && !(categories & (UINT32_C(1) << (r->category % 32))))) {
+        return size;
+    }
+
+    const uint32_t formats_used = __atomic_load_n(&(header->formats_used), __ATOMIC_ACQUIRE);
+    if (formats_used > header->formats_size || r->format >= formats_used) {
+        return 0;
+    }
+    /* The format has to end within the table. */
+    const char *fmt = logbuffer + header->formats_offset + r->format;
+    if (memchr(fmt, '\0', formats_used - r->format) == NULL) {
+        return 0;
+    }
+
+    static char message[4096];
+    const int64_t nsec = (int64_t)r->timestamp + header->realtime_offset;
+    const time_t t = nsec / 1000000000;
+    struct tm result;
+    size_t len = strftime(message, sizeof(message), "%x %X - ", localtime_r(&t, &result));
+    if (!format_message(message + len, sizeof(message) - len, fmt,
+                        record + sizeof(i3_shmlog_record), record + size)) {
+        snprintf(message + len, sizeof(message) - len, "(malformed log record for \"%s\")\n", fmt);
+    }
+    swrite(STDOUT_FILENO, message, strlen(message));
+    return size;
+}
+
+/*
+ * Prints the records between the given byte offsets of the log.
+ *
+ */
+static void print_records(uint32_t from, uint32_t to) {
+    if (from < header->records_offset || to > logbuffer_size || from > to) {
+        return;
+    }
+    const char *walk = logbuffer + from;
+    const char *limit = logbuffer + to;
+    while (walk < limit) {
+        const uint16_t size = print_record(walk, limit);
+        if (size == 0) {
+            break;
+        }
+        walk += size;
+    }
+}
 
-    /* The log wrapped. Print the remaining content and reset walk to the top
-     * of the log. */
-    wrap_count = header->wrap_count;
-    const int len = (logbuffer + header->offset_last_wrap) - walk;
-    swrite(STDOUT_FILENO, walk, len);
-    walk = logbuffer + sizeof(i3_shmlog_header);
-    return 1;
+/*
+ * Parses a comma-separated list of category names into a bitmask.
+ *
+ */
+static uint32_t parse_categories(const char *list) {
+    uint32_t result = 0;
+    char *copy = sstrdup(list);
+    for (char *name = strtok(copy, ","); name != NULL; name = strtok(NULL, ",")) {
+        size_t i;
+        for (i = 0; i < NUM_CATEGORIES; i++) {
+            if (strcasecmp(name, category_names[i]) == 0) {
+                break;
+            }
+        }
+        if (i == NUM_CATEGORIES) {
+            errx(EXIT_FAILURE, "Unknown log category \"%s\"", name);
+        }
+        result |= (UINT32_C(1) << i);
+    }
+    free(copy);
+    return result;
 }
 
-static void print_till_end(void) {
-    check_for_wrap();
-    const int len = (logbuffer + header->offset_next_write) - walk;
-    swrite(STDOUT_FILENO, walk, len);
-    walk += len;
+static uint8_t parse_level(const char *name) {
+    if (strcasecmp(name, "debug") == 0) {
+        return I3_SHMLOG_DEBUG;
+    } else if (strcasecmp(name, "info") == 0) {
+        return I3_SHMLOG_INFO;
+    } else if (strcasecmp(name, "error") == 0) {
+        return I3_SHMLOG_ERROR;
+    }
+    errx(EXIT_FAILURE, "Unknown log level \"%s\" (use debug, info or error)", name);
+}
+
+/*
+ * Waits until i3 wrote new records (or a second passed). On Linux, this
+ * sleeps on the notify_sequence futex, which i3 only wakes up if a reader is
+ * waiting. Elsewhere, the log is polled.
+ *
+ */
+static void wait_for_records(uint32_t sequence) {
+#if defined(__linux__)
+    waiting = true;
+    __atomic_add_fetch(&(header->notify_waiters), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(header->notify_sequence), __ATOMIC_SEQ_CST) == sequence) {
+        const struct timespec timeout = {1, 0};
+        syscall(SYS_futex, &(header->notify_sequence), FUTEX_WAIT, sequence, &timeout, NULL, 0);
+    }
+    __atomic_sub_fetch(&(header->notify_waiters), 1, __ATOMIC_SEQ_CST);
+    waiting = false;
+#else
+    const struct timespec interval = {0, 100 * 1000 * 1000};
+    if (__atomic_load_n(&(header->notify_sequence), __ATOMIC_ACQUIRE) == sequence) {
+        nanosleep(&interval, NULL);
+    }
+#endif
+}
+
+/*
+ * Makes sure that i3 does not keep waking us up after we were killed while
+ * waiting (e.g. by ^C or because the reading end of the pipe was closed).
+ *
+ */
+static void handle_exit_signal(int sig) {
+    if (waiting) {
+        __atomic_sub_fetch(&(header->notify_waiters), 1, __ATOMIC_SEQ_CST);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/*
+ * Prints the records which i3 writes from now on, starting at the given
+ * offset, until i3 closes the log or exits.
+ *
+ */
+static void follow(uint32_t offset, uint32_t wraps) {
+    signal(SIGINT, handle_exit_signal);
+    signal(SIGTERM, handle_exit_signal);
+    signal(SIGHUP, handle_exit_signal);
+    signal(SIGPIPE, handle_exit_signal);
+
+    for (;;) {
+        const uint32_t sequence = __atomic_load_n(&(header->notify_sequence), __ATOMIC_ACQUIRE);
+
+        /* Read the offsets again if i3 wrapped in between. */
+        uint32_t wrap_count, next_write, last_wrap, oldest;
+        do {
+            wrap_count = __atomic_load_n(&(header->wrap_count), __ATOMIC_ACQUIRE);
+            next_write = __atomic_load_n(&(header->offset_next_write), __ATOMIC_ACQUIRE);
+            last_wrap = header->offset_last_wrap;
+            oldest = header->offset_oldest;
+        } while (wrap_count != __atomic_load_n(&(header->wrap_count), __ATOMIC_ACQUIRE));
+
+        if (wrap_count != wraps) {
+            /* Print the rest of the records before the wrap, unless i3
+             * overwrote them already. */
+            if (wrap_count == wraps + 1 && offset >= oldest) {
+                print_records(offset, last_wrap);
+            } else {
+                const char *marker = "[i3-dump-log] Messages are missing: i3 overwrote them before they were read.\n";
+                swrite(STDOUT_FILENO, marker, strlen(marker));
+                if (wrap_count == wraps + 1) {
+                    print_records(oldest, last_wrap);
+                }
+            }
+            offset = header->records_offset;
+            wraps = wrap_count;
+        }
+
+        if (next_write > offset) {
+            print_records(offset, next_write);
+            offset = next_write;
+        }
+
+        if (__atomic_load_n(&(header->closed), __ATOMIC_ACQUIRE)) {
+            return;
+        }
+
+        wait_for_records(sequence);
+
+        if (kill(header->pid, 0) == -1 && errno == ESRCH) {
+            return;
+        }
+    }
 }
 
 void errorlog(char *fmt, ...) {
@@ -85,25 +427,23 @@ void errorlog(char *fmt, ...) {
 int main(int argc, char *argv[]) {
     int o, option_index = 0;
     bool verbose = false;
-#if !defined(__OpenBSD__)
-    bool follow = false;
-#endif
+    bool raw = false;
+    char *input = NULL;
+    bool follow_log = false;
 
     static struct option long_options[] = {
         {"version", no_argument, 0, 'v'},
         {"verbose", no_argument, 0, 'V'},
-#if !defined(__OpenBSD__)
         {"follow", no_argument, 0, 'f'},
-#endif
+        {"level", required_argument, 0, 'l'},
+        {"categories", required_argument, 0, 'c'},
+        {"raw", no_argument, 0, 'r'},
+        {"input", required_argument, 0, 'i'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
 
-#if !defined(__OpenBSD__)
-    char *options_string = "s:vfVh";
-#else
-    char *options_string = "vVh";
-#endif
+    char *options_string = "s:vfVl:c:ri:h";
 
     while ((o = getopt_long(argc, argv, options_string, long_options, &option_index)) != -1) {
         if (o == 'v') {
@@ -111,21 +451,60 @@ int main(int argc, char *argv[]) {
             return 0;
         } else if (o == 'V') {
             verbose = true;
-#if !defined(__OpenBSD__)
         } else if (o == 'f') {
-            follow = true;
-#endif
+            follow_log = true;
+        } else if (o == 'l') {
+            min_level = parse_level(optarg);
+        } else if (o == 'c') {
+            categories = parse_categories(optarg);
+        } else if (o == 'r') {
+            raw = true;
+        } else if (o == 'i') {
+            input = optarg;
         } else if (o == 'h') {
             printf("i3-dump-log " I3_VERSION "\n");
-#if !defined(__OpenBSD__)
-            printf("i3-dump-log [-fhVv]\n");
-#else
-            printf("i3-dump-log [-hVv]\n");
-#endif
+            printf("i3-dump-log [-fhVvr] [-l debug|info|error] [-c <category>[,<category>...]] [-i <file>]\n");
             return 0;
         }
     }
 
+    if (follow_log && (raw || input != NULL)) {
+        errx(EXIT_FAILURE, "-f cannot be combined with -r or -i");
+    }
+
+    if (input != NULL) {
+        /* A copy of the log made with -r, e.g. by somebody else. */
+        int fd = open(input, O_RDONLY);
+        if (fd == -1) {
+            err(EXIT_FAILURE, "open(%s)", input);
+        }
+        struct stat statbuf;
+        if (fstat(fd, &statbuf) != 0) {
+            err(EXIT_FAILURE, "stat(%s)", input);
+        }
+        logbuffer = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (logbuffer == MAP_FAILED) {
+            err(EXIT_FAILURE, "Could not mmap %s", input);
+        }
+        close(fd);
+        logbuffer_size = statbuf.st_size;
+        header = (i3_shmlog_header *)logbuffer;
+        if (logbuffer_size < sizeof(i3_shmlog_header) ||
+            header->version != I3_SHMLOG_VERSION ||
+            !header_is_valid()) {
+            errx(EXIT_FAILURE, "%s is not a copy of an i3 log of this version (see -r).", input);
+        }
+        if (raw) {
+            swrite(STDOUT_FILENO, logbuffer, logbuffer_size);
+            return 0;
+        }
+        if (header->wrap_count > 0) {
+            print_records(header->offset_oldest, header->offset_last_wrap);
+        }
+        print_records(header->records_offset, header->offset_next_write);
+        return 0;
+    }
+
     char *shmname = root_atom_contents("I3_SHMLOG_PATH", NULL, 0);
     if (shmname == NULL) {
         /* Something failed. Let’s invest a little effort to find out what it
@@ -184,8 +563,10 @@ int main(int argc, char *argv[]) {
 
     struct stat statbuf;
 
-    /* NB: While we must never write, we need O_RDWR for the pthread condvar. */
-    int logbuffer_shm = shm_open(shmname, O_RDWR, 0);
+    /* NB: We must never write to the log, except for registering as a
+     * waiter in the header when following the log. Only then the log is
+     * opened for writing. */
+    int logbuffer_shm = shm_open(shmname, (follow_log ? O_RDWR : O_RDONLY), 0);
     if (logbuffer_shm == -1) {
         err(EXIT_FAILURE, "Could not shm_open SHM segment for the i3 log (%s)", shmname);
     }
@@ -194,82 +575,58 @@ int main(int argc, char *argv[]) {
         err(EXIT_FAILURE, "stat(%s)", shmname);
     }
 
-    logbuffer = mmap(NULL, statbuf.st_size, PROT_READ, MAP_SHARED, logbuffer_shm, 0);
+    const int prot = (follow_log ? PROT_READ | PROT_WRITE : PROT_READ);
+    logbuffer = mmap(NULL, statbuf.st_size, prot, MAP_SHARED, logbuffer_shm, 0);
     if (logbuffer == MAP_FAILED) {
         err(EXIT_FAILURE, "Could not mmap SHM segment for the i3 log");
     }
 
     header = (i3_shmlog_header *)logbuffer;
+    logbuffer_size = statbuf.st_size;
 
-    if (verbose) {
-        printf("next_write = %d, last_wrap = %d, logbuffer_size = %d, shmname = %s\n",
-               header->offset_next_write, header->offset_last_wrap, header->size, shmname);
+    if ((size_t)statbuf.st_size < sizeof(i3_shmlog_header) ||
+        header->version != I3_SHMLOG_VERSION) {
+        errx(EXIT_FAILURE, "The i3 log (%s) uses a different format than this i3-dump-log. "
+                           "Please use the i3-dump-log of the running i3.",
+             shmname);
     }
-    free(shmname);
-    walk = logbuffer + header->offset_next_write;
-
-    /* We first need to print old content in case there was at least one
-     * wrapping already. */
-
-    if (*walk != '\0') {
-        /* In case there was a write to the buffer already, skip the first
-         * old line, it very likely is mangled. Not a problem, though, the log
-         * is chatty enough to have plenty lines left. */
-        while (*walk != '\n') {
-            walk++;
-        }
-        walk++;
+    if (!header_is_valid()) {
+        errx(EXIT_FAILURE, "The i3 log (%s) is corrupt.", shmname);
     }
 
-    /* In case there was no wrapping, this is a no-op, otherwise it prints the
-     * old lines. */
-    wrap_count = 0;
-    check_for_wrap();
-
-    /* Then start from the beginning and print the newer lines */
-    walk = logbuffer + sizeof(i3_shmlog_header);
-    print_till_end();
+    if (verbose) {
+        printf("next_write = %d, last_wrap = %d, oldest = %d, logbuffer_size = %d, formats_used = %d, shmname = %s\n",
+               header->offset_next_write, header->offset_last_wrap, header->offset_oldest,
+               header->size, header->formats_used, shmname);
+    }
+    free(shmname);
 
-#if !defined(__OpenBSD__)
-    if (!follow) {
+    if (raw) {
+        /* The header, the format table and the records, which i3-dump-log -i
+         * can print later. */
+        swrite(STDOUT_FILENO, logbuffer, logbuffer_size);
         return 0;
     }
 
-    char *log_stream_socket_path = root_atom_contents("I3_LOG_STREAM_SOCKET_PATH", NULL, 0);
-    if (log_stream_socket_path == NULL) {
-        errx(EXIT_FAILURE, "could not determine i3 log stream socket path: possible i3-dump-log and i3 version mismatch");
-    }
+    /* Copy the offsets before printing, so that records which i3 writes in
+     * the meantime do not confuse us. */
+    const uint32_t wrap_count = header->wrap_count;
+    const uint32_t next_write = __atomic_load_n(&(header->offset_next_write), __ATOMIC_ACQUIRE);
+    const uint32_t last_wrap = header->offset_last_wrap;
+    const uint32_t oldest = header->offset_oldest;
 
-    int sockfd = socket(AF_LOCAL, SOCK_STREAM, 0);
-    if (sockfd == -1) {
-        err(EXIT_FAILURE, "Could not create socket");
+    /* We first need to print old records in case there was at least one
+     * wrapping already. */
+    if (wrap_count > 0) {
+        print_records(oldest, last_wrap);
     }
 
-    (void)fcntl(sockfd, F_SETFD, FD_CLOEXEC);
-
-    struct sockaddr_un addr;
-    memset(&addr, 0, sizeof(struct sockaddr_un));
-    addr.sun_family = AF_LOCAL;
-    strncpy(addr.sun_path, log_stream_socket_path, sizeof(addr.sun_path) - 1);
-    if (connect(sockfd, (const struct sockaddr *)&addr, sizeof(struct sockaddr_un)) < 0) {
-        err(EXIT_FAILURE, "Could not connect to i3 on socket %s", log_stream_socket_path);
-    }
+    /* Then start from the beginning and print the newer records */
+    print_records(header->records_offset, next_write);
 
-    /* Same size as the buffer used in log.c vlog(): */
-    char buf[4096];
-    for (;;) {
-        const int n = read(sockfd, buf, sizeof(buf));
-        if (n == -1) {
-            err(EXIT_FAILURE, "read(log-stream-socket):");
-        }
-        if (n == 0) {
-            exit(0); /* i3 closed the socket */
-        }
-        buf[n] = '\0';
-        swrite(STDOUT_FILENO, buf, n);
+    if (follow_log) {
+        follow(next_write, wrap_count);
     }
-
-#endif
     exit(0);
     return 0;
 }
@@ -80,17 +80,18 @@ typedef struct config_t {
 extern config_t config;
 
 /**
- * Parse the received bar configuration JSON string
+ * Parse the received bar configuration JSON string (or its CBOR encoding if
+ * cbor is true)
  *
  */
-void parse_config_json(const unsigned char *json, size_t size);
+void parse_config_json(const unsigned char *json, size_t size, bool cbor);
 
 /**
  * Parse the received bar configuration list. The only usecase right now is to
  * automatically get the first bar id.
  *
  */
-void parse_get_first_i3bar_config(const unsigned char *json, size_t size);
+void parse_get_first_i3bar_config(const unsigned char *json, size_t size, bool cbor);
 
 /**
  * free()s the color strings as soon as they are not needed anymore.
@@ -24,7 +24,7 @@ struct mode {
 typedef struct mode mode;
 
 /*
- * Parse the received JSON string
+ * Parse the received JSON string (or its CBOR encoding if cbor is true)
  *
  */
-void parse_mode_json(const unsigned char *json, size_t size);
+void parse_mode_json(const unsigned char *json, size_t size, bool cbor);
@@ -22,10 +22,10 @@ SLIST_HEAD(outputs_head, i3_output);
 extern struct outputs_head* outputs;
 
 /*
- * Parse the received JSON string
+ * Parse the received JSON string (or its CBOR encoding if cbor is true)
  *
  */
-void parse_outputs_json(const unsigned char* json, size_t size);
+void parse_outputs_json(const unsigned char* json, size_t size, bool cbor);
 
 /*
  * Initiate the outputs list
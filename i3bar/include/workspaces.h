@@ -18,10 +18,11 @@ typedef struct i3_ws i3_ws;
 TAILQ_HEAD(ws_head, i3_ws);
 
 /*
- * Parse the received JSON string
+ * Parse the received JSON string (or its CBOR encoding if cbor is true, see
+ * I3_IPC_MESSAGE_TYPE_SET_ENCODING)
  *
  */
-void parse_workspaces_json(const unsigned char *json, size_t size);
+void parse_workspaces_json(const unsigned char *json, size_t size, bool cbor);
 
 /*
  * free() all workspace data structures
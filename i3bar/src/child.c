@@ -9,7 +9,6 @@
  */
 #include "common.h"
 #include "queue.h"
-#include "yajl_utils.h"
 
 #include <ctype.h> /* isspace */
 #include <err.h>
@@ -29,6 +28,8 @@
 #include <yajl/yajl_gen.h>
 #include <yajl/yajl_parse.h>
 
+#define ystr(str) yajl_gen_string(gen, (unsigned char *)str, strlen(str))
+
 /* Global variables for child_*() */
 i3bar_child status_child = {0};
 i3bar_child ws_child = {0};
@@ -572,7 +573,7 @@ static void ws_stdin_io_cb(int fd) {
         ws_last_json = append_string(ws_child.pending_line, strings[idx]);
         FREE(ws_child.pending_line);
 
-        parse_workspaces_json((const unsigned char *)ws_last_json, strlen(ws_last_json));
+        parse_workspaces_json((const unsigned char *)ws_last_json, strlen(ws_last_json), false);
     }
 
     g_strfreev(strings);
@@ -602,7 +603,7 @@ static void common_stdin_cb(struct ev_loop *loop, ev_io *watcher, int revents) {
 void repeat_last_ws_json(void) {
     if (ws_last_json) {
         DLOG("Repeating last workspace JSON\n");
-        parse_workspaces_json((const unsigned char *)ws_last_json, strlen(ws_last_json));
+        parse_workspaces_json((const unsigned char *)ws_last_json, strlen(ws_last_json), false);
     }
 }
 
@@ -403,15 +403,17 @@ static yajl_callbacks outputs_callbacks = {
 };
 
 /*
- * Parse the received bar configuration JSON string
+ * Parse the received bar configuration JSON string (or its CBOR encoding if
+ * cbor is true)
  *
  */
-void parse_config_json(const unsigned char *json, size_t size) {
+void parse_config_json(const unsigned char *json, size_t size, bool cbor) {
     TAILQ_INIT(&(config.bindings));
     TAILQ_INIT(&(config.tray_outputs));
 
     yajl_handle handle = yajl_alloc(&outputs_callbacks, NULL, NULL);
-    yajl_status state = yajl_parse(handle, json, size);
+    yajl_status state = (cbor ? cbor_parse(&outputs_callbacks, NULL, json, size)
+                              : yajl_parse(handle, json, size));
 
     /* FIXME: Proper error handling for JSON parsing */
     switch (state) {
@@ -442,10 +444,14 @@ static int i3bar_config_string_cb(void *params_, const unsigned char *val, size_
  * automatically get the first bar id.
  *
  */
-void parse_get_first_i3bar_config(const unsigned char *json, size_t size) {
+void parse_get_first_i3bar_config(const unsigned char *json, size_t size, bool cbor) {
     yajl_callbacks configs_callbacks = {
         .yajl_string = i3bar_config_string_cb,
     };
+    if (cbor) {
+        cbor_parse(&configs_callbacks, NULL, json, size);
+        return;
+    }
     yajl_handle handle = yajl_alloc(&configs_callbacks, NULL, NULL);
     yajl_parse(handle, json, size);
     yajl_free(handle);
@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <yajl/yajl_parse.h>
 #ifdef I3_ASAN_ENABLED
 #include <sanitizer/lsan_interface.h>
 #endif
@@ -24,8 +25,20 @@ ev_io *i3_connection;
 
 const char *sock_path;
 
+/* Whether i3 sends replies and events encoded as CBOR instead of JSON, which
+ * i3bar requests right after connecting (see got_encoding_reply()). */
+static bool cbor_encoding = false;
+
 typedef void (*handler_t)(const unsigned char *, size_t);
 
+/*
+ * Returns the payload for debug logging, which only makes sense for JSON.
+ *
+ */
+static const char *loggable(const unsigned char *payload) {
+    return (cbor_encoding ? "(CBOR)" : (const char *)payload);
+}
+
 /*
  * Returns true when i3bar is configured to read workspace information from i3
  * via JSON over the i3 IPC interface, as opposed to reading workspace
@@ -51,7 +64,7 @@ static void got_command_reply(const unsigned char *reply, size_t size) {
  */
 static void got_workspace_reply(const unsigned char *reply, size_t size) {
     DLOG("Got workspace data!\n");
-    parse_workspaces_json(reply, size);
+    parse_workspaces_json(reply, size, cbor_encoding);
     draw_bars(false);
 }
 
@@ -61,7 +74,7 @@ static void got_workspace_reply(const unsigned char *reply, size_t size) {
  *
  */
 static void got_subscribe_reply(const unsigned char *reply, size_t size) {
-    DLOG("Got subscribe reply: %s\n", reply);
+    DLOG("Got subscribe reply: %s\n", loggable(reply));
     /* TODO: Error handling for subscribe commands */
 }
 
@@ -74,7 +87,7 @@ static void got_output_reply(const unsigned char *reply, size_t size) {
     free_outputs();
 
     DLOG("Parsing outputs JSON...\n");
-    parse_outputs_json(reply, size);
+    parse_outputs_json(reply, size, cbor_encoding);
     DLOG("Reconfiguring windows...\n");
     reconfig_windows(false);
 
@@ -107,8 +120,8 @@ static void got_output_reply(const unsigned char *reply, size_t size) {
  */
 static void got_bar_config(const unsigned char *reply, size_t size) {
     if (!config.bar_id) {
-        DLOG("Received bar list \"%s\"\n", reply);
-        parse_get_first_i3bar_config(reply, size);
+        DLOG("Received bar list \"%s\"\n", loggable(reply));
+        parse_get_first_i3bar_config(reply, size, cbor_encoding);
 
         if (!config.bar_id) {
             ELOG("No bar configuration found, please configure a bar block in your i3 config file.\n");
@@ -120,14 +133,14 @@ static void got_bar_config(const unsigned char *reply, size_t size) {
         return;
     }
 
-    DLOG("Received bar config \"%s\"\n", reply);
+    DLOG("Received bar config \"%s\"\n", loggable(reply));
     /* We initiate the main function by requesting infos about the outputs and
      * workspaces. Everything else (creating the bars, showing the right workspace-
      * buttons and more) is taken care of by the event-drivenness of the code */
     i3_send_msg(I3_IPC_MESSAGE_TYPE_GET_OUTPUTS, NULL);
 
     free_colors(&(config.colors));
-    parse_config_json(reply, size);
+    parse_config_json(reply, size, cbor_encoding);
 
     /* Now we can actually use 'config', so let's subscribe to the appropriate
      * events and request the workspaces if necessary. */
@@ -146,6 +159,21 @@ static void got_bar_config(const unsigned char *reply, size_t size) {
     start_ws_child(config.workspace_command);
 }
 
+/*
+ * Called, when we get the reply to our request for the CBOR encoding. The
+ * reply is still encoded as JSON, all later replies and events are CBOR. An
+ * older i3 does not reply at all, so JSON is used then.
+ *
+ */
+static void got_encoding_reply(const unsigned char *reply, size_t size) {
+    if (strstr((const char *)reply, "\"success\":true") != NULL) {
+        DLOG("Using the CBOR encoding\n");
+        cbor_encoding = true;
+    } else {
+        ELOG("Could not select the CBOR encoding: %s\n", reply);
+    }
+}
+
 /* Data structure to easily call the reply handlers later */
 handler_t reply_handlers[] = {
     &got_command_reply,   /* I3_IPC_REPLY_TYPE_COMMAND */
@@ -160,6 +188,10 @@ handler_t reply_handlers[] = {
     NULL,                 /* I3_IPC_REPLY_TYPE_CONFIG */
     NULL,                 /* I3_IPC_REPLY_TYPE_TICK */
     NULL,                 /* I3_IPC_REPLY_TYPE_SYNC */
+    NULL,                 /* I3_IPC_REPLY_TYPE_GET_BINDING_STATE */
+    NULL,                 /* I3_IPC_REPLY_TYPE_STATS */
+    NULL,                 /* I3_IPC_REPLY_TYPE_TREE_PATCH */
+    &got_encoding_reply,  /* I3_IPC_REPLY_TYPE_ENCODING */
 };
 
 /*
@@ -186,7 +218,7 @@ static void got_output_event(const unsigned char *event, size_t size) {
  */
 static void got_mode_event(const unsigned char *event, size_t size) {
     DLOG("Got mode event!\n");
-    parse_mode_json(event, size);
+    parse_mode_json(event, size, cbor_encoding);
     draw_bars(false);
 }
 
@@ -202,17 +234,67 @@ static bool strings_differ(char *a, char *b) {
     return strcmp(a, b) != 0;
 }
 
+struct bar_id_params {
+    int depth;
+    bool id_key;
+    bool matches;
+};
+
+static int bar_id_start_map_cb(void *params_) {
+    ((struct bar_id_params *)params_)->depth++;
+    return 1;
+}
+
+static int bar_id_end_map_cb(void *params_) {
+    ((struct bar_id_params *)params_)->depth--;
+    return 1;
+}
+
+static int bar_id_map_key_cb(void *params_, const unsigned char *key, size_t len) {
+    struct bar_id_params *params = params_;
+    params->id_key = (params->depth == 1 && len == strlen("id") && strncmp((const char *)key, "id", len) == 0);
+    return 1;
+}
+
+static int bar_id_string_cb(void *params_, const unsigned char *val, size_t len) {
+    struct bar_id_params *params = params_;
+    if (!params->id_key) {
+        return 1;
+    }
+    params->matches = (strlen(config.bar_id) == len && strncmp((const char *)val, config.bar_id, len) == 0);
+    return 0; /* Stop parsing */
+}
+
+/*
+ * Returns true if the given barconfig_update event is about this bar
+ * instance.
+ *
+ */
+static bool is_our_bar_config(const unsigned char *event, size_t size) {
+    static yajl_callbacks bar_id_callbacks = {
+        .yajl_start_map = bar_id_start_map_cb,
+        .yajl_end_map = bar_id_end_map_cb,
+        .yajl_map_key = bar_id_map_key_cb,
+        .yajl_string = bar_id_string_cb,
+    };
+    struct bar_id_params params = {0};
+    if (cbor_encoding) {
+        cbor_parse(&bar_id_callbacks, &params, event, size);
+    } else {
+        yajl_handle handle = yajl_alloc(&bar_id_callbacks, NULL, &params);
+        yajl_parse(handle, event, size);
+        yajl_free(handle);
+    }
+    return params.matches;
+}
+
 /*
  * Called, when a barconfig_update event arrives (i.e. i3 changed the bar hidden_state or mode)
  *
  */
 static void got_bar_config_update(const unsigned char *event, size_t size) {
     /* check whether this affect this bar instance by checking the bar_id */
-    char *expected_id;
-    sasprintf(&expected_id, "\"id\":\"%s\"", config.bar_id);
-    char *found_id = strstr((const char *)event, expected_id);
-    FREE(expected_id);
-    if (found_id == NULL) {
+    if (!is_our_bar_config(event, size)) {
         return;
     }
 
@@ -222,7 +304,7 @@ static void got_bar_config_update(const unsigned char *event, size_t size) {
     free_colors(&(config.colors));
 
     /* update the configuration with the received settings */
-    DLOG("Received bar config update \"%s\"\n", event);
+    DLOG("Received bar config update \"%s\"\n", loggable(event));
 
     char *old_command = config.command;
     char *old_workspace_command = config.workspace_command;
@@ -230,7 +312,7 @@ static void got_bar_config_update(const unsigned char *event, size_t size) {
     config.workspace_command = NULL;
     bar_display_mode_t old_mode = config.hide_on_modifier;
 
-    parse_config_json(event, size);
+    parse_config_json(event, size, cbor_encoding);
     if (old_mode != config.hide_on_modifier) {
         reconfig_windows(true);
     }
@@ -397,6 +479,10 @@ void init_connection(const char *socket_path) {
     i3_connection = smalloc(sizeof(ev_io));
     ev_io_init(i3_connection, &got_data, sockfd, EV_READ);
     ev_io_start(main_loop, i3_connection);
+
+    /* i3bar parses every workspace and output reply, so save i3 the JSON
+     * formatting and ourselves the JSON parsing. */
+    i3_send_msg(I3_IPC_MESSAGE_TYPE_SET_ENCODING, "cbor");
 }
 
 /*
@@ -95,17 +95,18 @@ static yajl_callbacks mode_callbacks = {
 };
 
 /*
- * Parse the received JSON string
+ * Parse the received JSON string (or its CBOR encoding if cbor is true)
  *
  */
-void parse_mode_json(const unsigned char *json, size_t size) {
+void parse_mode_json(const unsigned char *json, size_t size, bool cbor) {
     struct mode_json_params params;
     mode binding;
     params.cur_key = NULL;
     params.mode = &binding;
 
     yajl_handle handle = yajl_alloc(&mode_callbacks, NULL, (void *)&params);
-    yajl_status state = yajl_parse(handle, json, size);
+    yajl_status state = (cbor ? cbor_parse(&mode_callbacks, (void *)&params, json, size)
+                              : yajl_parse(handle, json, size));
 
     /* FIXME: Proper error handling for JSON parsing */
     switch (state) {
@@ -261,17 +261,18 @@ void init_outputs(void) {
 }
 
 /*
- * Parse the received JSON string
+ * Parse the received JSON string (or its CBOR encoding if cbor is true)
  *
  */
-void parse_outputs_json(const unsigned char *json, size_t size) {
+void parse_outputs_json(const unsigned char *json, size_t size, bool cbor) {
     struct outputs_json_params params;
     params.outputs_walk = NULL;
     params.cur_key = NULL;
     params.in_rect = false;
 
     yajl_handle handle = yajl_alloc(&outputs_callbacks, NULL, (void *)&params);
-    yajl_status state = yajl_parse(handle, json, size);
+    yajl_status state = (cbor ? cbor_parse(&outputs_callbacks, (void *)&params, json, size)
+                              : yajl_parse(handle, json, size));
 
     /* FIXME: Proper errorhandling for JSON-parsing */
     switch (state) {
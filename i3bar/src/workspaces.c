@@ -235,15 +235,17 @@ static yajl_callbacks workspaces_callbacks = {
 };
 
 /*
- * Parse the received JSON string
+ * Parse the received JSON string (or its CBOR encoding if cbor is true, see
+ * I3_IPC_MESSAGE_TYPE_SET_ENCODING)
  *
  */
-void parse_workspaces_json(const unsigned char *json, size_t size) {
+void parse_workspaces_json(const unsigned char *json, size_t size, bool cbor) {
     free_workspaces();
 
     struct workspaces_json_params params = {0};
     yajl_handle handle = yajl_alloc(&workspaces_callbacks, NULL, (void *)&params);
-    yajl_status state = yajl_parse(handle, json, size);
+    yajl_status state = (cbor ? cbor_parse(&workspaces_callbacks, (void *)&params, json, size)
+                              : yajl_parse(handle, json, size));
 
     /* FIXME: Proper error handling for JSON parsing */
     switch (state) {
@@ -251,9 +253,13 @@ void parse_workspaces_json(const unsigned char *json, size_t size) {
             break;
         case yajl_status_client_canceled:
         case yajl_status_error: {
-            unsigned char *err = yajl_get_error(handle, 1, json, size);
-            ELOG("Could not parse workspaces reply, error:\n%s\njson:---%s---\n", err, json);
-            yajl_free_error(handle, err);
+            if (cbor) {
+                ELOG("Could not parse CBOR workspaces reply\n");
+            } else {
+                unsigned char *err = yajl_get_error(handle, 1, json, size);
+                ELOG("Could not parse workspaces reply, error:\n%s\njson:---%s---\n", err, json);
+                yajl_free_error(handle, err);
+            }
 
             if (config.workspace_command) {
                 kill_ws_child();
@@ -34,6 +34,7 @@
 
 #include "libi3.h"
 #include "data.h"
+#include "hashmap.h"
 #include "util.h"
 #include "ipc.h"
 #include "tree.h"
@@ -50,6 +51,7 @@
 #include "drag.h"
 #include "configuration.h"
 #include "handlers.h"
+#include "ignore_events.h"
 #include "randr.h"
 #include "xinerama.h"
 #include "con.h"
@@ -77,4 +79,7 @@
 #include "display_version.h"
 #include "restore_layout.h"
 #include "sync.h"
+#include "tree_patch.h"
+#include "snapshot.h"
+#include "trace.h"
 #include "main.h"
@@ -332,6 +332,18 @@ void cmd_shmlog(I3_CMD, const char *argument);
  */
 void cmd_debuglog(I3_CMD, const char *argument);
 
+/**
+ * Implementation of 'debuglog categories <category>[,<category>...]'
+ *
+ */
+void cmd_debuglog_categories(I3_CMD, const char *categories);
+
+/**
+ * Implementation of 'trace toggle|on|off'
+ *
+ */
+void cmd_trace(I3_CMD, const char *argument);
+
 /**
  * Implementation of 'gaps inner|outer|top|right|bottom|left|horizontal|vertical current|all set|plus|minus|toggle <px>'
  *
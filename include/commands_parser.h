@@ -11,7 +11,7 @@
 
 #include <config.h>
 
-#include <yajl/yajl_gen.h>
+#include "ipc_gen.h"
 
 /**
  * Holds an intermediate representation of the result of a call to any command.
@@ -19,8 +19,8 @@
  * internally use this struct when calling cmd_floating and cmd_border.
  */
 struct CommandResultIR {
-    /* The JSON generator to append a reply to (may be NULL). */
-    yajl_gen json_gen;
+    /* The generator to append a reply to (may be NULL). */
+    ipc_gen json_gen;
 
     /* The IPC client connection which sent this command (may be NULL, e.g. for
        key bindings). */
@@ -59,13 +59,22 @@ struct CommandResult {
 char *parse_string(const char **walk, bool as_word);
 
 /**
- * Parses and executes the given command. If a caller-allocated yajl_gen is
- * passed, a json reply will be generated in the format specified by the ipc
- * protocol. Pass NULL if no json reply is required.
+ * Parses and executes the given command. If a caller-allocated ipc_gen is
+ * passed, a reply will be generated in the format specified by the ipc
+ * protocol. Pass NULL if no reply is required.
  *
  * Free the returned CommandResult with command_result_free().
  */
-CommandResult *parse_command(const char *input, yajl_gen gen, ipc_client *client);
+CommandResult *parse_command(const char *input, ipc_gen gen, ipc_client *client);
+
+/**
+ * Parses criteria like [class="^Firefox$" workspace="3"] with the same grammar
+ * as the criteria of a command into the given (initialized) match, without
+ * executing anything. Returns NULL on success, or an error message, which the
+ * caller has to free.
+ *
+ */
+char *parse_criteria(const char *input, Match *match);
 
 /**
  * Frees a CommandResult
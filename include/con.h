@@ -189,6 +189,35 @@ bool con_inside_focused(Con *con);
  */
 bool con_has_parent(Con *con, Con *parent);
 
+/**
+ * Sets the client window of the given container (or NULL to detach it) and
+ * updates the index used by con_by_window_id().
+ *
+ */
+void con_set_window(Con *con, i3Window *window);
+
+/**
+ * Adds the frame of the given container to the index used by
+ * con_by_frame_id(). Called from x_con_init() once the frame exists.
+ *
+ */
+void con_index_frame(Con *con);
+
+/**
+ * Removes the frame of the given container from the index used by
+ * con_by_frame_id().
+ *
+ */
+void con_unindex_frame(Con *con);
+
+/**
+ * Verifies that the handle table and the window, frame and mark indexes agree
+ * with a walk over all containers. Aborts on mismatch, so only call this in debug
+ * builds.
+ *
+ */
+void con_check_indexes(void);
+
 /**
  * Returns the container with the given client window ID or NULL if no such
  * container exists.
@@ -200,15 +229,20 @@ Con *con_by_window_id(xcb_window_t window);
  * Returns the container with the given container ID or NULL if no such
  * container exists.
  *
+ * Container IDs are the addresses of the containers (see the IPC protocol), so
+ * an ID of a freed container may refer to a new container at the same
+ * address. Resolve IDs right away; code which needs to hold on to a container
+ * stores its handle and uses con_by_handle() instead.
+ *
  */
 Con *con_by_con_id(long target);
 
 /**
- * Returns true if the given container (still) exists.
- * This can be used, e.g., to make sure a container hasn't been closed in the meantime.
+ * Returns the container referenced by the given handle or NULL if that
+ * container has been freed in the meantime.
  *
  */
-bool con_exists(Con *con);
+Con *con_by_handle(con_handle_t handle);
 
 /**
  * Returns the container with the given frame ID or NULL if no such container
@@ -224,6 +258,22 @@ Con *con_by_frame_id(xcb_window_t frame);
  */
 Con *con_by_mark(const char *mark);
 
+/**
+ * Iterates over all marks and the containers holding them, in no particular
+ * order. Start with *iter = 0 and call this function until it returns false.
+ * Marks must not be added or removed while iterating.
+ *
+ */
+bool con_next_mark(uint32_t *iter, const char **mark, Con **con);
+
+/**
+ * Adds every container holding a mark which matches the given regular
+ * expression to 'result' (a hash table with integer keys, mapping each
+ * container to itself). Only the mark index is scanned, not the whole tree.
+ *
+ */
+void con_by_mark_regex(struct regex *regex, struct hashmap *result);
+
 /**
  * Start from a container and traverse the transient_for linked list. Returns
  * true if target window is found in the list. Protects againsts potential
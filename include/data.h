@@ -49,6 +49,7 @@ typedef struct Assignment Assignment;
 typedef struct Window i3Window;
 typedef struct gaps_t gaps_t;
 typedef struct mark_t mark_t;
+typedef struct con_handle_t con_handle_t;
 
 /******************************************************************************
  * Helper types
@@ -172,6 +173,19 @@ typedef enum {
     FOCUS_WRAPPING_WORKSPACE = 3
 } focus_wrapping_t;
 
+/**
+ * A generation-checked reference to a container. Every container occupies one
+ * slot in the handle table while it exists. Freeing the container bumps the
+ * generation of its slot, so a handle which outlived its container never
+ * resolves to another container that happens to reuse the slot (or the same
+ * memory address). See con_by_handle().
+ *
+ */
+struct con_handle_t {
+    uint32_t slot;
+    uint32_t generation;
+};
+
 /**
  * Stores a rectangle, for example the size of a window, the child window etc.
  *
@@ -241,12 +255,17 @@ struct Workspace_Assignment {
     TAILQ_ENTRY(Workspace_Assignment) ws_assignments;
 };
 
+/**
+ * An entry in the ring buffer of ignored sequence numbers, see
+ * src/ignore_events.c.
+ *
+ */
 struct Ignore_Event {
-    int sequence;
+    /* X11 events only contain the lower 16 bits of the sequence number. */
+    uint16_t sequence;
     int response_type;
-    time_t added;
-
-    SLIST_ENTRY(Ignore_Event) ignore_events;
+    /* CLOCK_MONOTONIC timestamp in milliseconds. */
+    uint64_t added;
 };
 
 /**
@@ -643,6 +662,9 @@ struct mark_t {
 struct Con {
     bool mapped;
 
+    /** The slot of this container in the handle table. */
+    con_handle_t handle;
+
     /* Should this container be marked urgent? This gets set when the window
      * inside this container (if any) sets the urgency hint, for example. */
     bool urgent;
@@ -723,6 +745,19 @@ struct Con {
     /** Cache for the decoration rendering */
     struct deco_render_params *deco_render_params;
 
+    /** Only for workspaces: the inputs and side effects of the last render,
+     * so that unchanged workspaces are not laid out again (see render.c). */
+    struct render_cache *render_cache;
+
+    /** The tree_generation at which the IPC serialization of this container
+     * was last seen to change, and a hash of that serialization (see
+     * tree_patch.c). */
+    uint64_t patch_generation;
+    uint64_t patch_fingerprint;
+    /** Only for workspaces: whether the next scan has to compare the
+     * containers on this workspace (see tree_patch_con_changed()). */
+    bool patch_dirty;
+
     /* Only workspace-containers can have floating clients */
     TAILQ_HEAD(floating_head, Con) floating_head;
 
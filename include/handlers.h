@@ -18,28 +18,33 @@ extern int randr_base;
 extern int xkb_base;
 extern int shape_base;
 
-/**
- * Adds the given sequence to the list of events which are ignored.
- * If this ignore should only affect a specific response_type, pass
- * response_type, otherwise, pass -1.
- *
- * Every ignored sequence number gets garbage collected after 5 seconds.
- *
- */
-void add_ignore_event(const int sequence, const int response_type);
+/** Statistics about handling PropertyNotify events, reported by the GET_STATS
+ * IPC message. */
+struct property_stats {
+    /** Number of PropertyNotify events for properties i3 handles. */
+    uint64_t notifies;
+    /** Number of batches of PropertyNotify events which needed at least one
+     * property to be requested. */
+    uint64_t batches;
+    /** Number of GetProperty requests sent for all batches. */
+    uint64_t requests;
+};
+extern struct property_stats property_stats;
 
 /**
- * Checks if the given sequence is ignored and returns true if so.
+ * Takes an xcb_generic_event_t and calls the appropriate handler, based on the
+ * event type.
  *
  */
-bool event_is_ignored(const int sequence, const int response_type);
+void handle_event(int type, xcb_generic_event_t *event);
 
 /**
- * Takes an xcb_generic_event_t and calls the appropriate handler, based on the
- * event type.
+ * Handles all PropertyNotify events which were collected since the last call.
+ * The properties are requested from X11 all at once, before waiting for the
+ * first reply.
  *
  */
-void handle_event(int type, xcb_generic_event_t *event);
+void handle_pending_property_notifies(void);
 
 /**
  * Sets the appropriate atoms for the property handlers after the atoms were
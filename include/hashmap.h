@@ -0,0 +1,88 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * hashmap.c: A small open-addressing hash table, used to index containers
+ *            (and other objects) by X11 window ID, pointer or name.
+ *
+ */
+#pragma once
+
+#include <config.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Converts an integer (like an xcb_window_t) into a key for hash tables with
+ * integer keys. The key 0 is reserved and must not be used. */
+#define HASHMAP_INT_KEY(x) ((const void *)(uintptr_t)(x))
+
+struct hashmap_entry {
+    const void *key;
+    void *value;
+};
+
+/**
+ * A hash table mapping keys to pointers. Keys are either integers (see
+ * HASHMAP_INT_KEY) or NUL-terminated strings. For string keys, the hash table
+ * does not copy the key, so the caller has to make sure it stays valid for as
+ * long as the entry exists (usually by pointing into the stored value).
+ *
+ * A zero-initialized struct hashmap (see HASHMAP_INITIALIZER) is a valid,
+ * empty hash table; memory is only allocated on the first insert.
+ *
+ */
+struct hashmap {
+    bool string_keys;
+    uint32_t size;
+    /* Number of slots. Always 0 or a power of two. */
+    uint32_t capacity;
+    struct hashmap_entry *entries;
+};
+
+#define HASHMAP_INITIALIZER(strings) \
+    { .string_keys = (strings), .size = 0, .capacity = 0, .entries = NULL }
+
+/**
+ * Returns the value stored for the given key or NULL if there is no such
+ * entry.
+ *
+ */
+void *hashmap_get(struct hashmap *map, const void *key);
+
+/**
+ * Stores value for the given key, replacing any previous entry.
+ *
+ */
+void hashmap_put(struct hashmap *map, const void *key, void *value);
+
+/**
+ * Removes the entry for the given key and returns its value (or NULL if there
+ * was no such entry).
+ *
+ */
+void *hashmap_remove(struct hashmap *map, const void *key);
+
+/**
+ * Removes the entry for the given key, but only if it currently maps to the
+ * given value. Returns true if an entry was removed.
+ *
+ */
+bool hashmap_remove_value(struct hashmap *map, const void *key, void *value);
+
+/**
+ * Iterates over all entries. Start with *iter = 0 and call this function until
+ * it returns false. The hash table must not be modified while iterating.
+ *
+ */
+bool hashmap_next(struct hashmap *map, uint32_t *iter, const void **key, void **value);
+
+/**
+ * Frees all memory used by the hash table and resets it to an empty state.
+ * The stored values are not freed.
+ *
+ */
+void hashmap_clear(struct hashmap *map);
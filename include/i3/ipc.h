@@ -69,6 +69,18 @@ typedef struct i3_ipc_header {
 /** Request the current binding state. */
 #define I3_IPC_MESSAGE_TYPE_GET_BINDING_STATE 12
 
+/** Request statistics about i3 internals. */
+#define I3_IPC_MESSAGE_TYPE_GET_STATS 13
+
+/** Request the changes of the tree since a given generation. */
+#define I3_IPC_MESSAGE_TYPE_GET_TREE_PATCH 14
+
+/** Select the encoding (JSON or CBOR) of replies and events. */
+#define I3_IPC_MESSAGE_TYPE_SET_ENCODING 15
+
+/** Request the recorded trace spans (see the trace command). */
+#define I3_IPC_MESSAGE_TYPE_GET_TRACE 16
+
 /*
  * Messages from i3 to clients
  *
@@ -86,6 +98,10 @@ typedef struct i3_ipc_header {
 #define I3_IPC_REPLY_TYPE_TICK 10
 #define I3_IPC_REPLY_TYPE_SYNC 11
 #define I3_IPC_REPLY_TYPE_GET_BINDING_STATE 12
+#define I3_IPC_REPLY_TYPE_STATS 13
+#define I3_IPC_REPLY_TYPE_TREE_PATCH 14
+#define I3_IPC_REPLY_TYPE_ENCODING 15
+#define I3_IPC_REPLY_TYPE_TRACE 16
 
 /*
  * Events from i3 to clients. Events have the first bit set high.
@@ -116,3 +132,6 @@ typedef struct i3_ipc_header {
 
 /** The tick event will be sent upon a tick IPC message */
 #define I3_IPC_EVENT_TICK (I3_IPC_EVENT_MASK | 7)
+
+/** The tree_patch event will be triggered upon changes of the tree */
+#define I3_IPC_EVENT_TREE_PATCH (I3_IPC_EVENT_MASK | 8)
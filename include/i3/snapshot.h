@@ -0,0 +1,118 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * This public header defines the format of the state snapshot, which i3
+ * publishes in a POSIX shared memory segment whenever it changed. The name of
+ * the segment is stored in the I3_SNAPSHOT_PATH property of the root window
+ * (see docs/ipc for more information).
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+
+/** "i3sn", to recognize the segment. */
+#define I3_SNAPSHOT_MAGIC 0x6e733369
+
+/** Changes whenever the format changes incompatibly. */
+#define I3_SNAPSHOT_VERSION 1
+
+/** Index value which refers to no record (e.g. the workspace of a window in
+ * the scratchpad). */
+#define I3_SNAPSHOT_NONE UINT32_MAX
+
+/* Flags of workspaces and windows. */
+#define I3_SNAPSHOT_FOCUSED (1 << 0)
+#define I3_SNAPSHOT_URGENT (1 << 1)
+#define I3_SNAPSHOT_VISIBLE (1 << 2)
+#define I3_SNAPSHOT_FLOATING (1 << 3)
+#define I3_SNAPSHOT_FULLSCREEN (1 << 4)
+
+/*
+ * The segment starts with this header, followed by the records and strings
+ * at the given offsets. All integers use the byte order of the machine i3
+ * runs on.
+ *
+ * Readers have to follow the seqlock protocol: read sequence (with acquire
+ * semantics) and retry later if it is odd (i3 is writing). Then copy the
+ * snapshot (first checking that size does not exceed the mapped length,
+ * otherwise map the segment again with the new size), issue an acquire
+ * fence and read sequence again. If it changed, the copy is inconsistent and
+ * has to be repeated. The segment never shrinks.
+ *
+ */
+typedef struct i3_snapshot_header {
+    uint32_t sequence;
+    uint32_t magic;
+    uint32_t version;
+    /* The size of the snapshot (header, records and strings) in bytes. */
+    uint32_t size;
+
+    /* The tree generation the snapshot reflects (see GET_TREE_PATCH). */
+    uint64_t generation;
+    /* The ID of the focused container (as in GET_TREE). */
+    uint64_t focused;
+
+    uint32_t num_outputs;
+    uint32_t num_workspaces;
+    uint32_t num_windows;
+    uint32_t strings_size;
+
+    /* Byte offsets from the start of the segment. */
+    uint32_t outputs_offset;
+    uint32_t workspaces_offset;
+    uint32_t windows_offset;
+    /* NUL-terminated UTF-8 strings. String fields of records are byte
+     * offsets relative to strings_offset. */
+    uint32_t strings_offset;
+} i3_snapshot_header;
+
+typedef struct i3_snapshot_rect {
+    int32_t x;
+    int32_t y;
+    uint32_t width;
+    uint32_t height;
+} i3_snapshot_rect;
+
+typedef struct i3_snapshot_output {
+    /* The ID of the output container. */
+    uint64_t id;
+    uint32_t name;
+    /* Index of the visible workspace on this output. */
+    uint32_t current_workspace;
+    i3_snapshot_rect rect;
+} i3_snapshot_output;
+
+typedef struct i3_snapshot_workspace {
+    /* The ID of the workspace container. */
+    uint64_t id;
+    uint32_t name;
+    /* The number of the workspace, or -1. */
+    int32_t num;
+    /* Index of the output this workspace is on. */
+    uint32_t output;
+    /* I3_SNAPSHOT_FOCUSED, I3_SNAPSHOT_URGENT, I3_SNAPSHOT_VISIBLE */
+    uint32_t flags;
+    i3_snapshot_rect rect;
+} i3_snapshot_workspace;
+
+typedef struct i3_snapshot_window {
+    /* The ID of the container holding the window. */
+    uint64_t id;
+    /* The X11 window ID. */
+    uint32_t window;
+    /* Index of the workspace this window is on (I3_SNAPSHOT_NONE for
+     * windows in the scratchpad). */
+    uint32_t workspace;
+    uint32_t class_class;
+    uint32_t class_instance;
+    uint32_t title;
+    /* I3_SNAPSHOT_FOCUSED, I3_SNAPSHOT_URGENT, I3_SNAPSHOT_FLOATING,
+     * I3_SNAPSHOT_FULLSCREEN */
+    uint32_t flags;
+    /* The geometry of the container (including decorations). */
+    i3_snapshot_rect rect;
+} i3_snapshot_window;
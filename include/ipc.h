@@ -18,29 +18,110 @@
 #include "data.h"
 #include "tree.h"
 #include "configuration.h"
+#include "ipc_gen.h"
 
 #include "i3/ipc.h"
 
 extern char *current_socketpath;
 
+/* Number of event types (see I3_IPC_EVENT_* in i3/ipc.h). The type of an
+ * event, without I3_IPC_EVENT_MASK, is its index. */
+#define IPC_NUM_EVENTS 9
+
+/* A message payload, shared by all clients with the same encoding to which
+ * the message (e.g. an event) is sent. Freed when the last client has written
+ * it. */
+typedef struct ipc_payload {
+    int refcount;
+    size_t size;
+    uint8_t data[];
+} ipc_payload;
+
+/* The encoding of the replies and events sent to a client (see
+ * I3_IPC_MESSAGE_TYPE_SET_ENCODING). */
+typedef enum {
+    IPC_ENCODING_JSON = 0,
+    IPC_ENCODING_CBOR,
+} ipc_encoding_t;
+
+#define IPC_NUM_ENCODINGS 2
+
+/* What to do when the send queue of a client grows beyond the configured
+ * limit (see ipc_set_queue_limit()). */
+typedef enum {
+    /* Disconnect the client. Clients are also disconnected when nothing could
+     * be written to them for the kill timeout. */
+    IPC_OVERFLOW_KILL = 0,
+    /* Drop all queued events and queue a "resync" event per event type
+     * instead, telling the client to query the current state. */
+    IPC_OVERFLOW_DROP,
+    /* Like IPC_OVERFLOW_DROP, but first replace queued events which are
+     * superseded by a newer event (e.g. an older title change of the same
+     * window). */
+    IPC_OVERFLOW_COALESCE,
+} ipc_overflow_policy_t;
+
+/* A message in the send queue of a client. */
+typedef struct ipc_message {
+    i3_ipc_header_t header;
+    ipc_payload *payload;
+    /* The number of bytes (of the header and the payload) which have already
+     * been written. */
+    size_t written;
+
+    /* For events which supersede earlier events of the same type and change:
+     * the change (e.g. "title") and the container the event refers to, or a
+     * zeroed handle if the event supersedes such events for any container. */
+    const char *supersedes;
+    con_handle_t con;
+    /* For resync events: the number of events which were dropped. */
+    uint32_t dropped;
+
+    TAILQ_ENTRY(ipc_message) messages;
+} ipc_message;
+
 typedef struct ipc_client {
     int fd;
 
-    /* The events which this client wants to receive */
-    int num_events;
-    char **events;
+    /* The events which this client wants to receive: bit n is set if the
+     * client subscribed to the event (I3_IPC_EVENT_MASK | n). */
+    uint32_t events;
 
     /* For clients which subscribe to the tick event: whether the first tick
      * event has been sent by i3. */
     bool first_tick_sent;
 
+    /* For clients which subscribe to the tree_patch event: the generation of
+     * the last tree_patch event sent to this client (0 if none was sent yet,
+     * so that the first one is a full patch). */
+    uint64_t tree_patch_generation;
+
+    ipc_encoding_t encoding;
+
     struct ev_io *read_callback;
     struct ev_io *write_callback;
     struct ev_timer *timeout;
-    uint8_t *buffer;
-    size_t buffer_size;
+    /* Messages which could not be written yet, oldest first. */
+    TAILQ_HEAD(ipc_messages_head, ipc_message) messages;
+    uint32_t num_messages;
+    size_t queued_bytes;
+
+    /* The number of events which were dropped or replaced by newer events
+     * because the client did not keep up (see ipc_overflow_policy_t). */
+    uint64_t dropped;
+    uint64_t coalesced;
+
+    /* Statistics reported by GET_STATS. */
+    time_t connect_time;
+    uint64_t received_messages;
+    /* Bytes which could not be written right away, in total. */
+    uint64_t total_queued_bytes;
+    uint64_t sent_bytes;
+    uint64_t delivered_events;
 
     TAILQ_ENTRY(ipc_client) clients;
+    /* One list of subscribers per event type. */
+    TAILQ_ENTRY(ipc_client) subscribers[IPC_NUM_EVENTS];
 } ipc_client;
 
 /*
@@ -80,12 +161,36 @@ void ipc_new_client(EV_P_ struct ev_io *w, int revents);
  */
 ipc_client *ipc_new_client_on_fd(EV_P_ int fd);
 
+/**
+ * Allocates a generator for the payload of an event of the given type, which
+ * writes the encodings selected by the clients subscribed to it. Free with
+ * ipc_gen_free().
+ *
+ */
+ipc_gen ipc_event_gen_alloc(uint32_t message_type);
+
 /**
  * Sends the specified event to all IPC clients which are currently connected
- * and subscribed to this kind of event.
+ * and subscribed to this kind of event. The payload is taken from gen, which
+ * has to be allocated with ipc_event_gen_alloc().
+ *
+ */
+void ipc_send_event(const char *event, uint32_t message_type, ipc_gen gen);
+
+/**
+ * Returns true if any IPC client is subscribed to the given event type (one of
+ * the I3_IPC_EVENT_* constants).
  *
  */
-void ipc_send_event(const char *event, uint32_t message_type, const char *payload);
+bool ipc_has_subscribers(uint32_t message_type);
+
+/**
+ * Returns true if the payload of an event of the given type has to be built,
+ * because at least one client is subscribed to it. Otherwise, the avoided
+ * serialization is counted (see GET_STATS).
+ *
+ */
+bool ipc_wants_event(uint32_t message_type);
 
 /**
  * Calls to ipc_shutdown() should provide a reason for the shutdown.
@@ -104,13 +209,20 @@ typedef enum {
  */
 void ipc_shutdown(shutdown_reason_t reason, int exempt_fd);
 
-void dump_node(yajl_gen gen, Con *con, bool inplace_restart);
+void dump_node(ipc_gen gen, Con *con, bool inplace_restart);
 
 /**
- * Generates a json workspace event. Returns a dynamically allocated yajl
- * generator. Free with yajl_gen_free().
+ * Like dump_node(), but "nodes" and "floating_nodes" only contain the IDs of
+ * the child containers.
+ *
  */
-yajl_gen ipc_marshal_workspace_event(const char *change, Con *current, Con *old);
+void dump_node_shallow(ipc_gen gen, Con *con);
+
+/**
+ * Generates a workspace event (see ipc_event_gen_alloc()). Returns a
+ * dynamically allocated generator. Free with ipc_gen_free().
+ */
+ipc_gen ipc_marshal_workspace_event(const char *change, Con *current, Con *old);
 
 /**
  * For the workspace events we send, along with the usual "change" field, also
@@ -125,6 +237,14 @@ void ipc_send_workspace_event(const char *change, Con *current, Con *old);
  */
 void ipc_send_window_event(const char *property, Con *con);
 
+/**
+ * Sends a tree_patch event with the changes of the tree since the last
+ * tree_patch event, if there are any. Called before i3 waits for new events,
+ * so that a burst of changes results in a single event.
+ *
+ */
+void ipc_send_tree_patch_event(void);
+
 /**
  * For the barconfig update events, we send the serialized barconfig.
  */
@@ -135,12 +255,32 @@ void ipc_send_barconfig_update_event(Barconfig *barconfig);
  */
 void ipc_send_binding_event(const char *event_type, Binding *bind, const char *modename);
 
+/**
+ * For the output events, we send the change (currently always
+ * "unspecified").
+ */
+void ipc_send_output_event(const char *change);
+
+/**
+ * For the mode events, we send the name of the new binding mode in "change"
+ * and whether it uses pango markup.
+ */
+void ipc_send_mode_event(const char *mode, bool pango_markup);
+
 /**
  * Set the maximum duration that we allow for a connection with an unwriteable
  * socket.
  */
 void ipc_set_kill_timeout(ev_tstamp new);
 
+/**
+ * Set the maximum number of messages which may be queued for a client whose
+ * socket is not writeable, and what to do with clients which exceed it. A
+ * limit of 0 means no limit.
+ *
+ */
+void ipc_set_queue_limit(long limit, ipc_overflow_policy_t policy);
+
 /**
  * Sends a restart reply to the IPC client on the specified fd.
  */
@@ -0,0 +1,67 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * ipc_gen.c: Generates IPC payloads in the encodings selected by the clients
+ *            (JSON and/or CBOR) in a single pass.
+ *
+ */
+#pragma once
+
+#include <config.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <yajl/yajl_gen.h>
+
+#include "libi3.h"
+
+/**
+ * A generator with the interface of yajl_gen (see the y() and ystr() macros
+ * in yajl_utils.h), which writes JSON, CBOR or both. Each payload is thereby
+ * serialized only once, even if it is sent to clients with different
+ * encodings, and never converted from one encoding to the other.
+ *
+ */
+typedef struct ipc_gen {
+    /** NULL if no JSON is written. */
+    yajl_gen json;
+    /** NULL if no CBOR is written. */
+    cbor_gen cbor;
+} *ipc_gen;
+
+/**
+ * Allocates a generator which writes JSON if json is true and CBOR if cbor is
+ * true. Free with ipc_gen_free().
+ *
+ */
+ipc_gen ipc_gen_alloc(bool json, bool cbor);
+void ipc_gen_free(ipc_gen gen);
+
+/**
+ * Returns the JSON written so far (an empty buffer if no JSON is written). The
+ * buffer is owned by the generator.
+ *
+ */
+void ipc_gen_get_buf(ipc_gen gen, const unsigned char **buf, size_t *len);
+
+/**
+ * Returns the CBOR written so far (an empty buffer if no CBOR is written). The
+ * buffer is owned by the generator.
+ *
+ */
+void ipc_gen_get_cbor(ipc_gen gen, const unsigned char **buf, size_t *len);
+
+void ipc_gen_null(ipc_gen gen);
+void ipc_gen_bool(ipc_gen gen, int value);
+void ipc_gen_integer(ipc_gen gen, long long value);
+void ipc_gen_double(ipc_gen gen, double value);
+void ipc_gen_number(ipc_gen gen, const char *number, size_t len);
+void ipc_gen_string(ipc_gen gen, const unsigned char *str, size_t len);
+void ipc_gen_map_open(ipc_gen gen);
+void ipc_gen_map_close(ipc_gen gen);
+void ipc_gen_array_open(ipc_gen gen);
+void ipc_gen_array_close(ipc_gen gen);
@@ -19,6 +19,7 @@
 #include <xcb/xcb.h>
 #include <xcb/xproto.h>
 #include <xcb/xcb_keysyms.h>
+#include <yajl/yajl_parse.h>
 
 #include <pango/pango.h>
 #include <cairo/cairo-xcb.h>
@@ -325,6 +326,92 @@ int ipc_send_message(int sockfd, const uint32_t message_size,
 int ipc_recv_message(int sockfd, uint32_t *message_type,
                      uint32_t *reply_length, uint8_t **reply);
 
+/** A generator which writes CBOR instead of JSON, see cbor_gen_alloc(). */
+typedef struct cbor_gen_t *cbor_gen;
+
+/**
+ * Allocates a generator which writes CBOR (RFC 8949) with the same structure
+ * as the JSON yajl_gen would write for the same calls. Maps and arrays are
+ * encoded with indefinite length, so that they can be written without knowing
+ * the number of their items in advance. Free with cbor_gen_free().
+ *
+ */
+cbor_gen cbor_gen_alloc(void);
+void cbor_gen_free(cbor_gen gen);
+
+/**
+ * Returns the CBOR written so far. The buffer is owned by the generator.
+ *
+ */
+void cbor_gen_get_buf(cbor_gen gen, const unsigned char **buf, size_t *len);
+
+void cbor_gen_null(cbor_gen gen);
+void cbor_gen_bool(cbor_gen gen, int value);
+void cbor_gen_integer(cbor_gen gen, long long value);
+void cbor_gen_double(cbor_gen gen, double value);
+
+/**
+ * Writes a number given as JSON number literal (like yajl_gen_number()), as
+ * integer if it has no fraction or exponent and as double otherwise.
+ *
+ */
+void cbor_gen_number(cbor_gen gen, const char *number, size_t len);
+
+void cbor_gen_string(cbor_gen gen, const unsigned char *str, size_t len);
+void cbor_gen_map_open(cbor_gen gen);
+void cbor_gen_map_close(cbor_gen gen);
+void cbor_gen_array_open(cbor_gen gen);
+void cbor_gen_array_close(cbor_gen gen);
+
+/**
+ * Parses a CBOR document (as sent by i3 to clients which negotiated the binary
+ * encoding, see I3_IPC_MESSAGE_TYPE_SET_ENCODING), calling the given yajl
+ * callbacks just like yajl_parse() would for the equivalent JSON document.
+ * This allows clients to use the same callbacks for both encodings.
+ *
+ * Returns yajl_status_ok on success, yajl_status_client_canceled if a
+ * callback returned 0 and yajl_status_error if the data is not a single,
+ * complete CBOR item which can be represented in JSON.
+ *
+ */
+yajl_status cbor_parse(const yajl_callbacks *callbacks, void *ctx, const uint8_t *data, size_t size);
+
+/** The types of arguments of printf conversions, see
+ * printf_next_conversion(). */
+typedef enum {
+    PRINTF_ARG_NONE = 0, /* "%%" */
+    PRINTF_ARG_INT,      /* also char and short, which are promoted to int */
+    PRINTF_ARG_LONG,
+    PRINTF_ARG_LLONG,
+    PRINTF_ARG_SIZE,
+    PRINTF_ARG_INTMAX,
+    PRINTF_ARG_PTRDIFF,
+    PRINTF_ARG_DOUBLE,
+    PRINTF_ARG_POINTER,
+    PRINTF_ARG_STRING,
+    PRINTF_ARG_INVALID, /* e.g. %n, wide characters or long double */
+} printf_arg_t;
+
+/** The conversion has no precision, see printf_next_conversion(). */
+#define PRINTF_PRECISION_NONE (-1)
+/** The precision is given as int argument ("%.*s"). */
+#define PRINTF_PRECISION_STAR (-2)
+
+/**
+ * Finds the next conversion specification (like "%-5.*s") in a printf format
+ * string. Returns a pointer to its '%' or NULL if there is none. *end is set
+ * to the first byte after the specification, *stars to the number of int
+ * arguments consumed by '*' as field width or precision, *precision to the
+ * precision (PRINTF_PRECISION_NONE if there is none, PRINTF_PRECISION_STAR if
+ * it is the last of the int arguments) and *type to the type of the converted
+ * argument (PRINTF_ARG_NONE for "%%").
+ *
+ * Used to store the arguments of log messages in binary form (see shmlog.h)
+ * and to format them later on.
+ *
+ */
+const char *printf_next_conversion(const char *fmt, const char **end, int *stars, int *precision, printf_arg_t *type);
+
 /**
  * Generates a configure_notify event and sends it to the given window
  * Applications need this to think they’ve configured themselves correctly.
@@ -11,6 +11,8 @@
 
 #include <config.h>
 #include <ev.h>
+#include <stdint.h>
+#include "ipc_gen.h"
 
 /* We will include libi3.h which define its own version of LOG, ELOG.
  * We want *our* version, so we undef the libi3 one. */
@@ -23,11 +25,58 @@
 #if defined(DLOG)
 #undef DLOG
 #endif
+/** Categories of debug log messages, which can be enabled and disabled
+ * separately (see the debuglog command). */
+typedef enum {
+    LOG_GENERAL = (1 << 0),
+    LOG_X = (1 << 1),
+    LOG_RENDER = (1 << 2),
+    LOG_IPC = (1 << 3),
+    LOG_MANAGE = (1 << 4),
+    LOG_BINDINGS = (1 << 5),
+    LOG_RANDR = (1 << 6),
+    LOG_MATCH = (1 << 7),
+    LOG_COMMANDS = (1 << 8),
+    /** Every ignored and checked X11 sequence number (see ignore_events.c),
+     * which is too verbose to be enabled by default. */
+    LOG_SEQUENCES = (1 << 9),
+} log_category_t;
+
+#define LOG_NUM_CATEGORIES 10
+#define LOG_ALL_CATEGORIES ((1 << LOG_NUM_CATEGORIES) - 1)
+/** The categories which are enabled when i3 starts. */
+#define LOG_DEFAULT_CATEGORIES (LOG_ALL_CATEGORIES & ~LOG_SEQUENCES)
+
+/** The categories whose DLOG() calls are compiled in, see the log_categories
+ * meson option. DLOG() calls of other categories are eliminated. */
+#if !defined(I3_LOG_CATEGORIES)
+#define I3_LOG_CATEGORIES LOG_ALL_CATEGORIES
+#endif
+
+/** The category of the DLOG() calls of a source file, which can be defined
+ * before including all.h. */
+#if !defined(LOG_CATEGORY)
+#define LOG_CATEGORY LOG_GENERAL
+#endif
+
+/** The categories whose debug log messages are currently logged: the enabled
+ * categories while debug logging or the SHM log is active, 0 otherwise. */
+extern uint32_t log_active_categories;
+
 /** ##__VA_ARGS__ means: leave out __VA_ARGS__ completely if it is empty, that
    is, delete the preceding comma */
 #define LOG(fmt, ...) verboselog(fmt, ##__VA_ARGS__)
 #define ELOG(fmt, ...) errorlog("ERROR: " fmt, ##__VA_ARGS__)
-#define DLOG(fmt, ...) debuglog("%s:%s:%d - " fmt, __FILE__, __FUNCTION__, __LINE__, ##__VA_ARGS__)
+#define DLOG(fmt, ...) CDLOG(LOG_CATEGORY, fmt, ##__VA_ARGS__)
+/** Logs a debug message of the given category. The arguments are only
+ * evaluated if the category is active. */
+#define CDLOG(category, fmt, ...)                                                       \
+    do {                                                                                \
+        if ((I3_LOG_CATEGORIES & (category)) && (log_active_categories & (category))) { \
+            debuglog_category((category), "%s:%s:%d - " fmt,                            \
+                              __FILE__, __FUNCTION__, __LINE__, ##__VA_ARGS__);         \
+        }                                                                               \
+    } while (0)
 
 extern char *errorfilename;
 extern char *shmlogname;
@@ -81,6 +130,39 @@ void set_verbosity(bool _verbose);
 void debuglog(char *fmt, ...)
     __attribute__((format(printf, 1, 2)));
 
+/**
+ * Logs the given debug message of the given category (see CDLOG()), whose
+ * caller already checked that the category is active.
+ *
+ */
+void debuglog_category(log_category_t category, char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * Enables debug log messages of the given categories (a bitmask of
+ * log_category_t) and disables all others.
+ *
+ */
+void set_log_categories(uint32_t categories);
+
+/**
+ * Returns the enabled debug log categories.
+ *
+ */
+uint32_t get_log_categories(void);
+
+/**
+ * Returns the name of the given category (as used by the debuglog command).
+ *
+ */
+const char *log_category_name(log_category_t category);
+
+/**
+ * Returns the category with the given name or 0 if there is none.
+ *
+ */
+log_category_t log_category_from_name(const char *name);
+
 /**
  * Logs the given message to stdout while prefixing the current time to it.
  *
@@ -104,3 +186,9 @@ void verboselog(char *fmt, ...)
 void purge_zerobyte_logfile(void);
 
 void log_new_client(EV_P_ struct ev_io *w, int revents);
+
+/**
+ * Dumps the clients following the log (e.g. i3-dump-log -f) for GET_STATS.
+ *
+ */
+void dump_log_clients(ipc_gen gen);
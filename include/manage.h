@@ -31,13 +31,32 @@ void manage_existing_windows(xcb_window_t root);
 void restore_geometry(void);
 
 /**
- * Do some sanity checks and then reparent the window.
+ * Queues the window for being managed, without waiting for any replies. The
+ * window is managed by manage_pending_windows() once the replies are
+ * available.
  *
  */
 void manage_window(xcb_window_t window,
                    xcb_get_window_attributes_cookie_t cookie,
                    bool needs_to_be_mapped);
 
+/**
+ * Returns true if manage_window() was called for the given window, but the
+ * window is not managed yet.
+ *
+ */
+bool manage_window_is_pending(xcb_window_t window);
+
+/**
+ * Manages the windows for which manage_window() was called, in the same order.
+ *
+ * If block is false, this stops at the first window whose replies have not
+ * been received yet, so that the event loop is not blocked while waiting for
+ * the X server (and the client). Returns true if any window was handled.
+ *
+ */
+bool manage_pending_windows(bool block);
+
 /**
  * Remanages a window: performs a swallow check and runs assignments.
  * Returns con for the window regardless if it updated.
@@ -42,6 +42,15 @@ void match_copy(Match *dest, Match *src);
  */
 bool match_matches_window(Match *match, i3Window *window);
 
+/**
+ * Check if a match data structure matches the given container, like the
+ * criteria of a command. 'cons_by_mark_match' holds the containers with a
+ * mark matching the mark regex (see con_by_mark_regex()). Containers without a
+ * window only match criteria which do not refer to windows (con_id, con_mark).
+ *
+ */
+bool match_matches_con(Match *match, Con *con, struct hashmap *cons_by_mark_match);
+
 /**
  * Frees the given match. It must not be used afterwards!
  *
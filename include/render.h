@@ -42,6 +42,50 @@ typedef struct render_params {
  */
 void render_con(Con *con);
 
+/**
+ * Set by --verify-render: every incremental render of the whole tree is
+ * followed by a full render, and i3 aborts if the results differ. Tree
+ * patches are verified as well (see tree_patch.c).
+ *
+ */
+extern bool render_verify;
+
+/**
+ * Frees the render cache of the given container (if any).
+ *
+ */
+void render_cache_free(Con *con);
+
+/**
+ * Marks the workspace of the given container as changed, so that the next
+ * render lays it out again instead of keeping its previous layout, and
+ * reports the change to tree_patch_con_changed(). Called wherever an input
+ * of the layout changes (see render.c).
+ *
+ */
+void render_con_changed(Con *con);
+
+/**
+ * Marks all workspaces as changed. Used for changes which influence the
+ * layout of other workspaces than their own, like a container entering or
+ * leaving global fullscreen mode or a changed WM_TRANSIENT_FOR (which decides
+ * whether a floating window is shown above a fullscreen window).
+ *
+ */
+void render_invalidate_all(void);
+
+/**
+ * Marks the given container and its children as unmapped before rendering
+ * the tree, which maps the visible ones again.
+ *
+ * The containers of a workspace which did not change since the last render of
+ * the whole tree (and was rendered in it) keep their mapped state: the next
+ * render will most likely replay the previous one, which maps the same
+ * containers. If it does not, render_con() unmaps them after all.
+ *
+ */
+void mark_unmapped(Con *con);
+
 /**
  * Returns the height for the decorations
  *
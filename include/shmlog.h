@@ -12,27 +12,126 @@
 
 #include <config.h>
 
+#include <stdint.h>
+
 /* Default shmlog size if not set by user. */
 extern const int default_shmlog_size;
 
+/** The version of the format, see i3_shmlog_header. Version 1 stored
+ * formatted lines of text, version 2 had no notification fields. */
+#define I3_SHMLOG_VERSION 3
+
+/** The maximum size of a record (including its arguments) in bytes. */
+#define I3_SHMLOG_MAX_RECORD 4096
+
+/** The names of the log categories, indexed by the category of debug records
+ * (see log_category_t). */
+#define I3_SHMLOG_CATEGORY_NAMES \
+    "general", "x", "render", "ipc", "manage", "bindings", "randr", "match", "commands", "sequences"
+
 /**
  * Header of the shmlog file. Used by i3/src/log.c and i3/i3-dump-log/main.c.
  *
+ * The log consists of binary records (see i3_shmlog_record) in a ringbuffer,
+ * which reference their printf format strings in a separate table. Formatting
+ * the messages is left to the reader, so that logging only copies the
+ * arguments.
+ *
  */
 typedef struct i3_shmlog_header {
-    /* Byte offset where the next line will be written to. */
-    uint32_t offset_next_write;
+    /* Readers of version 1 only know these four fields and print the text
+     * between the end of them and legacy_offset_next_write. i3 makes them
+     * describe legacy_notice, which asks to use a matching i3-dump-log. */
+    uint32_t legacy_offset_next_write;
+    uint32_t legacy_offset_last_wrap;
+    uint32_t legacy_size;
+    uint32_t legacy_wrap_count;
+    char legacy_notice[112];
 
-    /* Byte offset where the last wrap occurred. */
-    uint32_t offset_last_wrap;
+    /* I3_SHMLOG_VERSION. Readers must refuse other versions. */
+    uint32_t version;
 
     /* The size of the logfile in bytes. Since the size is limited to 25 MiB
      * an uint32_t is sufficient. */
     uint32_t size;
 
+    /* Byte offset and size of the table of NUL-terminated format strings,
+     * and the number of bytes of the table which are used so far. Strings
+     * are appended and never change. */
+    uint32_t formats_offset;
+    uint32_t formats_size;
+    uint32_t formats_used;
+
+    /* Byte offset of the ringbuffer, which extends to the end of the file. */
+    uint32_t records_offset;
+
+    /* Byte offset where the next record will be written to. */
+    uint32_t offset_next_write;
+
+    /* Byte offset where the last wrap occurred. */
+    uint32_t offset_last_wrap;
+
+    /* Byte offset of the oldest complete record before offset_last_wrap
+     * which was not overwritten since the last wrap. */
+    uint32_t offset_oldest;
+
     /* wrap counter. We need it to reliably signal to clients that we just
      * wrapped (clients cannot use offset_last_wrap because that might
      * coincidentally be exactly the same as previously). Overflows can happen
      * and don’t matter — clients use an equality check (==). */
     uint32_t wrap_count;
+
+    /* Nanoseconds to add to the timestamp of a record (CLOCK_MONOTONIC) to
+     * get the wall clock time (CLOCK_REALTIME). */
+    int64_t realtime_offset;
+
+    /* Incremented after each record and when the log is closed. Readers
+     * which follow the log wait for it to change (using it as a futex on
+     * Linux), so that i3 does not have to send them the messages. */
+    uint32_t notify_sequence;
+
+    /* The number of readers waiting for notify_sequence to change. i3 only
+     * wakes them up (FUTEX_WAKE) if there are any. */
+    uint32_t notify_waiters;
+
+    /* Set to 1 when i3 stops writing to this log (i3 exits or the SHM log is
+     * disabled). */
+    uint32_t closed;
+
+    /* The process ID of i3, so that readers notice when i3 died. */
+    uint32_t pid;
 } i3_shmlog_header;
+
+/** The log levels of records. */
+typedef enum {
+    I3_SHMLOG_DEBUG = 0,
+    I3_SHMLOG_INFO = 1,
+    I3_SHMLOG_ERROR = 2,
+} i3_shmlog_level;
+
+/**
+ * A record in the ringbuffer of the shmlog. It is followed by the arguments
+ * of its format string in the order in which the format uses them (as found
+ * by printf_next_conversion()), in the native representation of their C types
+ * (e.g. a long for PRINTF_ARG_LONG, a void * for PRINTF_ARG_POINTER). Strings
+ * are stored as NUL-terminated copies of at most precision bytes and may be
+ * truncated further to keep the record within I3_SHMLOG_MAX_RECORD.
+ *
+ */
+typedef struct i3_shmlog_record {
+    /* The size of the record including its arguments, in bytes. Always a
+     * multiple of 8. */
+    uint16_t size;
+
+    /* i3_shmlog_level */
+    uint8_t level;
+    /* For debug messages, the index of their category (the bit number in
+     * log_category_t), otherwise 0. */
+    uint8_t category;
+
+    /* Byte offset of the format string within the format table. */
+    uint32_t format;
+
+    /* CLOCK_MONOTONIC time of the message in nanoseconds. */
+    uint64_t timestamp;
+} i3_shmlog_record;
@@ -0,0 +1,48 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * snapshot.c: Publishes a compact snapshot of the state (outputs,
+ *             workspaces and windows) in a shared memory segment whenever it
+ *             was pushed to X11, which local clients can read without IPC
+ *             round trips.
+ *
+ */
+#pragma once
+
+#include <config.h>
+
+/** The name of the shared memory segment, or NULL if there is none. */
+extern char *snapshot_path;
+
+/**
+ * Creates the shared memory segment for the state snapshot. Its name is
+ * published in the I3_SNAPSHOT_PATH atom (see x_set_i3_atoms()).
+ *
+ */
+void snapshot_open(void);
+
+/**
+ * Requests a new snapshot. Called from x_push_changes(), i.e. after every
+ * render and every change which is pushed to X11 without a render (e.g. a
+ * title change). The snapshot is written once per event loop iteration by
+ * snapshot_publish_if_requested().
+ *
+ */
+void snapshot_publish_later(void);
+
+/**
+ * Writes a snapshot of the current state into the shared memory segment if
+ * snapshot_publish_later() was called since the last one. A seqlock protects
+ * the readers from seeing a partially written snapshot.
+ *
+ */
+void snapshot_publish_if_requested(void);
+
+/**
+ * Removes the shared memory segment, e.g. when exiting.
+ *
+ */
+void snapshot_close(void);
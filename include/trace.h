@@ -0,0 +1,62 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * trace.c: Records spans (e.g. handling an X11 event or rendering the tree)
+ *          in a ring buffer, which can be dumped as a Chrome trace (see the
+ *          trace command and the GET_TRACE IPC message).
+ *
+ */
+#pragma once
+
+#include <config.h>
+
+#include "ipc_gen.h"
+
+/** The number of spans the ring buffer holds. Older spans are overwritten. */
+#define TRACE_RING_SIZE 65536
+
+/** Whether spans are recorded (see the trace command). */
+extern bool trace_enabled;
+
+/** Returns the start of a span, or 0 if tracing is disabled, which costs a
+ * single (predictable) branch. */
+#define TRACE_BEGIN() (__builtin_expect(trace_enabled, 0) ? trace_now() : 0)
+
+/** Records the span which started at start (see TRACE_BEGIN()). category and
+ * name have to be string constants. */
+#define TRACE_END(start, category, name)               \
+    do {                                               \
+        if (__builtin_expect((start) != 0, 0)) {       \
+            trace_record((start), (category), (name)); \
+        }                                              \
+    } while (0)
+
+/**
+ * Returns the current time (CLOCK_MONOTONIC) in nanoseconds.
+ *
+ */
+uint64_t trace_now(void);
+
+/**
+ * Stores the span which started at start and ends now in the ring buffer.
+ * Use TRACE_END() instead of calling this function directly.
+ *
+ */
+void trace_record(uint64_t start, const char *category, const char *name);
+
+/**
+ * Enables or disables recording spans. Enabling discards the spans recorded
+ * before, disabling keeps them, so that they can still be dumped.
+ *
+ */
+void set_tracing(bool enabled);
+
+/**
+ * Dumps the recorded spans in the Chrome trace event format (a JSON object
+ * with a "traceEvents" array), which chrome://tracing and Perfetto can load.
+ *
+ */
+void trace_dump(ipc_gen gen);
@@ -18,6 +18,30 @@ extern Con *focused;
 TAILQ_HEAD(all_cons_head, Con);
 extern struct all_cons_head all_cons;
 
+/** Statistics about rendering, reported by the GET_STATS IPC message. */
+struct tree_render_stats {
+    /** Number of renders of the tree. */
+    uint64_t renders;
+    /** Number of calls of tree_render_later(). */
+    uint64_t requested;
+    /** Number of renders which were requested by tree_render_later(). */
+    uint64_t deferred;
+    /** Number of X11 events and IPC messages handled, to relate the number
+     * of renders to. */
+    uint64_t events;
+    /** Number of times a workspace was laid out, or kept its previous layout
+     * because it did not change (see render_con()). */
+    uint64_t workspaces_rendered;
+    uint64_t workspaces_replayed;
+    /** How long the renders took. */
+    struct latency_histogram durations;
+};
+extern struct tree_render_stats tree_render_stats;
+
+/** Incremented whenever the tree (might have) changed, see
+ * tree_bump_generation(). */
+extern uint64_t tree_generation;
+
 /**
  * Initializes the tree by creating the root node, adding all RandR outputs
  * to the tree (that means randr_init() has to be called before) and
@@ -58,6 +82,33 @@ bool level_down(void);
  */
 void tree_render(void);
 
+/**
+ * Marks the tree as changed by incrementing tree_generation, which invalidates
+ * everything derived from the tree (like cached IPC replies). The changed
+ * containers themselves are reported to tree_patch_con_changed() where they
+ * change.
+ *
+ */
+void tree_bump_generation(void);
+
+/**
+ * Requests a render of the tree. Instead of rendering immediately, the tree is
+ * rendered once before i3 waits for new events (or at the next sync point, see
+ * tree_render_if_requested()), so that a burst of events or commands only
+ * renders the tree once.
+ *
+ */
+void tree_render_later(void);
+
+/**
+ * Renders the tree if tree_render_later() was called since the last render.
+ * Called from the event loop and wherever the rendered state has to be
+ * visible (i3 sync requests, IPC messages). Returns true if the tree was
+ * rendered.
+ *
+ */
+bool tree_render_if_requested(void);
+
 /**
  * Changes focus in the given direction
  *
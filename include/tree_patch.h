@@ -0,0 +1,45 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * tree_patch.c: Incremental updates of the tree for IPC clients (the
+ *               GET_TREE_PATCH message and the tree_patch event).
+ *
+ */
+#pragma once
+
+#include <config.h>
+
+#include "ipc_gen.h"
+
+/**
+ * Remembers that the given container was freed, so that patches report it as
+ * removed. Called by con_free().
+ *
+ */
+void tree_patch_con_freed(Con *con);
+
+/**
+ * Makes the next scan compare all containers, because the tree might have
+ * changed anywhere (e.g. after reloading the configuration).
+ *
+ */
+void tree_patch_invalidate(void);
+
+/**
+ * Makes the next scan compare the containers on the workspace of the given
+ * container. Called wherever a container changes.
+ *
+ */
+void tree_patch_con_changed(Con *con);
+
+/**
+ * Writes a patch containing all containers which changed or were removed
+ * since the given generation (see GET_TREE_PATCH in docs/ipc). If removals
+ * since that generation are no longer known, the patch contains all
+ * containers and is marked as "full". Returns false if the patch is empty.
+ *
+ */
+bool tree_patch_dump(ipc_gen gen, uint64_t since);
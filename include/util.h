@@ -195,3 +195,30 @@ const char *direction_to_string(direction_t direction);
  *
  */
 const char *position_to_string(position_t position);
+
+/** The number of buckets of a latency_histogram. */
+#define LATENCY_BUCKETS 10
+
+/** The upper bounds (inclusive, in microseconds) of the buckets of a
+ * latency_histogram. The last bucket counts all longer durations. */
+extern const uint64_t latency_bucket_bounds[LATENCY_BUCKETS - 1];
+
+/** Durations of an operation (e.g. handling an IPC message), see GET_STATS. */
+struct latency_histogram {
+    uint64_t count;
+    uint64_t total_usec;
+    uint64_t max_usec;
+    uint64_t buckets[LATENCY_BUCKETS];
+};
+
+/**
+ * Returns the time of the monotonic clock in microseconds.
+ *
+ */
+uint64_t monotonic_usec(void);
+
+/**
+ * Counts a duration (in microseconds) in the given histogram.
+ *
+ */
+void latency_histogram_add(struct latency_histogram *histogram, uint64_t usec);
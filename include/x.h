@@ -15,6 +15,19 @@
 /** Stores the X11 window ID of the currently focused window */
 extern xcb_window_t focused_id;
 
+/** Statistics about x_push_changes(), reported by the GET_STATS IPC message. */
+struct x_push_stats {
+    /** Number of calls of x_push_changes(). */
+    uint64_t pushes;
+    /** Number of X11 requests issued by the last call (only counted with
+     * debug logging). */
+    uint32_t last_requests;
+    /** Number of X11 requests issued by all calls (only counted with debug
+     * logging). */
+    uint64_t requests;
+};
+extern struct x_push_stats x_push_stats;
+
 /**
  * Initializes the X11 part for the given container. Called exactly once for
  * every container from con_new().
@@ -44,7 +57,8 @@ void x_reparent_child(Con *con, Con *old);
 void x_reinit(Con *con);
 
 /**
- * Kills the window decoration associated with the given container.
+ * Kills the window decoration associated with the given container. The
+ * EnterNotify events caused by destroying it are ignored.
  *
  */
 void x_con_kill(Con *con);
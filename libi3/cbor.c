@@ -0,0 +1,501 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * cbor.c: The binary encoding of IPC messages (CBOR, RFC 8949), generated
+ *         by i3 and parsed with yajl callbacks by clients.
+ *
+ */
+#include "libi3.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* CBOR major types (the upper three bits of the initial byte). */
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+
+/* Additional information for indefinite-length items and the "break" stop
+ * code which ends them. */
+#define CBOR_INDEFINITE 31
+#define CBOR_BREAK 0xff
+
+#define CBOR_FALSE 0xf4
+#define CBOR_TRUE 0xf5
+#define CBOR_NULL 0xf6
+#define CBOR_HALF 0xf9
+#define CBOR_FLOAT 0xfa
+#define CBOR_DOUBLE 0xfb
+
+/* The maximum nesting depth cbor_parse() accepts. */
+#define CBOR_MAX_DEPTH 128
+
+struct cbor_buffer {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+};
+
+static void cbor_reserve(struct cbor_buffer *buf, size_t bytes) {
+    if (buf->size + bytes <= buf->capacity) {
+        return;
+    }
+    while (buf->size + bytes > buf->capacity) {
+        buf->capacity = (buf->capacity == 0 ? 4096 : buf->capacity * 2);
+    }
+    buf->data = srealloc(buf->data, buf->capacity);
+}
+
+static void cbor_put_byte(struct cbor_buffer *buf, uint8_t byte) {
+    cbor_reserve(buf, 1);
+    buf->data[buf->size++] = byte;
+}
+
+/*
+ * Writes the initial byte of an item of the given major type and its
+ * argument, using the shortest possible encoding.
+ *
+ */
+static void cbor_put_head(struct cbor_buffer *buf, uint8_t major, uint64_t value) {
+    cbor_reserve(buf, 9);
+    uint8_t *out = buf->data + buf->size;
+    int bytes;
+    if (value < 24) {
+        *out = (major << 5) | value;
+        buf->size++;
+        return;
+    } else if (value <= UINT8_MAX) {
+        *out = (major << 5) | 24;
+        bytes = 1;
+    } else if (value <= UINT16_MAX) {
+        *out = (major << 5) | 25;
+        bytes = 2;
+    } else if (value <= UINT32_MAX) {
+        *out = (major << 5) | 26;
+        bytes = 4;
+    } else {
+        *out = (major << 5) | 27;
+        bytes = 8;
+    }
+    for (int i = 0; i < bytes; i++) {
+        out[1 + i] = (value >> (8 * (bytes - 1 - i))) & 0xff;
+    }
+    buf->size += 1 + bytes;
+}
+
+/* The generator behind the cbor_gen handle, see cbor_gen_alloc(). */
+struct cbor_gen_t {
+    struct cbor_buffer buf;
+};
+
+/*
+ * Allocates a generator which writes CBOR (RFC 8949) with the same structure
+ * as the JSON yajl_gen would write for the same calls. Maps and arrays are
+ * encoded with indefinite length, so that they can be written without knowing
+ * the number of their items in advance. Free with cbor_gen_free().
+ *
+ */
+cbor_gen cbor_gen_alloc(void) {
+    return scalloc(1, sizeof(struct cbor_gen_t));
+}
+
+void cbor_gen_free(cbor_gen gen) {
+    free(gen->buf.data);
+    free(gen);
+}
+
+/*
+ * Returns the CBOR written so far. The buffer is owned by the generator.
+ *
+ */
+void cbor_gen_get_buf(cbor_gen gen, const unsigned char **buf, size_t *len) {
+    *buf = gen->buf.data;
+    *len = gen->buf.size;
+}
+
+void cbor_gen_null(cbor_gen gen) {
+    cbor_put_byte(&(gen->buf), CBOR_NULL);
+}
+
+void cbor_gen_bool(cbor_gen gen, int value) {
+    cbor_put_byte(&(gen->buf), value ? CBOR_TRUE : CBOR_FALSE);
+}
+
+void cbor_gen_integer(cbor_gen gen, long long value) {
+    if (value >= 0) {
+        cbor_put_head(&(gen->buf), CBOR_UNSIGNED, (uint64_t)value);
+    } else {
+        cbor_put_head(&(gen->buf), CBOR_NEGATIVE, (uint64_t)(-(value + 1)));
+    }
+}
+
+void cbor_gen_double(cbor_gen gen, double value) {
+    struct cbor_buffer *buf = &(gen->buf);
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    cbor_reserve(buf, 9);
+    buf->data[buf->size++] = CBOR_DOUBLE;
+    for (int i = 0; i < 8; i++) {
+        buf->data[buf->size++] = (bits >> (8 * (7 - i))) & 0xff;
+    }
+}
+
+/*
+ * Writes a number given as JSON number literal (like yajl_gen_number()), as
+ * integer if it has no fraction or exponent and as double otherwise.
+ *
+ */
+void cbor_gen_number(cbor_gen gen, const char *number, size_t len) {
+    char *str = sstrndup(number, len);
+    if (strpbrk(str, ".eE") == NULL) {
+        cbor_gen_integer(gen, strtoll(str, NULL, 10));
+    } else {
+        cbor_gen_double(gen, strtod(str, NULL));
+    }
+    free(str);
+}
+
+void cbor_gen_string(cbor_gen gen, const unsigned char *str, size_t len) {
+    struct cbor_buffer *buf = &(gen->buf);
+    cbor_put_head(buf, CBOR_TEXT, len);
+    cbor_reserve(buf, len);
+    memcpy(buf->data + buf->size, str, len);
+    buf->size += len;
+}
+
+void cbor_gen_map_open(cbor_gen gen) {
+    cbor_put_byte(&(gen->buf), (CBOR_MAP << 5) | CBOR_INDEFINITE);
+}
+
+void cbor_gen_map_close(cbor_gen gen) {
+    cbor_put_byte(&(gen->buf), CBOR_BREAK);
+}
+
+void cbor_gen_array_open(cbor_gen gen) {
+    cbor_put_byte(&(gen->buf), (CBOR_ARRAY << 5) | CBOR_INDEFINITE);
+}
+
+void cbor_gen_array_close(cbor_gen gen) {
+    cbor_put_byte(&(gen->buf), CBOR_BREAK);
+}
+
+struct cbor_parser {
+    const yajl_callbacks *callbacks;
+    void *ctx;
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+};
+
+/* Result of cbor_parse_item(): like yajl_status, with an additional value for
+ * the "break" stop code which ends indefinite-length items. */
+typedef enum {
+    CBOR_ITEM_OK = yajl_status_ok,
+    CBOR_ITEM_CANCELED = yajl_status_client_canceled,
+    CBOR_ITEM_ERROR = yajl_status_error,
+    CBOR_ITEM_BREAK,
+} cbor_item_status;
+
+/*
+ * Reads the argument of the item whose initial byte was just read. Returns
+ * false if the data is truncated or the encoding is reserved.
+ *
+ */
+static bool cbor_read_argument(struct cbor_parser *p, uint8_t info, uint64_t *value) {
+    if (info < 24) {
+        *value = info;
+        return true;
+    }
+    if (info > 27) {
+        return false;
+    }
+    const size_t bytes = (size_t)1 << (info - 24);
+    if (p->size - p->pos < bytes) {
+        return false;
+    }
+    *value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        *value = (*value << 8) | p->data[p->pos++];
+    }
+    return true;
+}
+
+static int cbor_call_number(struct cbor_parser *p, const char *format, ...) {
+    char number[64];
+    va_list args;
+    va_start(args, format);
+    const int len = vsnprintf(number, sizeof(number), format, args);
+    va_end(args);
+    return p->callbacks->yajl_number(p->ctx, number, len);
+}
+
+static int cbor_call_integer(struct cbor_parser *p, long long value) {
+    /* Like yajl, prefer yajl_number over yajl_integer. */
+    if (p->callbacks->yajl_number) {
+        return cbor_call_number(p, "%lld", value);
+    }
+    if (p->callbacks->yajl_integer) {
+        return p->callbacks->yajl_integer(p->ctx, value);
+    }
+    return 1;
+}
+
+static int cbor_call_double(struct cbor_parser *p, double value) {
+    if (p->callbacks->yajl_number) {
+        return cbor_call_number(p, "%.17g", value);
+    }
+    if (p->callbacks->yajl_double) {
+        return p->callbacks->yajl_double(p->ctx, value);
+    }
+    return 1;
+}
+
+static double cbor_half_to_double(uint16_t half) {
+    const int exponent = (half >> 10) & 0x1f;
+    const int mantissa = half & 0x3ff;
+    double value;
+    if (exponent == 0) {
+        value = ldexp(mantissa, -24);
+    } else if (exponent != 31) {
+        value = ldexp(mantissa + 1024, exponent - 25);
+    } else {
+        value = (mantissa == 0 ? INFINITY : NAN);
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+static cbor_item_status cbor_parse_item(struct cbor_parser *p, int depth, bool is_key);
+
+#define CALL(callback, ...)                                                           \
+    do {                                                                              \
+        if (p->callbacks->callback && !p->callbacks->callback(p->ctx, __VA_ARGS__)) { \
+            return CBOR_ITEM_CANCELED;                                                \
+        }                                                                             \
+    } while (0)
+
+#define CALL_NOARGS(callback)                                            \
+    do {                                                                 \
+        if (p->callbacks->callback && !p->callbacks->callback(p->ctx)) { \
+            return CBOR_ITEM_CANCELED;                                   \
+        }                                                                \
+    } while (0)
+
+/*
+ * Parses the items of an array (or the keys and values of a map) of the given
+ * length, or until the "break" stop code if indefinite is true.
+ *
+ */
+static cbor_item_status cbor_parse_container(struct cbor_parser *p, int depth, bool map,
+                                             bool indefinite, uint64_t length) {
+    for (uint64_t i = 0; indefinite || i < length; i++) {
+        cbor_item_status status = cbor_parse_item(p, depth + 1, map);
+        if (status == CBOR_ITEM_BREAK && indefinite) {
+            return CBOR_ITEM_OK;
+        }
+        if (status != CBOR_ITEM_OK) {
+            return (status == CBOR_ITEM_BREAK ? CBOR_ITEM_ERROR : status);
+        }
+        if (!map) {
+            continue;
+        }
+        status = cbor_parse_item(p, depth + 1, false);
+        if (status != CBOR_ITEM_OK) {
+            return (status == CBOR_ITEM_BREAK ? CBOR_ITEM_ERROR : status);
+        }
+    }
+    return CBOR_ITEM_OK;
+}
+
+/*
+ * Parses a text or byte string, which might consist of several chunks if it
+ * has indefinite length. Map keys are passed to yajl_map_key, other strings
+ * to yajl_string.
+ *
+ */
+static cbor_item_status cbor_parse_string(struct cbor_parser *p, uint8_t major, uint8_t info, bool is_key) {
+    const yajl_callbacks *callbacks = p->callbacks;
+    int (*callback)(void *, const unsigned char *, size_t) =
+        (is_key ? callbacks->yajl_map_key : callbacks->yajl_string);
+
+    if (info != CBOR_INDEFINITE) {
+        uint64_t length;
+        if (!cbor_read_argument(p, info, &length) || p->size - p->pos < length) {
+            return CBOR_ITEM_ERROR;
+        }
+        const unsigned char *str = p->data + p->pos;
+        p->pos += length;
+        if (callback && !callback(p->ctx, str, length)) {
+            return CBOR_ITEM_CANCELED;
+        }
+        return CBOR_ITEM_OK;
+    }
+
+    /* Concatenate the chunks, which must be definite-length strings of the
+     * same major type. */
+    struct cbor_buffer buf = {0};
+    cbor_item_status status = CBOR_ITEM_ERROR;
+    while (p->pos < p->size) {
+        const uint8_t initial = p->data[p->pos++];
+        if (initial == CBOR_BREAK) {
+            status = CBOR_ITEM_OK;
+            break;
+        }
+        uint64_t length;
+        if ((initial >> 5) != major ||
+            !cbor_read_argument(p, initial & 0x1f, &length) ||
+            p->size - p->pos < length) {
+            break;
+        }
+        cbor_reserve(&buf, length);
+        memcpy(buf.data + buf.size, p->data + p->pos, length);
+        buf.size += length;
+        p->pos += length;
+    }
+    const unsigned char *str = (buf.data != NULL ? buf.data : (const unsigned char *)"");
+    if (status == CBOR_ITEM_OK && callback && !callback(p->ctx, str, buf.size)) {
+        status = CBOR_ITEM_CANCELED;
+    }
+    free(buf.data);
+    return status;
+}
+
+static cbor_item_status cbor_parse_item(struct cbor_parser *p, int depth, bool is_key) {
+    if (depth > CBOR_MAX_DEPTH || p->pos >= p->size) {
+        return CBOR_ITEM_ERROR;
+    }
+
+    const uint8_t initial = p->data[p->pos++];
+    if (initial == CBOR_BREAK) {
+        return CBOR_ITEM_BREAK;
+    }
+    const uint8_t major = initial >> 5;
+    const uint8_t info = initial & 0x1f;
+    if (is_key && major != CBOR_TEXT && major != CBOR_BYTES) {
+        /* JSON only has string keys. */
+        return CBOR_ITEM_ERROR;
+    }
+
+    uint64_t value = 0;
+    switch (major) {
+        case CBOR_UNSIGNED:
+            if (!cbor_read_argument(p, info, &value) || value > INT64_MAX) {
+                return CBOR_ITEM_ERROR;
+            }
+            return cbor_call_integer(p, (long long)value) ? CBOR_ITEM_OK : CBOR_ITEM_CANCELED;
+        case CBOR_NEGATIVE:
+            if (!cbor_read_argument(p, info, &value) || value > INT64_MAX) {
+                return CBOR_ITEM_ERROR;
+            }
+            return cbor_call_integer(p, -1 - (long long)value) ? CBOR_ITEM_OK : CBOR_ITEM_CANCELED;
+        case CBOR_BYTES:
+        case CBOR_TEXT:
+            return cbor_parse_string(p, major, info, is_key);
+        case CBOR_ARRAY:
+        case CBOR_MAP: {
+            const bool map = (major == CBOR_MAP);
+            const bool indefinite = (info == CBOR_INDEFINITE);
+            if (!indefinite && !cbor_read_argument(p, info, &value)) {
+                return CBOR_ITEM_ERROR;
+            }
+            if (map) {
+                CALL_NOARGS(yajl_start_map);
+            } else {
+                CALL_NOARGS(yajl_start_array);
+            }
+            cbor_item_status status = cbor_parse_container(p, depth, map, indefinite, value);
+            if (status != CBOR_ITEM_OK) {
+                return status;
+            }
+            if (map) {
+                CALL_NOARGS(yajl_end_map);
+            } else {
+                CALL_NOARGS(yajl_end_array);
+            }
+            return CBOR_ITEM_OK;
+        }
+        case CBOR_TAG:
+            /* Tags (e.g. for dates) carry no meaning in JSON. */
+            if (!cbor_read_argument(p, info, &value)) {
+                return CBOR_ITEM_ERROR;
+            }
+            return cbor_parse_item(p, depth + 1, is_key);
+        case CBOR_SIMPLE:
+        default:
+            break;
+    }
+
+    switch (initial) {
+        case CBOR_FALSE:
+        case CBOR_TRUE:
+            CALL(yajl_boolean, initial == CBOR_TRUE);
+            return CBOR_ITEM_OK;
+        case CBOR_NULL:
+            CALL_NOARGS(yajl_null);
+            return CBOR_ITEM_OK;
+        case CBOR_HALF:
+        case CBOR_FLOAT:
+        case CBOR_DOUBLE: {
+            if (!cbor_read_argument(p, info, &value)) {
+                return CBOR_ITEM_ERROR;
+            }
+            double number;
+            if (initial == CBOR_HALF) {
+                number = cbor_half_to_double(value);
+            } else if (initial == CBOR_FLOAT) {
+                uint32_t bits = value;
+                float f;
+                memcpy(&f, &bits, sizeof(f));
+                number = f;
+            } else {
+                memcpy(&number, &value, sizeof(number));
+            }
+            return cbor_call_double(p, number) ? CBOR_ITEM_OK : CBOR_ITEM_CANCELED;
+        }
+        default:
+            /* undefined and unassigned simple values have no JSON
+             * equivalent. */
+            return CBOR_ITEM_ERROR;
+    }
+}
+
+#undef CALL
+#undef CALL_NOARGS
+
+/*
+ * Parses a CBOR document (as sent by i3 to clients which negotiated the binary
+ * encoding, see I3_IPC_MESSAGE_TYPE_SET_ENCODING), calling the given yajl
+ * callbacks just like yajl_parse() would for the equivalent JSON document.
+ * This allows clients to use the same callbacks for both encodings.
+ *
+ * Returns yajl_status_ok on success, yajl_status_client_canceled if a
+ * callback returned 0 and yajl_status_error if the data is not a single,
+ * complete CBOR item which can be represented in JSON.
+ *
+ */
+yajl_status cbor_parse(const yajl_callbacks *callbacks, void *ctx, const uint8_t *data, size_t size) {
+    struct cbor_parser p = {
+        .callbacks = callbacks,
+        .ctx = ctx,
+        .data = data,
+        .size = size,
+        .pos = 0,
+    };
+    const cbor_item_status status = cbor_parse_item(&p, 0, false);
+    if (status == CBOR_ITEM_CANCELED) {
+        return yajl_status_client_canceled;
+    }
+    if (status != CBOR_ITEM_OK || p.pos != p.size) {
+        return yajl_status_error;
+    }
+    return yajl_status_ok;
+}
@@ -0,0 +1,180 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ */
+#include "libi3.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+
+/*
+ * Finds the next conversion specification (like "%-5.*s") in a printf format
+ * string. Returns a pointer to its '%' or NULL if there is none. *end is set
+ * to the first byte after the specification, *stars to the number of int
+ * arguments consumed by '*' as field width or precision, *precision to the
+ * precision (PRINTF_PRECISION_NONE if there is none, PRINTF_PRECISION_STAR if
+ * it is the last of the int arguments) and *type to the type of the converted
+ * argument (PRINTF_ARG_NONE for "%%").
+ *
+ * Used to store the arguments of log messages in binary form (see shmlog.h)
+ * and to format them later on.
+ *
+ */
+const char *printf_next_conversion(const char *fmt, const char **end, int *stars, int *precision, printf_arg_t *type) {
+    const char *start = strchr(fmt, '%');
+    if (start == NULL) {
+        return NULL;
+    }
+
+    const char *walk = start + 1;
+    *stars = 0;
+    *precision = PRINTF_PRECISION_NONE;
+    *type = PRINTF_ARG_INVALID;
+
+    if (*walk == '%') {
+        *end = walk + 1;
+        *type = PRINTF_ARG_NONE;
+        return start;
+    }
+
+    /* Flags */
+    while (*walk != '\0' && strchr("-+ #0'", *walk) != NULL) {
+        walk++;
+    }
+
+    /* Field width and precision. Positional arguments ("%1$d") are not
+     * supported. */
+    for (int field = 0; field < 2; field++) {
+        if (field == 1) {
+            if (*walk != '.') {
+                break;
+            }
+            walk++;
+        }
+        if (*walk == '*') {
+            (*stars)++;
+            walk++;
+            if (field == 1) {
+                *precision = PRINTF_PRECISION_STAR;
+            }
+        } else {
+            /* A '.' without digits means a precision of 0. */
+            int value = 0;
+            while (isdigit((unsigned char)*walk)) {
+                if (value <= (INT_MAX - 9) / 10) {
+                    value = value * 10 + (*walk - '0');
+                }
+                walk++;
+            }
+            if (field == 1) {
+                *precision = value;
+            }
+        }
+        if (*walk == '$') {
+            *end = walk + 1;
+            return start;
+        }
+    }
+
+    /* Length modifier */
+    enum { LEN_NONE,
+           LEN_LONG,
+           LEN_LLONG,
+           LEN_SIZE,
+           LEN_INTMAX,
+           LEN_PTRDIFF,
+           LEN_UNSUPPORTED } length = LEN_NONE;
+    if (walk[0] == 'h') {
+        walk += (walk[1] == 'h' ? 2 : 1);
+    } else if (walk[0] == 'l' && walk[1] == 'l') {
+        length = LEN_LLONG;
+        walk += 2;
+    } else if (walk[0] == 'l') {
+        length = LEN_LONG;
+        walk++;
+    } else if (walk[0] == 'q') {
+        length = LEN_LLONG;
+        walk++;
+    } else if (walk[0] == 'z') {
+        length = LEN_SIZE;
+        walk++;
+    } else if (walk[0] == 'j') {
+        length = LEN_INTMAX;
+        walk++;
+    } else if (walk[0] == 't') {
+        length = LEN_PTRDIFF;
+        walk++;
+    } else if (walk[0] == 'L') {
+        length = LEN_UNSUPPORTED;
+        walk++;
+    }
+
+    const char conversion = *walk;
+    *end = (conversion == '\0' ? walk : walk + 1);
+    switch (conversion) {
+        case 'd':
+        case 'i':
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            switch (length) {
+                case LEN_NONE:
+                    *type = PRINTF_ARG_INT;
+                    break;
+                case LEN_LONG:
+                    *type = PRINTF_ARG_LONG;
+                    break;
+                case LEN_LLONG:
+                    *type = PRINTF_ARG_LLONG;
+                    break;
+                case LEN_SIZE:
+                    *type = PRINTF_ARG_SIZE;
+                    break;
+                case LEN_INTMAX:
+                    *type = PRINTF_ARG_INTMAX;
+                    break;
+                case LEN_PTRDIFF:
+                    *type = PRINTF_ARG_PTRDIFF;
+                    break;
+                case LEN_UNSUPPORTED:
+                    break;
+            }
+            break;
+        case 'c':
+            if (length == LEN_NONE) {
+                *type = PRINTF_ARG_INT;
+            }
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (length == LEN_NONE || length == LEN_LONG) {
+                *type = PRINTF_ARG_DOUBLE;
+            }
+            break;
+        case 's':
+            if (length == LEN_NONE) {
+                *type = PRINTF_ARG_STRING;
+            }
+            break;
+        case 'p':
+            if (length == LEN_NONE) {
+                *type = PRINTF_ARG_POINTER;
+            }
+            break;
+        default:
+            /* %n, %m and wide characters cannot be formatted later on. */
+            break;
+    }
+    return start;
+}
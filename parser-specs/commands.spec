@@ -21,6 +21,7 @@ state INITIAL:
   'reload' -> call cmd_reload()
   'shmlog' -> SHMLOG
   'debuglog' -> DEBUGLOG
+  'trace' -> TRACE
   'border' -> BORDER
   'layout' -> LAYOUT
   'append_layout' -> APPEND_LAYOUT
@@ -100,9 +101,21 @@ state SHMLOG:
     -> call cmd_shmlog($argument)
 
 # debuglog toggle|on|off
+# debuglog categories <category>[,<category>...]
 state DEBUGLOG:
   argument = 'toggle', 'on', 'off'
     -> call cmd_debuglog($argument)
+  'categories'
+    -> DEBUGLOG_CATEGORIES
+
+state DEBUGLOG_CATEGORIES:
+  categories = string
+    -> call cmd_debuglog_categories($categories)
+
+# trace toggle|on|off
+state TRACE:
+  argument = 'toggle', 'on', 'off'
+    -> call cmd_trace($argument)
 
 # border normal|pixel [<n>]
 # border none|1pixel|toggle
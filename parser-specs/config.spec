@@ -54,6 +54,7 @@ state INITIAL:
   'workspace'                              -> WORKSPACE
   'ipc_socket', 'ipc-socket'               -> IPC_SOCKET
   'ipc_kill_timeout'                       -> IPC_KILL_TIMEOUT
+  'ipc_queue_limit'                        -> IPC_QUEUE_LIMIT
   'restart_state'                          -> RESTART_STATE
   'popup_during_fullscreen'                -> POPUP_DURING_FULLSCREEN
   'tiling_drag'                            -> TILING_DRAG
@@ -359,6 +360,17 @@ state IPC_KILL_TIMEOUT:
   timeout = number
       -> call cfg_ipc_kill_timeout(&timeout)
 
+# ipc_queue_limit <messages> [kill|drop|coalesce]
+state IPC_QUEUE_LIMIT:
+  limit = number
+      -> IPC_QUEUE_LIMIT_POLICY
+
+state IPC_QUEUE_LIMIT_POLICY:
+  end
+      -> call cfg_ipc_queue_limit(&limit, $policy)
+  policy = 'kill', 'drop', 'coalesce'
+      -> call cfg_ipc_queue_limit(&limit, $policy)
+
 # restart_state <path> (for testcases)
 state RESTART_STATE:
   path = string
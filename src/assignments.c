@@ -7,6 +7,7 @@
  * assignments.c: Assignments for specific windows (for_window).
  *
  */
+#define LOG_CATEGORY LOG_MANAGE
 #include "all.h"
 
 /*
@@ -51,6 +52,9 @@ void run_assignments(i3Window *window) {
         DLOG("matching assignment, execute command %s\n", current->dest.command);
         char *full_command;
         sasprintf(&full_command, "[id=\"%d\"] %s", window->id, current->dest.command);
+        /* The command might change anything (e.g. when run by a property
+         * handler, which only reports the changes of its window). */
+        tree_bump_generation();
         CommandResult *result = parse_command(full_command, NULL, NULL);
         free(full_command);
 
@@ -61,9 +65,9 @@ void run_assignments(i3Window *window) {
         command_result_free(result);
     }
 
-    /* If any of the commands required re-rendering, we will do that now. */
+    /* If any of the commands required re-rendering, we will do that soon. */
     if (needs_tree_render) {
-        tree_render();
+        tree_render_later();
     }
 }
 
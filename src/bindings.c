@@ -6,6 +6,7 @@
  *
  * bindings.c: Functions for configuring, finding and, running bindings.
  */
+#define LOG_CATEGORY LOG_BINDINGS
 #include "all.h"
 
 #include <math.h>
@@ -662,12 +663,7 @@ void switch_mode(const char *new_mode) {
             }
         }
 
-        char *event_msg;
-        sasprintf(&event_msg, "{\"change\":\"%s\", \"pango_markup\":%s}",
-                  mode->name, (mode->pango_markup ? "true" : "false"));
-
-        ipc_send_event("mode", I3_IPC_EVENT_MODE, event_msg);
-        FREE(event_msg);
+        ipc_send_mode_event(mode->name, mode->pango_markup);
 
         return;
     }
@@ -873,11 +869,14 @@ CommandResult *run_binding(Binding *bind, Con *con) {
      * correctly produce an event later. */
     char *modename = sstrdup(current_binding_mode);
 
+    /* Key events do not mark the tree as changed (see handle_event()), but
+     * the command might change anything. */
+    tree_bump_generation();
     CommandResult *result = parse_command(command, NULL, NULL);
     free(command);
 
     if (result->needs_tree_render) {
-        tree_render();
+        tree_render_later();
     }
 
     if (result->parse_error) {
@@ -69,7 +69,7 @@ static bool tiling_resize_for_border(Con *con, border_t border, xcb_button_press
     resize_graphical_handler(first, second, orientation, event, use_threshold);
 
     DLOG("After resize handler, rendering\n");
-    tree_render();
+    tree_render_later();
     return true;
 }
 
@@ -158,7 +158,7 @@ static bool tiling_resize(Con *con, xcb_button_press_event_t *event, const click
 static void allow_replay_pointer(xcb_timestamp_t time) {
     xcb_allow_events(conn, XCB_ALLOW_REPLAY_POINTER, time);
     xcb_flush(conn);
-    tree_render();
+    tree_render_later();
 }
 
 /*
@@ -408,7 +408,7 @@ void handle_button_press(xcb_button_press_event_t *event) {
                 ws = TAILQ_FIRST(&(output_get_content(output)->focus_head));
                 if (ws != con_get_workspace(focused)) {
                     workspace_show(ws);
-                    tree_render();
+                    tree_render_later();
                 }
                 return;
             }
@@ -7,6 +7,7 @@
  * commands.c: all command functions (see commands_parser.c)
  *
  */
+#define LOG_CATEGORY LOG_COMMANDS
 #include "all.h"
 #include "shmlog.h"
 
@@ -14,9 +15,9 @@
 #include <stdint.h>
 #include <unistd.h>
 
-// Macros to make the YAJL API a bit easier to use.
-#define y(x, ...) (cmd_output->json_gen != NULL ? yajl_gen_##x(cmd_output->json_gen, ##__VA_ARGS__) : 0)
-#define ystr(str) (cmd_output->json_gen != NULL ? yajl_gen_string(cmd_output->json_gen, (unsigned char *)str, strlen(str)) : 0)
+// Macros to make the ipc_gen API a bit easier to use.
+#define y(x, ...) (cmd_output->json_gen != NULL ? ipc_gen_##x(cmd_output->json_gen, ##__VA_ARGS__) : (void)0)
+#define ystr(str) (cmd_output->json_gen != NULL ? ipc_gen_string(cmd_output->json_gen, (unsigned char *)str, strlen(str)) : (void)0)
 #define ysuccess(success)                   \
     do {                                    \
         if (cmd_output->json_gen != NULL) { \
@@ -54,7 +55,8 @@
 /** When the command did not include match criteria (!), we use the currently
  * focused container. Do not confuse this case with a command which included
  * criteria but which did not match any windows. This macro has to be called in
- * every command.
+ * every command, which also reports the containers as changed (see
+ * owindows_changed()).
  */
 #define HANDLE_EMPTY_MATCH                              \
     do {                                                \
@@ -71,6 +73,7 @@
             TAILQ_INIT(&owindows);                      \
             TAILQ_INSERT_TAIL(&owindows, ow, owindows); \
         }                                               \
+        owindows_changed();                             \
     } while (0)
 
 /*
@@ -138,6 +141,19 @@ typedef TAILQ_HEAD(owindows_head, owindow) owindows_head;
 
 static owindows_head owindows;
 
+/*
+ * Reports the containers the command operates on to tree_patch_con_changed(),
+ * since commands change properties (like marks, the title format or sticky)
+ * which do not influence the layout.
+ *
+ */
+static void owindows_changed(void) {
+    owindow *current;
+    TAILQ_FOREACH (current, &owindows, owindows) {
+        tree_patch_con_changed(current->con);
+    }
+}
+
 /*
  * Initializes the specified 'Match' data structure and the initial state of
  * commands.c for matching target windows of a command.
@@ -177,6 +193,14 @@ void cmd_criteria_match_windows(I3_CMD) {
      * list which will contain only matching windows */
     struct owindows_head old = owindows;
     TAILQ_INIT(&owindows);
+
+    /* Match the mark regex against the mark index once instead of against
+     * the marks of every single container. */
+    struct hashmap cons_by_mark_match = HASHMAP_INITIALIZER(false);
+    if (current_match->mark != NULL) {
+        con_by_mark_regex(current_match->mark, &cons_by_mark_match);
+    }
+
     for (next = TAILQ_FIRST(&old); next != TAILQ_END(&old);) {
         /* make a copy of the next pointer and advance the pointer to the
          * next element as we are going to invalidate the element’s
@@ -186,62 +210,13 @@ void cmd_criteria_match_windows(I3_CMD) {
 
         DLOG("checking if con %p / %s matches\n", current->con, current->con->name);
 
-        /* We use this flag to prevent matching on window-less containers if
-         * only window-specific criteria were specified. */
-        bool accept_match = false;
-
-        if (current_match->con_id != NULL) {
-            accept_match = true;
-
-            if (current_match->con_id == current->con) {
-                DLOG("con_id matched.\n");
-            } else {
-                DLOG("con_id does not match.\n");
-                FREE(current);
-                continue;
-            }
-        }
-
-        if (current_match->mark != NULL && !TAILQ_EMPTY(&(current->con->marks_head))) {
-            accept_match = true;
-            bool matched_by_mark = false;
-
-            mark_t *mark;
-            TAILQ_FOREACH (mark, &(current->con->marks_head), marks) {
-                if (!regex_matches(current_match->mark, mark->name)) {
-                    continue;
-                }
-
-                DLOG("match by mark\n");
-                matched_by_mark = true;
-                break;
-            }
-
-            if (!matched_by_mark) {
-                DLOG("mark does not match.\n");
-                FREE(current);
-                continue;
-            }
-        }
-
-        if (current->con->window != NULL) {
-            if (match_matches_window(current_match, current->con->window)) {
-                DLOG("matches window!\n");
-                accept_match = true;
-            } else {
-                DLOG("doesn't match\n");
-                FREE(current);
-                continue;
-            }
-        }
-
-        if (accept_match) {
+        if (match_matches_con(current_match, current->con, &cons_by_mark_match)) {
             TAILQ_INSERT_TAIL(&owindows, current, owindows);
         } else {
             FREE(current);
-            continue;
         }
     }
+    hashmap_clear(&cons_by_mark_match);
 
     TAILQ_FOREACH (current, &owindows, owindows) {
         DLOG("matching: %p / %s\n", current->con, current->con->name);
@@ -569,6 +544,7 @@ static bool cmd_resize_tiling_width_height(I3_CMD, Con *current, const char *dir
         child->percent -= subtract_percent;
         LOG("child->percent after (%p) = %f\n", child, child->percent);
     }
+    render_con_changed(current);
 
     return true;
 }
@@ -2391,6 +2367,68 @@ void cmd_debuglog(I3_CMD, const char *argument) {
     ysuccess(true);
 }
 
+/*
+ * Implementation of 'debuglog categories <category>[,<category>...]'
+ *
+ * Categories prefixed with + or - are enabled or disabled, the others replace
+ * the enabled categories. "all" and "none" refer to all categories.
+ *
+ */
+void cmd_debuglog_categories(I3_CMD, const char *categories) {
+    uint32_t enabled = get_log_categories();
+    bool replaced = false;
+
+    char *copy = sstrdup(categories);
+    for (char *name = strtok(copy, ","); name != NULL; name = strtok(NULL, ",")) {
+        const char op = (*name == '+' || *name == '-' ? *(name++) : '=');
+        uint32_t bits;
+        if (strcasecmp(name, "all") == 0) {
+            bits = LOG_ALL_CATEGORIES;
+        } else if (strcasecmp(name, "none") == 0) {
+            bits = 0;
+        } else if ((bits = log_category_from_name(name)) == 0) {
+            yerror("Unknown log category \"%s\"", name);
+            free(copy);
+            return;
+        }
+
+        if (op == '+') {
+            enabled |= bits;
+        } else if (op == '-') {
+            enabled &= ~bits;
+        } else {
+            if (!replaced) {
+                enabled = 0;
+                replaced = true;
+            }
+            enabled |= bits;
+        }
+    }
+    free(copy);
+
+    set_log_categories(enabled);
+    LOG("Debug log categories set to 0x%x\n", get_log_categories());
+    ysuccess(true);
+}
+
+/*
+ * Implementation of 'trace toggle|on|off'
+ *
+ */
+void cmd_trace(I3_CMD, const char *argument) {
+    if (!strcmp(argument, "toggle")) {
+        LOG("%s tracing\n", trace_enabled ? "Disabling" : "Enabling");
+        set_tracing(!trace_enabled);
+    } else if (!strcmp(argument, "on") && !trace_enabled) {
+        LOG("Enabling tracing\n");
+        set_tracing(true);
+    } else if (!strcmp(argument, "off") && trace_enabled) {
+        LOG("Disabling tracing\n");
+        set_tracing(false);
+    }
+    ysuccess(true);
+}
+
 static int *gaps_inner(gaps_t *gaps) {
     return &(gaps->inner);
 }
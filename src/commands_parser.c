@@ -23,11 +23,12 @@
  * instead of actually calling any function).
  *
  */
+#define LOG_CATEGORY LOG_COMMANDS
 #include "all.h"
 
-// Macros to make the YAJL API a bit easier to use.
-#define y(x, ...) (command_output.json_gen != NULL ? yajl_gen_##x(command_output.json_gen, ##__VA_ARGS__) : 0)
-#define ystr(str) (command_output.json_gen != NULL ? yajl_gen_string(command_output.json_gen, (unsigned char *)str, strlen(str)) : 0)
+// Macros to make the ipc_gen API a bit easier to use.
+#define y(x, ...) (command_output.json_gen != NULL ? ipc_gen_##x(command_output.json_gen, ##__VA_ARGS__) : (void)0)
+#define ystr(str) (command_output.json_gen != NULL ? ipc_gen_string(command_output.json_gen, (unsigned char *)str, strlen(str)) : (void)0)
 
 /*******************************************************************************
  * The data structures used for parsing. Essentially the current state and a
@@ -244,14 +245,152 @@ char *parse_string(const char **walk, bool as_word) {
 }
 
 /*
- * Parses and executes the given command. If a caller-allocated yajl_gen is
- * passed, a json reply will be generated in the format specified by the ipc
- * protocol. Pass NULL if no json reply is required.
+ * Looks for one of the tokens of the current state at *walk. If one matches,
+ * it is handled (possibly calling a function, see next_state()) and *walk is
+ * advanced past it. Returns false if none of the tokens matched.
+ *
+ */
+static bool handle_token(const char **walkp) {
+    const char *walk = *walkp;
+    cmdp_token_ptr *ptr = &(tokens[state]);
+    for (int c = 0; c < ptr->n; c++) {
+        const cmdp_token *token = &(ptr->array[c]);
+
+        /* A literal. */
+        if (token->name[0] == '\'') {
+            if (strncasecmp(walk, token->name + 1, strlen(token->name) - 1) == 0) {
+                if (token->identifier != NULL) {
+                    push_string(&stack, token->identifier, sstrdup(token->name + 1));
+                }
+                *walkp = walk + strlen(token->name) - 1;
+                next_state(token);
+                return true;
+            }
+            continue;
+        }
+
+        if (strcmp(token->name, "number") == 0) {
+            /* Handle numbers. We only accept decimal numbers for now. */
+            char *end = NULL;
+            errno = 0;
+            long int num = strtol(walk, &end, 10);
+            if ((errno == ERANGE && (num == LONG_MIN || num == LONG_MAX)) ||
+                (errno != 0 && num == 0)) {
+                continue;
+            }
+
+            /* No valid numbers found */
+            if (end == walk) {
+                continue;
+            }
+
+            if (token->identifier != NULL) {
+                push_long(&stack, token->identifier, num);
+            }
+
+            /* Set walk to the first non-number character */
+            *walkp = end;
+            next_state(token);
+            return true;
+        }
+
+        if (strcmp(token->name, "string") == 0 ||
+            strcmp(token->name, "word") == 0) {
+            char *str = parse_string(&walk, (token->name[0] != 's'));
+            if (str != NULL) {
+                if (token->identifier) {
+                    push_string(&stack, token->identifier, str);
+                }
+                /* If we are at the end of a quoted string, skip the ending
+                 * double quote. */
+                if (*walk == '"') {
+                    walk++;
+                }
+                *walkp = walk;
+                next_state(token);
+                return true;
+            }
+        }
+
+        if (strcmp(token->name, "end") == 0) {
+            if (*walk == '\0' || *walk == ',' || *walk == ';') {
+                next_state(token);
+                /* To make sure we start with an appropriate matching
+                 * datastructure for commands which do *not* specify any
+                 * criteria, we re-initialize the criteria system after
+                 * every command. */
+// TODO: make this testable
+#ifndef TEST_PARSER
+                if (*walk == '\0' || *walk == ';') {
+                    cmd_criteria_init(&current_match, &subcommand_output);
+                }
+#endif
+                *walkp = walk + 1;
+                return true;
+            }
+        }
+    }
+    *walkp = walk;
+    return false;
+}
+
+/*
+ * Returns an error message listing the tokens which are possible in the
+ * current state.
+ *
+ */
+static char *expected_tokens_message(void) {
+    cmdp_token_ptr *ptr = &(tokens[state]);
+
+    /* Figure out how much memory we will need to fill in the names of
+     * all tokens afterwards. */
+    int tokenlen = 0;
+    for (int c = 0; c < ptr->n; c++) {
+        tokenlen += strlen(ptr->array[c].name) + strlen("'', ");
+    }
+
+    char *errormessage;
+    char *possible_tokens = smalloc(tokenlen + 1);
+    char *tokenwalk = possible_tokens;
+    for (int c = 0; c < ptr->n; c++) {
+        const cmdp_token *token = &(ptr->array[c]);
+        if (token->name[0] == '\'') {
+            /* A literal is copied to the error message enclosed with
+             * single quotes. */
+            *tokenwalk++ = '\'';
+            strcpy(tokenwalk, token->name + 1);
+            tokenwalk += strlen(token->name + 1);
+            *tokenwalk++ = '\'';
+        } else {
+            /* Any other token is copied to the error message enclosed
+             * with angle brackets. */
+            *tokenwalk++ = '<';
+            strcpy(tokenwalk, token->name);
+            tokenwalk += strlen(token->name);
+            *tokenwalk++ = '>';
+        }
+        if (c < (ptr->n - 1)) {
+            *tokenwalk++ = ',';
+            *tokenwalk++ = ' ';
+        }
+    }
+    *tokenwalk = '\0';
+    sasprintf(&errormessage, "Expected one of these tokens: %s",
+              possible_tokens);
+    free(possible_tokens);
+    return errormessage;
+}
+
+/*
+ * Parses and executes the given command. If a caller-allocated ipc_gen is
+ * passed, a reply will be generated in the format specified by the ipc
+ * protocol. Pass NULL if no reply is required.
  *
  * Free the returned CommandResult with command_result_free().
  */
-CommandResult *parse_command(const char *input, yajl_gen gen, ipc_client *client) {
+CommandResult *parse_command(const char *input, ipc_gen gen, ipc_client *client) {
     DLOG("COMMAND: *%.4000s*\n", input);
+    const uint64_t trace_start = TRACE_BEGIN();
     state = INITIAL;
     CommandResult *result = scalloc(1, sizeof(CommandResult));
 
@@ -265,9 +404,6 @@ CommandResult *parse_command(const char *input, yajl_gen gen, ipc_client *client
 
     const char *walk = input;
     const size_t len = strlen(input);
-    int c;
-    const cmdp_token *token;
-    bool token_handled;
 
 // TODO: make this testable
 #ifndef TEST_PARSER
@@ -284,129 +420,11 @@ CommandResult *parse_command(const char *input, yajl_gen gen, ipc_client *client
             walk++;
         }
 
-        cmdp_token_ptr *ptr = &(tokens[state]);
-        token_handled = false;
-        for (c = 0; c < ptr->n; c++) {
-            token = &(ptr->array[c]);
-
-            /* A literal. */
-            if (token->name[0] == '\'') {
-                if (strncasecmp(walk, token->name + 1, strlen(token->name) - 1) == 0) {
-                    if (token->identifier != NULL) {
-                        push_string(&stack, token->identifier, sstrdup(token->name + 1));
-                    }
-                    walk += strlen(token->name) - 1;
-                    next_state(token);
-                    token_handled = true;
-                    break;
-                }
-                continue;
-            }
-
-            if (strcmp(token->name, "number") == 0) {
-                /* Handle numbers. We only accept decimal numbers for now. */
-                char *end = NULL;
-                errno = 0;
-                long int num = strtol(walk, &end, 10);
-                if ((errno == ERANGE && (num == LONG_MIN || num == LONG_MAX)) ||
-                    (errno != 0 && num == 0)) {
-                    continue;
-                }
-
-                /* No valid numbers found */
-                if (end == walk) {
-                    continue;
-                }
-
-                if (token->identifier != NULL) {
-                    push_long(&stack, token->identifier, num);
-                }
-
-                /* Set walk to the first non-number character */
-                walk = end;
-                next_state(token);
-                token_handled = true;
-                break;
-            }
-
-            if (strcmp(token->name, "string") == 0 ||
-                strcmp(token->name, "word") == 0) {
-                char *str = parse_string(&walk, (token->name[0] != 's'));
-                if (str != NULL) {
-                    if (token->identifier) {
-                        push_string(&stack, token->identifier, str);
-                    }
-                    /* If we are at the end of a quoted string, skip the ending
-                     * double quote. */
-                    if (*walk == '"') {
-                        walk++;
-                    }
-                    next_state(token);
-                    token_handled = true;
-                    break;
-                }
-            }
-
-            if (strcmp(token->name, "end") == 0) {
-                if (*walk == '\0' || *walk == ',' || *walk == ';') {
-                    next_state(token);
-                    token_handled = true;
-                    /* To make sure we start with an appropriate matching
-                     * datastructure for commands which do *not* specify any
-                     * criteria, we re-initialize the criteria system after
-                     * every command. */
-// TODO: make this testable
-#ifndef TEST_PARSER
-                    if (*walk == '\0' || *walk == ';') {
-                        cmd_criteria_init(&current_match, &subcommand_output);
-                    }
-#endif
-                    walk++;
-                    break;
-                }
-            }
-        }
-
-        if (!token_handled) {
-            /* Figure out how much memory we will need to fill in the names of
-             * all tokens afterwards. */
-            int tokenlen = 0;
-            for (c = 0; c < ptr->n; c++) {
-                tokenlen += strlen(ptr->array[c].name) + strlen("'', ");
-            }
-
+        if (!handle_token(&walk)) {
             /* Build up a decent error message. We include the problem, the
              * full input, and underline the position where the parser
              * currently is. */
-            char *errormessage;
-            char *possible_tokens = smalloc(tokenlen + 1);
-            char *tokenwalk = possible_tokens;
-            for (c = 0; c < ptr->n; c++) {
-                token = &(ptr->array[c]);
-                if (token->name[0] == '\'') {
-                    /* A literal is copied to the error message enclosed with
-                     * single quotes. */
-                    *tokenwalk++ = '\'';
-                    strcpy(tokenwalk, token->name + 1);
-                    tokenwalk += strlen(token->name + 1);
-                    *tokenwalk++ = '\'';
-                } else {
-                    /* Any other token is copied to the error message enclosed
-                     * with angle brackets. */
-                    *tokenwalk++ = '<';
-                    strcpy(tokenwalk, token->name);
-                    tokenwalk += strlen(token->name);
-                    *tokenwalk++ = '>';
-                }
-                if (c < (ptr->n - 1)) {
-                    *tokenwalk++ = ',';
-                    *tokenwalk++ = ' ';
-                }
-            }
-            *tokenwalk = '\0';
-            sasprintf(&errormessage, "Expected one of these tokens: %s",
-                      possible_tokens);
-            free(possible_tokens);
+            char *errormessage = expected_tokens_message();
 
             /* Contains the same amount of characters as 'input' has, but with
              * the unparsable part highlighted using ^ characters. */
@@ -449,9 +467,80 @@ CommandResult *parse_command(const char *input, yajl_gen gen, ipc_client *client
     y(array_close);
 
     result->needs_tree_render = command_output.needs_tree_render;
+    TRACE_END(trace_start, "commands", "parse_command");
     return result;
 }
 
+#ifndef TEST_PARSER
+/*
+ * Parses criteria like [class="^Firefox$" workspace="3"] with the same grammar
+ * as the criteria of a command into the given (initialized) match, without
+ * executing anything. Returns NULL on success, or an error message, which the
+ * caller has to free.
+ *
+ */
+char *parse_criteria(const char *input, Match *match) {
+    DLOG("CRITERIA: *%.4000s*\n", input);
+    const char *walk = input;
+    char *error = NULL;
+
+    command_output.json_gen = NULL;
+    command_output.client = NULL;
+    match_free(&current_match);
+    match_init(&current_match);
+
+    while (*walk == ' ' || *walk == '\t') {
+        walk++;
+    }
+    if (*walk != '[') {
+        return sstrdup("Expected one of these tokens: '['");
+    }
+    walk++;
+    state = CRITERIA;
+
+    while (true) {
+        while (*walk == ' ' || *walk == '\t') {
+            walk++;
+        }
+        /* The closing bracket would match the windows (see
+         * cmd_criteria_match_windows()), which is up to the caller. */
+        if (state == CRITERIA && *walk == ']') {
+            walk++;
+            break;
+        }
+        if (!handle_token(&walk)) {
+            error = expected_tokens_message();
+            clear_stack(&stack);
+            break;
+        }
+    }
+    state = INITIAL;
+
+    if (error == NULL && current_match.error != NULL) {
+        error = sstrdup(current_match.error);
+    }
+    if (error == NULL) {
+        while (*walk == ' ' || *walk == '\t') {
+            walk++;
+        }
+        if (*walk != '\0') {
+            sasprintf(&error, "Unexpected input after the criteria: %s", walk);
+        }
+    }
+    if (error == NULL) {
+        /* The match takes over the regular expressions of current_match. */
+        match_free(match);
+        *match = current_match;
+        match_init(&current_match);
+    } else {
+        ELOG("Invalid criteria: %s\n", error);
+        match_free(&current_match);
+        match_init(&current_match);
+    }
+    return error;
+}
+#endif
+
 /*
  * Frees a CommandResult
  */
@@ -486,6 +575,26 @@ void debuglog(char *fmt, ...) {
     va_end(args);
 }
 
+uint32_t log_active_categories = LOG_ALL_CATEGORIES;
+
+bool trace_enabled = false;
+
+uint64_t trace_now(void) {
+    return 0;
+}
+
+void trace_record(uint64_t start, const char *category, const char *name) {
+}
+
+void debuglog_category(log_category_t category, char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    fprintf(stdout, "# ");
+    vfprintf(stdout, fmt, args);
+    va_end(args);
+}
+
 void errorlog(char *fmt, ...) {
     va_list args;
 
@@ -499,12 +608,12 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Syntax: %s <command>\n", argv[0]);
         return 1;
     }
-    yajl_gen gen = yajl_gen_alloc(NULL);
+    ipc_gen gen = ipc_gen_alloc(true, false);
 
     CommandResult *result = parse_command(argv[1], gen, NULL);
 
     command_result_free(result);
 
-    yajl_gen_free(gen);
+    ipc_gen_free(gen);
 }
 #endif
@@ -14,6 +14,74 @@
 
 static void con_on_remove_child(Con *con);
 
+/* Indexes for con_by_window_id() and con_by_frame_id(), which are called for
+ * nearly every X11 event. Kept in sync by con_set_window(), x_con_init(),
+ * x_con_kill() and con_free(). */
+static struct hashmap cons_by_window = HASHMAP_INITIALIZER(false);
+static struct hashmap cons_by_frame = HASHMAP_INITIALIZER(false);
+
+/* Maps every mark to the container holding it (marks are unique). The keys
+ * point to mark_t->name of the respective mark. */
+static struct hashmap cons_by_mark = HASHMAP_INITIALIZER(true);
+
+/* The handle table (see con_handle_t). Free slots form a singly-linked list
+ * through next_free. cons_by_pointer resolves the IPC container IDs, which are
+ * the addresses of the containers. */
+struct con_slot {
+    Con *con;
+    uint32_t generation;
+    uint32_t next_free;
+};
+#define NO_FREE_SLOT UINT32_MAX
+static struct con_slot *con_slots = NULL;
+static uint32_t con_slots_used = 0;
+static uint32_t con_slots_capacity = 0;
+static uint32_t con_slots_free = NO_FREE_SLOT;
+static struct hashmap cons_by_pointer = HASHMAP_INITIALIZER(false);
+
+/*
+ * Assigns a slot in the handle table to the given (new) container.
+ *
+ */
+static void con_handle_acquire(Con *con) {
+    uint32_t slot;
+    if (con_slots_free != NO_FREE_SLOT) {
+        slot = con_slots_free;
+        con_slots_free = con_slots[slot].next_free;
+    } else {
+        if (con_slots_used == con_slots_capacity) {
+            con_slots_capacity = (con_slots_capacity == 0 ? 64 : con_slots_capacity * 2);
+            con_slots = srealloc(con_slots, con_slots_capacity * sizeof(struct con_slot));
+        }
+        slot = con_slots_used++;
+        /* Generation 0 is never valid, so that a zeroed handle resolves to
+         * NULL. */
+        con_slots[slot].generation = 1;
+    }
+
+    con_slots[slot].con = con;
+    con_slots[slot].next_free = NO_FREE_SLOT;
+    con->handle = (con_handle_t){.slot = slot, .generation = con_slots[slot].generation};
+    hashmap_put(&cons_by_pointer, con, con);
+}
+
+/*
+ * Releases the slot of the given container, invalidating all handles to it.
+ *
+ */
+static void con_handle_release(Con *con) {
+    struct con_slot *slot = &(con_slots[con->handle.slot]);
+    assert(slot->con == con);
+
+    slot->con = NULL;
+    if (++(slot->generation) == 0) {
+        slot->generation = 1;
+    }
+    slot->next_free = con_slots_free;
+    con_slots_free = con->handle.slot;
+    hashmap_remove(&cons_by_pointer, con);
+}
+
 /*
  * force parent split containers to be redrawn
  *
@@ -39,8 +107,9 @@ Con *con_new_skeleton(Con *parent, i3Window *window) {
     Con *new = scalloc(1, sizeof(Con));
     new->on_remove_child = con_on_remove_child;
     TAILQ_INSERT_TAIL(&all_cons, new, all_cons);
+    con_handle_acquire(new);
     new->type = CT_CON;
-    new->window = window;
+    con_set_window(new, window);
     new->border_style = new->max_user_border_style = config.default_border;
     new->current_border_width = -1;
     new->window_icon_padding = -1;
@@ -80,7 +149,14 @@ Con *con_new(Con *parent, i3Window *window) {
 void con_free(Con *con) {
     free(con->name);
     FREE(con->deco_render_params);
+    render_cache_free(con);
+    tree_patch_con_freed(con);
     TAILQ_REMOVE(&all_cons, con, all_cons);
+    con_handle_release(con);
+    if (con->window != NULL) {
+        hashmap_remove_value(&cons_by_window, HASHMAP_INT_KEY(con->window->id), con);
+    }
+    con_unindex_frame(con);
     while (!TAILQ_EMPTY(&(con->swallow_head))) {
         Match *match = TAILQ_FIRST(&(con->swallow_head));
         TAILQ_REMOVE(&(con->swallow_head), match, matches);
@@ -90,6 +166,7 @@ void con_free(Con *con) {
     while (!TAILQ_EMPTY(&(con->marks_head))) {
         mark_t *mark = TAILQ_FIRST(&(con->marks_head));
         TAILQ_REMOVE(&(con->marks_head), mark, marks);
+        hashmap_remove_value(&cons_by_mark, mark->name, con);
         FREE(mark->name);
         FREE(mark);
     }
@@ -211,6 +288,7 @@ add_to_focus_head:
      * to focus them. */
     TAILQ_INSERT_TAIL(focus_head, con, focused);
     con_force_split_parents_redraw(con);
+    render_con_changed(con);
 }
 
 /*
@@ -233,6 +311,7 @@ void con_attach(Con *con, Con *parent, bool ignore_focus) {
  */
 void con_detach(Con *con) {
     con_force_split_parents_redraw(con);
+    render_con_changed(con);
     if (con->type == CT_FLOATING_CON) {
         TAILQ_REMOVE(&(con->parent->floating_head), con, floating_windows);
         TAILQ_REMOVE(&(con->parent->focus_head), con, focused);
@@ -253,6 +332,9 @@ void con_focus(Con *con) {
 
     /* 1: set focused-pointer to the new con */
     /* 2: exchange the position of the container in focus stack of the parent all the way up */
+    if (TAILQ_FIRST(&(con->parent->focus_head)) != con) {
+        render_con_changed(con);
+    }
     TAILQ_REMOVE(&(con->parent->focus_head), con, focused);
     TAILQ_INSERT_HEAD(&(con->parent->focus_head), con, focused);
     if (con->parent->parent != NULL) {
@@ -745,43 +827,133 @@ bool con_has_parent(Con *con, Con *parent) {
 }
 
 /*
- * Returns the container with the given client window ID or NULL if no such
- * container exists.
+ * Sets the client window of the given container (or NULL to detach it) and
+ * updates the index used by con_by_window_id().
  *
  */
-Con *con_by_window_id(xcb_window_t window) {
+void con_set_window(Con *con, i3Window *window) {
+    if (con->window != NULL && con->window != window) {
+        hashmap_remove_value(&cons_by_window, HASHMAP_INT_KEY(con->window->id), con);
+    }
+    con->window = window;
+    render_con_changed(con);
+    if (window != NULL && window->id != XCB_NONE) {
+        hashmap_put(&cons_by_window, HASHMAP_INT_KEY(window->id), con);
+    }
+}
+
+/*
+ * Adds the frame of the given container to the index used by
+ * con_by_frame_id(). Called from x_con_init() once the frame exists.
+ *
+ */
+void con_index_frame(Con *con) {
+    if (con->frame.id != XCB_NONE) {
+        hashmap_put(&cons_by_frame, HASHMAP_INT_KEY(con->frame.id), con);
+    }
+}
+
+/*
+ * Removes the frame of the given container from the index used by
+ * con_by_frame_id().
+ *
+ */
+void con_unindex_frame(Con *con) {
+    if (con->frame.id != XCB_NONE) {
+        hashmap_remove_value(&cons_by_frame, HASHMAP_INT_KEY(con->frame.id), con);
+    }
+}
+
+/*
+ * Verifies that the handle table and the window, frame and mark indexes agree
+ * with a walk over all containers. Aborts on mismatch, so only call this in debug
+ * builds.
+ *
+ */
+void con_check_indexes(void) {
+    uint32_t cons = 0, windows = 0, frames = 0, marks = 0;
     Con *con;
     TAILQ_FOREACH (con, &all_cons, all_cons) {
-        if (con->window != NULL && con->window->id == window) {
-            return con;
+        if (con_by_handle(con->handle) != con || con_by_con_id((long)con) != con) {
+            ELOG("BUG: con %p has a stale handle (slot %u)\n", con, con->handle.slot);
+            assert(false);
+        }
+        cons++;
+        if (con->window != NULL && con->window->id != XCB_NONE) {
+            if (hashmap_get(&cons_by_window, HASHMAP_INT_KEY(con->window->id)) != con) {
+                ELOG("BUG: window 0x%08x of con %p is not indexed\n", con->window->id, con);
+                assert(false);
+            }
+            windows++;
+        }
+        if (con->frame.id != XCB_NONE) {
+            if (hashmap_get(&cons_by_frame, HASHMAP_INT_KEY(con->frame.id)) != con) {
+                ELOG("BUG: frame 0x%08x of con %p is not indexed\n", con->frame.id, con);
+                assert(false);
+            }
+            frames++;
+        }
+        mark_t *mark;
+        TAILQ_FOREACH (mark, &(con->marks_head), marks) {
+            if (hashmap_get(&cons_by_mark, mark->name) != con) {
+                ELOG("BUG: mark \"%s\" of con %p is not indexed\n", mark->name, con);
+                assert(false);
+            }
+            marks++;
         }
     }
-    return NULL;
+
+    if (cons != cons_by_pointer.size ||
+        windows != cons_by_window.size ||
+        frames != cons_by_frame.size ||
+        marks != cons_by_mark.size) {
+        ELOG("BUG: con indexes are stale: %u/%u cons, %u/%u windows, %u/%u frames, %u/%u marks\n",
+             cons, cons_by_pointer.size, windows, cons_by_window.size,
+             frames, cons_by_frame.size, marks, cons_by_mark.size);
+        assert(false);
+    }
+}
+
+/*
+ * Returns the container with the given client window ID or NULL if no such
+ * container exists.
+ *
+ */
+Con *con_by_window_id(xcb_window_t window) {
+    if (window == XCB_NONE) {
+        return NULL;
+    }
+    return hashmap_get(&cons_by_window, HASHMAP_INT_KEY(window));
 }
 
 /*
  * Returns the container with the given container ID or NULL if no such
  * container exists.
  *
+ * Container IDs are the addresses of the containers (see the IPC protocol), so
+ * an ID of a freed container may refer to a new container at the same
+ * address. Resolve IDs right away; code which needs to hold on to a container
+ * stores its handle and uses con_by_handle() instead.
+ *
  */
 Con *con_by_con_id(long target) {
-    Con *con;
-    TAILQ_FOREACH (con, &all_cons, all_cons) {
-        if (con == (Con *)target) {
-            return con;
-        }
+    if (target == 0) {
+        return NULL;
     }
-
-    return NULL;
+    return hashmap_get(&cons_by_pointer, HASHMAP_INT_KEY(target));
 }
 
 /*
- * Returns true if the given container (still) exists.
- * This can be used, e.g., to make sure a container hasn't been closed in the meantime.
+ * Returns the container referenced by the given handle or NULL if that
+ * container has been freed in the meantime.
  *
  */
-bool con_exists(Con *con) {
-    return con_by_con_id((long)con) != NULL;
+Con *con_by_handle(con_handle_t handle) {
+    if (handle.slot >= con_slots_used ||
+        con_slots[handle.slot].generation != handle.generation) {
+        return NULL;
+    }
+    return con_slots[handle.slot].con;
 }
 
 /*
@@ -790,13 +962,10 @@ bool con_exists(Con *con) {
  *
  */
 Con *con_by_frame_id(xcb_window_t frame) {
-    Con *con;
-    TAILQ_FOREACH (con, &all_cons, all_cons) {
-        if (con->frame.id == frame) {
-            return con;
-        }
+    if (frame == XCB_NONE) {
+        return NULL;
     }
-    return NULL;
+    return hashmap_get(&cons_by_frame, HASHMAP_INT_KEY(frame));
 }
 
 /*
@@ -805,14 +974,45 @@ Con *con_by_frame_id(xcb_window_t frame) {
  *
  */
 Con *con_by_mark(const char *mark) {
+    return hashmap_get(&cons_by_mark, mark);
+}
+
+/*
+ * Iterates over all marks and the containers holding them, in no particular
+ * order. Start with *iter = 0 and call this function until it returns false.
+ * Marks must not be added or removed while iterating.
+ *
+ */
+bool con_next_mark(uint32_t *iter, const char **mark, Con **con) {
+    const void *key;
+    void *value;
+    if (!hashmap_next(&cons_by_mark, iter, &key, &value)) {
+        return false;
+    }
+    if (mark != NULL) {
+        *mark = key;
+    }
+    if (con != NULL) {
+        *con = value;
+    }
+    return true;
+}
+
+/*
+ * Adds every container holding a mark which matches the given regular
+ * expression to 'result' (a hash table with integer keys, mapping each
+ * container to itself). Only the mark index is scanned, not the whole tree.
+ *
+ */
+void con_by_mark_regex(struct regex *regex, struct hashmap *result) {
+    uint32_t iter = 0;
+    const char *mark;
     Con *con;
-    TAILQ_FOREACH (con, &all_cons, all_cons) {
-        if (con_has_mark(con, mark)) {
-            return con;
+    while (con_next_mark(&iter, &mark, &con)) {
+        if (regex_matches(regex, mark)) {
+            hashmap_put(result, con, con);
         }
     }
-
-    return NULL;
 }
 
 /*
@@ -855,14 +1055,7 @@ bool con_find_transient_for_window(Con *start, xcb_window_t target) {
  *
  */
 bool con_has_mark(Con *con, const char *mark) {
-    mark_t *current;
-    TAILQ_FOREACH (current, &(con->marks_head), marks) {
-        if (strcmp(current->name, mark) == 0) {
-            return true;
-        }
-    }
-
-    return false;
+    return con_by_mark(mark) == con;
 }
 
 /*
@@ -904,9 +1097,32 @@ void con_mark(Con *con, const char *mark, mark_mode_t mode) {
     mark_t *new = scalloc(1, sizeof(mark_t));
     new->name = sstrdup(mark);
     TAILQ_INSERT_TAIL(&(con->marks_head), new, marks);
+    hashmap_put(&cons_by_mark, new->name, con);
     ipc_send_window_event("mark", con);
 
     con->mark_changed = true;
+    tree_patch_con_changed(con);
+}
+
+/* Removes all marks of the given container. */
+static void con_unmark_all(Con *con) {
+    if (TAILQ_EMPTY(&(con->marks_head))) {
+        return;
+    }
+
+    mark_t *mark;
+    while (!TAILQ_EMPTY(&(con->marks_head))) {
+        mark = TAILQ_FIRST(&(con->marks_head));
+        hashmap_remove_value(&cons_by_mark, mark->name, con);
+        FREE(mark->name);
+        TAILQ_REMOVE(&(con->marks_head), mark, marks);
+        FREE(mark);
+
+        ipc_send_window_event("mark", con);
+    }
+
+    con->mark_changed = true;
+    tree_patch_con_changed(con);
 }
 
 /*
@@ -919,28 +1135,29 @@ void con_mark(Con *con, const char *mark, mark_mode_t mode) {
 void con_unmark(Con *con, const char *name) {
     Con *current;
     if (name == NULL) {
-        DLOG("Unmarking all containers.\n");
-        TAILQ_FOREACH (current, &all_cons, all_cons) {
-            if (con != NULL && current != con) {
-                continue;
-            }
-
-            if (TAILQ_EMPTY(&(current->marks_head))) {
-                continue;
-            }
-
-            mark_t *mark;
-            while (!TAILQ_EMPTY(&(current->marks_head))) {
-                mark = TAILQ_FIRST(&(current->marks_head));
-                FREE(mark->name);
-                TAILQ_REMOVE(&(current->marks_head), mark, marks);
-                FREE(mark);
-
-                ipc_send_window_event("mark", current);
-            }
+        if (con != NULL) {
+            con_unmark_all(con);
+            return;
+        }
 
-            current->mark_changed = true;
+        DLOG("Unmarking all containers.\n");
+        /* Every container holding a mark is in the mark index, so there is no
+         * need to walk the whole tree. The containers are collected first,
+         * since unmarking them changes the index. A container with several
+         * marks is collected more than once, which is harmless. */
+        if (cons_by_mark.size == 0) {
+            return;
+        }
+        Con **marked = smalloc(cons_by_mark.size * sizeof(Con *));
+        uint32_t count = 0;
+        uint32_t iter = 0;
+        while (con_next_mark(&iter, NULL, &current)) {
+            marked[count++] = current;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            con_unmark_all(marked[i]);
         }
+        free(marked);
     } else {
         DLOG("Removing mark \"%s\".\n", name);
         current = (con == NULL) ? con_by_mark(name) : con;
@@ -951,6 +1168,7 @@ void con_unmark(Con *con, const char *name) {
 
         DLOG("Found mark on con = %p. Removing it now.\n", current);
         current->mark_changed = true;
+        tree_patch_con_changed(current);
 
         mark_t *mark;
         TAILQ_FOREACH (mark, &(current->marks_head), marks) {
@@ -958,6 +1176,7 @@ void con_unmark(Con *con, const char *name) {
                 continue;
             }
 
+            hashmap_remove_value(&cons_by_mark, mark->name, current);
             FREE(mark->name);
             TAILQ_REMOVE(&(current->marks_head), mark, marks);
             FREE(mark);
@@ -1066,6 +1285,7 @@ void set_focus_order(Con *con, Con **focus_order) {
 
         TAILQ_INSERT_TAIL(&(con->focus_head), focus_order[idx], focused);
     }
+    render_con_changed(con);
 }
 
 /*
@@ -1181,6 +1401,7 @@ void con_fix_percent(Con *con) {
             child->percent /= total;
         }
     }
+    render_con_changed(con);
 }
 
 /*
@@ -1211,7 +1432,12 @@ void con_toggle_fullscreen(Con *con, int fullscreen_mode) {
  *
  */
 static void con_set_fullscreen_mode(Con *con, fullscreen_mode_t fullscreen_mode) {
+    /* A global fullscreen container hides all other workspaces. */
+    if (con->fullscreen_mode == CF_GLOBAL || fullscreen_mode == CF_GLOBAL) {
+        render_invalidate_all();
+    }
     con->fullscreen_mode = fullscreen_mode;
+    render_con_changed(con);
 
     DLOG("mode now: %d\n", con->fullscreen_mode);
 
@@ -1965,6 +2191,7 @@ void con_set_border_style(Con *con, border_style_t border_style, int border_widt
     if (border_style > con->max_user_border_style) {
         border_style = con->max_user_border_style;
     }
+    render_con_changed(con);
 
     /* Handle the simple case: non-floating containerns */
     if (!con_is_floating(con)) {
@@ -2028,6 +2255,7 @@ void con_set_layout(Con *con, layout_t layout) {
             con->workspace_layout = ws_layout;
             DLOG("Setting layout to %d\n", layout);
             con->layout = layout;
+            render_con_changed(con);
         } else if (layout == L_STACKED || layout == L_TABBED || layout == L_SPLITV || layout == L_SPLITH) {
             DLOG("Creating new split container\n");
             /* 1: create a new split container */
@@ -2103,6 +2331,7 @@ void con_set_layout(Con *con, layout_t layout) {
         con->layout = layout;
     }
     con_force_split_parents_redraw(con);
+    render_con_changed(con);
 }
 
 /*
@@ -2225,15 +2454,17 @@ static void con_on_remove_child(Con *con) {
     if (con->type == CT_WORKSPACE) {
         if (TAILQ_EMPTY(&(con->focus_head)) && !workspace_is_visible(con)) {
             LOG("Closing old workspace (%p / %s), it is empty\n", con, con->name);
-            yajl_gen gen = ipc_marshal_workspace_event("empty", con, NULL);
+            /* The event has to be built before the workspace is freed. */
+            ipc_gen gen = NULL;
+            if (ipc_wants_event(I3_IPC_EVENT_WORKSPACE)) {
+                gen = ipc_marshal_workspace_event("empty", con, NULL);
+            }
             tree_close_internal(con, DONT_KILL_WINDOW, false);
 
-            const unsigned char *payload;
-            ylength length;
-            y(get_buf, &payload, &length);
-            ipc_send_event("workspace", I3_IPC_EVENT_WORKSPACE, (const char *)payload);
-
-            y(free);
+            if (gen != NULL) {
+                ipc_send_event("workspace", I3_IPC_EVENT_WORKSPACE, gen);
+                y(free);
+            }
         }
         return;
     }
@@ -2462,6 +2693,9 @@ void con_set_urgency(Con *con, bool urgent) {
 
     if (con->urgent != old_urgent) {
         LOG("Urgency flag changed to %d\n", con->urgent);
+        /* Urgency changes might be rendered without laying out the workspace
+         * again (e.g. when the urgency timer expires). */
+        tree_patch_con_changed(con);
         ipc_send_window_event("urgent", con);
     }
 }
@@ -2715,8 +2949,9 @@ uint32_t con_rect_size_in_orientation(Con *con) {
  *
  */
 void con_merge_into(Con *old, Con *new) {
-    new->window = old->window;
-    old->window = NULL;
+    i3Window *window = old->window;
+    con_set_window(old, NULL);
+    con_set_window(new, window);
 
     if (old->title_format) {
         FREE(new->title_format);
@@ -2734,13 +2969,15 @@ void con_merge_into(Con *old, Con *new) {
 
     con_set_urgency(new, old->urgent);
 
+    new->mark_changed = !TAILQ_EMPTY(&(old->marks_head));
     mark_t *mark;
-    TAILQ_FOREACH (mark, &(old->marks_head), marks) {
+    while (!TAILQ_EMPTY(&(old->marks_head))) {
+        mark = TAILQ_FIRST(&(old->marks_head));
+        TAILQ_REMOVE(&(old->marks_head), mark, marks);
         TAILQ_INSERT_TAIL(&(new->marks_head), mark, marks);
+        hashmap_put(&cons_by_mark, mark->name, new);
         ipc_send_window_event("mark", new);
     }
-    new->mark_changed = (TAILQ_FIRST(&(old->marks_head)) != NULL);
-    TAILQ_INIT(&(old->marks_head));
 
     tree_close_internal(old, DONT_KILL_WINDOW, false);
 }
@@ -302,9 +302,13 @@ bool load_configuration(const char *override_configpath, config_load_t load_type
         regrab_all_buttons(conn);
         gaps_reapply_workspace_assignments();
 
+        /* Configuration options like the border width are reported by IPC for
+         * every container. */
+        tree_patch_invalidate();
+
         /* Redraw the currently visible decorations on reload, so that the
          * possibly new drawing parameters changed. */
-        tree_render();
+        tree_render_later();
     }
 
     return result == 0;
@@ -684,6 +684,16 @@ CFGFUN(ipc_kill_timeout, const long timeout_ms) {
     ipc_set_kill_timeout(timeout_ms / 1000.0);
 }
 
+CFGFUN(ipc_queue_limit, const long limit, const char *policy) {
+    ipc_overflow_policy_t overflow_policy = IPC_OVERFLOW_KILL;
+    if (policy != NULL && strcmp(policy, "drop") == 0) {
+        overflow_policy = IPC_OVERFLOW_DROP;
+    } else if (policy != NULL && strcmp(policy, "coalesce") == 0) {
+        overflow_policy = IPC_OVERFLOW_COALESCE;
+    }
+    ipc_set_queue_limit(limit, overflow_policy);
+}
+
 CFGFUN(tiling_drag, const char *value) {
     if (strcmp(value, "modifier") == 0) {
         config.tiling_drag = TILING_DRAG_MODIFIER;
@@ -551,6 +551,17 @@ void debuglog(char *fmt, ...) {
     va_end(args);
 }
 
+uint32_t log_active_categories = LOG_ALL_CATEGORIES;
+
+void debuglog_category(log_category_t category, char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    fprintf(stdout, "# ");
+    vfprintf(stdout, fmt, args);
+    va_end(args);
+}
+
 void errorlog(char *fmt, ...) {
     va_list args;
 
@@ -20,6 +20,9 @@ struct drag_x11_cb {
      * drag of the resize handle. */
     Con *con;
 
+    /* The handle of con, used to detect whether it was closed meanwhile. */
+    con_handle_t con_handle;
+
     /* The original event that initiated the drag. */
     const xcb_button_press_event_t *event;
 
@@ -108,6 +111,8 @@ static bool drain_drag_events(EV_P, struct drag_x11_cb *dragloop) {
         }
 
         if (dragloop->result != DRAGGING) {
+            handle_pending_property_notifies();
+            tree_render_if_requested();
             ev_break(EV_A_ EVBREAK_ONE);
             if (dragloop->result == DRAG_SUCCESS) {
                 /* Ensure motion notify events are handled. */
@@ -119,6 +124,9 @@ static bool drain_drag_events(EV_P, struct drag_x11_cb *dragloop) {
         }
     }
 
+    handle_pending_property_notifies();
+    tree_render_if_requested();
+
     if (last_motion_notify == NULL) {
         return true;
     }
@@ -139,7 +147,9 @@ static bool drain_drag_events(EV_P, struct drag_x11_cb *dragloop) {
     /* Ensure that we are either dragging the resize handle (con is NULL) or that the
      * container still exists. The latter might not be true, e.g., if the window closed
      * for any reason while the user was dragging it. */
-    if (dragloop->threshold_exceeded && (!dragloop->con || con_exists(dragloop->con))) {
+    if (dragloop->threshold_exceeded && (!dragloop->con || con_by_handle(dragloop->con_handle) != NULL)) {
+        /* Callbacks move or resize containers without rendering the tree. */
+        tree_bump_generation();
         dragloop->callback(
             dragloop->con,
             &(dragloop->old_rect),
@@ -235,6 +245,7 @@ drag_result_t drag_pointer(Con *con, const xcb_button_press_event_t *event,
     };
     ev_prepare *prepare = &loop.prepare;
     if (con) {
+        loop.con_handle = con->handle;
         loop.old_rect = con->rect;
     }
     ev_prepare_init(prepare, xcb_drag_prepare_cb);
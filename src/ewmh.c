@@ -7,6 +7,7 @@
  * ewmh.c: Get/set certain EWMH properties easily.
  *
  */
+#define LOG_CATEGORY LOG_X
 #include "all.h"
 
 #include "i3-atoms_NET_SUPPORTED.xmacro.h"
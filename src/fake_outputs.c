@@ -8,6 +8,7 @@
  * which don’t support multi-monitor in a useful way) and for our testsuite.
  *
  */
+#define LOG_CATEGORY LOG_RANDR
 #include "all.h"
 
 static int num_screens;
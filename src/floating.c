@@ -584,7 +584,7 @@ DRAGGING_CB(drag_window_callback) {
     }
     /* Ensure not to warp the pointer while dragging */
     x_set_warp_to(NULL);
-    tree_render();
+    tree_render_later();
 }
 
 /*
@@ -601,11 +601,12 @@ void floating_drag_window(Con *con, const xcb_button_press_event_t *event, bool
 
     /* Store the initial rect in case of user revert/cancel */
     Rect initial_rect = con->rect;
+    const con_handle_t handle = con->handle;
 
     /* Drag the window */
     drag_result_t drag_result = drag_pointer(con, event, XCB_NONE, XCURSOR_CURSOR_MOVE, use_threshold, drag_window_callback, NULL);
 
-    if (!con_exists(con)) {
+    if (con_by_handle(handle) == NULL) {
         DLOG("The container has been closed in the meantime.\n");
         return;
     }
@@ -621,7 +622,7 @@ void floating_drag_window(Con *con, const xcb_button_press_event_t *event, bool
         con->scratchpad_state = SCRATCHPAD_CHANGED;
     }
 
-    tree_render();
+    tree_render_later();
 }
 
 /*
@@ -726,10 +727,11 @@ void floating_resize_window(Con *con, const bool proportional,
 
     /* get the initial rect in case of revert/cancel */
     Rect initial_rect = con->rect;
+    const con_handle_t handle = con->handle;
 
     drag_result_t drag_result = drag_pointer(con, event, XCB_NONE, cursor, false, resize_window_callback, &params);
 
-    if (!con_exists(con)) {
+    if (con_by_handle(handle) == NULL) {
         DLOG("The container has been closed in the meantime.\n");
         return;
     }
@@ -769,7 +771,7 @@ bool floating_reposition(Con *con, Rect newrect) {
         con->scratchpad_state = SCRATCHPAD_CHANGED;
     }
 
-    tree_render();
+    tree_render_later();
     return true;
 }
 
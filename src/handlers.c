@@ -8,11 +8,9 @@
  *             …).
  *
  */
+#define LOG_CATEGORY LOG_X
 #include "all.h"
 
-#include <sys/time.h>
-#include <time.h>
-
 #include <xcb/randr.h>
 #define SN_API_NOT_YET_FROZEN 1
 #include <libsn/sn-monitor.h>
@@ -22,66 +20,6 @@ int xkb_base = -1;
 int xkb_current_group;
 int shape_base = -1;
 
-/* After mapping/unmapping windows, a notify event is generated. However, we don’t want it,
-   since it’d trigger an infinite loop of switching between the different windows when
-   changing workspaces */
-static SLIST_HEAD(ignore_head, Ignore_Event) ignore_events;
-
-/*
- * Adds the given sequence to the list of events which are ignored.
- * If this ignore should only affect a specific response_type, pass
- * response_type, otherwise, pass -1.
- *
- * Every ignored sequence number gets garbage collected after 5 seconds.
- *
- */
-void add_ignore_event(const int sequence, const int response_type) {
-    struct Ignore_Event *event = smalloc(sizeof(struct Ignore_Event));
-
-    event->sequence = sequence;
-    event->response_type = response_type;
-    event->added = time(NULL);
-
-    SLIST_INSERT_HEAD(&ignore_events, event, ignore_events);
-}
-
-/*
- * Checks if the given sequence is ignored and returns true if so.
- *
- */
-bool event_is_ignored(const int sequence, const int response_type) {
-    struct Ignore_Event *event;
-    time_t now = time(NULL);
-    for (event = SLIST_FIRST(&ignore_events); event != SLIST_END(&ignore_events);) {
-        if ((now - event->added) > 5) {
-            struct Ignore_Event *save = event;
-            event = SLIST_NEXT(event, ignore_events);
-            SLIST_REMOVE(&ignore_events, save, Ignore_Event, ignore_events);
-            free(save);
-        } else {
-            event = SLIST_NEXT(event, ignore_events);
-        }
-    }
-
-    SLIST_FOREACH (event, &ignore_events, ignore_events) {
-        if (event->sequence != sequence) {
-            continue;
-        }
-
-        if (event->response_type != -1 &&
-            event->response_type != response_type) {
-            continue;
-        }
-
-        /* Instead of removing & freeing a sequence number we better wait until
-         * it gets garbage collected. It may generate multiple events (there
-         * are multiple enter_notifies for one configure_request, for example). */
-        return true;
-    }
-
-    return false;
-}
-
 /*
  * Called with coordinates of an enter_notify event or motion_notify event
  * to check if the user crossed virtual screen boundaries and adjust the
@@ -116,7 +54,7 @@ static void check_crossing_screen_boundary(uint32_t x, uint32_t y) {
 
     /* If the focus changed, we re-render to get updated decorations */
     if (old_focused != focused) {
-        tree_render();
+        tree_render_later();
     }
 }
 
@@ -191,7 +129,7 @@ static void handle_enter_notify(xcb_enter_notify_event_t *event) {
 
     focused_id = XCB_NONE;
     con_focus(con_descend_focused(con));
-    tree_render();
+    tree_render_later();
 }
 
 /*
@@ -233,6 +171,7 @@ static void handle_motion_notify(xcb_motion_notify_event_t *event) {
             }
 
             con_focus(con);
+            tree_bump_generation();
             x_push_changes(croot);
             return;
         }
@@ -249,6 +188,7 @@ static void handle_motion_notify(xcb_motion_notify_event_t *event) {
             }
 
             con_focus(current);
+            tree_bump_generation();
             x_push_changes(croot);
             return;
         }
@@ -337,6 +277,10 @@ static void handle_configure_request(xcb_configure_request_event_t *event) {
 
     DLOG("Configure request!\n");
 
+    /* The geometry or the rect of a floating window might change, even on a
+     * workspace which is not visible (and thus not rendered). */
+    tree_patch_con_changed(con);
+
     Con *workspace = con_get_workspace(con);
     if (workspace && (strcmp(workspace->name, "__i3_scratch") == 0)) {
         DLOG("This is a scratchpad container, ignoring ConfigureRequest\n");
@@ -384,7 +328,7 @@ static void handle_configure_request(xcb_configure_request_event_t *event) {
             DLOG("Dock client wants to change height to %d, we can do that.\n", event->height);
 
             con->geometry.height = event->height;
-            tree_render();
+            tree_render_later();
         }
 
         if (event->value_mask & XCB_CONFIG_WINDOW_X || event->value_mask & XCB_CONFIG_WINDOW_Y) {
@@ -401,7 +345,7 @@ static void handle_configure_request(xcb_configure_request_event_t *event) {
                 con_detach(con);
                 con_attach(con, nc, false);
 
-                tree_render();
+                tree_render_later();
             } else {
                 DLOG("Dock client will not be moved, we only support moving it to another output.\n");
             }
@@ -433,12 +377,12 @@ static void handle_configure_request(xcb_configure_request_event_t *event) {
             DLOG("Focusing con = %p\n", con);
             workspace_show(workspace);
             con_activate_unblock(con);
-            tree_render();
+            tree_render_later();
         } else if (config.focus_on_window_activation == FOWA_URGENT || (config.focus_on_window_activation == FOWA_SMART && !workspace_is_visible(workspace))) {
             DLOG("Marking con = %p urgent\n", con);
             con_set_urgency(con, true);
             con = remanage_window(con);
-            tree_render();
+            tree_render_later();
         } else {
             DLOG("Ignoring request for con = %p.\n", con);
         }
@@ -473,7 +417,7 @@ static void handle_screen_change(xcb_generic_event_t *e) {
 
     scratchpad_fix_resolution();
 
-    ipc_send_event("output", I3_IPC_EVENT_OUTPUT, "{\"change\":\"unspecified\"}");
+    ipc_send_output_event("unspecified");
 }
 
 /*
@@ -518,7 +462,7 @@ static void handle_unmap_notify_event(xcb_unmap_notify_event_t *event) {
     xcb_delete_property(conn, event->window, A__NET_WM_STATE);
 
     tree_close_internal(con, DONT_KILL_WINDOW, false);
-    tree_render();
+    tree_render_later();
 
 ignore_end:
     /* If the client (as opposed to i3) destroyed or unmapped a window, an
@@ -724,7 +668,7 @@ static void handle_net_wm_state_change(Con *con, uint32_t change, uint32_t atom)
         return;
     }
 
-    tree_render();
+    tree_render_later();
 }
 
 /*
@@ -739,6 +683,12 @@ static void handle_client_message(xcb_client_message_event_t *event) {
     }
 
     LOG("ClientMessage for window 0x%08x\n", event->window);
+
+    /* Most messages change their window (e.g. its sticky or urgency state). */
+    Con *target = con_by_window_id(event->window);
+    if (target != NULL) {
+        tree_patch_con_changed(target);
+    }
     if (event->type == A__NET_WM_STATE) {
         if (event->format != 32) {
             DLOG("Unknown format %d in ClientMessage\n", event->format);
@@ -811,10 +761,12 @@ static void handle_client_message(xcb_client_message_event_t *event) {
             }
         }
 
-        tree_render();
+        tree_render_later();
     } else if (event->type == A_I3_SYNC) {
         xcb_window_t window = event->data.data32[0];
         uint32_t rnd = event->data.data32[1];
+        /* The client expects to see the result of all preceding requests. */
+        tree_render_if_requested();
         sync_respond(window, rnd);
     } else if (event->type == A__NET_REQUEST_FRAME_EXTENTS) {
         /*
@@ -873,7 +825,7 @@ static void handle_client_message(xcb_client_message_event_t *event) {
 
         DLOG("Handling request to focus workspace %s\n", ws->name);
         workspace_show(ws);
-        tree_render();
+        tree_render_later();
     } else if (event->type == A__NET_WM_DESKTOP) {
         uint32_t index = event->data.data32[0];
         DLOG("Request to move window %d to EWMH desktop index %d\n", event->window, index);
@@ -906,7 +858,7 @@ static void handle_client_message(xcb_client_message_event_t *event) {
             con_move_to_workspace(con, ws, true, false, false);
         }
 
-        tree_render();
+        tree_render_later();
         ewmh_update_wm_desktop();
     } else if (event->type == A__NET_CLOSE_WINDOW) {
         /*
@@ -923,7 +875,7 @@ static void handle_client_message(xcb_client_message_event_t *event) {
             }
 
             tree_close_internal(con, KILL_WINDOW, false);
-            tree_render();
+            tree_render_later();
         } else {
             DLOG("Couldn't find con for _NET_CLOSE_WINDOW request. (window = %08x)\n", event->window);
         }
@@ -1011,7 +963,7 @@ static bool handle_normal_hints(Con *con, xcb_get_property_reply_t *reply) {
         Con *floating = con_inside_floating(con);
         if (floating) {
             floating_check_size(con, false);
-            tree_render();
+            tree_render_later();
         }
     }
 
@@ -1028,7 +980,7 @@ static bool handle_hints(Con *con, xcb_get_property_reply_t *reply) {
     window_update_hints(con->window, reply, &urgency_hint);
     con_set_urgency(con, urgency_hint);
     remanage_window(con);
-    tree_render();
+    tree_render_later();
     return true;
 }
 
@@ -1106,7 +1058,7 @@ static void handle_focus_in(xcb_focus_in_event_t *event) {
 
     /* We update focused_id because we don’t need to set focus again */
     focused_id = event->event;
-    tree_render();
+    tree_render_later();
 }
 
 /*
@@ -1196,7 +1148,7 @@ static void handle_configure_notify(xcb_configure_notify_event_t *event) {
     }
     randr_query_outputs();
 
-    ipc_send_event("output", I3_IPC_EVENT_OUTPUT, "{\"change\":\"unspecified\"}");
+    ipc_send_output_event("unspecified");
 }
 
 /*
@@ -1299,7 +1251,7 @@ static bool handle_strut_partial_change(Con *con, xcb_get_property_reply_t *prop
     con_detach(con);
     con_attach(con, dockarea, true);
 
-    tree_render();
+    tree_render_later();
 
     return true;
 }
@@ -1358,6 +1310,34 @@ static struct property_handler_t property_handlers[] = {
     {0, UINT_MAX, handle_windowicon_change}};
 #define NUM_HANDLERS (sizeof(property_handlers) / sizeof(struct property_handler_t))
 
+/* Maps an atom to 1 + the index of its handler in property_handlers (or 0 if
+ * there is no handler for the atom). Atoms are small integers handed out by the
+ * X server in sequence, so a plain array is sufficient. */
+static uint8_t *handler_by_atom;
+static xcb_atom_t handler_by_atom_size;
+
+/* PropertyNotify events are not handled right away, but collected until all
+ * queued X11 events were processed (or until a different kind of event needs
+ * to be handled). Then, the properties are requested all at once and only one
+ * round trip is needed, no matter how many properties changed. Multiple
+ * changes of the same property of a window are handled only once. */
+struct pending_property_window {
+    xcb_window_t window;
+    /* Bit i is set if the property of handler i changed… */
+    uint32_t changed;
+    /* …and if that property was deleted by the last change. */
+    uint32_t deleted;
+};
+
+static struct pending_property_window *pending_properties;
+static uint32_t pending_properties_count;
+static uint32_t pending_properties_capacity;
+
+/* Maps a window to 1 + its index in pending_properties. */
+static struct hashmap pending_properties_by_window = HASHMAP_INITIALIZER(false);
+
+struct property_stats property_stats;
+
 /*
  * Sets the appropriate atoms for the property handlers after the atoms were
  * received from X11
@@ -1380,47 +1360,164 @@ void property_handlers_init(void) {
     property_handlers[11].atom = XCB_ATOM_WM_CLIENT_MACHINE;
     property_handlers[12].atom = A__MOTIF_WM_HINTS;
     property_handlers[13].atom = A__NET_WM_ICON;
-}
-
-static void property_notify(uint8_t state, xcb_window_t window, xcb_atom_t atom) {
-    struct property_handler_t *handler = NULL;
-    xcb_get_property_reply_t *propr = NULL;
-    xcb_generic_error_t *err = NULL;
-    Con *con;
 
+    handler_by_atom_size = 0;
     for (size_t c = 0; c < NUM_HANDLERS; c++) {
-        if (property_handlers[c].atom != atom) {
-            continue;
+        if (property_handlers[c].atom >= handler_by_atom_size) {
+            handler_by_atom_size = property_handlers[c].atom + 1;
         }
+    }
+    FREE(handler_by_atom);
+    handler_by_atom = scalloc(handler_by_atom_size, sizeof(uint8_t));
+    for (size_t c = 0; c < NUM_HANDLERS; c++) {
+        handler_by_atom[property_handlers[c].atom] = c + 1;
+    }
+}
 
-        handler = &property_handlers[c];
-        break;
+/*
+ * Returns the entry for the given window in the current batch of
+ * PropertyNotify events, creating it if necessary.
+ *
+ */
+static struct pending_property_window *pending_property_window(xcb_window_t window) {
+    uint32_t idx = (uintptr_t)hashmap_get(&pending_properties_by_window, HASHMAP_INT_KEY(window));
+    if (idx == 0) {
+        if (pending_properties_count == pending_properties_capacity) {
+            pending_properties_capacity = (pending_properties_capacity == 0 ? 16 : pending_properties_capacity * 2);
+            pending_properties = srealloc(pending_properties,
+                                          pending_properties_capacity * sizeof(struct pending_property_window));
+        }
+        pending_properties[pending_properties_count++] = (struct pending_property_window){
+            .window = window,
+        };
+        idx = pending_properties_count;
+        hashmap_put(&pending_properties_by_window, HASHMAP_INT_KEY(window), (void *)(uintptr_t)idx);
     }
 
-    if (handler == NULL) {
+    return &pending_properties[idx - 1];
+}
+
+static void property_notify(uint8_t state, xcb_window_t window, xcb_atom_t atom) {
+    if (atom >= handler_by_atom_size || handler_by_atom[atom] == 0) {
         /* DLOG("Unhandled property notify for atom %d (0x%08x)\n", atom, atom); */
         return;
     }
+    const uint32_t bit = (1 << (handler_by_atom[atom] - 1));
+    property_stats.notifies++;
+
+    struct pending_property_window *pending = pending_property_window(window);
+    if (pending->changed & bit) {
+        DLOG("Coalescing property notify for atom %d on window 0x%08x\n", atom, window);
+    }
+    pending->changed |= bit;
+    if (state == XCB_PROPERTY_DELETE) {
+        pending->deleted |= bit;
+    } else {
+        pending->deleted &= ~bit;
+    }
+}
 
-    if ((con = con_by_window_id(window)) == NULL || con->window == NULL) {
-        DLOG("Received property for atom %d for unknown client\n", atom);
+/*
+ * Handles all PropertyNotify events which were collected since the last call.
+ * The properties are requested from X11 all at once, before waiting for the
+ * first reply.
+ *
+ */
+void handle_pending_property_notifies(void) {
+    if (pending_properties_count == 0) {
         return;
     }
 
-    if (state != XCB_PROPERTY_DELETE) {
-        xcb_get_property_cookie_t cookie = xcb_get_property(conn, 0, window, atom, XCB_GET_PROPERTY_TYPE_ANY, 0, handler->long_len);
-        propr = xcb_get_property_reply(conn, cookie, &err);
-        if (err != NULL) {
-            DLOG("got error %d when getting property of atom %d\n", err->error_code, atom);
-            FREE(err);
-            return;
+    /* The property handlers might cause further events to be handled, so
+     * start a new batch before calling them. */
+    struct pending_property_window *batch = pending_properties;
+    const uint32_t batch_count = pending_properties_count;
+    pending_properties = NULL;
+    pending_properties_count = 0;
+    pending_properties_capacity = 0;
+    hashmap_clear(&pending_properties_by_window);
+
+    uint32_t num_cookies = 0;
+    for (uint32_t i = 0; i < batch_count; i++) {
+        if (manage_window_is_pending(batch[i].window)) {
+            /* The properties might have changed after they were requested for
+             * managing the window. Handle them once it is managed. */
+            struct pending_property_window *pending = pending_property_window(batch[i].window);
+            pending->changed = batch[i].changed;
+            pending->deleted = batch[i].deleted;
+            batch[i].changed = 0;
+            continue;
+        }
+        if (con_by_window_id(batch[i].window) == NULL) {
+            DLOG("Received property notify for unknown client 0x%08x\n", batch[i].window);
+            batch[i].changed = 0;
+            continue;
+        }
+        for (size_t h = 0; h < NUM_HANDLERS; h++) {
+            if ((batch[i].changed & ~batch[i].deleted) & (1 << h)) {
+                num_cookies++;
+            }
         }
     }
 
-    /* the handler will free() the reply unless it returns false */
-    if (!handler->cb(con, propr)) {
-        FREE(propr);
+    if (num_cookies > 0) {
+        property_stats.batches++;
+        property_stats.requests += num_cookies;
+    }
+
+    xcb_get_property_cookie_t *cookies = scalloc(num_cookies + 1, sizeof(xcb_get_property_cookie_t));
+    uint32_t c = 0;
+    for (uint32_t i = 0; i < batch_count; i++) {
+        for (size_t h = 0; h < NUM_HANDLERS; h++) {
+            const uint32_t bit = (1 << h);
+            if ((batch[i].changed & bit) && !(batch[i].deleted & bit)) {
+                cookies[c++] = xcb_get_property(conn, 0, batch[i].window, property_handlers[h].atom,
+                                                XCB_GET_PROPERTY_TYPE_ANY, 0, property_handlers[h].long_len);
+            }
+        }
+    }
+
+    c = 0;
+    for (uint32_t i = 0; i < batch_count; i++) {
+        for (size_t h = 0; h < NUM_HANDLERS; h++) {
+            const uint32_t bit = (1 << h);
+            if (!(batch[i].changed & bit)) {
+                continue;
+            }
+
+            xcb_get_property_reply_t *propr = NULL;
+            if (!(batch[i].deleted & bit)) {
+                xcb_generic_error_t *err = NULL;
+                propr = xcb_get_property_reply(conn, cookies[c++], &err);
+                if (err != NULL) {
+                    DLOG("got error %d when getting property of atom %d\n", err->error_code, property_handlers[h].atom);
+                    FREE(err);
+                    continue;
+                }
+            }
+
+            /* An earlier handler might have unmanaged the window. */
+            Con *con = con_by_window_id(batch[i].window);
+            if (con == NULL || con->window == NULL) {
+                DLOG("Received property for atom %d for unknown client\n", property_handlers[h].atom);
+                FREE(propr);
+                continue;
+            }
+
+            /* Most property handlers do not render the tree (e.g. a title
+             * change only redraws the decoration). */
+            tree_bump_generation();
+            tree_patch_con_changed(con);
+
+            /* the handler will free() the reply unless it returns false */
+            if (!property_handlers[h].cb(con, propr)) {
+                FREE(propr);
+            }
+        }
     }
+
+    free(cookies);
+    free(batch);
 }
 
 /*
@@ -1432,6 +1529,40 @@ void handle_event(int type, xcb_generic_event_t *event) {
     if (type != XCB_MOTION_NOTIFY) {
         DLOG("event type %d, xkb_base %d\n", type, xkb_base);
     }
+    tree_render_stats.events++;
+
+    /* Other events might depend on new windows being managed and their
+     * properties being up to date (e.g. an I3_SYNC client message sent after
+     * mapping a window or changing its title). */
+    if (type != XCB_MAP_REQUEST && type != XCB_PROPERTY_NOTIFY) {
+        manage_pending_windows(true);
+        handle_pending_property_notifies();
+    }
+
+    /* Most events may change the tree. Motion events are frequent and rarely
+     * change the focus, so handle_motion_notify() marks the tree as changed
+     * itself, and property changes are handled later. Key events only change
+     * the tree by running a binding (see run_binding()). Enter and focus
+     * events only move the focus, which is checked after handling them.
+     * Expose, FocusOut and I3_SYNC events do not change anything. */
+    const bool focus_event = (type == XCB_ENTER_NOTIFY || type == XCB_FOCUS_IN);
+    const con_handle_t focused_before = focused->handle;
+    if (type != XCB_MOTION_NOTIFY && type != XCB_EXPOSE && type != XCB_PROPERTY_NOTIFY &&
+        type != XCB_KEY_PRESS && type != XCB_KEY_RELEASE && type != XCB_FOCUS_OUT &&
+        !focus_event &&
+        !(type == XCB_CLIENT_MESSAGE && ((xcb_client_message_event_t *)event)->type == A_I3_SYNC)) {
+        tree_bump_generation();
+    }
+
+    /* These events are handled based on the rendered layout (e.g. which tab
+     * was clicked, which container lies in a given direction or which
+     * geometry a window is told about). */
+    if (type == XCB_KEY_PRESS || type == XCB_KEY_RELEASE ||
+        type == XCB_BUTTON_PRESS || type == XCB_BUTTON_RELEASE ||
+        type == XCB_MOTION_NOTIFY || type == XCB_ENTER_NOTIFY ||
+        type == XCB_CONFIGURE_REQUEST || type == XCB_EXPOSE) {
+        tree_render_if_requested();
+    }
 
     if (randr_base > -1 &&
         type == randr_base + XCB_RANDR_SCREEN_CHANGE_NOTIFY) {
@@ -1583,4 +1714,10 @@ void handle_event(int type, xcb_generic_event_t *event) {
             /* DLOG("Unhandled event of type %d\n", type); */
             break;
     }
+
+    /* Only moving the focus changes the tree, which tree_patch.c tracks
+     * itself. */
+    if (focus_event && con_by_handle(focused_before) != focused) {
+        tree_bump_generation();
+    }
 }
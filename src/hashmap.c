@@ -0,0 +1,219 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * hashmap.c: A small open-addressing hash table, used to index containers
+ *            (and other objects) by X11 window ID, pointer or name.
+ *
+ * Collisions are resolved by linear probing. Removal uses backward shifting
+ * instead of tombstones, so lookups never get slower over time, no matter how
+ * many windows come and go.
+ *
+ */
+#include "all.h"
+
+/* The table is grown when more than 3/4 of the slots are in use. */
+#define MIN_CAPACITY 16
+
+static uint32_t hash_key(struct hashmap *map, const void *key) {
+    if (map->string_keys) {
+        /* FNV-1a */
+        uint32_t hash = 2166136261u;
+        for (const unsigned char *c = key; *c != '\0'; c++) {
+            hash ^= *c;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /* X11 IDs and pointers are mostly sequential, so spread them out using
+     * the 64-bit finalizer of MurmurHash3. */
+    uint64_t h = (uint64_t)(uintptr_t)key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+static bool keys_equal(struct hashmap *map, const void *a, const void *b) {
+    if (map->string_keys) {
+        return strcmp(a, b) == 0;
+    }
+    return a == b;
+}
+
+/*
+ * Returns the slot in which the given key is stored, or the empty slot in
+ * which it would have to be inserted.
+ *
+ */
+static uint32_t find_slot(struct hashmap *map, const void *key) {
+    const uint32_t mask = map->capacity - 1;
+    uint32_t slot = hash_key(map, key) & mask;
+    while (map->entries[slot].key != NULL &&
+           !keys_equal(map, map->entries[slot].key, key)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void resize(struct hashmap *map, uint32_t capacity) {
+    struct hashmap_entry *old_entries = map->entries;
+    const uint32_t old_capacity = map->capacity;
+
+    map->entries = scalloc(capacity, sizeof(struct hashmap_entry));
+    map->capacity = capacity;
+
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old_entries[i].key == NULL) {
+            continue;
+        }
+        map->entries[find_slot(map, old_entries[i].key)] = old_entries[i];
+    }
+
+    free(old_entries);
+}
+
+/*
+ * Returns the value stored for the given key or NULL if there is no such
+ * entry.
+ *
+ */
+void *hashmap_get(struct hashmap *map, const void *key) {
+    assert(key != NULL);
+    if (map->size == 0) {
+        return NULL;
+    }
+
+    return map->entries[find_slot(map, key)].value;
+}
+
+/*
+ * Stores value for the given key, replacing any previous entry.
+ *
+ */
+void hashmap_put(struct hashmap *map, const void *key, void *value) {
+    assert(key != NULL);
+    if (map->capacity == 0) {
+        resize(map, MIN_CAPACITY);
+    } else if ((map->size + 1) * 4 > map->capacity * 3) {
+        resize(map, map->capacity * 2);
+    }
+
+    struct hashmap_entry *entry = &(map->entries[find_slot(map, key)]);
+    if (entry->key == NULL) {
+        map->size++;
+    }
+    entry->key = key;
+    entry->value = value;
+}
+
+/*
+ * Empties the given slot and moves entries which come after it in the same
+ * probe sequence up, so that they stay reachable.
+ *
+ */
+static void remove_slot(struct hashmap *map, uint32_t slot) {
+    const uint32_t mask = map->capacity - 1;
+    uint32_t hole = slot;
+    uint32_t next = slot;
+
+    while (true) {
+        next = (next + 1) & mask;
+        if (map->entries[next].key == NULL) {
+            break;
+        }
+
+        /* The entry in 'next' may only be moved into the hole if its home
+         * slot does not lie (cyclically) between the hole and 'next'. */
+        const uint32_t home = hash_key(map, map->entries[next].key) & mask;
+        const bool home_between = (hole <= next)
+                                      ? (hole < home && home <= next)
+                                      : (hole < home || home <= next);
+        if (home_between) {
+            continue;
+        }
+
+        map->entries[hole] = map->entries[next];
+        hole = next;
+    }
+
+    map->entries[hole].key = NULL;
+    map->entries[hole].value = NULL;
+    map->size--;
+}
+
+/*
+ * Removes the entry for the given key and returns its value (or NULL if there
+ * was no such entry).
+ *
+ */
+void *hashmap_remove(struct hashmap *map, const void *key) {
+    assert(key != NULL);
+    if (map->size == 0) {
+        return NULL;
+    }
+
+    const uint32_t slot = find_slot(map, key);
+    void *value = map->entries[slot].value;
+    if (map->entries[slot].key != NULL) {
+        remove_slot(map, slot);
+    }
+    return value;
+}
+
+/*
+ * Removes the entry for the given key, but only if it currently maps to the
+ * given value. Returns true if an entry was removed.
+ *
+ */
+bool hashmap_remove_value(struct hashmap *map, const void *key, void *value) {
+    assert(key != NULL);
+    if (map->size == 0) {
+        return false;
+    }
+
+    const uint32_t slot = find_slot(map, key);
+    if (map->entries[slot].key == NULL || map->entries[slot].value != value) {
+        return false;
+    }
+    remove_slot(map, slot);
+    return true;
+}
+
+/*
+ * Iterates over all entries. Start with *iter = 0 and call this function until
+ * it returns false. The hash table must not be modified while iterating.
+ *
+ */
+bool hashmap_next(struct hashmap *map, uint32_t *iter, const void **key, void **value) {
+    while (*iter < map->capacity) {
+        struct hashmap_entry *entry = &(map->entries[(*iter)++]);
+        if (entry->key == NULL) {
+            continue;
+        }
+        if (key != NULL) {
+            *key = entry->key;
+        }
+        if (value != NULL) {
+            *value = entry->value;
+        }
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Frees all memory used by the hash table and resets it to an empty state.
+ * The stored values are not freed.
+ *
+ */
+void hashmap_clear(struct hashmap *map) {
+    FREE(map->entries);
+    map->size = 0;
+    map->capacity = 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * ignore_events.c: Remembers X11 sequence numbers whose events (or errors)
+ *                  should be ignored.
+ *
+ * After mapping/unmapping windows, a notify event is generated. However, we
+ * don’t want it, since it’d trigger an infinite loop of switching between the
+ * different windows when changing workspaces.
+ *
+ * The sequence numbers are kept in a ring buffer, sorted by sequence number,
+ * so that adding is (amortized) O(1) and looking up is O(log n), without
+ * allocating memory for each entry.
+ *
+ * With the "sequences" debug log category enabled (it is disabled by default,
+ * since these functions are called for most X11 events), every call is
+ * logged, so that the calls of a real session can be replayed by
+ * testcases/bench_ignore_events.c.
+ *
+ */
+#include "all.h"
+
+#include <time.h>
+
+/* Initial number of entries in the ring buffer. The size is always a power of
+ * two. When the ring is full, it grows instead of dropping entries which did
+ * not expire yet. */
+#define INITIAL_RING_SIZE 1024
+
+/* Entries expire after this many milliseconds… */
+#define EXPIRE_MSEC 5000
+
+/* …or once this many newer sequence numbers have been added. Keeping all
+ * entries within a window this small makes comparing 16-bit sequence numbers
+ * unambiguous, even when they wrap around. */
+#define EXPIRE_SEQUENCES 0x4000
+
+static struct Ignore_Event *ring;
+static uint32_t ring_size;
+static uint32_t ring_start;
+static uint32_t ring_count;
+
+/* The newest sequence number which was added. */
+static uint16_t newest_sequence;
+
+#define RING_AT(i) ring[(ring_start + (i)) & (ring_size - 1)]
+
+/*
+ * Returns true if sequence number a comes before b, taking wraparound into
+ * account.
+ *
+ */
+static bool sequence_before(uint16_t a, uint16_t b) {
+    return (int16_t)(uint16_t)(a - b) < 0;
+}
+
+static uint64_t now_msec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Drops entries from the start of the ring (the lowest sequence numbers) once
+ * they have expired. Since entries are sorted by sequence number and not by the
+ * time they were added, an expired entry may stay around a little longer when
+ * it is preceded by one which has not yet expired. That is harmless.
+ *
+ */
+static void expire(uint64_t now) {
+    while (ring_count > 0) {
+        struct Ignore_Event *first = &RING_AT(0);
+        if (now - first->added < EXPIRE_MSEC &&
+            (uint16_t)(newest_sequence - first->sequence) < EXPIRE_SEQUENCES) {
+            break;
+        }
+        ring_start++;
+        ring_count--;
+    }
+}
+
+/*
+ * Doubles the size of the ring (or allocates it initially), keeping the order
+ * of the entries.
+ *
+ */
+static void grow(void) {
+    const uint32_t new_size = (ring_size == 0 ? INITIAL_RING_SIZE : ring_size * 2);
+    struct Ignore_Event *new_ring = smalloc(new_size * sizeof(struct Ignore_Event));
+    for (uint32_t i = 0; i < ring_count; i++) {
+        new_ring[i] = RING_AT(i);
+    }
+    if (ring_size > 0) {
+        DLOG("%u ignored sequences pending, growing the ring to %u entries\n", ring_count, new_size);
+    }
+    free(ring);
+    ring = new_ring;
+    ring_size = new_size;
+    ring_start = 0;
+}
+
+/*
+ * Adds the given sequence to the list of events which are ignored.
+ * If this ignore should only affect a specific response_type, pass
+ * response_type, otherwise, pass -1.
+ *
+ * Every ignored sequence number gets garbage collected after 5 seconds.
+ *
+ */
+void add_ignore_event(const int sequence, const int response_type) {
+    /* Sequence numbers in X11 events are only 16 bits wide, while xcb cookies
+     * contain the full sequence number. */
+    const uint16_t seq = (uint16_t)sequence;
+    const uint64_t now = now_msec();
+
+    CDLOG(LOG_SEQUENCES, "ignore_events: add %d %d\n", sequence, response_type);
+
+    if (ring_count == 0 || sequence_before(newest_sequence, seq)) {
+        newest_sequence = seq;
+    } else if ((uint16_t)(newest_sequence - seq) >= EXPIRE_SEQUENCES) {
+        /* Way older than anything else in the ring. The events for this
+         * sequence were processed long ago. */
+        return;
+    }
+    expire(now);
+
+    if (ring_count == ring_size) {
+        grow();
+    }
+
+    /* Entries are almost always added in order (requests we send and events
+     * we receive both have increasing sequence numbers), but an event can be
+     * older than the last request we sent. Insert it at the right position. */
+    uint32_t pos = ring_count;
+    while (pos > 0 && sequence_before(seq, RING_AT(pos - 1).sequence)) {
+        RING_AT(pos) = RING_AT(pos - 1);
+        pos--;
+    }
+
+    RING_AT(pos) = (struct Ignore_Event){
+        .sequence = seq,
+        .response_type = response_type,
+        .added = now,
+    };
+    ring_count++;
+}
+
+/*
+ * Looks up the given sequence in the ring, see event_is_ignored().
+ *
+ */
+static bool sequence_is_ignored(const int sequence, const int response_type) {
+    const uint16_t seq = (uint16_t)sequence;
+
+    expire(now_msec());
+
+    /* Find the first entry which does not come before seq. */
+    uint32_t low = 0;
+    uint32_t high = ring_count;
+    while (low < high) {
+        const uint32_t mid = low + (high - low) / 2;
+        if (sequence_before(RING_AT(mid).sequence, seq)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    for (uint32_t i = low; i < ring_count && RING_AT(i).sequence == seq; i++) {
+        struct Ignore_Event *event = &RING_AT(i);
+        if (event->response_type != -1 &&
+            event->response_type != response_type) {
+            continue;
+        }
+
+        /* Instead of removing a sequence number we better wait until it
+         * expires. It may generate multiple events (there are multiple
+         * enter_notifies for one configure_request, for example). */
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Checks if the given sequence is ignored and returns true if so.
+ *
+ */
+bool event_is_ignored(const int sequence, const int response_type) {
+    const bool ignored = sequence_is_ignored(sequence, response_type);
+    CDLOG(LOG_SEQUENCES, "ignore_events: check %d %d %d\n", sequence, response_type, ignored);
+    return ignored;
+}
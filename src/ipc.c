@@ -8,6 +8,7 @@
  *
  */
 
+#define LOG_CATEGORY LOG_IPC
 #include "all.h"
 #include "yajl_utils.h"
 
@@ -17,7 +18,9 @@
 #include <locale.h>
 #include <stdint.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <yajl/yajl_gen.h>
@@ -27,32 +30,254 @@ char *current_socketpath = NULL;
 
 TAILQ_HEAD(ipc_client_head, ipc_client) all_clients = TAILQ_HEAD_INITIALIZER(all_clients);
 
+/* The clients which are subscribed to each event type, in the order in which
+ * they subscribed. */
+static struct ipc_client_head subscribers[IPC_NUM_EVENTS] = {
+    TAILQ_HEAD_INITIALIZER(subscribers[0]),
+    TAILQ_HEAD_INITIALIZER(subscribers[1]),
+    TAILQ_HEAD_INITIALIZER(subscribers[2]),
+    TAILQ_HEAD_INITIALIZER(subscribers[3]),
+    TAILQ_HEAD_INITIALIZER(subscribers[4]),
+    TAILQ_HEAD_INITIALIZER(subscribers[5]),
+    TAILQ_HEAD_INITIALIZER(subscribers[6]),
+    TAILQ_HEAD_INITIALIZER(subscribers[7]),
+    TAILQ_HEAD_INITIALIZER(subscribers[8]),
+};
+
+/* Statistics about sent and avoided event payloads, see GET_STATS. */
+static struct {
+    uint64_t serialized;
+    uint64_t skipped;
+    /* The number of clients the serialized events were sent to, in total. */
+    uint64_t recipients;
+} event_stats[IPC_NUM_EVENTS];
+
+/* The names of the message types, as used by i3-msg -t. */
+static const char *message_type_names[] = {
+    "run_command",
+    "get_workspaces",
+    "subscribe",
+    "get_outputs",
+    "get_tree",
+    "get_marks",
+    "get_bar_config",
+    "get_version",
+    "get_binding_modes",
+    "get_config",
+    "send_tick",
+    "sync",
+    "get_binding_state",
+    "get_stats",
+    "get_tree_patch",
+    "set_encoding",
+    "get_trace",
+};
+
+/* How long handling each message type took, see GET_STATS. */
+static struct latency_histogram handler_durations[sizeof(message_type_names) / sizeof(char *)];
+
+/* The names of the event types, as used in SUBSCRIBE messages. */
+static const char *event_names[IPC_NUM_EVENTS] = {
+    "workspace",
+    "output",
+    "mode",
+    "window",
+    "barconfig_update",
+    "binding",
+    "shutdown",
+    "tick",
+    "tree_patch",
+};
+
 static void ipc_client_timeout(EV_P_ ev_timer *w, int revents);
 static void ipc_socket_writeable_cb(EV_P_ struct ev_io *w, int revents);
 
 static ev_tstamp kill_timeout = 10.0;
+static uint32_t queue_limit = 0;
+static ipc_overflow_policy_t overflow_policy = IPC_OVERFLOW_KILL;
 
 void ipc_set_kill_timeout(ev_tstamp new) {
     kill_timeout = new;
 }
 
 /*
- * Try to write the contents of the pending buffer to the client's subscription
- * socket. Will set, reset or clear the timeout and io write callbacks depending
- * on the result of the write operation.
+ * Set the maximum number of messages which may be queued for a client whose
+ * socket is not writeable, and what to do with clients which exceed it. A
+ * limit of 0 means no limit.
+ *
+ */
+void ipc_set_queue_limit(long limit, ipc_overflow_policy_t policy) {
+    queue_limit = (limit > 0 ? (uint32_t)limit : 0);
+    overflow_policy = policy;
+}
+
+/*
+ * Returns true if clients are killed when nothing could be written to them for
+ * kill_timeout. That is not necessary when their queues are bounded and they
+ * are not killed on overflow.
+ *
+ */
+static bool ipc_kill_on_timeout(void) {
+    return (queue_limit == 0 || overflow_policy == IPC_OVERFLOW_KILL);
+}
+
+static bool ipc_queue_exceeded(ipc_client *client) {
+    return (queue_limit > 0 && client->num_messages > queue_limit);
+}
+
+/* The maximum number of queued messages written with a single writev(). */
+#define MAX_WRITEV_MESSAGES 64
+
+static ipc_payload *ipc_new_payload(size_t size, const uint8_t *data) {
+    ipc_payload *payload = smalloc(sizeof(ipc_payload) + size);
+    payload->refcount = 1;
+    payload->size = size;
+    memcpy(payload->data, data, size);
+    return payload;
+}
+
+static void ipc_payload_unref(ipc_payload *payload) {
+    if (--(payload->refcount) == 0) {
+        free(payload);
+    }
+}
+
+/*
+ * Allocates a generator for a reply to the client, which writes the encoding
+ * selected by the client.
+ *
+ */
+static ipc_gen ipc_reply_gen_alloc(ipc_client *client) {
+    return ipc_gen_alloc(client->encoding == IPC_ENCODING_JSON,
+                         client->encoding == IPC_ENCODING_CBOR);
+}
+
+/*
+ * Returns the payload written to gen in the encoding selected by the client.
+ *
+ */
+static void ipc_gen_get_payload(ipc_gen gen, ipc_client *client, const uint8_t **payload, size_t *size) {
+    if (client->encoding == IPC_ENCODING_CBOR) {
+        ipc_gen_get_cbor(gen, payload, size);
+    } else {
+        ipc_gen_get_buf(gen, payload, size);
+    }
+}
+
+static void ipc_enqueue_message(ipc_client *client, ipc_message *message) {
+    TAILQ_INSERT_TAIL(&(client->messages), message, messages);
+    client->num_messages++;
+    client->queued_bytes += sizeof(i3_ipc_header_t) + message->payload->size;
+    client->total_queued_bytes += sizeof(i3_ipc_header_t) + message->payload->size - message->written;
+}
+
+static void ipc_dequeue_message(ipc_client *client, ipc_message *message) {
+    TAILQ_REMOVE(&(client->messages), message, messages);
+    client->num_messages--;
+    client->queued_bytes -= sizeof(i3_ipc_header_t) + message->payload->size;
+    ipc_payload_unref(message->payload);
+    free(message);
+}
+
+/*
+ * Writes as many queued messages to the client as possible without blocking.
+ * Returns the number of bytes written or -1 on error.
+ *
+ */
+static ssize_t ipc_write_queue(ipc_client *client) {
+    ssize_t total = 0;
+    while (!TAILQ_EMPTY(&(client->messages))) {
+        struct iovec iov[2 * MAX_WRITEV_MESSAGES];
+        int iovcnt = 0;
+        size_t requested = 0;
+        ipc_message *message;
+        TAILQ_FOREACH (message, &(client->messages), messages) {
+            if (iovcnt + 2 > 2 * MAX_WRITEV_MESSAGES) {
+                break;
+            }
+            const size_t header_size = sizeof(i3_ipc_header_t);
+            if (message->written < header_size) {
+                iov[iovcnt++] = (struct iovec){
+                    .iov_base = ((uint8_t *)&(message->header)) + message->written,
+                    .iov_len = header_size - message->written};
+                iov[iovcnt++] = (struct iovec){
+                    .iov_base = message->payload->data,
+                    .iov_len = message->payload->size};
+            } else {
+                const size_t offset = message->written - header_size;
+                iov[iovcnt++] = (struct iovec){
+                    .iov_base = message->payload->data + offset,
+                    .iov_len = message->payload->size - offset};
+            }
+            requested += sizeof(i3_ipc_header_t) + message->payload->size - message->written;
+        }
+
+        const ssize_t n = writev(client->fd, iov, iovcnt);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN ? total : -1);
+        }
+        total += n;
+        client->sent_bytes += n;
+
+        /* Advance over the written messages. */
+        size_t remaining = (size_t)n;
+        while (remaining > 0) {
+            message = TAILQ_FIRST(&(client->messages));
+            const size_t left = sizeof(i3_ipc_header_t) + message->payload->size - message->written;
+            if (remaining < left) {
+                message->written += remaining;
+                break;
+            }
+            remaining -= left;
+            if (message->header.type & I3_IPC_EVENT_MASK) {
+                client->delivered_events++;
+            }
+            ipc_dequeue_message(client, message);
+        }
+        if ((size_t)n < requested) {
+            /* Short write, the socket buffer is full. */
+            break;
+        }
+    }
+    return total;
+}
+
+/*
+ * (Re-)starts the timer which kills the client after the given delay.
+ *
+ */
+static void ipc_set_client_timeout(ipc_client *client, ev_tstamp after) {
+    if (!client->timeout) {
+        struct ev_timer *timeout = scalloc(1, sizeof(struct ev_timer));
+        ev_timer_init(timeout, ipc_client_timeout, after, 0.);
+        timeout->data = client;
+        client->timeout = timeout;
+        ev_set_priority(timeout, EV_MINPRI);
+    } else {
+        ev_timer_stop(main_loop, client->timeout);
+        ev_timer_set(client->timeout, after, 0.);
+    }
+    ev_timer_start(main_loop, client->timeout);
+}
+
+/*
+ * Try to write the queued messages to the client's subscription socket. Will
+ * set, reset or clear the timeout and io write callbacks depending on the
+ * result of the write operation.
  *
  */
 static void ipc_push_pending(ipc_client *client) {
-    const ssize_t result = writeall_nonblock(client->fd, client->buffer, client->buffer_size);
+    const ssize_t result = ipc_write_queue(client);
     if (result < 0) {
         return;
     }
 
-    if ((size_t)result == client->buffer_size) {
+    if (TAILQ_EMPTY(&(client->messages))) {
         /* Everything was written successfully: clear the timer and stop the io
          * callback. */
-        FREE(client->buffer);
-        client->buffer_size = 0;
         if (client->timeout) {
             ev_timer_stop(main_loop, client->timeout);
             FREE(client->timeout);
@@ -65,53 +290,233 @@ static void ipc_push_pending(ipc_client *client) {
      * timer if needed. */
     ev_io_start(main_loop, client->write_callback);
 
+    if (!ipc_kill_on_timeout()) {
+        /* The queue is bounded, so the client can stay. */
+        if (client->timeout) {
+            ev_timer_stop(main_loop, client->timeout);
+            FREE(client->timeout);
+        }
+        return;
+    }
+
     if (!client->timeout) {
-        struct ev_timer *timeout = scalloc(1, sizeof(struct ev_timer));
-        ev_timer_init(timeout, ipc_client_timeout, kill_timeout, 0.);
-        timeout->data = client;
-        client->timeout = timeout;
-        ev_set_priority(timeout, EV_MINPRI);
-        ev_timer_start(main_loop, client->timeout);
-    } else if (result > 0) {
+        ipc_set_client_timeout(client, kill_timeout);
+    } else if (result > 0 && !ipc_queue_exceeded(client)) {
         /* Keep the old timeout when nothing is written. Otherwise, we would
-         * keep a dead connection by continuously renewing its timeouts. */
-        ev_timer_stop(main_loop, client->timeout);
-        ev_timer_set(client->timeout, kill_timeout, 0.0);
-        ev_timer_start(main_loop, client->timeout);
+         * keep a dead connection by continuously renewing its timeouts. The
+         * same goes for a client which is about to be killed because its
+         * queue overflowed. */
+        ipc_set_client_timeout(client, kill_timeout);
     }
-    if (result == 0) {
+}
+
+/*
+ * Removes the queued events of the client which are superseded by the given
+ * new message (see IPC_OVERFLOW_COALESCE). Partially written messages are
+ * kept, of course.
+ *
+ */
+static void ipc_coalesce(ipc_client *client, ipc_message *new) {
+    ipc_message *message = TAILQ_FIRST(&(client->messages));
+    while (message != NULL) {
+        ipc_message *next = TAILQ_NEXT(message, messages);
+        if (message->written == 0 &&
+            message->header.type == new->header.type &&
+            message->supersedes != NULL &&
+            strcmp(message->supersedes, new->supersedes) == 0 &&
+            message->con.slot == new->con.slot &&
+            message->con.generation == new->con.generation) {
+            ipc_dequeue_message(client, message);
+            client->coalesced++;
+        }
+        message = next;
+    }
+}
+
+/*
+ * Drops all queued events of the client which were not partially written yet
+ * and queues one "resync" event per type of the dropped events instead, which
+ * tells the client how many events it missed. Replies are never dropped.
+ *
+ */
+static void ipc_drop_events(ipc_client *client) {
+    uint32_t dropped[IPC_NUM_EVENTS] = {0};
+    ipc_message *message = TAILQ_FIRST(&(client->messages));
+    while (message != NULL) {
+        ipc_message *next = TAILQ_NEXT(message, messages);
+        if (message->written == 0 && (message->header.type & I3_IPC_EVENT_MASK)) {
+            const uint32_t index = (message->header.type & ~I3_IPC_EVENT_MASK);
+            if (message->dropped > 0) {
+                /* A resync event queued by an earlier overflow. */
+                dropped[index] += message->dropped;
+            } else {
+                dropped[index]++;
+                client->dropped++;
+            }
+            ipc_dequeue_message(client, message);
+        }
+        message = next;
+    }
+
+    for (uint32_t index = 0; index < IPC_NUM_EVENTS; index++) {
+        if (dropped[index] == 0) {
+            continue;
+        }
+        DLOG("IPC client on fd %d missed %u %s events\n", client->fd, dropped[index], event_names[index]);
+
+        ipc_gen gen = ipc_reply_gen_alloc(client);
+        y(map_open);
+        ystr("change");
+        ystr("resync");
+        ystr("dropped");
+        y(integer, dropped[index]);
+        y(map_close);
+
+        const uint8_t *payload;
+        size_t size;
+        ipc_gen_get_payload(gen, client, &payload, &size);
+
+        message = scalloc(1, sizeof(ipc_message));
+        message->payload = ipc_new_payload(size, payload);
+        message->header = (i3_ipc_header_t){
+            .magic = {'i', '3', '-', 'i', 'p', 'c'},
+            .size = message->payload->size,
+            .type = (I3_IPC_EVENT_MASK | index)};
+        message->dropped = dropped[index];
+        ipc_enqueue_message(client, message);
+
+        y(free);
+    }
+}
+
+/*
+ * Applies the overflow policy to a client whose send queue exceeds the
+ * limit.
+ *
+ */
+static void ipc_queue_overflow(ipc_client *client) {
+    if (overflow_policy == IPC_OVERFLOW_KILL) {
+        /* The client cannot be freed here because the caller still uses it,
+         * so let the timer kill it right away. */
+        if (client->num_messages == queue_limit + 1) {
+            ELOG("client %p on fd %d exceeds the limit of %u queued messages\n", client, client->fd, queue_limit);
+        }
+        ipc_set_client_timeout(client, 0.);
         return;
     }
 
-    /* Shift the buffer to the left and reduce the allocated space. */
-    client->buffer_size -= (size_t)result;
-    memmove(client->buffer, client->buffer + result, client->buffer_size);
-    client->buffer = srealloc(client->buffer, client->buffer_size);
+    ipc_drop_events(client);
 }
 
 /*
- * Given a message and a message type, create the corresponding header, merge it
- * with the message and append it to the given client's output buffer. Also,
- * send the message if the client's buffer was empty.
+ * Sends a message to the given client. If the client's send queue is empty,
+ * the message is written directly from the given buffer. Only if that is not
+ * (completely) possible, the message is queued: its payload is then copied
+ * into *shared (unless that was done already for another client) and
+ * referenced by the queued message, so that a message sent to several clients
+ * is copied at most once. The payload (and *shared) has to be in the encoding
+ * selected by the client.
+ *
+ * Events which supersede earlier events (see ipc_message) pass the change and
+ * container which identify them, otherwise supersedes is NULL.
  *
  */
-static void ipc_send_client_message(ipc_client *client, size_t size, const uint32_t message_type, const uint8_t *payload) {
+static void ipc_send_shared_message(ipc_client *client, size_t size, const uint32_t message_type,
+                                    const uint8_t *payload, ipc_payload **shared,
+                                    const char *supersedes, Con *con) {
     const i3_ipc_header_t header = {
         .magic = {'i', '3', '-', 'i', 'p', 'c'},
         .size = size,
         .type = message_type};
     const size_t header_size = sizeof(i3_ipc_header_t);
-    const size_t message_size = header_size + size;
 
-    const bool push_now = (client->buffer_size == 0);
-    client->buffer = srealloc(client->buffer, client->buffer_size + message_size);
-    memcpy(client->buffer + client->buffer_size, ((void *)&header), header_size);
-    memcpy(client->buffer + client->buffer_size + header_size, payload, size);
-    client->buffer_size += message_size;
+    size_t written = 0;
+    if (TAILQ_EMPTY(&(client->messages))) {
+        struct iovec iov[2] = {
+            {.iov_base = (void *)&header, .iov_len = header_size},
+            {.iov_base = (void *)payload, .iov_len = size}};
+        ssize_t n;
+        do {
+            n = writev(client->fd, iov, 2);
+        } while (n == -1 && errno == EINTR);
+        if (n == -1 && errno != EAGAIN) {
+            /* The client is gone, which will be noticed when reading. */
+            return;
+        }
+        if (n > 0) {
+            written = (size_t)n;
+            client->sent_bytes += written;
+        }
+        if (written == header_size + size) {
+            if (message_type & I3_IPC_EVENT_MASK) {
+                client->delivered_events++;
+            }
+            return;
+        }
+    }
+
+    if (*shared == NULL) {
+        *shared = ipc_new_payload(size, payload);
+    }
+
+    ipc_message *message = scalloc(1, sizeof(ipc_message));
+    message->header = header;
+    message->payload = *shared;
+    message->payload->refcount++;
+    message->written = written;
+    message->supersedes = supersedes;
+    if (con != NULL) {
+        message->con = con->handle;
+    }
 
+    const bool push_now = TAILQ_EMPTY(&(client->messages));
+    if (!push_now && supersedes != NULL && overflow_policy == IPC_OVERFLOW_COALESCE) {
+        ipc_coalesce(client, message);
+    }
+    ipc_enqueue_message(client, message);
     if (push_now) {
         ipc_push_pending(client);
+    } else if (ipc_queue_exceeded(client)) {
+        ipc_queue_overflow(client);
+    }
+}
+
+/*
+ * Given a message and a message type, sends the message to the given client
+ * (or appends it to the client's send queue). gen has to be allocated with
+ * ipc_reply_gen_alloc().
+ *
+ */
+static void ipc_send_client_message(ipc_client *client, const uint32_t message_type, ipc_gen gen) {
+    const uint8_t *payload;
+    size_t size;
+    ipc_gen_get_payload(gen, client, &payload, &size);
+
+    ipc_payload *shared = NULL;
+    ipc_send_shared_message(client, size, message_type, payload, &shared, NULL, NULL);
+    if (shared != NULL) {
+        ipc_payload_unref(shared);
+    }
+}
+
+/*
+ * Sends a reply which only consists of the "success" member (and the "error"
+ * member, if error is not NULL) to the given client.
+ *
+ */
+static void ipc_send_success_reply(ipc_client *client, const uint32_t message_type, bool success, const char *error) {
+    ipc_gen gen = ipc_reply_gen_alloc(client);
+    y(map_open);
+    ystr("success");
+    y(bool, success);
+    if (error != NULL) {
+        ystr("error");
+        ystr(error);
     }
+    y(map_close);
+
+    ipc_send_client_message(client, message_type, gen);
+    y(free);
 }
 
 static void free_ipc_client(ipc_client *client, int exempt_fd) {
@@ -129,38 +534,116 @@ static void free_ipc_client(ipc_client *client, int exempt_fd) {
         FREE(client->timeout);
     }
 
-    free(client->buffer);
+    ipc_message *message;
+    while ((message = TAILQ_FIRST(&(client->messages))) != NULL) {
+        ipc_dequeue_message(client, message);
+    }
 
-    for (int i = 0; i < client->num_events; i++) {
-        free(client->events[i]);
+    for (int i = 0; i < IPC_NUM_EVENTS; i++) {
+        if (client->events & (1 << i)) {
+            TAILQ_REMOVE(&subscribers[i], client, subscribers[i]);
+        }
     }
-    free(client->events);
     TAILQ_REMOVE(&all_clients, client, clients);
     free(client);
 }
 
 /*
- * Sends the specified event to all IPC clients which are currently connected
- * and subscribed to this kind of event.
+ * Sends the specified event to all subscribed IPC clients. If supersedes is
+ * not NULL, clients which are behind may receive only this event instead of
+ * earlier queued events with the same change for the same container (or for
+ * any container if con is NULL), see IPC_OVERFLOW_COALESCE.
  *
  */
-void ipc_send_event(const char *event, uint32_t message_type, const char *payload) {
+static void ipc_send_superseding_event(const char *event, uint32_t message_type, ipc_gen gen,
+                                       const char *supersedes, Con *con) {
+    const uint32_t index = (message_type & ~I3_IPC_EVENT_MASK);
+    assert(index < IPC_NUM_EVENTS);
+    assert(strcasecmp(event, event_names[index]) == 0);
+
+    event_stats[index].serialized++;
+
+    /* One shared copy per encoding. */
+    ipc_payload *shared[IPC_NUM_ENCODINGS] = {NULL};
     ipc_client *current;
-    TAILQ_FOREACH (current, &all_clients, clients) {
-        for (int i = 0; i < current->num_events; i++) {
-            if (strcasecmp(current->events[i], event) == 0) {
-                ipc_send_client_message(current, strlen(payload), message_type, (uint8_t *)payload);
-                break;
-            }
+    TAILQ_FOREACH (current, &subscribers[index], subscribers[index]) {
+        const uint8_t *payload;
+        size_t size;
+        ipc_gen_get_payload(gen, current, &payload, &size);
+        ipc_send_shared_message(current, size, message_type, payload, &shared[current->encoding],
+                                supersedes, con);
+        event_stats[index].recipients++;
+    }
+    for (int i = 0; i < IPC_NUM_ENCODINGS; i++) {
+        if (shared[i] != NULL) {
+            ipc_payload_unref(shared[i]);
+        }
+    }
+}
+
+/*
+ * Allocates a generator for the payload of an event of the given type, which
+ * writes the encodings selected by the clients subscribed to it. Free with
+ * ipc_gen_free().
+ *
+ */
+ipc_gen ipc_event_gen_alloc(uint32_t message_type) {
+    const uint32_t index = (message_type & ~I3_IPC_EVENT_MASK);
+    assert(index < IPC_NUM_EVENTS);
+
+    bool json = false;
+    bool cbor = false;
+    ipc_client *current;
+    TAILQ_FOREACH (current, &subscribers[index], subscribers[index]) {
+        if (current->encoding == IPC_ENCODING_CBOR) {
+            cbor = true;
+        } else {
+            json = true;
         }
     }
+    return ipc_gen_alloc(json, cbor);
+}
+
+/*
+ * Sends the specified event to all IPC clients which are currently connected
+ * and subscribed to this kind of event. The payload is taken from gen, which
+ * has to be allocated with ipc_event_gen_alloc().
+ *
+ */
+void ipc_send_event(const char *event, uint32_t message_type, ipc_gen gen) {
+    ipc_send_superseding_event(event, message_type, gen, NULL, NULL);
+}
+
+/*
+ * Returns true if any IPC client is subscribed to the given event type (one of
+ * the I3_IPC_EVENT_* constants).
+ *
+ */
+bool ipc_has_subscribers(uint32_t message_type) {
+    const uint32_t index = (message_type & ~I3_IPC_EVENT_MASK);
+    assert(index < IPC_NUM_EVENTS);
+    return !TAILQ_EMPTY(&subscribers[index]);
+}
+
+/*
+ * Returns true if the payload of an event of the given type has to be built,
+ * because at least one client is subscribed to it. Otherwise, the avoided
+ * serialization is counted (see GET_STATS).
+ *
+ */
+bool ipc_wants_event(uint32_t message_type) {
+    if (ipc_has_subscribers(message_type)) {
+        return true;
+    }
+    event_stats[message_type & ~I3_IPC_EVENT_MASK].skipped++;
+    return false;
 }
 
 /*
  * For shutdown events, we send the reason for the shutdown.
  */
 static void ipc_send_shutdown_event(shutdown_reason_t reason) {
-    yajl_gen gen = ygenalloc();
+    ipc_gen gen = ipc_event_gen_alloc(I3_IPC_EVENT_SHUTDOWN);
     y(map_open);
 
     ystr("change");
@@ -173,11 +656,7 @@ static void ipc_send_shutdown_event(shutdown_reason_t reason) {
 
     y(map_close);
 
-    const unsigned char *payload;
-    ylength length;
-
-    y(get_buf, &payload, &length);
-    ipc_send_event("shutdown", I3_IPC_EVENT_SHUTDOWN, (const char *)payload);
+    ipc_send_event("shutdown", I3_IPC_EVENT_SHUTDOWN, gen);
 
     y(free);
 }
@@ -211,28 +690,27 @@ IPC_HANDLER(run_command) {
      * message_size bytes out of the buffer */
     char *command = sstrndup((const char *)message, message_size);
     LOG("IPC: received: *%.4000s*\n", command);
-    yajl_gen gen = yajl_gen_alloc(NULL);
+    ipc_gen gen = ipc_reply_gen_alloc(client);
 
+    tree_bump_generation();
     CommandResult *result = parse_command(command, gen, client);
     free(command);
 
     if (result->needs_tree_render) {
-        tree_render();
+        tree_render_later();
     }
 
     command_result_free(result);
 
-    const unsigned char *reply;
-    ylength length;
-    yajl_gen_get_buf(gen, &reply, &length);
-
-    ipc_send_client_message(client, length, I3_IPC_REPLY_TYPE_COMMAND,
-                            (const uint8_t *)reply);
+    /* The reply tells the client that the command took effect, so the result
+     * has to be visible (pushed to X11) before it is sent. */
+    tree_render_if_requested();
 
-    yajl_gen_free(gen);
+    ipc_send_client_message(client, I3_IPC_REPLY_TYPE_COMMAND, gen);
+    y(free);
 }
 
-static void dump_rect(yajl_gen gen, const char *name, Rect r) {
+static void dump_rect(ipc_gen gen, const char *name, Rect r) {
     ystr(name);
     y(map_open);
     ystr("x");
@@ -246,7 +724,7 @@ static void dump_rect(yajl_gen gen, const char *name, Rect r) {
     y(map_close);
 }
 
-static void dump_gaps(yajl_gen gen, const char *name, gaps_t gaps) {
+static void dump_gaps(ipc_gen gen, const char *name, gaps_t gaps) {
     ystr(name);
     y(map_open);
     ystr("inner");
@@ -268,7 +746,7 @@ static void dump_gaps(yajl_gen gen, const char *name, gaps_t gaps) {
     y(map_close);
 }
 
-static void dump_event_state_mask(yajl_gen gen, Binding *bind) {
+static void dump_event_state_mask(ipc_gen gen, Binding *bind) {
     y(array_open);
     for (int i = 0; i < 20; i++) {
         if (bind->event_state_mask & (1 << i)) {
@@ -330,7 +808,7 @@ static void dump_event_state_mask(yajl_gen gen, Binding *bind) {
     y(array_close);
 }
 
-static void dump_binding(yajl_gen gen, Binding *bind) {
+static void dump_binding(ipc_gen gen, Binding *bind) {
     y(map_open);
     ystr("input_code");
     y(integer, bind->keycode);
@@ -359,229 +837,390 @@ static void dump_binding(yajl_gen gen, Binding *bind) {
     y(map_close);
 }
 
-void dump_node(yajl_gen gen, struct Con *con, bool inplace_restart) {
+/* The fields of a container in the GET_TREE reply, which can be selected
+ * individually using the "fields" key of the request. */
+enum dump_field {
+    DUMP_ID = 0,
+    DUMP_TYPE,
+    DUMP_ORIENTATION,
+    DUMP_SCRATCHPAD_STATE,
+    DUMP_PERCENT,
+    DUMP_URGENT,
+    DUMP_MARKS,
+    DUMP_FOCUSED,
+    DUMP_OUTPUT,
+    DUMP_LAYOUT,
+    DUMP_WORKSPACE_LAYOUT,
+    DUMP_LAST_SPLIT_LAYOUT,
+    DUMP_BORDER,
+    DUMP_CURRENT_BORDER_WIDTH,
+    DUMP_RECT,
+    DUMP_DECO_RECT,
+    DUMP_WINDOW_RECT,
+    DUMP_GEOMETRY,
+    DUMP_NAME,
+    DUMP_TITLE_FORMAT,
+    DUMP_WINDOW_ICON_PADDING,
+    DUMP_NUM,
+    DUMP_GAPS,
+    DUMP_WINDOW,
+    DUMP_WINDOW_TYPE,
+    DUMP_WINDOW_PROPERTIES,
+    DUMP_FOCUS,
+    DUMP_FULLSCREEN_MODE,
+    DUMP_STICKY,
+    DUMP_FLOATING,
+    DUMP_SWALLOWS,
+    DUMP_NUM_FIELDS,
+};
+
+static const char *dump_field_names[DUMP_NUM_FIELDS] = {
+    "id",
+    "type",
+    "orientation",
+    "scratchpad_state",
+    "percent",
+    "urgent",
+    "marks",
+    "focused",
+    "output",
+    "layout",
+    "workspace_layout",
+    "last_split_layout",
+    "border",
+    "current_border_width",
+    "rect",
+    "deco_rect",
+    "window_rect",
+    "geometry",
+    "name",
+    "title_format",
+    "window_icon_padding",
+    "num",
+    "gaps",
+    "window",
+    "window_type",
+    "window_properties",
+    "focus",
+    "fullscreen_mode",
+    "sticky",
+    "floating",
+    "swallows",
+};
+
+#define DUMP_ALL_FIELDS ((UINT64_C(1) << DUMP_NUM_FIELDS) - 1)
+
+#define WANT(field) (options->fields & (UINT64_C(1) << DUMP_##field))
+
+/* Values of the 'included' hash table: the container matched the criteria
+ * (its whole subtree is dumped) or is an ancestor of a matching container
+ * (only its included children are dumped). */
+#define INCLUDE_SUBTREE ((void *)2)
+#define INCLUDE_PATH ((void *)1)
+
+struct dump_options {
+    bool inplace_restart;
+    /* Dump only the IDs of the children instead of the children. */
+    bool shallow;
+    /* Bitmask of the dump_field values to include. */
+    uint64_t fields;
+    /* If not NULL, only the containers in this hash table are dumped. */
+    struct hashmap *included;
+};
+
+static void dump_node_internal(ipc_gen gen, struct Con *con, const struct dump_options *options);
+
+static void dump_child(ipc_gen gen, Con *child, const struct dump_options *options) {
+    if (options->shallow) {
+        y(integer, (uintptr_t)child);
+        return;
+    }
+    if (options->included == NULL) {
+        dump_node_internal(gen, child, options);
+        return;
+    }
+
+    void *included = hashmap_get(options->included, child);
+    if (included == INCLUDE_SUBTREE) {
+        struct dump_options subtree = *options;
+        subtree.included = NULL;
+        dump_node_internal(gen, child, &subtree);
+    } else if (included == INCLUDE_PATH) {
+        dump_node_internal(gen, child, options);
+    }
+}
+
+static void dump_node_internal(ipc_gen gen, struct Con *con, const struct dump_options *options) {
+    const bool inplace_restart = options->inplace_restart;
+
     y(map_open);
-    ystr("id");
-    y(integer, (uintptr_t)con);
+    if (WANT(ID)) {
+        ystr("id");
+        y(integer, (uintptr_t)con);
+    }
 
-    ystr("type");
-    switch (con->type) {
-        case CT_ROOT:
-            ystr("root");
-            break;
-        case CT_OUTPUT:
-            ystr("output");
-            break;
-        case CT_CON:
-            ystr("con");
-            break;
-        case CT_FLOATING_CON:
-            ystr("floating_con");
-            break;
-        case CT_WORKSPACE:
-            ystr("workspace");
-            break;
-        case CT_DOCKAREA:
-            ystr("dockarea");
-            break;
+    if (WANT(TYPE)) {
+        ystr("type");
+        switch (con->type) {
+            case CT_ROOT:
+                ystr("root");
+                break;
+            case CT_OUTPUT:
+                ystr("output");
+                break;
+            case CT_CON:
+                ystr("con");
+                break;
+            case CT_FLOATING_CON:
+                ystr("floating_con");
+                break;
+            case CT_WORKSPACE:
+                ystr("workspace");
+                break;
+            case CT_DOCKAREA:
+                ystr("dockarea");
+                break;
+        }
     }
 
     /* provided for backwards compatibility only. */
-    ystr("orientation");
-    if (!con_is_split(con)) {
-        ystr("none");
-    } else {
-        if (con_orientation(con) == HORIZ) {
-            ystr("horizontal");
+    if (WANT(ORIENTATION)) {
+        ystr("orientation");
+        if (!con_is_split(con)) {
+            ystr("none");
         } else {
-            ystr("vertical");
+            if (con_orientation(con) == HORIZ) {
+                ystr("horizontal");
+            } else {
+                ystr("vertical");
+            }
         }
     }
 
-    ystr("scratchpad_state");
-    switch (con->scratchpad_state) {
-        case SCRATCHPAD_NONE:
-            ystr("none");
-            break;
-        case SCRATCHPAD_FRESH:
-            ystr("fresh");
-            break;
-        case SCRATCHPAD_CHANGED:
-            ystr("changed");
-            break;
+    if (WANT(SCRATCHPAD_STATE)) {
+        ystr("scratchpad_state");
+        switch (con->scratchpad_state) {
+            case SCRATCHPAD_NONE:
+                ystr("none");
+                break;
+            case SCRATCHPAD_FRESH:
+                ystr("fresh");
+                break;
+            case SCRATCHPAD_CHANGED:
+                ystr("changed");
+                break;
+        }
     }
 
-    ystr("percent");
-    if (con->percent == 0.0) {
-        y(null);
-    } else {
-        y(double, con->percent);
+    if (WANT(PERCENT)) {
+        ystr("percent");
+        if (con->percent == 0.0) {
+            y(null);
+        } else {
+            y(double, con->percent);
+        }
     }
 
-    ystr("urgent");
-    y(bool, con->urgent);
+    if (WANT(URGENT)) {
+        ystr("urgent");
+        y(bool, con->urgent);
+    }
 
-    ystr("marks");
-    y(array_open);
-    mark_t *mark;
-    TAILQ_FOREACH (mark, &(con->marks_head), marks) {
-        ystr(mark->name);
+    if (WANT(MARKS)) {
+        ystr("marks");
+        y(array_open);
+        mark_t *mark;
+        TAILQ_FOREACH (mark, &(con->marks_head), marks) {
+            ystr(mark->name);
+        }
+        y(array_close);
     }
-    y(array_close);
 
-    ystr("focused");
-    y(bool, (con == focused));
+    if (WANT(FOCUSED)) {
+        ystr("focused");
+        y(bool, (con == focused));
+    }
 
-    if (con->type != CT_ROOT && con->type != CT_OUTPUT) {
+    if (WANT(OUTPUT) && con->type != CT_ROOT && con->type != CT_OUTPUT) {
         ystr("output");
         ystr(con_get_output(con)->name);
     }
 
-    ystr("layout");
-    switch (con->layout) {
-        case L_DEFAULT:
-            DLOG("About to dump layout=default, this is a bug in the code.\n");
-            assert(false);
-            break;
-        case L_SPLITV:
-            ystr("splitv");
-            break;
-        case L_SPLITH:
-            ystr("splith");
-            break;
-        case L_STACKED:
-            ystr("stacked");
-            break;
-        case L_TABBED:
-            ystr("tabbed");
-            break;
-        case L_DOCKAREA:
-            ystr("dockarea");
-            break;
-        case L_OUTPUT:
-            ystr("output");
-            break;
+    if (WANT(LAYOUT)) {
+        ystr("layout");
+        switch (con->layout) {
+            case L_DEFAULT:
+                DLOG("About to dump layout=default, this is a bug in the code.\n");
+                assert(false);
+                break;
+            case L_SPLITV:
+                ystr("splitv");
+                break;
+            case L_SPLITH:
+                ystr("splith");
+                break;
+            case L_STACKED:
+                ystr("stacked");
+                break;
+            case L_TABBED:
+                ystr("tabbed");
+                break;
+            case L_DOCKAREA:
+                ystr("dockarea");
+                break;
+            case L_OUTPUT:
+                ystr("output");
+                break;
+        }
     }
 
-    ystr("workspace_layout");
-    switch (con->workspace_layout) {
-        case L_DEFAULT:
-            ystr("default");
-            break;
-        case L_STACKED:
-            ystr("stacked");
-            break;
-        case L_TABBED:
-            ystr("tabbed");
-            break;
-        default:
-            DLOG("About to dump workspace_layout=%d (none of default/stacked/tabbed), this is a bug.\n", con->workspace_layout);
-            assert(false);
-            break;
+    if (WANT(WORKSPACE_LAYOUT)) {
+        ystr("workspace_layout");
+        switch (con->workspace_layout) {
+            case L_DEFAULT:
+                ystr("default");
+                break;
+            case L_STACKED:
+                ystr("stacked");
+                break;
+            case L_TABBED:
+                ystr("tabbed");
+                break;
+            default:
+                DLOG("About to dump workspace_layout=%d (none of default/stacked/tabbed), this is a bug.\n", con->workspace_layout);
+                assert(false);
+                break;
+        }
     }
 
-    ystr("last_split_layout");
-    switch (con->layout) {
-        case L_SPLITV:
-            ystr("splitv");
-            break;
-        default:
-            ystr("splith");
-            break;
+    if (WANT(LAST_SPLIT_LAYOUT)) {
+        ystr("last_split_layout");
+        switch (con->layout) {
+            case L_SPLITV:
+                ystr("splitv");
+                break;
+            default:
+                ystr("splith");
+                break;
+        }
     }
 
-    ystr("border");
-    switch (con->border_style) {
-        case BS_NORMAL:
-            ystr("normal");
-            break;
-        case BS_NONE:
-            ystr("none");
-            break;
-        case BS_PIXEL:
-            ystr("pixel");
-            break;
+    if (WANT(BORDER)) {
+        ystr("border");
+        switch (con->border_style) {
+            case BS_NORMAL:
+                ystr("normal");
+                break;
+            case BS_NONE:
+                ystr("none");
+                break;
+            case BS_PIXEL:
+                ystr("pixel");
+                break;
+        }
     }
 
-    ystr("current_border_width");
-    y(integer, con->current_border_width);
+    if (WANT(CURRENT_BORDER_WIDTH)) {
+        ystr("current_border_width");
+        y(integer, con->current_border_width);
+    }
 
-    dump_rect(gen, "rect", con->rect);
-    if (con_draw_decoration_into_frame(con)) {
-        Rect simulated_deco_rect = con->deco_rect;
-        simulated_deco_rect.x = con->rect.x - con->parent->rect.x;
-        simulated_deco_rect.y = con->rect.y - con->parent->rect.y;
-        dump_rect(gen, "deco_rect", simulated_deco_rect);
-        dump_rect(gen, "actual_deco_rect", con->deco_rect);
-    } else {
-        dump_rect(gen, "deco_rect", con->deco_rect);
+    if (WANT(RECT)) {
+        dump_rect(gen, "rect", con->rect);
+    }
+    if (WANT(DECO_RECT)) {
+        if (con_draw_decoration_into_frame(con)) {
+            Rect simulated_deco_rect = con->deco_rect;
+            simulated_deco_rect.x = con->rect.x - con->parent->rect.x;
+            simulated_deco_rect.y = con->rect.y - con->parent->rect.y;
+            dump_rect(gen, "deco_rect", simulated_deco_rect);
+            dump_rect(gen, "actual_deco_rect", con->deco_rect);
+        } else {
+            dump_rect(gen, "deco_rect", con->deco_rect);
+        }
+    }
+    if (WANT(WINDOW_RECT)) {
+        dump_rect(gen, "window_rect", con->window_rect);
+    }
+    if (WANT(GEOMETRY)) {
+        dump_rect(gen, "geometry", con->geometry);
     }
-    dump_rect(gen, "window_rect", con->window_rect);
-    dump_rect(gen, "geometry", con->geometry);
 
-    ystr("name");
-    if (con->window && con->window->name) {
-        ystr(i3string_as_utf8(con->window->name));
-    } else if (con->name != NULL) {
-        ystr(con->name);
-    } else {
-        y(null);
+    if (WANT(NAME)) {
+        ystr("name");
+        if (con->window && con->window->name) {
+            ystr(i3string_as_utf8(con->window->name));
+        } else if (con->name != NULL) {
+            ystr(con->name);
+        } else {
+            y(null);
+        }
     }
 
-    if (con->title_format != NULL) {
+    if (WANT(TITLE_FORMAT) && con->title_format != NULL) {
         ystr("title_format");
         ystr(con->title_format);
     }
 
-    ystr("window_icon_padding");
-    y(integer, con->window_icon_padding);
+    if (WANT(WINDOW_ICON_PADDING)) {
+        ystr("window_icon_padding");
+        y(integer, con->window_icon_padding);
+    }
 
     if (con->type == CT_WORKSPACE) {
-        ystr("num");
-        y(integer, con->num);
+        if (WANT(NUM)) {
+            ystr("num");
+            y(integer, con->num);
+        }
 
-        dump_gaps(gen, "gaps", con->gaps);
+        if (WANT(GAPS)) {
+            dump_gaps(gen, "gaps", con->gaps);
+        }
     }
 
-    ystr("window");
-    if (con->window) {
-        y(integer, con->window->id);
-    } else {
-        y(null);
+    if (WANT(WINDOW)) {
+        ystr("window");
+        if (con->window) {
+            y(integer, con->window->id);
+        } else {
+            y(null);
+        }
     }
 
-    ystr("window_type");
-    if (con->window) {
-        if (con->window->window_type == A__NET_WM_WINDOW_TYPE_NORMAL) {
-            ystr("normal");
-        } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_DOCK) {
-            ystr("dock");
-        } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_DIALOG) {
-            ystr("dialog");
-        } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_UTILITY) {
-            ystr("utility");
-        } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_TOOLBAR) {
-            ystr("toolbar");
-        } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_SPLASH) {
-            ystr("splash");
-        } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_MENU) {
-            ystr("menu");
-        } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_DROPDOWN_MENU) {
-            ystr("dropdown_menu");
-        } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_POPUP_MENU) {
-            ystr("popup_menu");
-        } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_TOOLTIP) {
-            ystr("tooltip");
-        } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_NOTIFICATION) {
-            ystr("notification");
+    if (WANT(WINDOW_TYPE)) {
+        ystr("window_type");
+        if (con->window) {
+            if (con->window->window_type == A__NET_WM_WINDOW_TYPE_NORMAL) {
+                ystr("normal");
+            } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_DOCK) {
+                ystr("dock");
+            } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_DIALOG) {
+                ystr("dialog");
+            } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_UTILITY) {
+                ystr("utility");
+            } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_TOOLBAR) {
+                ystr("toolbar");
+            } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_SPLASH) {
+                ystr("splash");
+            } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_MENU) {
+                ystr("menu");
+            } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_DROPDOWN_MENU) {
+                ystr("dropdown_menu");
+            } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_POPUP_MENU) {
+                ystr("popup_menu");
+            } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_TOOLTIP) {
+                ystr("tooltip");
+            } else if (con->window->window_type == A__NET_WM_WINDOW_TYPE_NOTIFICATION) {
+                ystr("notification");
+            } else {
+                ystr("unknown");
+            }
         } else {
-            ystr("unknown");
+            y(null);
         }
-    } else {
-        y(null);
     }
 
-    if (con->window && !inplace_restart) {
+    if (WANT(WINDOW_PROPERTIES) && con->window && !inplace_restart) {
         /* Window properties are useless to preserve when restarting because
          * they will be queried again anyway. However, for i3-save-tree(1),
          * they are very useful and save i3-save-tree dealing with X11. */
@@ -621,7 +1260,7 @@ void dump_node(yajl_gen gen, struct Con *con, bool inplace_restart) {
     Con *node;
     if (con->type != CT_DOCKAREA || !inplace_restart) {
         TAILQ_FOREACH (node, &(con->nodes_head), nodes) {
-            dump_node(gen, node, inplace_restart);
+            dump_child(gen, node, options);
         }
     }
     y(array_close);
@@ -629,55 +1268,64 @@ void dump_node(yajl_gen gen, struct Con *con, bool inplace_restart) {
     ystr("floating_nodes");
     y(array_open);
     TAILQ_FOREACH (node, &(con->floating_head), floating_windows) {
-        dump_node(gen, node, inplace_restart);
+        dump_child(gen, node, options);
     }
     y(array_close);
 
-    ystr("focus");
-    y(array_open);
-    TAILQ_FOREACH (node, &(con->focus_head), focused) {
-        y(integer, (uintptr_t)node);
+    if (WANT(FOCUS)) {
+        ystr("focus");
+        y(array_open);
+        TAILQ_FOREACH (node, &(con->focus_head), focused) {
+            y(integer, (uintptr_t)node);
+        }
+        y(array_close);
     }
-    y(array_close);
-
-    ystr("fullscreen_mode");
-    y(integer, con->fullscreen_mode);
 
-    ystr("sticky");
-    y(bool, con->sticky);
+    if (WANT(FULLSCREEN_MODE)) {
+        ystr("fullscreen_mode");
+        y(integer, con->fullscreen_mode);
+    }
 
-    ystr("floating");
-    switch (con->floating) {
-        case FLOATING_AUTO_OFF:
-            ystr("auto_off");
-            break;
-        case FLOATING_AUTO_ON:
-            ystr("auto_on");
-            break;
-        case FLOATING_USER_OFF:
-            ystr("user_off");
-            break;
-        case FLOATING_USER_ON:
-            ystr("user_on");
-            break;
+    if (WANT(STICKY)) {
+        ystr("sticky");
+        y(bool, con->sticky);
     }
 
-    ystr("swallows");
-    y(array_open);
-    Match *match;
-    TAILQ_FOREACH (match, &(con->swallow_head), matches) {
-        /* We will generate a new restart_mode match specification after this
-         * loop, so skip this one. */
-        if (match->restart_mode) {
-            continue;
-        }
-        y(map_open);
-        if (match->dock != M_DONTCHECK) {
-            ystr("dock");
-            y(integer, match->dock);
-            ystr("insert_where");
-            y(integer, match->insert_where);
+    if (WANT(FLOATING)) {
+        ystr("floating");
+        switch (con->floating) {
+            case FLOATING_AUTO_OFF:
+                ystr("auto_off");
+                break;
+            case FLOATING_AUTO_ON:
+                ystr("auto_on");
+                break;
+            case FLOATING_USER_OFF:
+                ystr("user_off");
+                break;
+            case FLOATING_USER_ON:
+                ystr("user_on");
+                break;
         }
+    }
+
+    if (WANT(SWALLOWS)) {
+        ystr("swallows");
+        y(array_open);
+        Match *match;
+        TAILQ_FOREACH (match, &(con->swallow_head), matches) {
+            /* We will generate a new restart_mode match specification after this
+             * loop, so skip this one. */
+            if (match->restart_mode) {
+                continue;
+            }
+            y(map_open);
+            if (match->dock != M_DONTCHECK) {
+                ystr("dock");
+                y(integer, match->dock);
+                ystr("insert_where");
+                y(integer, match->insert_where);
+            }
 
 #define DUMP_REGEX(re_name)                \
     do {                                   \
@@ -687,27 +1335,28 @@ void dump_node(yajl_gen gen, struct Con *con, bool inplace_restart) {
         }                                  \
     } while (0)
 
-        DUMP_REGEX(class);
-        DUMP_REGEX(instance);
-        DUMP_REGEX(window_role);
-        DUMP_REGEX(title);
-        DUMP_REGEX(machine);
+            DUMP_REGEX(class);
+            DUMP_REGEX(instance);
+            DUMP_REGEX(window_role);
+            DUMP_REGEX(title);
+            DUMP_REGEX(machine);
 
 #undef DUMP_REGEX
-        y(map_close);
-    }
-
-    if (inplace_restart) {
-        if (con->window != NULL) {
-            y(map_open);
-            ystr("id");
-            y(integer, con->window->id);
-            ystr("restart_mode");
-            y(bool, true);
             y(map_close);
         }
+
+        if (inplace_restart) {
+            if (con->window != NULL) {
+                y(map_open);
+                ystr("id");
+                y(integer, con->window->id);
+                ystr("restart_mode");
+                y(bool, true);
+                y(map_close);
+            }
+        }
+        y(array_close);
     }
-    y(array_close);
 
     if (inplace_restart && con->window != NULL) {
         ystr("depth");
@@ -722,7 +1371,28 @@ void dump_node(yajl_gen gen, struct Con *con, bool inplace_restart) {
     y(map_close);
 }
 
-static void dump_bar_bindings(yajl_gen gen, Barconfig *config) {
+void dump_node(ipc_gen gen, struct Con *con, bool inplace_restart) {
+    const struct dump_options options = {
+        .inplace_restart = inplace_restart,
+        .fields = DUMP_ALL_FIELDS,
+    };
+    dump_node_internal(gen, con, &options);
+}
+
+/*
+ * Like dump_node(), but "nodes" and "floating_nodes" only contain the IDs of
+ * the child containers.
+ *
+ */
+void dump_node_shallow(ipc_gen gen, Con *con) {
+    const struct dump_options options = {
+        .shallow = true,
+        .fields = DUMP_ALL_FIELDS,
+    };
+    dump_node_internal(gen, con, &options);
+}
+
+static void dump_bar_bindings(ipc_gen gen, Barconfig *config) {
     if (TAILQ_EMPTY(&(config->bar_bindings))) {
         return;
     }
@@ -756,7 +1426,7 @@ static char *canonicalize_output_name(char *name) {
     return output ? output_primary_name(output) : name;
 }
 
-static void dump_bar_config(yajl_gen gen, Barconfig *config) {
+static void dump_bar_config(ipc_gen gen, Barconfig *config) {
     y(map_open);
 
     ystr("id");
@@ -871,55 +1541,272 @@ static void dump_bar_config(yajl_gen gen, Barconfig *config) {
     ystr("verbose");
     y(bool, config->verbose);
 
-#undef YSTR_IF_SET
-#define YSTR_IF_SET(name)              \
-    do {                               \
-        if (config->colors.name) {     \
-            ystr(#name);               \
-            ystr(config->colors.name); \
-        }                              \
-    } while (0)
+#undef YSTR_IF_SET
+#define YSTR_IF_SET(name)              \
+    do {                               \
+        if (config->colors.name) {     \
+            ystr(#name);               \
+            ystr(config->colors.name); \
+        }                              \
+    } while (0)
+
+    ystr("colors");
+    y(map_open);
+    YSTR_IF_SET(background);
+    YSTR_IF_SET(statusline);
+    YSTR_IF_SET(separator);
+    YSTR_IF_SET(focused_background);
+    YSTR_IF_SET(focused_statusline);
+    YSTR_IF_SET(focused_separator);
+    YSTR_IF_SET(focused_workspace_border);
+    YSTR_IF_SET(focused_workspace_bg);
+    YSTR_IF_SET(focused_workspace_text);
+    YSTR_IF_SET(active_workspace_border);
+    YSTR_IF_SET(active_workspace_bg);
+    YSTR_IF_SET(active_workspace_text);
+    YSTR_IF_SET(inactive_workspace_border);
+    YSTR_IF_SET(inactive_workspace_bg);
+    YSTR_IF_SET(inactive_workspace_text);
+    YSTR_IF_SET(urgent_workspace_border);
+    YSTR_IF_SET(urgent_workspace_bg);
+    YSTR_IF_SET(urgent_workspace_text);
+    YSTR_IF_SET(binding_mode_border);
+    YSTR_IF_SET(binding_mode_bg);
+    YSTR_IF_SET(binding_mode_text);
+    y(map_close);
+
+    y(map_close);
+#undef YSTR_IF_SET
+}
+
+/* A serialized reply which only depends on the tree, valid as long as
+ * tree_generation does not change. Each encoding is cached separately, since
+ * it is generated for the first client which selected it. */
+struct reply_cache {
+    uint64_t generation[IPC_NUM_ENCODINGS];
+    ipc_payload *payload[IPC_NUM_ENCODINGS];
+};
+
+static struct reply_cache tree_cache;
+static struct reply_cache workspaces_cache;
+static struct reply_cache outputs_cache;
+static struct reply_cache marks_cache;
+
+/* Statistics about the cached replies, see GET_STATS. */
+static struct {
+    uint64_t hits;
+    uint64_t misses;
+} reply_cache_stats;
+
+/*
+ * Sends the cached reply to the client if the tree did not change since it
+ * was generated. The payload is shared with the cache, so it is not copied.
+ * Returns false if there is no valid cached reply; the caller then generates
+ * the reply and sends it using ipc_send_and_cache_reply().
+ *
+ */
+static bool ipc_send_cached_reply(ipc_client *client, struct reply_cache *cache, const uint32_t message_type) {
+    const ipc_encoding_t encoding = client->encoding;
+    if (cache->payload[encoding] == NULL || cache->generation[encoding] != tree_generation) {
+        reply_cache_stats.misses++;
+        return false;
+    }
+    reply_cache_stats.hits++;
+
+    ipc_payload *shared = cache->payload[encoding];
+    ipc_send_shared_message(client, shared->size, message_type, shared->data, &shared, NULL, NULL);
+    return true;
+}
+
+/*
+ * Replaces the cached reply in the encoding of the client with the reply
+ * written to gen (see ipc_reply_gen_alloc()) and sends it to the client.
+ *
+ */
+static void ipc_send_and_cache_reply(ipc_client *client, struct reply_cache *cache, const uint32_t message_type,
+                                     ipc_gen gen) {
+    const uint8_t *payload;
+    size_t size;
+    ipc_gen_get_payload(gen, client, &payload, &size);
+
+    const ipc_encoding_t encoding = client->encoding;
+    if (cache->payload[encoding] != NULL) {
+        ipc_payload_unref(cache->payload[encoding]);
+    }
+    cache->payload[encoding] = ipc_new_payload(size, payload);
+    cache->generation[encoding] = tree_generation;
+
+    ipc_payload *shared = cache->payload[encoding];
+    ipc_send_shared_message(client, size, message_type, shared->data, &shared, NULL, NULL);
+}
+
+struct tree_request {
+    char *last_key;
+    bool has_fields;
+    uint64_t fields;
+    char *criteria;
+    char *error;
+};
+
+static int _tree_json_key(void *extra, const unsigned char *val, size_t len) {
+    struct tree_request *request = extra;
+    FREE(request->last_key);
+    request->last_key = sstrndup((const char *)val, len);
+    return 1;
+}
+
+static int _tree_json_string(void *extra, const unsigned char *val, size_t len) {
+    struct tree_request *request = extra;
+    if (request->last_key == NULL) {
+        return 1;
+    }
+
+    if (strcmp(request->last_key, "criteria") == 0) {
+        FREE(request->criteria);
+        request->criteria = sstrndup((const char *)val, len);
+    } else if (strcmp(request->last_key, "fields") == 0) {
+        request->has_fields = true;
+        for (int i = 0; i < DUMP_NUM_FIELDS; i++) {
+            if (strlen(dump_field_names[i]) == len &&
+                strncmp(dump_field_names[i], (const char *)val, len) == 0) {
+                request->fields |= (UINT64_C(1) << i);
+                return 1;
+            }
+        }
+        if (request->error == NULL) {
+            sasprintf(&(request->error), "unknown field \"%.*s\"", (int)len, val);
+        }
+    }
+    return 1;
+}
+
+/*
+ * Adds every container matching the criteria and all of its ancestors to the
+ * 'included' hash table (see INCLUDE_SUBTREE and INCLUDE_PATH).
+ *
+ */
+static void include_matching_cons(Match *match, struct hashmap *included) {
+    struct hashmap cons_by_mark_match = HASHMAP_INITIALIZER(false);
+    if (match->mark != NULL) {
+        con_by_mark_regex(match->mark, &cons_by_mark_match);
+    }
+
+    Con *con;
+    TAILQ_FOREACH (con, &all_cons, all_cons) {
+        if (!match_matches_con(match, con, &cons_by_mark_match)) {
+            continue;
+        }
+        hashmap_put(included, con, INCLUDE_SUBTREE);
+        for (Con *parent = con->parent; parent != NULL; parent = parent->parent) {
+            if (hashmap_get(included, parent) != NULL) {
+                break;
+            }
+            hashmap_put(included, parent, INCLUDE_PATH);
+        }
+    }
+    hashmap_clear(&cons_by_mark_match);
+}
+
+static void ipc_send_tree_error(ipc_client *client, const char *error) {
+    ELOG("Invalid GET_TREE request: %s\n", error);
 
-    ystr("colors");
+    ipc_gen gen = ipc_reply_gen_alloc(client);
     y(map_open);
-    YSTR_IF_SET(background);
-    YSTR_IF_SET(statusline);
-    YSTR_IF_SET(separator);
-    YSTR_IF_SET(focused_background);
-    YSTR_IF_SET(focused_statusline);
-    YSTR_IF_SET(focused_separator);
-    YSTR_IF_SET(focused_workspace_border);
-    YSTR_IF_SET(focused_workspace_bg);
-    YSTR_IF_SET(focused_workspace_text);
-    YSTR_IF_SET(active_workspace_border);
-    YSTR_IF_SET(active_workspace_bg);
-    YSTR_IF_SET(active_workspace_text);
-    YSTR_IF_SET(inactive_workspace_border);
-    YSTR_IF_SET(inactive_workspace_bg);
-    YSTR_IF_SET(inactive_workspace_text);
-    YSTR_IF_SET(urgent_workspace_border);
-    YSTR_IF_SET(urgent_workspace_bg);
-    YSTR_IF_SET(urgent_workspace_text);
-    YSTR_IF_SET(binding_mode_border);
-    YSTR_IF_SET(binding_mode_bg);
-    YSTR_IF_SET(binding_mode_text);
+    ystr("success");
+    y(bool, false);
+    ystr("error");
+    ystr(error);
     y(map_close);
 
-    y(map_close);
-#undef YSTR_IF_SET
+    ipc_send_client_message(client, I3_IPC_REPLY_TYPE_TREE, gen);
+    y(free);
 }
 
+/*
+ * Formats the reply message for a GET_TREE request and sends it to the
+ * client. An empty payload requests the whole tree (this reply is cached).
+ * Otherwise, the payload is a JSON map which can restrict the dumped fields
+ * ("fields") and the dumped containers ("criteria"): only the containers
+ * matching the criteria are dumped, together with their subtrees and
+ * ancestors.
+ *
+ */
 IPC_HANDLER(tree) {
+    if (message_size == 0 && ipc_send_cached_reply(client, &tree_cache, I3_IPC_REPLY_TYPE_TREE)) {
+        return;
+    }
+
+    struct dump_options options = {
+        .fields = DUMP_ALL_FIELDS,
+    };
+    struct hashmap included = HASHMAP_INITIALIZER(false);
+
+    if (message_size > 0) {
+        static yajl_callbacks callbacks = {
+            .yajl_map_key = _tree_json_key,
+            .yajl_string = _tree_json_string,
+        };
+
+        struct tree_request request;
+        memset(&request, '\0', sizeof(struct tree_request));
+        yajl_handle p = yalloc(&callbacks, (void *)&request);
+        yajl_status stat = yajl_parse(p, (const unsigned char *)message, message_size);
+        if (stat == yajl_status_ok) {
+            stat = yajl_complete_parse(p);
+        }
+        FREE(request.last_key);
+        if (stat != yajl_status_ok) {
+            unsigned char *err = yajl_get_error(p, true, (const unsigned char *)message, message_size);
+            ELOG("YAJL parse error: %s\n", err);
+            yajl_free_error(p, err);
+            yajl_free(p);
+            FREE(request.criteria);
+            FREE(request.error);
+            ipc_send_tree_error(client, "invalid JSON");
+            return;
+        }
+        yajl_free(p);
+
+        if (request.error != NULL) {
+            ipc_send_tree_error(client, request.error);
+            FREE(request.criteria);
+            FREE(request.error);
+            return;
+        }
+
+        if (request.has_fields) {
+            options.fields = request.fields;
+        }
+
+        if (request.criteria != NULL) {
+            Match match;
+            match_init(&match);
+            char *error = parse_criteria(request.criteria, &match);
+            if (error != NULL) {
+                ipc_send_tree_error(client, error);
+                free(error);
+                match_free(&match);
+                FREE(request.criteria);
+                return;
+            }
+            include_matching_cons(&match, &included);
+            options.included = &included;
+            match_free(&match);
+            FREE(request.criteria);
+        }
+    }
+
     setlocale(LC_NUMERIC, "C");
-    yajl_gen gen = ygenalloc();
-    dump_node(gen, croot, false);
+    ipc_gen gen = ipc_reply_gen_alloc(client);
+    dump_node_internal(gen, croot, &options);
     setlocale(LC_NUMERIC, "");
+    hashmap_clear(&included);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_client_message(client, length, I3_IPC_REPLY_TYPE_TREE, payload);
+    if (message_size == 0) {
+        ipc_send_and_cache_reply(client, &tree_cache, I3_IPC_REPLY_TYPE_TREE, gen);
+    } else {
+        ipc_send_client_message(client, I3_IPC_REPLY_TYPE_TREE, gen);
+    }
     y(free);
 }
 
@@ -929,7 +1816,11 @@ IPC_HANDLER(tree) {
  *
  */
 IPC_HANDLER(get_workspaces) {
-    yajl_gen gen = ygenalloc();
+    if (ipc_send_cached_reply(client, &workspaces_cache, I3_IPC_REPLY_TYPE_WORKSPACES)) {
+        return;
+    }
+
+    ipc_gen gen = ipc_reply_gen_alloc(client);
     y(array_open);
 
     Con *focused_ws = con_get_workspace(focused);
@@ -983,11 +1874,7 @@ IPC_HANDLER(get_workspaces) {
 
     y(array_close);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_client_message(client, length, I3_IPC_REPLY_TYPE_WORKSPACES, payload);
+    ipc_send_and_cache_reply(client, &workspaces_cache, I3_IPC_REPLY_TYPE_WORKSPACES, gen);
     y(free);
 }
 
@@ -997,7 +1884,11 @@ IPC_HANDLER(get_workspaces) {
  *
  */
 IPC_HANDLER(get_outputs) {
-    yajl_gen gen = ygenalloc();
+    if (ipc_send_cached_reply(client, &outputs_cache, I3_IPC_REPLY_TYPE_OUTPUTS)) {
+        return;
+    }
+
+    ipc_gen gen = ipc_reply_gen_alloc(client);
     y(array_open);
 
     Output *output;
@@ -1038,38 +1929,51 @@ IPC_HANDLER(get_outputs) {
 
     y(array_close);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_client_message(client, length, I3_IPC_REPLY_TYPE_OUTPUTS, payload);
+    ipc_send_and_cache_reply(client, &outputs_cache, I3_IPC_REPLY_TYPE_OUTPUTS, gen);
     y(free);
 }
 
+static int mark_name_cmp(const void *a, const void *b) {
+    return strcmp(*((const char **)a), *((const char **)b));
+}
+
 /*
  * Formats the reply message for a GET_MARKS request and sends it to the
  * client
  *
  */
 IPC_HANDLER(get_marks) {
-    yajl_gen gen = ygenalloc();
+    if (ipc_send_cached_reply(client, &marks_cache, I3_IPC_REPLY_TYPE_MARKS)) {
+        return;
+    }
+
+    ipc_gen gen = ipc_reply_gen_alloc(client);
     y(array_open);
 
-    Con *con;
-    TAILQ_FOREACH (con, &all_cons, all_cons) {
-        mark_t *mark;
-        TAILQ_FOREACH (mark, &(con->marks_head), marks) {
-            ystr(mark->name);
+    /* Take the marks from the mark index instead of walking all containers.
+     * The index is in hash order, so sort the marks by name to send the same
+     * reply for the same marks. */
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    const char **marks = NULL;
+    uint32_t iter = 0;
+    const char *mark;
+    while (con_next_mark(&iter, &mark, NULL)) {
+        if (count == capacity) {
+            capacity = (capacity == 0 ? 16 : capacity * 2);
+            marks = srealloc(marks, capacity * sizeof(const char *));
         }
+        marks[count++] = mark;
+    }
+    qsort(marks, count, sizeof(const char *), mark_name_cmp);
+    for (uint32_t i = 0; i < count; i++) {
+        ystr(marks[i]);
     }
+    free(marks);
 
     y(array_close);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_client_message(client, length, I3_IPC_REPLY_TYPE_MARKS, payload);
+    ipc_send_and_cache_reply(client, &marks_cache, I3_IPC_REPLY_TYPE_MARKS, gen);
     y(free);
 }
 
@@ -1078,7 +1982,7 @@ IPC_HANDLER(get_marks) {
  *
  */
 IPC_HANDLER(get_version) {
-    yajl_gen gen = ygenalloc();
+    ipc_gen gen = ipc_reply_gen_alloc(client);
     y(map_open);
 
     ystr("major");
@@ -1109,11 +2013,7 @@ IPC_HANDLER(get_version) {
     y(array_close);
     y(map_close);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_client_message(client, length, I3_IPC_REPLY_TYPE_VERSION, payload);
+    ipc_send_client_message(client, I3_IPC_REPLY_TYPE_VERSION, gen);
     y(free);
 }
 
@@ -1123,7 +2023,7 @@ IPC_HANDLER(get_version) {
  *
  */
 IPC_HANDLER(get_bar_config) {
-    yajl_gen gen = ygenalloc();
+    ipc_gen gen = ipc_reply_gen_alloc(client);
 
     /* If no ID was passed, we return a JSON array with all IDs */
     if (message_size == 0) {
@@ -1134,11 +2034,7 @@ IPC_HANDLER(get_bar_config) {
         }
         y(array_close);
 
-        const unsigned char *payload;
-        ylength length;
-        y(get_buf, &payload, &length);
-
-        ipc_send_client_message(client, length, I3_IPC_REPLY_TYPE_BAR_CONFIG, payload);
+        ipc_send_client_message(client, I3_IPC_REPLY_TYPE_BAR_CONFIG, gen);
         y(free);
         return;
     }
@@ -1172,11 +2068,7 @@ IPC_HANDLER(get_bar_config) {
         dump_bar_config(gen, config);
     }
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_client_message(client, length, I3_IPC_REPLY_TYPE_BAR_CONFIG, payload);
+    ipc_send_client_message(client, I3_IPC_REPLY_TYPE_BAR_CONFIG, gen);
     y(free);
 }
 
@@ -1185,7 +2077,7 @@ IPC_HANDLER(get_bar_config) {
  *
  */
 IPC_HANDLER(get_binding_modes) {
-    yajl_gen gen = ygenalloc();
+    ipc_gen gen = ipc_reply_gen_alloc(client);
 
     y(array_open);
     struct Mode *mode;
@@ -1194,11 +2086,7 @@ IPC_HANDLER(get_binding_modes) {
     }
     y(array_close);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_client_message(client, length, I3_IPC_REPLY_TYPE_BINDING_MODES, payload);
+    ipc_send_client_message(client, I3_IPC_REPLY_TYPE_BINDING_MODES, gen);
     y(free);
 }
 
@@ -1211,21 +2099,21 @@ static int add_subscription(void *extra, const unsigned char *s,
     ipc_client *client = extra;
 
     DLOG("should add subscription to extra %p, sub %.*s\n", client, (int)len, s);
-    int event = client->num_events;
-
-    client->num_events++;
-    client->events = srealloc(client->events, client->num_events * sizeof(char *));
-    /* We copy the string because it is not null-terminated and strndup()
-     * is missing on some BSD systems */
-    client->events[event] = scalloc(len + 1, 1);
-    memcpy(client->events[event], s, len);
+    for (int i = 0; i < IPC_NUM_EVENTS; i++) {
+        if (strlen(event_names[i]) != len ||
+            strncasecmp(event_names[i], (const char *)s, len) != 0) {
+            continue;
+        }
 
-    DLOG("client is now subscribed to:\n");
-    for (int i = 0; i < client->num_events; i++) {
-        DLOG("event %s\n", client->events[i]);
+        if (!(client->events & (1 << i))) {
+            client->events |= (1 << i);
+            TAILQ_INSERT_TAIL(&subscribers[i], client, subscribers[i]);
+        }
+        DLOG("client is now subscribed to events 0x%x\n", client->events);
+        return 1;
     }
-    DLOG("(done)\n");
 
+    DLOG("Ignoring subscription to unknown event %.*s\n", (int)len, s);
     return 1;
 }
 
@@ -1252,40 +2140,39 @@ IPC_HANDLER(subscribe) {
         ELOG("YAJL parse error: %s\n", err);
         yajl_free_error(p, err);
 
-        const char *reply = "{\"success\":false}";
-        ipc_send_client_message(client, strlen(reply), I3_IPC_REPLY_TYPE_SUBSCRIBE, (const uint8_t *)reply);
+        ipc_send_success_reply(client, I3_IPC_REPLY_TYPE_SUBSCRIBE, false, NULL);
         yajl_free(p);
         return;
     }
     yajl_free(p);
-    const char *reply = "{\"success\":true}";
-    ipc_send_client_message(client, strlen(reply), I3_IPC_REPLY_TYPE_SUBSCRIBE, (const uint8_t *)reply);
+    ipc_send_success_reply(client, I3_IPC_REPLY_TYPE_SUBSCRIBE, true, NULL);
 
     if (client->first_tick_sent) {
         return;
     }
 
-    bool is_tick = false;
-    for (int i = 0; i < client->num_events; i++) {
-        if (strcmp(client->events[i], "tick") == 0) {
-            is_tick = true;
-            break;
-        }
-    }
-    if (!is_tick) {
+    if (!(client->events & (1 << (I3_IPC_EVENT_TICK & ~I3_IPC_EVENT_MASK)))) {
         return;
     }
 
     client->first_tick_sent = true;
-    const char *payload = "{\"first\":true,\"payload\":\"\"}";
-    ipc_send_client_message(client, strlen(payload), I3_IPC_EVENT_TICK, (const uint8_t *)payload);
+    ipc_gen gen = ipc_reply_gen_alloc(client);
+    y(map_open);
+    ystr("first");
+    y(bool, true);
+    ystr("payload");
+    ystr("");
+    y(map_close);
+
+    ipc_send_client_message(client, I3_IPC_EVENT_TICK, gen);
+    y(free);
 }
 
 /*
  * Returns the raw last loaded i3 configuration file contents.
  */
 IPC_HANDLER(get_config) {
-    yajl_gen gen = ygenalloc();
+    ipc_gen gen = ipc_reply_gen_alloc(client);
 
     y(map_open);
 
@@ -1309,11 +2196,7 @@ IPC_HANDLER(get_config) {
 
     y(map_close);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_client_message(client, length, I3_IPC_REPLY_TYPE_CONFIG, payload);
+    ipc_send_client_message(client, I3_IPC_REPLY_TYPE_CONFIG, gen);
     y(free);
 }
 
@@ -1322,7 +2205,7 @@ IPC_HANDLER(get_config) {
  * synchronization point in event-related tests.
  */
 IPC_HANDLER(send_tick) {
-    yajl_gen gen = ygenalloc();
+    ipc_gen gen = ipc_event_gen_alloc(I3_IPC_EVENT_TICK);
 
     y(map_open);
 
@@ -1330,19 +2213,14 @@ IPC_HANDLER(send_tick) {
     y(bool, false);
 
     ystr("payload");
-    yajl_gen_string(gen, (unsigned char *)message, message_size);
+    y(string, (unsigned char *)message, message_size);
 
     y(map_close);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_event("tick", I3_IPC_EVENT_TICK, (const char *)payload);
+    ipc_send_event("tick", I3_IPC_EVENT_TICK, gen);
     y(free);
 
-    const char *reply = "{\"success\":true}";
-    ipc_send_client_message(client, strlen(reply), I3_IPC_REPLY_TYPE_TICK, (const uint8_t *)reply);
+    ipc_send_success_reply(client, I3_IPC_REPLY_TYPE_TICK, true, NULL);
     DLOG("Sent tick event\n");
 }
 
@@ -1392,8 +2270,7 @@ IPC_HANDLER(sync) {
         ELOG("YAJL parse error: %s\n", err);
         yajl_free_error(p, err);
 
-        const char *reply = "{\"success\":false}";
-        ipc_send_client_message(client, strlen(reply), I3_IPC_REPLY_TYPE_SYNC, (const uint8_t *)reply);
+        ipc_send_success_reply(client, I3_IPC_REPLY_TYPE_SYNC, false, NULL);
         yajl_free(p);
         return;
     }
@@ -1401,12 +2278,11 @@ IPC_HANDLER(sync) {
 
     DLOG("received IPC sync request (rnd = %d, window = 0x%08x)\n", state.rnd, state.window);
     sync_respond(state.window, state.rnd);
-    const char *reply = "{\"success\":true}";
-    ipc_send_client_message(client, strlen(reply), I3_IPC_REPLY_TYPE_SYNC, (const uint8_t *)reply);
+    ipc_send_success_reply(client, I3_IPC_REPLY_TYPE_SYNC, true, NULL);
 }
 
 IPC_HANDLER(get_binding_state) {
-    yajl_gen gen = ygenalloc();
+    ipc_gen gen = ipc_reply_gen_alloc(client);
 
     y(map_open);
 
@@ -1415,17 +2291,228 @@ IPC_HANDLER(get_binding_state) {
 
     y(map_close);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
+    ipc_send_client_message(client, I3_IPC_REPLY_TYPE_GET_BINDING_STATE, gen);
+    y(free);
+}
+
+/*
+ * Sends the changes of the tree since the generation given in the payload
+ * (see tree_patch_dump()).
+ *
+ */
+IPC_HANDLER(get_tree_patch) {
+    char *since_str = sstrndup((const char *)message, message_size);
+    const uint64_t since = strtoull(since_str, NULL, 10);
+    free(since_str);
+
+    ipc_gen gen = ipc_reply_gen_alloc(client);
+    tree_patch_dump(gen, since);
+
+    ipc_send_client_message(client, I3_IPC_REPLY_TYPE_TREE_PATCH, gen);
+    y(free);
+}
+
+/*
+ * Selects the encoding of the replies and events sent to this client. The
+ * payload is the name of the encoding ("json" or "cbor"). The reply itself
+ * still uses the previous encoding.
+ *
+ */
+IPC_HANDLER(set_encoding) {
+    ipc_encoding_t encoding;
+    if (message_size == strlen("json") && strncasecmp((const char *)message, "json", message_size) == 0) {
+        encoding = IPC_ENCODING_JSON;
+    } else if (message_size == strlen("cbor") && strncasecmp((const char *)message, "cbor", message_size) == 0) {
+        encoding = IPC_ENCODING_CBOR;
+    } else {
+        ELOG("Unknown IPC encoding \"%.*s\"\n", (int)message_size, message);
+        ipc_send_success_reply(client, I3_IPC_REPLY_TYPE_ENCODING, false, "unknown encoding");
+        return;
+    }
+
+    ipc_send_success_reply(client, I3_IPC_REPLY_TYPE_ENCODING, true, NULL);
+
+    DLOG("client on fd %d now uses the %s encoding\n", client->fd,
+         (encoding == IPC_ENCODING_CBOR ? "cbor" : "json"));
+    client->encoding = encoding;
+}
+
+/*
+ * Dumps the given histogram as a map for the GET_STATS reply.
+ *
+ */
+static void dump_latency_histogram(ipc_gen gen, const struct latency_histogram *histogram) {
+    y(map_open);
+    ystr("count");
+    y(integer, histogram->count);
+    ystr("total_usec");
+    y(integer, histogram->total_usec);
+    ystr("max_usec");
+    y(integer, histogram->max_usec);
+    ystr("buckets");
+    y(array_open);
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        y(map_open);
+        ystr("le_usec");
+        if (i < LATENCY_BUCKETS - 1) {
+            y(integer, latency_bucket_bounds[i]);
+        } else {
+            y(null);
+        }
+        ystr("count");
+        y(integer, histogram->buckets[i]);
+        y(map_close);
+    }
+    y(array_close);
+    y(map_close);
+}
+
+IPC_HANDLER(get_stats) {
+    ipc_gen gen = ipc_reply_gen_alloc(client);
+
+    y(map_open);
+
+    ystr("render");
+    y(map_open);
+    ystr("renders");
+    y(integer, tree_render_stats.renders);
+    ystr("requested");
+    y(integer, tree_render_stats.requested);
+    ystr("deferred");
+    y(integer, tree_render_stats.deferred);
+    ystr("events");
+    y(integer, tree_render_stats.events);
+    ystr("workspaces_rendered");
+    y(integer, tree_render_stats.workspaces_rendered);
+    ystr("workspaces_replayed");
+    y(integer, tree_render_stats.workspaces_replayed);
+    ystr("durations");
+    dump_latency_histogram(gen, &(tree_render_stats.durations));
+    y(map_close);
+
+    ystr("handlers");
+    y(map_open);
+    for (size_t i = 0; i < sizeof(message_type_names) / sizeof(char *); i++) {
+        ystr(message_type_names[i]);
+        dump_latency_histogram(gen, &handler_durations[i]);
+    }
+    y(map_close);
+
+    ystr("events");
+    y(map_open);
+    for (int i = 0; i < IPC_NUM_EVENTS; i++) {
+        ystr(event_names[i]);
+        y(map_open);
+        ystr("serialized");
+        y(integer, event_stats[i].serialized);
+        ystr("skipped");
+        y(integer, event_stats[i].skipped);
+        ystr("recipients");
+        y(integer, event_stats[i].recipients);
+        y(map_close);
+    }
+    y(map_close);
+
+    ystr("reply_cache");
+    y(map_open);
+    ystr("hits");
+    y(integer, reply_cache_stats.hits);
+    ystr("misses");
+    y(integer, reply_cache_stats.misses);
+    y(map_close);
+
+    ystr("clients");
+    y(array_open);
+    ipc_client *current;
+    TAILQ_FOREACH (current, &all_clients, clients) {
+        y(map_open);
+        ystr("fd");
+        y(integer, current->fd);
+        ystr("events");
+        y(array_open);
+        for (int i = 0; i < IPC_NUM_EVENTS; i++) {
+            if (current->events & (1 << i)) {
+                ystr(event_names[i]);
+            }
+        }
+        y(array_close);
+        ystr("encoding");
+        ystr((const char *)(current->encoding == IPC_ENCODING_CBOR ? "cbor" : "json"));
+        ystr("queued_messages");
+        y(integer, current->num_messages);
+        ystr("queued_bytes");
+        y(integer, current->queued_bytes);
+        ystr("dropped");
+        y(integer, current->dropped);
+        ystr("coalesced");
+        y(integer, current->coalesced);
+        ystr("connect_time");
+        y(integer, current->connect_time);
+        ystr("received_messages");
+        y(integer, current->received_messages);
+        ystr("total_queued_bytes");
+        y(integer, current->total_queued_bytes);
+        ystr("sent_bytes");
+        y(integer, current->sent_bytes);
+        ystr("delivered_events");
+        y(integer, current->delivered_events);
+        y(map_close);
+    }
+    y(array_close);
+
+    ystr("x_push");
+    y(map_open);
+    ystr("pushes");
+    y(integer, x_push_stats.pushes);
+    ystr("last_requests");
+    y(integer, x_push_stats.last_requests);
+    ystr("requests");
+    y(integer, x_push_stats.requests);
+    y(map_close);
+
+    ystr("properties");
+    y(map_open);
+    ystr("notifies");
+    y(integer, property_stats.notifies);
+    ystr("batches");
+    y(integer, property_stats.batches);
+    ystr("requests");
+    y(integer, property_stats.requests);
+    y(map_close);
+
+    ystr("log_categories");
+    y(array_open);
+    for (int i = 0; i < LOG_NUM_CATEGORIES; i++) {
+        if (get_log_categories() & (1 << i)) {
+            ystr(log_category_name(1 << i));
+        }
+    }
+    y(array_close);
+
+    ystr("log_clients");
+    dump_log_clients(gen);
+
+    y(map_close);
+
+    ipc_send_client_message(client, I3_IPC_REPLY_TYPE_STATS, gen);
+    y(free);
+}
+
+/*
+ * Returns the recorded trace spans in the Chrome trace event format.
+ *
+ */
+IPC_HANDLER(get_trace) {
+    ipc_gen gen = ipc_reply_gen_alloc(client);
+    trace_dump(gen);
 
-    ipc_send_client_message(client, length, I3_IPC_REPLY_TYPE_GET_BINDING_STATE, payload);
+    ipc_send_client_message(client, I3_IPC_REPLY_TYPE_TRACE, gen);
     y(free);
 }
 
 /* The index of each callback function corresponds to the numeric
  * value of the message type (see include/i3/ipc.h) */
-handler_t handlers[13] = {
+handler_t handlers[17] = {
     handle_run_command,
     handle_get_workspaces,
     handle_subscribe,
@@ -1439,6 +2526,10 @@ handler_t handlers[13] = {
     handle_send_tick,
     handle_sync,
     handle_get_binding_state,
+    handle_get_stats,
+    handle_get_tree_patch,
+    handle_set_encoding,
+    handle_get_trace,
 };
 
 /*
@@ -1474,11 +2565,23 @@ static void ipc_receive_message(EV_P_ struct ev_io *w, int revents) {
         return;
     }
 
+    /* Make sure that windows which were mapped before the message was sent
+     * show up in replies and are affected by commands, and that replies
+     * reflect the rendered layout. */
+    manage_pending_windows(true);
+    tree_render_if_requested();
+
+    client->received_messages++;
+    tree_render_stats.events++;
     if (message_type >= (sizeof(handlers) / sizeof(handler_t))) {
         DLOG("Unhandled message type: %d\n", message_type);
     } else {
+        const uint64_t start = monotonic_usec();
+        const uint64_t trace_start = TRACE_BEGIN();
         handler_t h = handlers[message_type];
         h(client, message, 0, message_length, message_type);
+        TRACE_END(trace_start, "ipc", message_type_names[message_type]);
+        latency_histogram_add(&handler_durations[message_type], monotonic_usec() - start);
     }
 
     FREE(message);
@@ -1534,9 +2637,8 @@ static void ipc_socket_writeable_cb(EV_P_ ev_io *w, int revents) {
     DLOG("fd %d writeable\n", w->fd);
     ipc_client *client = (ipc_client *)w->data;
 
-    /* If this callback is called then there should be a corresponding active
-     * timer. */
-    assert(client->timeout != NULL);
+    /* This callback is only active while messages are queued. */
+    assert(!TAILQ_EMPTY(&(client->messages)));
     ipc_push_pending(client);
 }
 
@@ -1577,6 +2679,8 @@ ipc_client *ipc_new_client_on_fd(EV_P_ int fd) {
 
     ipc_client *client = scalloc(1, sizeof(ipc_client));
     client->fd = fd;
+    client->connect_time = time(NULL);
+    TAILQ_INIT(&(client->messages));
 
     client->read_callback = scalloc(1, sizeof(struct ev_io));
     client->read_callback->data = client;
@@ -1593,12 +2697,12 @@ ipc_client *ipc_new_client_on_fd(EV_P_ int fd) {
 }
 
 /*
- * Generates a json workspace event. Returns a dynamically allocated yajl
- * generator. Free with yajl_gen_free().
+ * Generates a workspace event (see ipc_event_gen_alloc()). Returns a
+ * dynamically allocated generator. Free with ipc_gen_free().
  */
-yajl_gen ipc_marshal_workspace_event(const char *change, Con *current, Con *old) {
+ipc_gen ipc_marshal_workspace_event(const char *change, Con *current, Con *old) {
     setlocale(LC_NUMERIC, "C");
-    yajl_gen gen = ygenalloc();
+    ipc_gen gen = ipc_event_gen_alloc(I3_IPC_EVENT_WORKSPACE);
 
     y(map_open);
 
@@ -1632,13 +2736,15 @@ yajl_gen ipc_marshal_workspace_event(const char *change, Con *current, Con *old)
  * previously focused workspace in "old".
  */
 void ipc_send_workspace_event(const char *change, Con *current, Con *old) {
-    yajl_gen gen = ipc_marshal_workspace_event(change, current, old);
+    if (!ipc_wants_event(I3_IPC_EVENT_WORKSPACE)) {
+        return;
+    }
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
+    ipc_gen gen = ipc_marshal_workspace_event(change, current, old);
 
-    ipc_send_event("workspace", I3_IPC_EVENT_WORKSPACE, (const char *)payload);
+    /* Only the last focus change matters to clients which are behind. */
+    ipc_send_superseding_event("workspace", I3_IPC_EVENT_WORKSPACE, gen,
+                               (strcmp(change, "focus") == 0 ? "focus" : NULL), NULL);
 
     y(free);
 }
@@ -1651,8 +2757,12 @@ void ipc_send_window_event(const char *property, Con *con) {
     DLOG("Issue IPC window %s event (con = %p, window = 0x%08x)\n",
          property, con, (con->window ? con->window->id : XCB_WINDOW_NONE));
 
+    if (!ipc_wants_event(I3_IPC_EVENT_WINDOW)) {
+        return;
+    }
+
     setlocale(LC_NUMERIC, "C");
-    yajl_gen gen = ygenalloc();
+    ipc_gen gen = ipc_event_gen_alloc(I3_IPC_EVENT_WINDOW);
 
     y(map_open);
 
@@ -1664,30 +2774,93 @@ void ipc_send_window_event(const char *property, Con *con) {
 
     y(map_close);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_event("window", I3_IPC_EVENT_WINDOW, (const char *)payload);
+    /* Only the last title of a window and the last focus change matter to
+     * clients which are behind. */
+    if (strcmp(property, "title") == 0) {
+        ipc_send_superseding_event("window", I3_IPC_EVENT_WINDOW, gen, "title", con);
+    } else if (strcmp(property, "focus") == 0) {
+        ipc_send_superseding_event("window", I3_IPC_EVENT_WINDOW, gen, "focus", NULL);
+    } else {
+        ipc_send_event("window", I3_IPC_EVENT_WINDOW, gen);
+    }
     y(free);
     setlocale(LC_NUMERIC, "");
 }
 
+/*
+ * Sends a tree_patch event to every subscriber with the changes of the tree
+ * since the last tree_patch event sent to that subscriber, if there are any.
+ * The first event for a new subscriber is a full patch. Called before i3 waits
+ * for new events, so that a burst of changes results in a single event.
+ *
+ */
+void ipc_send_tree_patch_event(void) {
+    const uint32_t index = (I3_IPC_EVENT_TREE_PATCH & ~I3_IPC_EVENT_MASK);
+
+    /* Usually, all subscribers are at the same generation. Otherwise, one
+     * patch is built for each generation. */
+    while (true) {
+        ipc_client *current;
+        uint64_t since = 0;
+        bool outdated = false;
+        TAILQ_FOREACH (current, &subscribers[index], subscribers[index]) {
+            if (current->tree_patch_generation != tree_generation) {
+                since = current->tree_patch_generation;
+                outdated = true;
+                break;
+            }
+        }
+        if (!outdated) {
+            return;
+        }
+
+        ipc_gen gen = ipc_event_gen_alloc(I3_IPC_EVENT_TREE_PATCH);
+        const bool changed = tree_patch_dump(gen, since);
+        if (changed) {
+            event_stats[index].serialized++;
+        }
+
+        /* One shared copy per encoding. */
+        ipc_payload *shared[IPC_NUM_ENCODINGS] = {NULL};
+        TAILQ_FOREACH (current, &subscribers[index], subscribers[index]) {
+            if (current->tree_patch_generation != since) {
+                continue;
+            }
+            current->tree_patch_generation = tree_generation;
+            if (!changed) {
+                continue;
+            }
+            const uint8_t *payload;
+            size_t size;
+            ipc_gen_get_payload(gen, current, &payload, &size);
+            ipc_send_shared_message(current, size, I3_IPC_EVENT_TREE_PATCH, payload,
+                                    &shared[current->encoding], NULL, NULL);
+            event_stats[index].recipients++;
+        }
+        for (int i = 0; i < IPC_NUM_ENCODINGS; i++) {
+            if (shared[i] != NULL) {
+                ipc_payload_unref(shared[i]);
+            }
+        }
+        y(free);
+    }
+}
+
 /*
  * For the barconfig update events, we send the serialized barconfig.
  */
 void ipc_send_barconfig_update_event(Barconfig *barconfig) {
     DLOG("Issue barconfig_update event for id = %s\n", barconfig->id);
+    if (!ipc_wants_event(I3_IPC_EVENT_BARCONFIG_UPDATE)) {
+        return;
+    }
+
     setlocale(LC_NUMERIC, "C");
-    yajl_gen gen = ygenalloc();
+    ipc_gen gen = ipc_event_gen_alloc(I3_IPC_EVENT_BARCONFIG_UPDATE);
 
     dump_bar_config(gen, barconfig);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_event("barconfig_update", I3_IPC_EVENT_BARCONFIG_UPDATE, (const char *)payload);
+    ipc_send_event("barconfig_update", I3_IPC_EVENT_BARCONFIG_UPDATE, gen);
     y(free);
     setlocale(LC_NUMERIC, "");
 }
@@ -1697,10 +2870,13 @@ void ipc_send_barconfig_update_event(Barconfig *barconfig) {
  */
 void ipc_send_binding_event(const char *event_type, Binding *bind, const char *modename) {
     DLOG("Issue IPC binding %s event (sym = %s, code = %d)\n", event_type, bind->symbol, bind->keycode);
+    if (!ipc_wants_event(I3_IPC_EVENT_BINDING)) {
+        return;
+    }
 
     setlocale(LC_NUMERIC, "C");
 
-    yajl_gen gen = ygenalloc();
+    ipc_gen gen = ipc_event_gen_alloc(I3_IPC_EVENT_BINDING);
 
     y(map_open);
 
@@ -1719,24 +2895,66 @@ void ipc_send_binding_event(const char *event_type, Binding *bind, const char *m
 
     y(map_close);
 
-    const unsigned char *payload;
-    ylength length;
-    y(get_buf, &payload, &length);
-
-    ipc_send_event("binding", I3_IPC_EVENT_BINDING, (const char *)payload);
+    ipc_send_event("binding", I3_IPC_EVENT_BINDING, gen);
 
     y(free);
     setlocale(LC_NUMERIC, "");
 }
 
+/*
+ * For the output events, we send the change (currently always
+ * "unspecified").
+ */
+void ipc_send_output_event(const char *change) {
+    if (!ipc_wants_event(I3_IPC_EVENT_OUTPUT)) {
+        return;
+    }
+
+    ipc_gen gen = ipc_event_gen_alloc(I3_IPC_EVENT_OUTPUT);
+    y(map_open);
+    ystr("change");
+    ystr(change);
+    y(map_close);
+
+    ipc_send_event("output", I3_IPC_EVENT_OUTPUT, gen);
+    y(free);
+}
+
+/*
+ * For the mode events, we send the name of the new binding mode in "change"
+ * and whether it uses pango markup.
+ */
+void ipc_send_mode_event(const char *mode, bool pango_markup) {
+    if (!ipc_wants_event(I3_IPC_EVENT_MODE)) {
+        return;
+    }
+
+    ipc_gen gen = ipc_event_gen_alloc(I3_IPC_EVENT_MODE);
+    y(map_open);
+    ystr("change");
+    ystr(mode);
+    ystr("pango_markup");
+    y(bool, pango_markup);
+    y(map_close);
+
+    ipc_send_event("mode", I3_IPC_EVENT_MODE, gen);
+    y(free);
+}
+
 /*
  * Sends a restart reply to the IPC client on the specified fd.
  */
 void ipc_confirm_restart(ipc_client *client) {
     DLOG("ipc_confirm_restart(fd %d)\n", client->fd);
-    static const char *reply = "[{\"success\":true}]";
-    ipc_send_client_message(
-        client, strlen(reply), I3_IPC_REPLY_TYPE_COMMAND,
-        (const uint8_t *)reply);
+    ipc_gen gen = ipc_reply_gen_alloc(client);
+    y(array_open);
+    y(map_open);
+    ystr("success");
+    y(bool, true);
+    y(map_close);
+    y(array_close);
+
+    ipc_send_client_message(client, I3_IPC_REPLY_TYPE_COMMAND, gen);
+    y(free);
     ipc_push_pending(client);
 }
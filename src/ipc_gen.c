@@ -0,0 +1,121 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * ipc_gen.c: Generates IPC payloads in the encodings selected by the clients
+ *            (JSON and/or CBOR) in a single pass.
+ *
+ */
+#include "ipc_gen.h"
+
+#include <stdlib.h>
+
+/*
+ * Allocates a generator which writes JSON if json is true and CBOR if cbor is
+ * true. Free with ipc_gen_free().
+ *
+ */
+ipc_gen ipc_gen_alloc(bool json, bool cbor) {
+    ipc_gen gen = scalloc(1, sizeof(struct ipc_gen));
+    if (json) {
+        gen->json = yajl_gen_alloc(NULL);
+    }
+    if (cbor) {
+        gen->cbor = cbor_gen_alloc();
+    }
+    return gen;
+}
+
+void ipc_gen_free(ipc_gen gen) {
+    if (gen->json != NULL) {
+        yajl_gen_free(gen->json);
+    }
+    if (gen->cbor != NULL) {
+        cbor_gen_free(gen->cbor);
+    }
+    free(gen);
+}
+
+/*
+ * Returns the JSON written so far (an empty buffer if no JSON is written). The
+ * buffer is owned by the generator.
+ *
+ */
+void ipc_gen_get_buf(ipc_gen gen, const unsigned char **buf, size_t *len) {
+    if (gen->json == NULL) {
+        *buf = (const unsigned char *)"";
+        *len = 0;
+        return;
+    }
+    yajl_gen_get_buf(gen->json, buf, len);
+}
+
+/*
+ * Returns the CBOR written so far (an empty buffer if no CBOR is written). The
+ * buffer is owned by the generator.
+ *
+ */
+void ipc_gen_get_cbor(ipc_gen gen, const unsigned char **buf, size_t *len) {
+    if (gen->cbor == NULL) {
+        *buf = (const unsigned char *)"";
+        *len = 0;
+        return;
+    }
+    cbor_gen_get_buf(gen->cbor, buf, len);
+}
+
+/* Calls the yajl_gen and cbor_gen function of the same name for the
+ * encodings the generator writes. */
+#define BOTH(x, ...)                                \
+    do {                                            \
+        if (gen->json != NULL) {                    \
+            yajl_gen_##x(gen->json, ##__VA_ARGS__); \
+        }                                           \
+        if (gen->cbor != NULL) {                    \
+            cbor_gen_##x(gen->cbor, ##__VA_ARGS__); \
+        }                                           \
+    } while (0)
+
+void ipc_gen_null(ipc_gen gen) {
+    BOTH(null);
+}
+
+void ipc_gen_bool(ipc_gen gen, int value) {
+    BOTH(bool, value);
+}
+
+void ipc_gen_integer(ipc_gen gen, long long value) {
+    BOTH(integer, value);
+}
+
+void ipc_gen_double(ipc_gen gen, double value) {
+    BOTH(double, value);
+}
+
+void ipc_gen_number(ipc_gen gen, const char *number, size_t len) {
+    BOTH(number, number, len);
+}
+
+void ipc_gen_string(ipc_gen gen, const unsigned char *str, size_t len) {
+    BOTH(string, str, len);
+}
+
+void ipc_gen_map_open(ipc_gen gen) {
+    BOTH(map_open);
+}
+
+void ipc_gen_map_close(ipc_gen gen) {
+    BOTH(map_close);
+}
+
+void ipc_gen_array_open(ipc_gen gen) {
+    BOTH(array_open);
+}
+
+void ipc_gen_array_close(ipc_gen gen) {
+    BOTH(array_close);
+}
+
+#undef BOTH
@@ -7,6 +7,7 @@
  * key_press.c: key press handler
  *
  */
+#define LOG_CATEGORY LOG_BINDINGS
 #include "all.h"
 
 /*
@@ -487,6 +487,9 @@ static int json_int(void *ctx, long long val) {
 
     if (strcasecmp(last_key, "fullscreen_mode") == 0) {
         json_node->fullscreen_mode = val;
+        if (val == CF_GLOBAL) {
+            render_invalidate_all();
+        }
     }
 
     if (strcasecmp(last_key, "num") == 0) {
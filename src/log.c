@@ -11,6 +11,7 @@
 
 #include "all.h"
 #include "shmlog.h"
+#include "yajl_utils.h"
 
 #include <ev.h>
 #include <libgen.h>
@@ -18,14 +19,21 @@
 #include <sys/un.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 #if defined(__APPLE__)
@@ -33,6 +41,10 @@
 #endif
 
 static bool debug_logging = false;
+/* The categories of debug messages which are logged while debug logging or
+ * the SHM log is active. */
+static uint32_t log_categories = LOG_DEFAULT_CATEGORIES;
+uint32_t log_active_categories = 0;
 static bool verbose = false;
 static FILE *errorfile;
 char *errorfilename;
@@ -54,6 +66,9 @@ static i3_shmlog_header *header;
 /* A pointer to the byte where we last wrapped. Necessary to not print the
  * left-overs at the end of the ringbuffer. */
 static char *loglastwrap;
+/* A pointer to the oldest record before loglastwrap which was not overwritten
+ * yet (or loglastwrap if there is none). */
+static char *logoldest;
 /* Size (in bytes) of the i3 SHM log. */
 static int logbuffer_size;
 /* File descriptor for shm_open. */
@@ -61,17 +76,64 @@ static int logbuffer_shm;
 /* Size (in bytes) of physical memory */
 static long long physical_mem_bytes;
 
+/* The size of the buffer of each log client. Messages which do not fit
+ * because the client does not keep up are dropped. */
+#define LOG_CLIENT_BUFFER_SIZE (256 * 1024)
+
 typedef struct log_client {
     int fd;
 
+    /* Ring buffer of the messages which were not written yet. */
+    char *buffer;
+    size_t head;
+    size_t used;
+
+    /* The number of messages dropped since the client was told last time, and
+     * in total. */
+    uint64_t dropped;
+    uint64_t total_dropped;
+
+    struct ev_io *write_callback;
+
     TAILQ_ENTRY(log_client)
     clients;
 } log_client;
 
+/* The maximum number of arguments of a format whose messages are stored in
+ * binary form. */
+#define MAX_LOG_ARGS 32
+
+/* A printf format string which was used for a log message. */
+typedef struct log_format {
+    /* Whether messages with this format are formatted by i3 and stored as
+     * text (with preformatted_format), because the format uses conversions
+     * which printf_next_conversion() does not support or because the format
+     * table was full. */
+    bool preformat;
+    /* Byte offset of the format in the format table of the SHM log. */
+    uint32_t offset;
+    /* The size of the arguments in a record, counting strings as 1 byte. */
+    uint32_t fixed_size;
+    uint8_t num_args;
+    /* printf_arg_t, including the int arguments consumed by '*'. */
+    uint8_t args[MAX_LOG_ARGS];
+    /* For string arguments: the precision, which bounds how many bytes are
+     * read (the string does not need to be NUL-terminated then). */
+    int precision[MAX_LOG_ARGS];
+} log_format;
+
+/* The formats which are stored in the format table of the SHM log, indexed by
+ * their address. Since log messages are always logged with string literals as
+ * format, the address identifies the format. */
+static struct hashmap log_formats = HASHMAP_INITIALIZER(false);
+/* "%s", for messages which are formatted by i3. */
+static log_format *preformatted_format;
+
 TAILQ_HEAD(log_client_head, log_client)
 log_clients = TAILQ_HEAD_INITIALIZER(log_clients);
 
 void log_broadcast_to_clients(const char *message, size_t len);
+static void log_client_writeable_cb(EV_P_ struct ev_io *w, int revents);
 
 /*
  * Writes the offsets for the next write and for the last wrap to the
@@ -80,9 +142,250 @@ void log_broadcast_to_clients(const char *message, size_t len);
  *
  */
 static void store_log_markers(void) {
-    header->offset_next_write = (logwalk - logbuffer);
     header->offset_last_wrap = (loglastwrap - logbuffer);
-    header->size = logbuffer_size;
+    header->offset_oldest = (logoldest - logbuffer);
+    /* Readers which follow the log must see the record before the offset. */
+    __atomic_store_n(&(header->offset_next_write), (uint32_t)(logwalk - logbuffer), __ATOMIC_RELEASE);
+}
+
+/*
+ * Tells readers which follow the log (i3-dump-log -f) that there is
+ * something new. Only if a reader is actually waiting, this costs a syscall.
+ *
+ */
+static void notify_log_readers(void) {
+    __atomic_add_fetch(&(header->notify_sequence), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(header->notify_waiters), __ATOMIC_SEQ_CST) == 0) {
+        return;
+    }
+#if defined(__linux__)
+    syscall(SYS_futex, &(header->notify_sequence), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+/*
+ * Updates log_active_categories, which DLOG() checks before evaluating its
+ * arguments, after debug logging, the SHM log or the categories changed.
+ *
+ */
+static void update_active_categories(void) {
+    log_active_categories = (debug_logging || logbuffer != NULL ? log_categories : 0);
+}
+
+static uint64_t timespec_nsec(const struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static size_t log_arg_size(printf_arg_t type) {
+    switch (type) {
+        case PRINTF_ARG_INT:
+            return sizeof(int);
+        case PRINTF_ARG_LONG:
+            return sizeof(long);
+        case PRINTF_ARG_LLONG:
+            return sizeof(long long);
+        case PRINTF_ARG_SIZE:
+            return sizeof(size_t);
+        case PRINTF_ARG_INTMAX:
+            return sizeof(intmax_t);
+        case PRINTF_ARG_PTRDIFF:
+            return sizeof(ptrdiff_t);
+        case PRINTF_ARG_DOUBLE:
+            return sizeof(double);
+        case PRINTF_ARG_POINTER:
+            return sizeof(void *);
+        case PRINTF_ARG_STRING:
+            /* At least the terminating NUL byte. */
+            return 1;
+        case PRINTF_ARG_NONE:
+        case PRINTF_ARG_INVALID:
+            break;
+    }
+    return 0;
+}
+
+/*
+ * Returns the log_format for the given format string, adding the string to
+ * the format table of the SHM log when it is used for the first time.
+ *
+ */
+static log_format *get_log_format(const char *fmt) {
+    log_format *format = hashmap_get(&log_formats, fmt);
+    if (format != NULL) {
+        return format;
+    }
+
+    format = scalloc(1, sizeof(log_format));
+    const char *walk = fmt;
+    const char *end;
+    int stars;
+    int precision;
+    printf_arg_t type;
+    while ((walk = printf_next_conversion(walk, &end, &stars, &precision, &type)) != NULL) {
+        walk = end;
+        if (type == PRINTF_ARG_NONE) {
+            continue;
+        }
+        if (type == PRINTF_ARG_INVALID || format->num_args + stars + 1 > MAX_LOG_ARGS) {
+            format->preformat = true;
+            break;
+        }
+        for (int i = 0; i < stars; i++) {
+            format->args[format->num_args++] = PRINTF_ARG_INT;
+            format->fixed_size += sizeof(int);
+        }
+        format->precision[format->num_args] = precision;
+        format->args[format->num_args++] = type;
+        format->fixed_size += log_arg_size(type);
+    }
+
+    const size_t len = strlen(fmt) + 1;
+    if (!format->preformat && header->formats_used + len <= header->formats_size) {
+        format->offset = header->formats_used;
+        memcpy(logbuffer + header->formats_offset + header->formats_used, fmt, len);
+        /* Readers must not see the new size before the string. */
+        __atomic_store_n(&(header->formats_used), header->formats_used + len, __ATOMIC_RELEASE);
+    } else {
+        format->preformat = true;
+    }
+
+    hashmap_put(&log_formats, fmt, format);
+    return format;
+}
+
+static void free_log_formats(void) {
+    uint32_t iter = 0;
+    const void *key;
+    void *value;
+    while (hashmap_next(&log_formats, &iter, &key, &value)) {
+        free(value);
+    }
+    hashmap_clear(&log_formats);
+    preformatted_format = NULL;
+}
+
+/*
+ * Stores a log message as a binary record in the SHM log. Instead of
+ * formatting the message, only the arguments are copied, the format string is
+ * referenced by its offset in the format table. Formatting is left to
+ * i3-dump-log.
+ *
+ */
+static void shmlog_write(i3_shmlog_level level, uint8_t category, const char *fmt, va_list args) {
+    /* The record is assembled here first, so that its size is known before
+     * it is copied into the ringbuffer. */
+    static uint8_t record[I3_SHMLOG_MAX_RECORD] __attribute__((aligned(8)));
+    size_t size = sizeof(i3_shmlog_record);
+
+    log_format *format = get_log_format(fmt);
+    if (format->preformat) {
+        const size_t available = sizeof(record) - size;
+        if (vsnprintf((char *)record + size, available, fmt, args) < 0) {
+            record[size] = '\0';
+        }
+        size += strlen((char *)record + size) + 1;
+        format = preformatted_format;
+    } else {
+        /* The space which is left for the contents of string arguments. */
+        size_t budget = sizeof(record) - size - format->fixed_size;
+        /* The last int argument, which is the precision for "%.*s". */
+        int last_int = 0;
+        for (int i = 0; i < format->num_args; i++) {
+#define STORE_ARG(ctype)                              \
+    do {                                              \
+        const ctype value = va_arg(args, ctype);      \
+        memcpy(record + size, &value, sizeof(ctype)); \
+        size += sizeof(ctype);                        \
+    } while (0)
+            switch ((printf_arg_t)format->args[i]) {
+                case PRINTF_ARG_INT:
+                    last_int = va_arg(args, int);
+                    memcpy(record + size, &last_int, sizeof(int));
+                    size += sizeof(int);
+                    break;
+                case PRINTF_ARG_LONG:
+                    STORE_ARG(long);
+                    break;
+                case PRINTF_ARG_LLONG:
+                    STORE_ARG(long long);
+                    break;
+                case PRINTF_ARG_SIZE:
+                    STORE_ARG(size_t);
+                    break;
+                case PRINTF_ARG_INTMAX:
+                    STORE_ARG(intmax_t);
+                    break;
+                case PRINTF_ARG_PTRDIFF:
+                    STORE_ARG(ptrdiff_t);
+                    break;
+                case PRINTF_ARG_DOUBLE:
+                    STORE_ARG(double);
+                    break;
+                case PRINTF_ARG_POINTER:
+                    STORE_ARG(void *);
+                    break;
+                case PRINTF_ARG_STRING: {
+                    const char *str = va_arg(args, const char *);
+                    if (str == NULL) {
+                        str = "(null)";
+                    }
+                    /* Like printf, read at most precision bytes. A negative
+                     * precision given as argument is ignored. */
+                    int precision = format->precision[i];
+                    if (precision == PRINTF_PRECISION_STAR) {
+                        precision = last_int;
+                    }
+                    size_t max = budget;
+                    if (precision >= 0 && (size_t)precision < max) {
+                        max = precision;
+                    }
+                    const size_t len = strnlen(str, max);
+                    memcpy(record + size, str, len);
+                    record[size + len] = '\0';
+                    size += len + 1;
+                    budget -= len;
+                    break;
+                }
+                case PRINTF_ARG_NONE:
+                case PRINTF_ARG_INVALID:
+                    break;
+            }
+#undef STORE_ARG
+        }
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    size = (size + 7) & ~(size_t)7;
+    i3_shmlog_record *r = (i3_shmlog_record *)record;
+    r->size = size;
+    r->level = level;
+    r->category = category;
+    r->format = format->offset;
+    r->timestamp = timespec_nsec(&now);
+
+    /* If there is no space for the current record in the ringbuffer, we
+     * need to wrap and write to the beginning again. */
+    if (size > (size_t)(logbuffer_size - (logwalk - logbuffer))) {
+        loglastwrap = logwalk;
+        logwalk = logbuffer + header->records_offset;
+        logoldest = logwalk;
+        store_log_markers();
+        header->wrap_count++;
+    }
+
+    /* Skip the old records which are about to be overwritten. */
+    while (logoldest < loglastwrap && logoldest < logwalk + size) {
+        const uint16_t old_size = ((i3_shmlog_record *)logoldest)->size;
+        logoldest = (old_size == 0 ? loglastwrap : logoldest + old_size);
+    }
+
+    /* Copy the record, move the write pointer to the byte after it. */
+    memcpy(logwalk, record, size);
+    logwalk += size;
+
+    store_log_markers();
+    notify_log_readers();
 }
 
 /*
@@ -142,6 +445,10 @@ void open_logbuffer(void) {
     if (physical_mem_bytes * 0.01 < (long long)shmlog_size) {
         logbuffer_size = physical_mem_bytes * 0.01;
     }
+    /* Leave room for the format table and a couple of records. */
+    if (logbuffer_size < 64 * 1024) {
+        logbuffer_size = 64 * 1024;
+    }
 
 #if defined(__FreeBSD__)
     sasprintf(&shmlogname, "/tmp/i3-log-%d", getpid());
@@ -178,10 +485,40 @@ void open_logbuffer(void) {
     memset(logbuffer, '\0', logbuffer_size);
 
     header = (i3_shmlog_header *)logbuffer;
+    header->version = I3_SHMLOG_VERSION;
+    header->size = logbuffer_size;
+    header->pid = getpid();
+
+    /* Versions of i3-dump-log which only know the text format print this
+     * notice instead of the binary records. */
+    snprintf(header->legacy_notice, sizeof(header->legacy_notice),
+             "The i3 log uses a newer format. Please use the i3-dump-log of the running i3.\n");
+    header->legacy_offset_next_write = offsetof(i3_shmlog_header, legacy_notice) + strlen(header->legacy_notice);
+    header->legacy_offset_last_wrap = header->legacy_offset_next_write;
+    header->legacy_size = logbuffer_size;
+
+    /* i3 has about 2000 distinct log formats, which take up about 120 KiB. */
+    header->formats_offset = sizeof(i3_shmlog_header);
+    header->formats_size = logbuffer_size / 8;
+    if (header->formats_size > 1024 * 1024) {
+        header->formats_size = 1024 * 1024;
+    }
+    header->formats_used = 0;
+    header->records_offset = (header->formats_offset + header->formats_size + 7) & ~7;
+
+    struct timespec monotonic, realtime;
+    clock_gettime(CLOCK_MONOTONIC, &monotonic);
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    header->realtime_offset = (int64_t)(timespec_nsec(&realtime) - timespec_nsec(&monotonic));
 
-    logwalk = logbuffer + sizeof(i3_shmlog_header);
+    free_log_formats();
+    preformatted_format = get_log_format("%s");
+
+    logwalk = logbuffer + header->records_offset;
     loglastwrap = logbuffer + logbuffer_size;
+    logoldest = loglastwrap;
     store_log_markers();
+    update_active_categories();
 }
 
 /*
@@ -189,11 +526,19 @@ void open_logbuffer(void) {
  *
  */
 void close_logbuffer(void) {
+    if (logbuffer != NULL && logbuffer != MAP_FAILED) {
+        /* Readers which follow the log stop now. */
+        __atomic_store_n(&(header->closed), 1, __ATOMIC_RELEASE);
+        notify_log_readers();
+        munmap(logbuffer, logbuffer_size);
+    }
     close(logbuffer_shm);
     shm_unlink(shmlogname);
     free(shmlogname);
     logbuffer = NULL;
     shmlogname = "";
+    free_log_formats();
+    update_active_categories();
 }
 
 /*
@@ -220,6 +565,56 @@ bool get_debug_logging(void) {
  */
 void set_debug_logging(const bool _debug_logging) {
     debug_logging = _debug_logging;
+    update_active_categories();
+}
+
+/* The names of the categories, in the order of their bits. */
+static const char *log_category_names[LOG_NUM_CATEGORIES] = {
+    I3_SHMLOG_CATEGORY_NAMES,
+};
+
+/*
+ * Enables debug log messages of the given categories (a bitmask of
+ * log_category_t) and disables all others.
+ *
+ */
+void set_log_categories(uint32_t categories) {
+    log_categories = (categories & LOG_ALL_CATEGORIES);
+    update_active_categories();
+}
+
+/*
+ * Returns the enabled debug log categories.
+ *
+ */
+uint32_t get_log_categories(void) {
+    return log_categories;
+}
+
+/*
+ * Returns the name of the given category (as used by the debuglog command).
+ *
+ */
+const char *log_category_name(log_category_t category) {
+    for (int i = 0; i < LOG_NUM_CATEGORIES; i++) {
+        if (category == (1 << i)) {
+            return log_category_names[i];
+        }
+    }
+    return "unknown";
+}
+
+/*
+ * Returns the category with the given name or 0 if there is none.
+ *
+ */
+log_category_t log_category_from_name(const char *name) {
+    for (int i = 0; i < LOG_NUM_CATEGORIES; i++) {
+        if (strcasecmp(name, log_category_names[i]) == 0) {
+            return (1 << i);
+        }
+    }
+    return 0;
 }
 
 /*
@@ -229,7 +624,7 @@ void set_debug_logging(const bool _debug_logging) {
  * This is to be called by *LOG() which includes filename/linenumber/function.
  *
  */
-static void vlog(const bool print, const char *fmt, va_list args) {
+static void vlog(const bool print, const i3_shmlog_level level, const uint8_t category, const char *fmt, va_list args) {
     /* Precisely one page to not consume too much memory but to hold enough
      * data to be useful. */
     static char message[4096];
@@ -238,6 +633,18 @@ static void vlog(const bool print, const char *fmt, va_list args) {
     static struct tm *tmp;
     static size_t len;
 
+    if (logbuffer) {
+        va_list shmlog_args;
+        va_copy(shmlog_args, args);
+        shmlog_write(level, category, fmt, shmlog_args);
+        va_end(shmlog_args);
+
+        /* Only format the message if somebody reads it right away. */
+        if (!print && TAILQ_EMPTY(&log_clients)) {
+            return;
+        }
+    }
+
     /* Get current time */
     t = time(NULL);
     /* Convert time to local time (determined by the locale) */
@@ -248,8 +655,8 @@ static void vlog(const bool print, const char *fmt, va_list args) {
     /*
      * logbuffer  print
      * ----------------
-     *  true      true   format message, save, print
-     *  true      false  format message, save
+     *  true      true   save, format message, print
+     *  true      false  save, format message if log clients are connected
      *  false     true   print message only
      *  false     false  INVALID, never called
      */
@@ -277,22 +684,6 @@ static void vlog(const bool print, const char *fmt, va_list args) {
             message[len - 2] = '\n';
         }
 
-        /* If there is no space for the current message in the ringbuffer, we
-         * need to wrap and write to the beginning again. */
-        if (len >= (size_t)(logbuffer_size - (logwalk - logbuffer))) {
-            loglastwrap = logwalk;
-            logwalk = logbuffer + sizeof(i3_shmlog_header);
-            store_log_markers();
-            header->wrap_count++;
-        }
-
-        /* Copy the buffer, move the write pointer to the byte after our
-         * current message. */
-        strncpy(logwalk, message, len);
-        logwalk += len;
-
-        store_log_markers();
-
         if (print) {
             fwrite(message, len, 1, stdout);
         }
@@ -314,7 +705,7 @@ void verboselog(char *fmt, ...) {
     }
 
     va_start(args, fmt);
-    vlog(verbose, fmt, args);
+    vlog(verbose, I3_SHMLOG_INFO, 0, fmt, args);
     va_end(args);
 }
 
@@ -326,7 +717,7 @@ void errorlog(char *fmt, ...) {
     va_list args;
 
     va_start(args, fmt);
-    vlog(true, fmt, args);
+    vlog(true, I3_SHMLOG_ERROR, 0, fmt, args);
     va_end(args);
 
     /* also log to the error logfile, if opened */
@@ -345,12 +736,25 @@ void errorlog(char *fmt, ...) {
 void debuglog(char *fmt, ...) {
     va_list args;
 
-    if (!logbuffer && !(debug_logging)) {
+    if (!(log_active_categories & LOG_GENERAL)) {
         return;
     }
 
     va_start(args, fmt);
-    vlog(debug_logging, fmt, args);
+    vlog(debug_logging, I3_SHMLOG_DEBUG, 0, fmt, args);
+    va_end(args);
+}
+
+/*
+ * Logs the given debug message of the given category (see CDLOG()), whose
+ * caller already checked that the category is active.
+ *
+ */
+void debuglog_category(log_category_t category, char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    vlog(debug_logging, I3_SHMLOG_DEBUG, __builtin_ctz(category), fmt, args);
     va_end(args);
 }
 
@@ -411,23 +815,156 @@ void log_new_client(EV_P_ struct ev_io *w, int revents) {
 
     log_client *client = scalloc(1, sizeof(log_client));
     client->fd = fd;
+    client->buffer = smalloc(LOG_CLIENT_BUFFER_SIZE);
+    client->write_callback = scalloc(1, sizeof(struct ev_io));
+    client->write_callback->data = client;
+    ev_io_init(client->write_callback, log_client_writeable_cb, fd, EV_WRITE);
     TAILQ_INSERT_TAIL(&log_clients, client, clients);
 
     DLOG("log: new client connected on fd %d\n", fd);
 }
 
+/*
+ * Disconnects the given log client. No log messages must be written here,
+ * since this is called while broadcasting them.
+ *
+ */
+static void free_log_client(log_client *client) {
+    ev_io_stop(main_loop, client->write_callback);
+    close(client->fd);
+    TAILQ_REMOVE(&log_clients, client, clients);
+    free(client->write_callback);
+    free(client->buffer);
+    free(client);
+}
+
+/*
+ * Appends the given data to the buffer of the client, unless it does not fit.
+ *
+ */
+static bool log_client_append(log_client *client, const char *data, size_t len) {
+    if (LOG_CLIENT_BUFFER_SIZE - client->used < len) {
+        return false;
+    }
+
+    const size_t tail = (client->head + client->used) % LOG_CLIENT_BUFFER_SIZE;
+    const size_t first = (len < LOG_CLIENT_BUFFER_SIZE - tail ? len : LOG_CLIENT_BUFFER_SIZE - tail);
+    memcpy(client->buffer + tail, data, first);
+    memcpy(client->buffer, data + first, len - first);
+    client->used += len;
+    return true;
+}
+
+/*
+ * Tells the client how many messages were dropped since it was told last
+ * time, so that followers notice the gap.
+ *
+ */
+static void log_client_append_marker(log_client *client) {
+    if (client->dropped == 0) {
+        return;
+    }
+
+    char marker[128];
+    const int len = snprintf(marker, sizeof(marker),
+                             "[i3] %" PRIu64 " messages dropped (the log client did not keep up)\n",
+                             client->dropped);
+    if (log_client_append(client, marker, len)) {
+        client->dropped = 0;
+    }
+}
+
+/*
+ * Writes as much of the buffer of the client as its socket accepts without
+ * blocking and makes sure that the rest is written as soon as the socket is
+ * writeable again. Returns false if the client has to be disconnected.
+ *
+ */
+static bool log_client_flush(log_client *client) {
+    while (client->used > 0) {
+        const size_t end = client->head + client->used;
+        const size_t chunk = (end > LOG_CLIENT_BUFFER_SIZE ? LOG_CLIENT_BUFFER_SIZE - client->head : client->used);
+        const ssize_t n = write(client->fd, client->buffer + client->head, chunk);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+
+        client->head = (client->head + n) % LOG_CLIENT_BUFFER_SIZE;
+        client->used -= n;
+        if (client->used == 0) {
+            client->head = 0;
+            /* Report the drops once the client caught up. */
+            log_client_append_marker(client);
+        }
+    }
+
+    if (client->used > 0) {
+        ev_io_start(main_loop, client->write_callback);
+    } else {
+        ev_io_stop(main_loop, client->write_callback);
+    }
+    return true;
+}
+
+static void log_client_writeable_cb(EV_P_ struct ev_io *w, int revents) {
+    log_client *client = (log_client *)w->data;
+    if (!log_client_flush(client)) {
+        free_log_client(client);
+    }
+}
+
+/*
+ * Sends the given message to all log clients without blocking: the message
+ * is buffered for clients whose socket does not accept it right away, and
+ * dropped for clients whose buffer is full.
+ *
+ */
 void log_broadcast_to_clients(const char *message, size_t len) {
     log_client *current = TAILQ_FIRST(&log_clients);
     while (current != TAILQ_END(&log_clients)) {
-        /* XXX: In case slow connections turn out to be a problem here
-         * (unlikely as long as i3-dump-log is the only consumer), introduce
-         * buffering, similar to the IPC interface. */
-        ssize_t n = writeall(current->fd, message, len);
-        log_client *previous = current;
+        log_client *client = current;
         current = TAILQ_NEXT(current, clients);
-        if (n < 0) {
-            TAILQ_REMOVE(&log_clients, previous, clients);
-            free(previous);
+
+        log_client_append_marker(client);
+        if (client->dropped > 0 || !log_client_append(client, message, len)) {
+            client->dropped++;
+            client->total_dropped++;
+            continue;
+        }
+
+        /* While the socket is not writeable, the callback writes the buffer
+         * as soon as it is. */
+        if (ev_is_active(client->write_callback)) {
+            continue;
         }
+        if (!log_client_flush(client)) {
+            free_log_client(client);
+        }
+    }
+}
+
+/*
+ * Dumps the clients following the log (e.g. i3-dump-log -f) for GET_STATS.
+ *
+ */
+void dump_log_clients(ipc_gen gen) {
+    y(array_open);
+    log_client *current;
+    TAILQ_FOREACH (current, &log_clients, clients) {
+        y(map_open);
+        ystr("fd");
+        y(integer, current->fd);
+        ystr("buffered_bytes");
+        y(integer, current->used);
+        ystr("dropped");
+        y(integer, current->total_dropped);
+        y(map_close);
     }
+    y(array_close);
 }
@@ -25,6 +25,7 @@
 #include <sys/un.h>
 #include <unistd.h>
 #include <xcb/xcb_atom.h>
+#include <xcb/xcb_event.h>
 #include <xcb/xinerama.h>
 #include <xcb/bigreq.h>
 
@@ -121,6 +122,37 @@ static void xcb_got_event(EV_P_ struct ev_io *w, int revents) {
     /* empty, because xcb_prepare_cb are used */
 }
 
+/*
+ * Handles a single X11 event or error received from xcb and frees it.
+ *
+ */
+static void xcb_handle_event(xcb_generic_event_t *event) {
+    if (event->response_type == 0) {
+        if (event_is_ignored(event->sequence, 0)) {
+            DLOG("Expected X11 Error received for sequence %x\n", event->sequence);
+        } else {
+            xcb_generic_error_t *error = (xcb_generic_error_t *)event;
+            DLOG("X11 Error received (probably harmless)! sequence 0x%x, error_code = %d\n",
+                 error->sequence, error->error_code);
+        }
+        free(event);
+        return;
+    }
+
+    /* Strip off the highest bit (set if the event is generated) */
+    int type = (event->response_type & 0x7F);
+
+    const uint64_t trace_start = TRACE_BEGIN();
+    handle_event(type, event);
+    if (trace_start != 0) {
+        /* Extension events (RandR, XKB) have no label. */
+        const char *label = xcb_event_get_label(type);
+        TRACE_END(trace_start, "event", (label != NULL ? label : "ExtensionEvent"));
+    }
+
+    free(event);
+}
+
 /*
  * Called just before the event loop sleeps. Ensures xcb’s incoming and outgoing
  * queues are empty so that any activity will trigger another event loop
@@ -132,27 +164,41 @@ static void xcb_prepare_cb(EV_P_ ev_prepare *w, int revents) {
        sleeps. */
     xcb_generic_event_t *event;
 
-    while ((event = xcb_poll_for_event(conn)) != NULL) {
-        if (event->response_type == 0) {
-            if (event_is_ignored(event->sequence, 0)) {
-                DLOG("Expected X11 Error received for sequence %x\n", event->sequence);
-            } else {
-                xcb_generic_error_t *error = (xcb_generic_error_t *)event;
-                DLOG("X11 Error received (probably harmless)! sequence 0x%x, error_code = %d\n",
-                     error->sequence, error->error_code);
-            }
-            free(event);
-            continue;
+    while (true) {
+        while ((event = xcb_poll_for_event(conn)) != NULL) {
+            xcb_handle_event(event);
         }
 
-        /* Strip off the highest bit (set if the event is generated) */
-        int type = (event->response_type & 0x7F);
+        handle_pending_property_notifies();
 
-        handle_event(type, event);
+        /* Manage the windows whose replies arrived in the meantime. Managing
+         * a window generates new events, so drain the queue again. */
+        if (manage_pending_windows(false)) {
+            continue;
+        }
 
-        free(event);
+        /* Render the tree once for everything that happened since the last
+         * render. Rendering might read new events from the connection. */
+        if (tree_render_if_requested()) {
+            continue;
+        }
+
+        /* Looking for replies might have read new events from the connection
+         * as well. These have to be handled before sleeping, since the X11
+         * file descriptor will not become readable for them. */
+        if ((event = xcb_poll_for_queued_event(conn)) == NULL) {
+            break;
+        }
+        xcb_handle_event(event);
     }
 
+    /* Tell tree_patch subscribers about everything that changed. */
+    ipc_send_tree_patch_event();
+
+    /* Write the state snapshot once for everything that was pushed to X11,
+     * before flushing e.g. replies to i3 sync requests. */
+    snapshot_publish_if_requested();
+
     /* Flush all queued events to X11. */
     xcb_flush(conn);
 }
@@ -185,6 +231,7 @@ static void i3_exit(void) {
         fflush(stderr);
         shm_unlink(shmlogname);
     }
+    snapshot_close();
     ipc_shutdown(SHUTDOWN_REASON_EXIT, -1);
     unlink(config.ipc_socket_path);
     if (current_log_stream_socket_path != NULL) {
@@ -218,6 +265,9 @@ static void handle_core_signal(int sig, siginfo_t *info, void *data) {
     if (*shmlogname != '\0') {
         shm_unlink(shmlogname);
     }
+    if (snapshot_path != NULL) {
+        shm_unlink(snapshot_path);
+    }
     raise(sig);
 }
 
@@ -304,6 +354,7 @@ int main(int argc, char *argv[]) {
         {"disable-randr15", no_argument, 0, 0},
         {"disable_randr15", no_argument, 0, 0},
         {"disable-signalhandler", no_argument, 0, 0},
+        {"verify-render", no_argument, 0, 0},
         {"shmlog-size", required_argument, 0, 0},
         {"shmlog_size", required_argument, 0, 0},
         {"get-socketpath", no_argument, 0, 0},
@@ -395,6 +446,9 @@ int main(int argc, char *argv[]) {
                 } else if (strcmp(long_options[option_index].name, "disable-signalhandler") == 0) {
                     disable_signalhandler = true;
                     break;
+                } else if (strcmp(long_options[option_index].name, "verify-render") == 0) {
+                    render_verify = true;
+                    break;
                 } else if (strcmp(long_options[option_index].name, "get-socketpath") == 0 ||
                            strcmp(long_options[option_index].name, "get_socketpath") == 0) {
                     char *socket_path = root_atom_contents("I3_SOCKET_PATH", NULL, 0);
@@ -461,6 +515,11 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "\t--replace\n"
                                 "\tReplace an existing window manager.\n");
                 fprintf(stderr, "\n");
+                fprintf(stderr, "\t--verify-render\n"
+                                "\tAfter every incremental render, render the whole tree again\n"
+                                "\tand abort if the results differ. Likewise, abort if a tree\n"
+                                "\tpatch misses a changed container (for debugging).\n");
+                fprintf(stderr, "\n");
                 fprintf(stderr, "If you pass plain text arguments, i3 will interpret them as a command\n"
                                 "to send to a currently running i3 (like i3-msg). This allows you to\n"
                                 "use nice and logical commands, such as:\n"
@@ -1010,6 +1069,9 @@ int main(int argc, char *argv[]) {
     con_activate(con_descend_focused(output_get_content(output->con)));
     free(pointerreply);
 
+    snapshot_open();
+    /* Render the initial layout before managing any windows or accepting IPC
+     * connections. */
     tree_render();
 
     /* Listen to the IPC socket for clients */
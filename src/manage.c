@@ -7,8 +7,11 @@
  * manage.c: Initially managing new windows (or existing ones on restart).
  *
  */
+#define LOG_CATEGORY LOG_MANAGE
 #include "all.h"
 
+#include <xcb/xcbext.h>
+
 /*
  * Match frame and window depth. This is needed because X will refuse to reparent a
  * window whose background is ParentRelative under a window with a different depth.
@@ -65,6 +68,7 @@ void manage_existing_windows(xcb_window_t root) {
     for (i = 0; i < len; ++i) {
         manage_window(children[i], cookies[i], true);
     }
+    manage_pending_windows(true);
 
     free(reply);
     free(cookies);
@@ -103,17 +107,24 @@ void restore_geometry(void) {
 }
 
 /*
- * Do some sanity checks and then reparent the window.
+ * A window which is about to be managed. Its attributes are requested first.
+ * Only once they show that the window can be managed, its event mask is set
+ * and its properties are requested.
  *
  */
-void manage_window(xcb_window_t window, xcb_get_window_attributes_cookie_t cookie,
-                   bool needs_to_be_mapped) {
-    DLOG("window 0x%08x\n", window);
+struct pending_window {
+    xcb_window_t window;
+    bool needs_to_be_mapped;
 
-    xcb_drawable_t d = {window};
-    xcb_get_geometry_cookie_t geomc;
-    xcb_get_geometry_reply_t *geom;
-    xcb_get_window_attributes_reply_t *attr = NULL;
+    xcb_get_window_attributes_cookie_t attr_cookie;
+    xcb_get_geometry_cookie_t geom_cookie;
+
+    /* NULL until the attributes were received. Also NULL afterwards if the
+     * window will not be managed (e.g. because it is override_redirect), in
+     * which case attr_received is true but no properties were requested. */
+    bool attr_received;
+    xcb_get_window_attributes_reply_t *attr;
+    xcb_void_cookie_t event_mask_cookie;
 
     xcb_get_property_cookie_t wm_type_cookie, strut_cookie, state_cookie,
         utf8_title_cookie, title_cookie,
@@ -122,43 +133,89 @@ void manage_window(xcb_window_t window, xcb_get_window_attributes_cookie_t cooki
         wm_normal_hints_cookie, motif_wm_hints_cookie, wm_user_time_cookie, wm_desktop_cookie,
         wm_machine_cookie;
 
+    /* _NET_WM_ICON is requested last. Once its reply arrived, all other
+     * replies are available as well. */
     xcb_get_property_cookie_t wm_icon_cookie;
+    bool wm_icon_received;
+    xcb_get_property_reply_t *wm_icon_reply;
 
-    geomc = xcb_get_geometry(conn, d);
+    TAILQ_ENTRY(pending_window) pending_windows;
+};
 
-    /* Check if the window is mapped (it could be not mapped when initializing and
-       calling manage_window() for every window) */
-    if ((attr = xcb_get_window_attributes_reply(conn, cookie, 0)) == NULL) {
-        DLOG("Could not get attributes\n");
-        xcb_discard_reply(conn, geomc.sequence);
+/* Pending windows are managed in the order in which they were mapped. */
+static TAILQ_HEAD(pending_windows_head, pending_window) pending_windows =
+    TAILQ_HEAD_INITIALIZER(pending_windows);
+
+/* Maps the window ID to its struct pending_window. */
+static struct hashmap pending_windows_by_id = HASHMAP_INITIALIZER(false);
+
+/*
+ * Queues the window for being managed, without waiting for any replies. The
+ * window is managed by manage_pending_windows() once the replies are
+ * available.
+ *
+ */
+void manage_window(xcb_window_t window, xcb_get_window_attributes_cookie_t cookie,
+                   bool needs_to_be_mapped) {
+    DLOG("window 0x%08x\n", window);
+
+    /* Check if the window is already managed (or about to be) */
+    if (con_by_window_id(window) != NULL || manage_window_is_pending(window)) {
+        DLOG("already managed (by con %p)\n", con_by_window_id(window));
+        xcb_discard_reply(conn, cookie.sequence);
         return;
     }
 
-    if (needs_to_be_mapped && attr->map_state != XCB_MAP_STATE_VIEWABLE) {
-        xcb_discard_reply(conn, geomc.sequence);
-        goto out;
-    }
+    struct pending_window *pw = scalloc(1, sizeof(struct pending_window));
+    pw->window = window;
+    pw->needs_to_be_mapped = needs_to_be_mapped;
+    pw->attr_cookie = cookie;
 
-    /* Don’t manage clients with the override_redirect flag */
-    if (attr->override_redirect) {
-        xcb_discard_reply(conn, geomc.sequence);
-        goto out;
+    xcb_drawable_t d = {window};
+    pw->geom_cookie = xcb_get_geometry(conn, d);
+
+    TAILQ_INSERT_TAIL(&pending_windows, pw, pending_windows);
+    hashmap_put(&pending_windows_by_id, HASHMAP_INT_KEY(window), pw);
+}
+
+/*
+ * Handles the attributes reply of a pending window. If the window can be
+ * managed, its event mask is set and its properties are requested.
+ *
+ * If block is false and the reply has not been received yet, this returns
+ * false without doing anything.
+ *
+ */
+static bool pending_window_attributes(struct pending_window *pw, bool block) {
+    const xcb_window_t window = pw->window;
+    xcb_get_window_attributes_reply_t *attr = NULL;
+
+    if (block) {
+        attr = xcb_get_window_attributes_reply(conn, pw->attr_cookie, NULL);
+    } else {
+        xcb_generic_error_t *error = NULL;
+        if (!xcb_poll_for_reply(conn, pw->attr_cookie.sequence, (void **)&attr, &error)) {
+            return false;
+        }
+        free(error);
     }
+    pw->attr_received = true;
 
-    /* Check if the window is already managed */
-    if (con_by_window_id(window) != NULL) {
-        DLOG("already managed (by con %p)\n", con_by_window_id(window));
-        xcb_discard_reply(conn, geomc.sequence);
-        goto out;
+    /* Check if the window is mapped (it could be not mapped when initializing and
+       calling manage_window() for every window) */
+    if (attr == NULL) {
+        DLOG("Could not get attributes of window 0x%08x\n", window);
+        return true;
     }
 
-    /* Get the initial geometry (position, size, …) */
-    if ((geom = xcb_get_geometry_reply(conn, geomc, 0)) == NULL) {
-        DLOG("could not get geometry\n");
-        goto out;
+    if ((pw->needs_to_be_mapped && attr->map_state != XCB_MAP_STATE_VIEWABLE) ||
+        /* Don’t manage clients with the override_redirect flag */
+        attr->override_redirect) {
+        free(attr);
+        return true;
     }
 
-    uint32_t values[1];
+    pw->attr = attr;
 
     /* Set a temporary event mask for the new window, consisting only of
      * PropertyChange and StructureNotify. We need to be notified of
@@ -169,34 +226,119 @@ void manage_window(xcb_window_t window, xcb_get_window_attributes_cookie_t cooki
      * we get to re-parent it.
      * If this request fails, we assume the client has already unmapped the
      * window between the MapRequest and our event mask change. */
+    uint32_t values[1];
     values[0] = XCB_EVENT_MASK_PROPERTY_CHANGE |
                 XCB_EVENT_MASK_STRUCTURE_NOTIFY;
-    xcb_void_cookie_t event_mask_cookie =
+    pw->event_mask_cookie =
         xcb_change_window_attributes_checked(conn, window, XCB_CW_EVENT_MASK, values);
-    if (xcb_request_check(conn, event_mask_cookie) != NULL) {
-        LOG("Could not change event mask, the window probably already disappeared.\n");
-        goto out;
-    }
 
 #define GET_PROPERTY(atom, len) xcb_get_property(conn, false, window, atom, XCB_GET_PROPERTY_TYPE_ANY, 0, len)
 
-    wm_type_cookie = GET_PROPERTY(A__NET_WM_WINDOW_TYPE, UINT32_MAX);
-    strut_cookie = GET_PROPERTY(A__NET_WM_STRUT_PARTIAL, UINT32_MAX);
-    state_cookie = GET_PROPERTY(A__NET_WM_STATE, UINT32_MAX);
-    utf8_title_cookie = GET_PROPERTY(A__NET_WM_NAME, 128);
-    leader_cookie = GET_PROPERTY(A_WM_CLIENT_LEADER, UINT32_MAX);
-    transient_cookie = GET_PROPERTY(XCB_ATOM_WM_TRANSIENT_FOR, UINT32_MAX);
-    title_cookie = GET_PROPERTY(XCB_ATOM_WM_NAME, 128);
-    class_cookie = GET_PROPERTY(XCB_ATOM_WM_CLASS, 128);
-    role_cookie = GET_PROPERTY(A_WM_WINDOW_ROLE, 128);
-    startup_id_cookie = GET_PROPERTY(A__NET_STARTUP_ID, 512);
-    wm_hints_cookie = xcb_icccm_get_wm_hints(conn, window);
-    wm_normal_hints_cookie = xcb_icccm_get_wm_normal_hints(conn, window);
-    motif_wm_hints_cookie = GET_PROPERTY(A__MOTIF_WM_HINTS, 5 * sizeof(uint64_t));
-    wm_user_time_cookie = GET_PROPERTY(A__NET_WM_USER_TIME, UINT32_MAX);
-    wm_desktop_cookie = GET_PROPERTY(A__NET_WM_DESKTOP, UINT32_MAX);
-    wm_machine_cookie = GET_PROPERTY(XCB_ATOM_WM_CLIENT_MACHINE, UINT32_MAX);
-    wm_icon_cookie = GET_PROPERTY(A__NET_WM_ICON, UINT32_MAX);
+    pw->wm_type_cookie = GET_PROPERTY(A__NET_WM_WINDOW_TYPE, UINT32_MAX);
+    pw->strut_cookie = GET_PROPERTY(A__NET_WM_STRUT_PARTIAL, UINT32_MAX);
+    pw->state_cookie = GET_PROPERTY(A__NET_WM_STATE, UINT32_MAX);
+    pw->utf8_title_cookie = GET_PROPERTY(A__NET_WM_NAME, 128);
+    pw->leader_cookie = GET_PROPERTY(A_WM_CLIENT_LEADER, UINT32_MAX);
+    pw->transient_cookie = GET_PROPERTY(XCB_ATOM_WM_TRANSIENT_FOR, UINT32_MAX);
+    pw->title_cookie = GET_PROPERTY(XCB_ATOM_WM_NAME, 128);
+    pw->class_cookie = GET_PROPERTY(XCB_ATOM_WM_CLASS, 128);
+    pw->role_cookie = GET_PROPERTY(A_WM_WINDOW_ROLE, 128);
+    pw->startup_id_cookie = GET_PROPERTY(A__NET_STARTUP_ID, 512);
+    pw->wm_hints_cookie = xcb_icccm_get_wm_hints(conn, window);
+    pw->wm_normal_hints_cookie = xcb_icccm_get_wm_normal_hints(conn, window);
+    pw->motif_wm_hints_cookie = GET_PROPERTY(A__MOTIF_WM_HINTS, 5 * sizeof(uint64_t));
+    pw->wm_user_time_cookie = GET_PROPERTY(A__NET_WM_USER_TIME, UINT32_MAX);
+    pw->wm_desktop_cookie = GET_PROPERTY(A__NET_WM_DESKTOP, UINT32_MAX);
+    pw->wm_machine_cookie = GET_PROPERTY(XCB_ATOM_WM_CLIENT_MACHINE, UINT32_MAX);
+    pw->wm_icon_cookie = GET_PROPERTY(A__NET_WM_ICON, UINT32_MAX);
+
+#undef GET_PROPERTY
+
+    return true;
+}
+
+/*
+ * Returns true if manage_window() was called for the given window, but the
+ * window is not managed yet.
+ *
+ */
+bool manage_window_is_pending(xcb_window_t window) {
+    return hashmap_get(&pending_windows_by_id, HASHMAP_INT_KEY(window)) != NULL;
+}
+
+static xcb_get_property_reply_t *wm_icon_reply(struct pending_window *pw) {
+    if (pw->wm_icon_received) {
+        xcb_get_property_reply_t *reply = pw->wm_icon_reply;
+        pw->wm_icon_reply = NULL;
+        return reply;
+    }
+    return xcb_get_property_reply(conn, pw->wm_icon_cookie, NULL);
+}
+
+/*
+ * Discards the replies to all property requests of a window which will not be
+ * managed after all.
+ *
+ */
+static void discard_property_replies(struct pending_window *pw) {
+    xcb_discard_reply(conn, pw->wm_type_cookie.sequence);
+    xcb_discard_reply(conn, pw->strut_cookie.sequence);
+    xcb_discard_reply(conn, pw->state_cookie.sequence);
+    xcb_discard_reply(conn, pw->utf8_title_cookie.sequence);
+    xcb_discard_reply(conn, pw->leader_cookie.sequence);
+    xcb_discard_reply(conn, pw->transient_cookie.sequence);
+    xcb_discard_reply(conn, pw->title_cookie.sequence);
+    xcb_discard_reply(conn, pw->class_cookie.sequence);
+    xcb_discard_reply(conn, pw->role_cookie.sequence);
+    xcb_discard_reply(conn, pw->startup_id_cookie.sequence);
+    xcb_discard_reply(conn, pw->wm_hints_cookie.sequence);
+    xcb_discard_reply(conn, pw->wm_normal_hints_cookie.sequence);
+    xcb_discard_reply(conn, pw->motif_wm_hints_cookie.sequence);
+    xcb_discard_reply(conn, pw->wm_user_time_cookie.sequence);
+    xcb_discard_reply(conn, pw->wm_desktop_cookie.sequence);
+    xcb_discard_reply(conn, pw->wm_machine_cookie.sequence);
+    FREE(pw->wm_icon_reply);
+    if (!pw->wm_icon_received) {
+        xcb_discard_reply(conn, pw->wm_icon_cookie.sequence);
+    }
+}
+
+/*
+ * Does some sanity checks using the replies received for the window and then
+ * reparents it.
+ *
+ */
+static void manage_pending_window(struct pending_window *pw) {
+    const xcb_window_t window = pw->window;
+    DLOG("window 0x%08x\n", window);
+
+    xcb_get_geometry_reply_t *geom;
+    xcb_get_window_attributes_reply_t *attr = pw->attr;
+    xcb_generic_error_t *error;
+    uint32_t values[1];
+
+    /* The window is not going to be managed, see pending_window_attributes().
+     * Its event mask was not touched, so there is nothing to reset. */
+    if (attr == NULL) {
+        xcb_discard_reply(conn, pw->geom_cookie.sequence);
+        return;
+    }
+    pw->attr = NULL;
+
+    /* Get the initial geometry (position, size, …) */
+    if ((geom = xcb_get_geometry_reply(conn, pw->geom_cookie, 0)) == NULL) {
+        DLOG("could not get geometry\n");
+        xcb_discard_reply(conn, pw->event_mask_cookie.sequence);
+        discard_property_replies(pw);
+        goto out;
+    }
+
+    if ((error = xcb_request_check(conn, pw->event_mask_cookie)) != NULL) {
+        LOG("Could not change event mask, the window probably already disappeared.\n");
+        free(error);
+        discard_property_replies(pw);
+        goto geom_out;
+    }
 
     i3Window *cwindow = scalloc(1, sizeof(i3Window));
     cwindow->id = window;
@@ -207,31 +349,31 @@ void manage_window(xcb_window_t window, xcb_get_window_attributes_cookie_t cooki
     FREE(buttons);
 
     /* update as much information as possible so far (some replies may be NULL) */
-    window_update_class(cwindow, xcb_get_property_reply(conn, class_cookie, NULL));
-    window_update_name_legacy(cwindow, xcb_get_property_reply(conn, title_cookie, NULL));
-    window_update_name(cwindow, xcb_get_property_reply(conn, utf8_title_cookie, NULL));
-    window_update_icon(cwindow, xcb_get_property_reply(conn, wm_icon_cookie, NULL));
-    window_update_leader(cwindow, xcb_get_property_reply(conn, leader_cookie, NULL));
-    window_update_transient_for(cwindow, xcb_get_property_reply(conn, transient_cookie, NULL));
-    window_update_strut_partial(cwindow, xcb_get_property_reply(conn, strut_cookie, NULL));
-    window_update_role(cwindow, xcb_get_property_reply(conn, role_cookie, NULL));
+    window_update_class(cwindow, xcb_get_property_reply(conn, pw->class_cookie, NULL));
+    window_update_name_legacy(cwindow, xcb_get_property_reply(conn, pw->title_cookie, NULL));
+    window_update_name(cwindow, xcb_get_property_reply(conn, pw->utf8_title_cookie, NULL));
+    window_update_icon(cwindow, wm_icon_reply(pw));
+    window_update_leader(cwindow, xcb_get_property_reply(conn, pw->leader_cookie, NULL));
+    window_update_transient_for(cwindow, xcb_get_property_reply(conn, pw->transient_cookie, NULL));
+    window_update_strut_partial(cwindow, xcb_get_property_reply(conn, pw->strut_cookie, NULL));
+    window_update_role(cwindow, xcb_get_property_reply(conn, pw->role_cookie, NULL));
     bool urgency_hint;
-    window_update_hints(cwindow, xcb_get_property_reply(conn, wm_hints_cookie, NULL), &urgency_hint);
+    window_update_hints(cwindow, xcb_get_property_reply(conn, pw->wm_hints_cookie, NULL), &urgency_hint);
     border_style_t motif_border_style;
-    bool has_mwm_hints = window_update_motif_hints(cwindow, xcb_get_property_reply(conn, motif_wm_hints_cookie, NULL), &motif_border_style);
-    window_update_normal_hints(cwindow, xcb_get_property_reply(conn, wm_normal_hints_cookie, NULL), geom);
-    window_update_machine(cwindow, xcb_get_property_reply(conn, wm_machine_cookie, NULL));
-    xcb_get_property_reply_t *type_reply = xcb_get_property_reply(conn, wm_type_cookie, NULL);
-    xcb_get_property_reply_t *state_reply = xcb_get_property_reply(conn, state_cookie, NULL);
+    bool has_mwm_hints = window_update_motif_hints(cwindow, xcb_get_property_reply(conn, pw->motif_wm_hints_cookie, NULL), &motif_border_style);
+    window_update_normal_hints(cwindow, xcb_get_property_reply(conn, pw->wm_normal_hints_cookie, NULL), geom);
+    window_update_machine(cwindow, xcb_get_property_reply(conn, pw->wm_machine_cookie, NULL));
+    xcb_get_property_reply_t *type_reply = xcb_get_property_reply(conn, pw->wm_type_cookie, NULL);
+    xcb_get_property_reply_t *state_reply = xcb_get_property_reply(conn, pw->state_cookie, NULL);
 
     xcb_get_property_reply_t *startup_id_reply;
-    startup_id_reply = xcb_get_property_reply(conn, startup_id_cookie, NULL);
+    startup_id_reply = xcb_get_property_reply(conn, pw->startup_id_cookie, NULL);
     char *startup_ws = startup_workspace_for_window(cwindow, startup_id_reply);
     DLOG("startup workspace = %s\n", startup_ws);
 
     /* Get _NET_WM_DESKTOP if it was set. */
     xcb_get_property_reply_t *wm_desktop_reply;
-    wm_desktop_reply = xcb_get_property_reply(conn, wm_desktop_cookie, NULL);
+    wm_desktop_reply = xcb_get_property_reply(conn, pw->wm_desktop_cookie, NULL);
     cwindow->wm_desktop = NET_WM_DESKTOP_NONE;
     if (wm_desktop_reply != NULL && xcb_get_property_value_length(wm_desktop_reply) != 0) {
         uint32_t *wm_desktops = xcb_get_property_value(wm_desktop_reply);
@@ -389,10 +531,12 @@ void manage_window(xcb_window_t window, xcb_get_window_attributes_cookie_t cooki
     }
     xcb_window_t old_frame = XCB_NONE;
     if (nc->window != cwindow && nc->window != NULL) {
-        window_free(nc->window);
+        i3Window *placeholder = nc->window;
+        con_set_window(nc, NULL);
+        window_free(placeholder);
         old_frame = _match_depth(cwindow, nc);
     }
-    nc->window = cwindow;
+    con_set_window(nc, cwindow);
     x_reinit(nc);
 
     nc->border_width = geom->border_width;
@@ -550,8 +694,10 @@ void manage_window(xcb_window_t window, xcb_get_window_attributes_cookie_t cooki
     xcb_change_window_attributes(conn, window, XCB_CW_EVENT_MASK, values);
 
     xcb_void_cookie_t rcookie = xcb_reparent_window_checked(conn, window, nc->frame.id, 0, 0);
-    if (xcb_request_check(conn, rcookie) != NULL) {
+    if ((error = xcb_request_check(conn, rcookie)) != NULL) {
         LOG("Could not reparent the window, aborting\n");
+        free(error);
+        xcb_discard_reply(conn, pw->wm_user_time_cookie.sequence);
         goto geom_out;
     }
 
@@ -632,7 +778,7 @@ void manage_window(xcb_window_t window, xcb_get_window_attributes_cookie_t cooki
         DLOG("Checking con = %p for _NET_WM_USER_TIME.\n", nc);
 
         uint32_t *wm_user_time;
-        xcb_get_property_reply_t *wm_user_time_reply = xcb_get_property_reply(conn, wm_user_time_cookie, NULL);
+        xcb_get_property_reply_t *wm_user_time_reply = xcb_get_property_reply(conn, pw->wm_user_time_cookie, NULL);
         if (wm_user_time_reply != NULL && xcb_get_property_value_length(wm_user_time_reply) != 0 &&
             (wm_user_time = xcb_get_property_value(wm_user_time_reply)) &&
             wm_user_time[0] == 0) {
@@ -642,7 +788,7 @@ void manage_window(xcb_window_t window, xcb_get_window_attributes_cookie_t cooki
 
         FREE(wm_user_time_reply);
     } else {
-        xcb_discard_reply(conn, wm_user_time_cookie.sequence);
+        xcb_discard_reply(conn, pw->wm_user_time_cookie.sequence);
     }
 
     if (set_focus) {
@@ -663,12 +809,13 @@ void manage_window(xcb_window_t window, xcb_get_window_attributes_cookie_t cooki
         con_activate(nc);
     }
 
-    tree_render();
-
     /* Destroy the old frame if we had to reframe the container. This needs to be done
      * after rendering in order to prevent the background from flickering in its place. */
     if (old_frame != XCB_NONE) {
+        tree_render();
         xcb_destroy_window(conn, old_frame);
+    } else {
+        tree_render_later();
     }
 
     /* Windows might get managed with the urgency hint already set (Pidgin is
@@ -690,6 +837,55 @@ out:
     free(attr);
 }
 
+/*
+ * Manages the windows for which manage_window() was called, in the same order.
+ *
+ * If block is false, this stops at the first window whose replies have not
+ * been received yet, so that the event loop is not blocked while waiting for
+ * the X server (and the client). Returns true if any window was handled.
+ *
+ */
+bool manage_pending_windows(bool block) {
+    bool handled = false;
+    struct pending_window *pw;
+
+    /* Request the properties of every window whose attributes arrived, not
+     * only those of the first one, so that the round trips overlap. */
+    TAILQ_FOREACH (pw, &pending_windows, pending_windows) {
+        if (!pw->attr_received && !pending_window_attributes(pw, block)) {
+            break;
+        }
+    }
+
+    while ((pw = TAILQ_FIRST(&pending_windows)) != NULL) {
+        if (!pw->attr_received) {
+            break;
+        }
+        if (!block && pw->attr != NULL && !pw->wm_icon_received) {
+            void *reply = NULL;
+            xcb_generic_error_t *error = NULL;
+            if (!xcb_poll_for_reply(conn, pw->wm_icon_cookie.sequence, &reply, &error)) {
+                break;
+            }
+            free(error);
+            pw->wm_icon_received = true;
+            pw->wm_icon_reply = reply;
+        }
+
+        TAILQ_REMOVE(&pending_windows, pw, pending_windows);
+        hashmap_remove(&pending_windows_by_id, HASHMAP_INT_KEY(pw->window));
+
+        tree_bump_generation();
+        const uint64_t trace_start = TRACE_BEGIN();
+        manage_pending_window(pw);
+        TRACE_END(trace_start, "manage", "manage_window");
+        FREE(pw->wm_icon_reply);
+        free(pw);
+        handled = true;
+    }
+    return handled;
+}
+
 static Con *placeholder_for_con(Con *con) {
     /* Make sure this windows hasn't already been swallowed. */
     if (con->window->swallowed) {
@@ -727,7 +923,9 @@ Con *remanage_window(Con *con) {
     } else {
         _remove_matches(nc);
     }
-    window_free(nc->window);
+    i3Window *placeholder = nc->window;
+    con_set_window(nc, NULL);
+    window_free(placeholder);
 
     xcb_window_t old_frame = _match_depth(con->window, nc);
 
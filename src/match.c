@@ -11,6 +11,7 @@
  * match_matches_window() to find the windows affected by this command.
  *
  */
+#define LOG_CATEGORY LOG_MATCH
 #include "all.h"
 
 /* From sys/time.h, not sure if it’s available on all systems. */
@@ -272,6 +273,48 @@ bool match_matches_window(Match *match, i3Window *window) {
     return true;
 }
 
+/*
+ * Check if a match data structure matches the given container, like the
+ * criteria of a command. 'cons_by_mark_match' holds the containers with a
+ * mark matching the mark regex (see con_by_mark_regex()). Containers without a
+ * window only match criteria which do not refer to windows (con_id, con_mark).
+ *
+ */
+bool match_matches_con(Match *match, Con *con, struct hashmap *cons_by_mark_match) {
+    /* We use this flag to prevent matching on window-less containers if
+     * only window-specific criteria were specified. */
+    bool accept_match = false;
+
+    if (match->con_id != NULL) {
+        if (match->con_id != con) {
+            DLOG("con_id does not match.\n");
+            return false;
+        }
+        DLOG("con_id matched.\n");
+        accept_match = true;
+    }
+
+    if (match->mark != NULL && !TAILQ_EMPTY(&(con->marks_head))) {
+        if (hashmap_get(cons_by_mark_match, con) == NULL) {
+            DLOG("mark does not match.\n");
+            return false;
+        }
+        DLOG("match by mark\n");
+        accept_match = true;
+    }
+
+    if (con->window != NULL) {
+        if (!match_matches_window(match, con->window)) {
+            DLOG("doesn't match\n");
+            return false;
+        }
+        DLOG("matches window!\n");
+        accept_match = true;
+    }
+
+    return accept_match;
+}
+
 /*
  * Frees the given match. It must not be used afterwards!
  *
@@ -333,6 +333,7 @@ void tree_move(Con *con, direction_t direction) {
 
                 /* redraw parents to ensure all parent split container titles are updated correctly */
                 con_force_split_parents_redraw(con);
+                render_con_changed(con);
 
                 ipc_send_window_event("move", con);
                 return;
@@ -9,6 +9,7 @@
  * (take your time to read it completely, it answers all questions).
  *
  */
+#define LOG_CATEGORY LOG_RANDR
 #include "all.h"
 
 #include <time.h>
@@ -571,6 +572,7 @@ static void output_change_mode(xcb_connection_t *conn, Output *output) {
                 }
                 DLOG("Setting child [%d,%s]'s layout to %d.\n", child->num, child->name, child->layout);
             }
+            render_con_changed(workspace);
         }
     }
 }
@@ -1057,9 +1059,10 @@ void randr_query_outputs(void) {
         workspace_show(ws);
     }
 
-    /* render_layout flushes */
     ewmh_update_desktop_properties();
-    tree_render();
+    tree_render_later();
+    /* Workspaces might have moved to other outputs. */
+    tree_patch_invalidate();
 
     FREE(primary);
 }
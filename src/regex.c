@@ -7,6 +7,7 @@
  * regex.c: Interface to libPCRE (perl compatible regular expressions).
  *
  */
+#define LOG_CATEGORY LOG_MATCH
 #include "all.h"
 
 /*
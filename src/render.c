@@ -8,11 +8,13 @@
  *           various rects. Needs to be pushed to X11 (see x.c) to be visible.
  *
  */
+#define LOG_CATEGORY LOG_RENDER
 #include "all.h"
 
 #include <math.h>
 
 /* Forward declarations */
+static void render_con_internal(Con *con);
 static int *precalculate_sizes(Con *con, render_params *p);
 static void render_root(Con *con, Con *fullscreen);
 static void render_output(Con *con);
@@ -21,6 +23,471 @@ static void render_con_stacked(Con *con, Con *child, render_params *p, int i);
 static void render_con_tabbed(Con *con, Con *child, render_params *p, int i);
 static void render_con_dockarea(Con *con, Con *child, render_params *p);
 
+/* Set by --verify-render: every incremental render of the whole tree is
+ * followed by a full render, and the results are compared. Tree patches are
+ * verified as well (see tree_patch.c). */
+bool render_verify = false;
+
+/*
+ * Incremental rendering: Every change of an input of the layout of a
+ * workspace (the containers attached to it, their layout, percent, borders,
+ * fullscreen mode, focus order and windows) is reported to
+ * render_con_changed() where it happens, which marks the workspace as
+ * changed. When rendering the whole tree, render_con() lays out the changed
+ * workspaces only. For the others, it keeps the previous rects and replays
+ * the side effects of the last render (marking containers as mapped and
+ * raising them, in the same order). Besides the flag, only the workspace rect
+ * and gaps, the relevant configuration and the rects of the floating
+ * containers are compared, since they are changed in too many places
+ * (dragging, resizing, ConfigureRequests, …) to report each of them.
+ *
+ */
+
+/* A side effect of render_con(): a container was marked as mapped or raised. */
+struct render_step {
+    con_handle_t handle;
+    bool raise;
+};
+
+struct render_steps {
+    struct render_step *steps;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+/* A floating container of a workspace and its rect when it was rendered. */
+struct render_floating {
+    con_handle_t handle;
+    Rect rect;
+};
+
+/* Per-workspace cache, see Con->render_cache. */
+struct render_cache {
+    /* Cleared by render_con_changed(). */
+    bool valid;
+    uint64_t config_generation;
+
+    /* The rect assigned to the workspace by its parent, and the rect after
+     * applying the gaps. */
+    Rect input_rect;
+    Rect output_rect;
+    gaps_t gaps;
+
+    struct render_floating *floating_rects;
+    uint32_t num_floating;
+    uint32_t floating_capacity;
+
+    /* Side effects while rendering the tiling containers and (in
+     * render_root()) the floating containers of the workspace. */
+    struct render_steps tiling;
+    struct render_steps floating;
+
+    /* Number of the render pass in which the tiling containers were last
+     * rendered (or replayed), and whether they were replayed. */
+    uint64_t pass;
+    bool replayed;
+
+    /* Set by mark_unmapped() if the containers of the workspace kept their
+     * mapped state for the current pass. */
+    bool kept_mapped;
+};
+
+/* The configuration options which influence rendering. */
+struct render_config {
+    int deco_height;
+    gaps_t gaps;
+    int smart_gaps;
+    int hide_edge_borders;
+    int popup_during_fullscreen;
+    int default_border_width;
+    int default_floating_border_width;
+};
+
+static struct render_config last_config;
+static uint64_t config_generation;
+
+/* Nesting depth of render_con() calls. */
+static int render_depth;
+/* Whether the current (outermost) render_con() call renders the whole tree
+ * and thus may use and update the workspace caches. */
+static bool cache_pass;
+static uint64_t pass;
+/* The number of the last pass which rendered the whole tree. */
+static uint64_t last_cache_pass;
+
+/* Workspaces which were rendered (not replayed) in the current pass. Their
+ * caches are updated at the end of the pass. */
+static Con **rendered_workspaces;
+static uint32_t num_rendered_workspaces;
+static uint32_t rendered_workspaces_capacity;
+
+/* Workspaces whose containers kept their mapped state in mark_unmapped(). */
+static Con **kept_workspaces;
+static uint32_t num_kept_workspaces;
+static uint32_t kept_workspaces_capacity;
+
+/* The steps of the workspace which is currently being rendered, if any. */
+static struct render_steps *recording;
+
+/* All containers raised in the current pass, for --verify-render. */
+static struct render_steps *raised;
+
+static void append_step(struct render_steps *steps, Con *con, bool raise) {
+    if (steps->count == steps->capacity) {
+        steps->capacity = (steps->capacity == 0 ? 32 : steps->capacity * 2);
+        steps->steps = srealloc(steps->steps, steps->capacity * sizeof(struct render_step));
+    }
+    steps->steps[steps->count++] = (struct render_step){con->handle, raise};
+}
+
+static void raise_con(Con *con) {
+    x_raise_con(con);
+    if (recording != NULL) {
+        append_step(recording, con, true);
+    }
+    if (raised != NULL) {
+        append_step(raised, con, true);
+    }
+}
+
+static void set_mapped(Con *con) {
+    con->mapped = true;
+    if (recording != NULL) {
+        append_step(recording, con, false);
+    }
+}
+
+static void replay_steps(struct render_steps *steps) {
+    for (uint32_t i = 0; i < steps->count; i++) {
+        Con *con = con_by_handle(steps->steps[i].handle);
+        if (con == NULL) {
+            ELOG("BUG: container of a cached render step is gone\n");
+            assert(false);
+            continue;
+        }
+        if (steps->steps[i].raise) {
+            raise_con(con);
+        } else {
+            set_mapped(con);
+        }
+    }
+}
+
+static void update_config_generation(void) {
+    struct render_config current;
+    memset(&current, 0, sizeof(current));
+    current.deco_height = render_deco_height();
+    current.gaps = config.gaps;
+    current.smart_gaps = config.smart_gaps;
+    current.hide_edge_borders = config.hide_edge_borders;
+    current.popup_during_fullscreen = config.popup_during_fullscreen;
+    current.default_border_width = config.default_border_width;
+    current.default_floating_border_width = config.default_floating_border_width;
+
+    if (config_generation == 0 || memcmp(&current, &last_config, sizeof(current)) != 0) {
+        last_config = current;
+        config_generation++;
+    }
+}
+
+/*
+ * Marks the workspace of the given container as changed, so that the next
+ * render lays it out again instead of keeping its previous layout, and
+ * reports the change to tree_patch_con_changed(). Called wherever an input
+ * of the layout changes (see render.c).
+ *
+ */
+void render_con_changed(Con *con) {
+    Con *ws = con_get_workspace(con);
+    if (ws != NULL && ws->render_cache != NULL) {
+        ws->render_cache->valid = false;
+    }
+    tree_patch_con_changed(con);
+}
+
+/*
+ * Marks all workspaces as changed. Used for changes which influence the
+ * layout of other workspaces than their own, like a container entering or
+ * leaving global fullscreen mode or a changed WM_TRANSIENT_FOR (which decides
+ * whether a floating window is shown above a fullscreen window).
+ *
+ */
+void render_invalidate_all(void) {
+    config_generation++;
+}
+
+static bool floating_unchanged(Con *ws, struct render_cache *cache) {
+    uint32_t pos = 0;
+    Con *child;
+    TAILQ_FOREACH (child, &(ws->floating_head), floating_windows) {
+        if (pos >= cache->num_floating) {
+            return false;
+        }
+        struct render_floating *f = &(cache->floating_rects[pos++]);
+        if (f->handle.slot != child->handle.slot ||
+            f->handle.generation != child->handle.generation ||
+            !rect_equals(f->rect, child->rect)) {
+            return false;
+        }
+    }
+    return pos == cache->num_floating;
+}
+
+/*
+ * Returns true if nothing which influences the layout of the workspace changed
+ * since it was last rendered.
+ *
+ */
+static bool workspace_unchanged(Con *ws) {
+    struct render_cache *cache = ws->render_cache;
+    return cache != NULL && cache->valid &&
+           cache->config_generation == config_generation &&
+           rect_equals(cache->input_rect, ws->rect) &&
+           memcmp(&(cache->gaps), &(ws->gaps), sizeof(gaps_t)) == 0 &&
+           floating_unchanged(ws, cache);
+}
+
+/*
+ * Stores the inputs of a workspace which was rendered in the current pass.
+ *
+ */
+static void store_workspace_inputs(Con *ws) {
+    struct render_cache *cache = ws->render_cache;
+    cache->num_floating = 0;
+    Con *child;
+    TAILQ_FOREACH (child, &(ws->floating_head), floating_windows) {
+        if (cache->num_floating == cache->floating_capacity) {
+            cache->floating_capacity = (cache->floating_capacity == 0 ? 4 : cache->floating_capacity * 2);
+            cache->floating_rects = srealloc(cache->floating_rects, cache->floating_capacity * sizeof(struct render_floating));
+        }
+        cache->floating_rects[cache->num_floating++] = (struct render_floating){child->handle, child->rect};
+    }
+    cache->output_rect = ws->rect;
+    cache->gaps = ws->gaps;
+    cache->config_generation = config_generation;
+    cache->valid = true;
+}
+
+/*
+ * Frees the render cache of the given container (if any).
+ *
+ */
+void render_cache_free(Con *con) {
+    struct render_cache *cache = con->render_cache;
+    if (cache == NULL) {
+        return;
+    }
+    free(cache->floating_rects);
+    free(cache->tiling.steps);
+    free(cache->floating.steps);
+    FREE(con->render_cache);
+}
+
+static void unmap_subtree(Con *con) {
+    Con *current;
+
+    con->mapped = false;
+    TAILQ_FOREACH (current, &(con->nodes_head), nodes) {
+        unmap_subtree(current);
+    }
+    if (con->type == CT_WORKSPACE) {
+        /* We need to call unmap_subtree on floating nodes as well since we can
+         * make containers floating. */
+        TAILQ_FOREACH (current, &(con->floating_head), floating_windows) {
+            unmap_subtree(current);
+        }
+    }
+}
+
+/*
+ * Marks the given container and its children as unmapped before rendering
+ * the tree, which maps the visible ones again.
+ *
+ * The containers of a workspace which did not change since the last render of
+ * the whole tree (and was rendered in it) keep their mapped state: the next
+ * render will most likely replay the previous one, which maps the same
+ * containers. If it does not, render_con() unmaps them after all.
+ *
+ */
+void mark_unmapped(Con *con) {
+    if (con->type == CT_WORKSPACE) {
+        update_config_generation();
+        struct render_cache *cache = con->render_cache;
+        if (cache != NULL && cache->valid &&
+            cache->config_generation == config_generation &&
+            cache->pass == last_cache_pass) {
+            cache->kept_mapped = true;
+            if (num_kept_workspaces == kept_workspaces_capacity) {
+                kept_workspaces_capacity = (kept_workspaces_capacity == 0 ? 8 : kept_workspaces_capacity * 2);
+                kept_workspaces = srealloc(kept_workspaces, kept_workspaces_capacity * sizeof(Con *));
+            }
+            kept_workspaces[num_kept_workspaces++] = con;
+            return;
+        }
+    }
+
+    Con *current;
+    con->mapped = false;
+    TAILQ_FOREACH (current, &(con->nodes_head), nodes) {
+        mark_unmapped(current);
+    }
+    if (con->type == CT_WORKSPACE) {
+        /* We need to call mark_unmapped on floating nodes as well since we can
+         * make containers floating. */
+        TAILQ_FOREACH (current, &(con->floating_head), floating_windows) {
+            mark_unmapped(current);
+        }
+    }
+}
+
+/*
+ * Unmaps the containers of the workspaces which kept their mapped state in
+ * mark_unmapped(), but were not replayed (or not rendered at all, e.g.
+ * because another workspace is visible now).
+ *
+ */
+static void unmap_kept_workspaces(void) {
+    for (uint32_t i = 0; i < num_kept_workspaces; i++) {
+        Con *ws = kept_workspaces[i];
+        struct render_cache *cache = ws->render_cache;
+        if (!cache->kept_mapped) {
+            continue;
+        }
+        cache->kept_mapped = false;
+        if (cache->pass != pass) {
+            unmap_subtree(ws);
+        }
+    }
+    num_kept_workspaces = 0;
+}
+
+/*
+ * Renders the tiling containers of a workspace, or replays the previous render
+ * if the workspace did not change.
+ *
+ */
+static void render_workspace(Con *ws) {
+    if (ws->render_cache == NULL) {
+        ws->render_cache = scalloc(1, sizeof(struct render_cache));
+    }
+    struct render_cache *cache = ws->render_cache;
+
+    if (workspace_unchanged(ws)) {
+        DLOG("Workspace %p / %s did not change, keeping its layout\n", ws, ws->name);
+        ws->rect = cache->output_rect;
+        replay_steps(&(cache->tiling));
+        cache->pass = pass;
+        cache->replayed = true;
+        tree_render_stats.workspaces_replayed++;
+        return;
+    }
+
+    if (cache->kept_mapped) {
+        /* mark_unmapped() expected this workspace to be replayed. */
+        cache->kept_mapped = false;
+        unmap_subtree(ws);
+    }
+
+    cache->valid = false;
+    cache->input_rect = ws->rect;
+    cache->tiling.count = 0;
+    cache->floating.count = 0;
+    cache->pass = pass;
+    cache->replayed = false;
+    tree_render_stats.workspaces_rendered++;
+    tree_patch_con_changed(ws);
+
+    if (num_rendered_workspaces == rendered_workspaces_capacity) {
+        rendered_workspaces_capacity = (rendered_workspaces_capacity == 0 ? 8 : rendered_workspaces_capacity * 2);
+        rendered_workspaces = srealloc(rendered_workspaces, rendered_workspaces_capacity * sizeof(Con *));
+    }
+    rendered_workspaces[num_rendered_workspaces++] = ws;
+
+    struct render_steps *outer = recording;
+    recording = &(cache->tiling);
+    render_con_internal(ws);
+    recording = outer;
+}
+
+/*
+ * Saves the rects and mapped state of all containers, so that the result of
+ * an incremental render can be compared to a full render.
+ *
+ */
+struct render_result {
+    Rect rect;
+    Rect window_rect;
+    Rect deco_rect;
+    bool mapped;
+};
+
+static struct render_result *save_render_results(void) {
+    uint32_t count = 0;
+    Con *con;
+    TAILQ_FOREACH (con, &all_cons, all_cons) {
+        count++;
+    }
+    struct render_result *results = smalloc((count + 1) * sizeof(struct render_result));
+    uint32_t i = 0;
+    TAILQ_FOREACH (con, &all_cons, all_cons) {
+        results[i++] = (struct render_result){con->rect, con->window_rect, con->deco_rect, con->mapped};
+    }
+    return results;
+}
+
+/*
+ * Renders the whole tree a second time, without using the workspace caches,
+ * and aborts if the result differs from the incremental render.
+ *
+ */
+static void verify_render(Con *con, struct render_steps *incremental_raised, bool *mapped_before) {
+    struct render_result *incremental = save_render_results();
+
+    uint32_t i = 0;
+    Con *current;
+    TAILQ_FOREACH (current, &all_cons, all_cons) {
+        current->mapped = mapped_before[i++];
+    }
+
+    struct render_steps full_raised = {NULL, 0, 0};
+    raised = &full_raised;
+    cache_pass = false;
+    render_depth++;
+    render_con_internal(con);
+    render_depth--;
+    raised = NULL;
+
+    bool equal = (incremental_raised->count == full_raised.count);
+    for (uint32_t j = 0; equal && j < full_raised.count; j++) {
+        equal = (incremental_raised->steps[j].handle.slot == full_raised.steps[j].handle.slot &&
+                 incremental_raised->steps[j].handle.generation == full_raised.steps[j].handle.generation);
+    }
+    if (!equal) {
+        ELOG("BUG: incremental render raised containers in a different order than a full render\n");
+        assert(false);
+    }
+
+    i = 0;
+    TAILQ_FOREACH (current, &all_cons, all_cons) {
+        struct render_result *r = &incremental[i++];
+        if (!rect_equals(r->rect, current->rect) ||
+            !rect_equals(r->window_rect, current->window_rect) ||
+            !rect_equals(r->deco_rect, current->deco_rect) ||
+            r->mapped != current->mapped) {
+            ELOG("BUG: incremental render of con %p / %s differs from a full render: "
+                 "rect (%d, %d, %d, %d) vs. (%d, %d, %d, %d), mapped %d vs. %d\n",
+                 current, current->name,
+                 r->rect.x, r->rect.y, r->rect.width, r->rect.height,
+                 current->rect.x, current->rect.y, current->rect.width, current->rect.height,
+                 r->mapped, current->mapped);
+            assert(false);
+        }
+    }
+
+    free(full_raised.steps);
+    free(incremental);
+}
+
 /*
  * Returns the height for the decorations
  */
@@ -41,6 +508,72 @@ int render_deco_height(void) {
  *
  */
 void render_con(Con *con) {
+    if (render_depth > 0) {
+        render_con_internal(con);
+        return;
+    }
+
+    const uint64_t trace_start = TRACE_BEGIN();
+
+    /* Only renders of the whole tree use (and update) the workspace caches,
+     * because only those render the floating containers as well. */
+    cache_pass = (con == croot);
+    pass++;
+    num_rendered_workspaces = 0;
+    if (cache_pass) {
+        update_config_generation();
+        last_cache_pass = pass;
+    }
+
+    const bool verify = (render_verify && cache_pass);
+    bool *mapped_before = NULL;
+    struct render_steps incremental_raised = {NULL, 0, 0};
+    if (verify) {
+        uint32_t count = 0;
+        Con *current;
+        TAILQ_FOREACH (current, &all_cons, all_cons) {
+            count++;
+        }
+        mapped_before = smalloc((count + 1) * sizeof(bool));
+        count = 0;
+        TAILQ_FOREACH (current, &all_cons, all_cons) {
+            /* The full render starts out like a render without any kept
+             * mapped state (see mark_unmapped()). */
+            Con *ws = con_get_workspace(current);
+            const bool kept = (ws != NULL && ws->render_cache != NULL && ws->render_cache->kept_mapped);
+            mapped_before[count++] = current->mapped && !kept;
+        }
+        raised = &incremental_raised;
+    }
+
+    render_depth++;
+    render_con_internal(con);
+    render_depth--;
+    raised = NULL;
+
+    if (cache_pass) {
+        unmap_kept_workspaces();
+        for (uint32_t i = 0; i < num_rendered_workspaces; i++) {
+            store_workspace_inputs(rendered_workspaces[i]);
+        }
+        /* The rects on the workspaces which were laid out might have changed
+         * (they were reported to tree_patch_con_changed()). A render which
+         * only replays workspaces changes nothing. */
+        if (num_rendered_workspaces > 0) {
+            tree_bump_generation();
+        }
+    }
+
+    if (verify) {
+        verify_render(con, &incremental_raised, mapped_before);
+        free(incremental_raised.steps);
+        free(mapped_before);
+    }
+
+    TRACE_END(trace_start, "render", "render_con");
+}
+
+static void render_con_internal(Con *con) {
     render_params params = {
         .rect = con->rect,
         .x = con->rect.x,
@@ -86,7 +619,7 @@ void render_con(Con *con) {
     }
 
     int i = 0;
-    con->mapped = true;
+    set_mapped(con);
 
     /* if this container contains a window, set the coordinates */
     if (con->window) {
@@ -131,8 +664,12 @@ void render_con(Con *con) {
     }
     if (fullscreen) {
         fullscreen->rect = params.rect;
-        x_raise_con(fullscreen);
-        render_con(fullscreen);
+        raise_con(fullscreen);
+        if (cache_pass && fullscreen->type == CT_WORKSPACE) {
+            render_workspace(fullscreen);
+        } else {
+            render_con_internal(fullscreen);
+        }
         /* Fullscreen containers are either global (underneath the CT_ROOT
          * container) or per-output (underneath the CT_CONTENT container). For
          * global fullscreen containers, we cannot abort rendering here yet,
@@ -177,8 +714,8 @@ void render_con(Con *con) {
 
             DLOG("child at (%d, %d) with (%d x %d)\n",
                  child->rect.x, child->rect.y, child->rect.width, child->rect.height);
-            x_raise_con(child);
-            render_con(child);
+            raise_con(child);
+            render_con_internal(child);
 
             /* render_con_split() sets the deco_rect width based on the rect
              * width, but the render_con() call updates the rect width by
@@ -197,14 +734,14 @@ void render_con(Con *con) {
         /* in a stacking or tabbed container, we ensure the focused client is raised */
         if (con->layout == L_STACKED || con->layout == L_TABBED) {
             TAILQ_FOREACH_REVERSE (child, &(con->focus_head), focus_head, focused) {
-                x_raise_con(child);
+                raise_con(child);
             }
             if ((child = TAILQ_FIRST(&(con->focus_head)))) {
                 /* By rendering the stacked container again, we handle the case
                  * that we have a non-leaf-container inside the stack. In that
                  * case, the children of the non-leaf-container need to be
                  * raised as well. */
-                render_con(child);
+                render_con_internal(child);
             }
 
             if (params.children != 1) {
@@ -212,7 +749,7 @@ void render_con(Con *con) {
                  * decoration on top of every stack window. That way, when a
                  * new window is opened in the stack, the old window will not
                  * obscure part of the decoration (it’s unmapped afterwards). */
-                x_raise_con(con);
+                raise_con(con);
             }
         }
     }
@@ -254,7 +791,7 @@ static void render_root(Con *con, Con *fullscreen) {
     Con *output;
     if (!fullscreen) {
         TAILQ_FOREACH (output, &(con->nodes_head), nodes) {
-            render_con(output);
+            render_con_internal(output);
         }
     }
 
@@ -275,6 +812,19 @@ static void render_root(Con *con, Con *fullscreen) {
         }
         Con *workspace = TAILQ_FIRST(&(content->focus_head));
         Con *fullscreen = con_get_fullscreen_covering_ws(workspace);
+
+        /* If the tiling containers of the workspace were rendered in this
+         * pass, so are its floating containers: either by replaying the
+         * previous render or while recording the side effects. */
+        struct render_cache *cache = workspace->render_cache;
+        if (cache_pass && cache != NULL && cache->pass == pass) {
+            if (cache->replayed) {
+                replay_steps(&(cache->floating));
+                continue;
+            }
+            recording = &(cache->floating);
+        }
+
         Con *child;
         TAILQ_FOREACH (child, &(workspace->floating_head), floating_windows) {
             if (fullscreen != NULL) {
@@ -298,9 +848,10 @@ static void render_root(Con *con, Con *fullscreen) {
             }
             DLOG("floating child at (%d,%d) with %d x %d\n",
                  child->rect.x, child->rect.y, child->rect.width, child->rect.height);
-            x_raise_con(child);
-            render_con(child);
+            raise_con(child);
+            render_con_internal(child);
         }
+        recording = NULL;
     }
 }
 
@@ -348,8 +899,8 @@ static void render_output(Con *con) {
     Con *fullscreen = con_get_fullscreen_con(ws, CF_OUTPUT);
     if (fullscreen) {
         fullscreen->rect = con->rect;
-        x_raise_con(fullscreen);
-        render_con(fullscreen);
+        raise_con(fullscreen);
+        render_con_internal(fullscreen);
         return;
     }
 
@@ -390,8 +941,8 @@ static void render_output(Con *con) {
 
         DLOG("child at (%d, %d) with (%d x %d)\n",
              child->rect.x, child->rect.y, child->rect.width, child->rect.height);
-        x_raise_con(child);
-        render_con(child);
+        raise_con(child);
+        render_con_internal(child);
     }
 }
 
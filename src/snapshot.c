@@ -0,0 +1,345 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * snapshot.c: Publishes a compact snapshot of the state (outputs,
+ *             workspaces and windows) in a shared memory segment whenever it
+ *             was pushed to X11, which local clients can read without IPC
+ *             round trips.
+ *
+ */
+#include "all.h"
+
+#include "i3/snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+char *snapshot_path = NULL;
+
+static int snapshot_fd = -1;
+static uint8_t *snapshot_map = NULL;
+static size_t snapshot_map_size = 0;
+
+/* Whether the state changed since the last snapshot was written. */
+static bool publish_requested = false;
+
+/* The records of the next snapshot, which are collected before the shared
+ * memory is written, so that i3 writes (and readers have to wait) only for
+ * the duration of a memcpy(). */
+static struct {
+    i3_snapshot_output *outputs;
+    uint32_t num_outputs;
+    uint32_t outputs_capacity;
+
+    i3_snapshot_workspace *workspaces;
+    uint32_t num_workspaces;
+    uint32_t workspaces_capacity;
+
+    i3_snapshot_window *windows;
+    uint32_t num_windows;
+    uint32_t windows_capacity;
+
+    char *strings;
+    uint32_t strings_size;
+    uint32_t strings_capacity;
+} next;
+
+#define APPEND(array, num, capacity)                                    \
+    do {                                                                \
+        if ((num) == (capacity)) {                                      \
+            (capacity) = ((capacity) == 0 ? 16 : (capacity) * 2);       \
+            (array) = srealloc((array), (capacity) * sizeof(*(array))); \
+        }                                                               \
+        memset(&((array)[(num)]), 0, sizeof(*(array)));                 \
+    } while (0)
+
+/*
+ * Adds a string to the string table and returns its offset. The empty
+ * string is always at offset 0.
+ *
+ */
+static uint32_t add_string(const char *str) {
+    if (str == NULL || *str == '\0') {
+        return 0;
+    }
+    const uint32_t len = strlen(str) + 1;
+    if (next.strings_size + len > next.strings_capacity) {
+        while (next.strings_size + len > next.strings_capacity) {
+            next.strings_capacity *= 2;
+        }
+        next.strings = srealloc(next.strings, next.strings_capacity);
+    }
+    const uint32_t offset = next.strings_size;
+    memcpy(next.strings + offset, str, len);
+    next.strings_size += len;
+    return offset;
+}
+
+static i3_snapshot_rect snapshot_rect(Rect r) {
+    return (i3_snapshot_rect){
+        .x = (int32_t)r.x,
+        .y = (int32_t)r.y,
+        .width = r.width,
+        .height = r.height,
+    };
+}
+
+/*
+ * Adds the windows in the subtree of con (tiling and floating) in tree order.
+ *
+ */
+static void add_windows(Con *con, uint32_t workspace) {
+    if (con->window != NULL) {
+        APPEND(next.windows, next.num_windows, next.windows_capacity);
+        i3_snapshot_window *window = &(next.windows[next.num_windows++]);
+        window->id = (uintptr_t)con;
+        window->window = con->window->id;
+        window->workspace = workspace;
+        window->class_class = add_string(con->window->class_class);
+        window->class_instance = add_string(con->window->class_instance);
+        window->title = add_string(con->window->name ? i3string_as_utf8(con->window->name) : NULL);
+        window->flags = ((con == focused ? I3_SNAPSHOT_FOCUSED : 0) |
+                         (con->urgent ? I3_SNAPSHOT_URGENT : 0) |
+                         (con_is_floating(con) ? I3_SNAPSHOT_FLOATING : 0) |
+                         (con->fullscreen_mode != CF_NONE ? I3_SNAPSHOT_FULLSCREEN : 0));
+        window->rect = snapshot_rect(con->rect);
+    }
+
+    Con *child;
+    TAILQ_FOREACH (child, &(con->nodes_head), nodes) {
+        add_windows(child, workspace);
+    }
+    TAILQ_FOREACH (child, &(con->floating_head), floating_windows) {
+        add_windows(child, workspace);
+    }
+}
+
+static void collect_snapshot(void) {
+    next.num_outputs = 0;
+    next.num_workspaces = 0;
+    next.num_windows = 0;
+    if (next.strings == NULL) {
+        next.strings_capacity = 4096;
+        next.strings = smalloc(next.strings_capacity);
+    }
+    next.strings[0] = '\0';
+    next.strings_size = 1;
+
+    Con *output;
+    TAILQ_FOREACH (output, &(croot->nodes_head), nodes) {
+        const bool internal = con_is_internal(output);
+        uint32_t output_index = I3_SNAPSHOT_NONE;
+        Con *visible = NULL;
+        if (!internal) {
+            output_index = next.num_outputs;
+            APPEND(next.outputs, next.num_outputs, next.outputs_capacity);
+            i3_snapshot_output *o = &(next.outputs[next.num_outputs++]);
+            o->id = (uintptr_t)output;
+            o->name = add_string(output->name);
+            o->current_workspace = I3_SNAPSHOT_NONE;
+            o->rect = snapshot_rect(output->rect);
+            visible = con_get_fullscreen_con(output_get_content(output), CF_OUTPUT);
+        }
+
+        Con *ws;
+        TAILQ_FOREACH (ws, &(output_get_content(output)->nodes_head), nodes) {
+            if (internal || con_is_internal(ws)) {
+                /* The scratchpad. */
+                add_windows(ws, I3_SNAPSHOT_NONE);
+                continue;
+            }
+
+            const uint32_t ws_index = next.num_workspaces;
+            APPEND(next.workspaces, next.num_workspaces, next.workspaces_capacity);
+            i3_snapshot_workspace *w = &(next.workspaces[next.num_workspaces++]);
+            w->id = (uintptr_t)ws;
+            w->name = add_string(ws->name);
+            w->num = ws->num;
+            w->output = output_index;
+            w->flags = ((ws == con_get_workspace(focused) ? I3_SNAPSHOT_FOCUSED : 0) |
+                        (ws->urgent ? I3_SNAPSHOT_URGENT : 0) |
+                        (ws == visible ? I3_SNAPSHOT_VISIBLE : 0));
+            w->rect = snapshot_rect(ws->rect);
+            if (ws == visible) {
+                next.outputs[output_index].current_workspace = ws_index;
+            }
+
+            add_windows(ws, ws_index);
+        }
+    }
+}
+
+/*
+ * Makes sure that the segment is (and is mapped) at least size bytes large.
+ * The segment never shrinks, readers which mapped it earlier see the new
+ * size in the header and map it again.
+ *
+ */
+static bool reserve_segment(size_t size) {
+    if (size <= snapshot_map_size) {
+        return true;
+    }
+
+    size_t new_size = (snapshot_map_size == 0 ? 64 * 1024 : snapshot_map_size);
+    while (new_size < size) {
+        new_size *= 2;
+    }
+
+#if defined(__OpenBSD__) || defined(__APPLE__)
+    if (ftruncate(snapshot_fd, new_size) == -1) {
+        ELOG("Could not grow the state snapshot segment: %s\n", strerror(errno));
+#else
+    int ret;
+    if ((ret = posix_fallocate(snapshot_fd, 0, new_size)) != 0) {
+        ELOG("Could not grow the state snapshot segment: %s\n", strerror(ret));
+#endif
+        return false;
+    }
+
+    uint8_t *map = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, snapshot_fd, 0);
+    if (map == MAP_FAILED) {
+        ELOG("Could not mmap the state snapshot segment: %s\n", strerror(errno));
+        return false;
+    }
+    if (snapshot_map != NULL) {
+        munmap(snapshot_map, snapshot_map_size);
+    }
+    snapshot_map = map;
+    snapshot_map_size = new_size;
+    return true;
+}
+
+/*
+ * Creates the shared memory segment for the state snapshot. Its name is
+ * published in the I3_SNAPSHOT_PATH atom (see x_set_i3_atoms()).
+ *
+ */
+void snapshot_open(void) {
+#if defined(__FreeBSD__)
+    sasprintf(&snapshot_path, "/tmp/i3-snapshot-%d", getpid());
+#else
+    sasprintf(&snapshot_path, "/i3-snapshot-%d", getpid());
+#endif
+    /* After an in-place restart, the segment exists already. */
+    snapshot_fd = shm_open(snapshot_path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (snapshot_fd == -1) {
+        ELOG("Could not shm_open the state snapshot segment: %s\n", strerror(errno));
+        FREE(snapshot_path);
+        return;
+    }
+
+    struct stat st;
+    if (fstat(snapshot_fd, &st) == 0 && st.st_size > 0) {
+        snapshot_map_size = 0;
+        if (!reserve_segment(st.st_size)) {
+            snapshot_close();
+            return;
+        }
+    } else if (!reserve_segment(sizeof(i3_snapshot_header))) {
+        snapshot_close();
+        return;
+    }
+
+    /* Keep counting the sequence of the previous i3 process (if any), so that
+     * readers notice the change. */
+    i3_snapshot_header *header = (i3_snapshot_header *)snapshot_map;
+    if (header->magic != I3_SNAPSHOT_MAGIC) {
+        header->sequence = 0;
+    } else if (header->sequence & 1) {
+        header->sequence++;
+    }
+}
+
+/*
+ * Requests a new snapshot. Called from x_push_changes(), i.e. after every
+ * render and every change which is pushed to X11 without a render (e.g. a
+ * title change). The snapshot is written once per event loop iteration by
+ * snapshot_publish_if_requested().
+ *
+ */
+void snapshot_publish_later(void) {
+    publish_requested = true;
+}
+
+/*
+ * Writes a snapshot of the current state into the shared memory segment if
+ * snapshot_publish_later() was called since the last one. A seqlock protects
+ * the readers from seeing a partially written snapshot.
+ *
+ */
+void snapshot_publish_if_requested(void) {
+    if (!publish_requested || snapshot_map == NULL) {
+        return;
+    }
+    publish_requested = false;
+
+    collect_snapshot();
+
+    i3_snapshot_header header = {
+        .magic = I3_SNAPSHOT_MAGIC,
+        .version = I3_SNAPSHOT_VERSION,
+        .generation = tree_generation,
+        .focused = (uintptr_t)focused,
+        .num_outputs = next.num_outputs,
+        .num_workspaces = next.num_workspaces,
+        .num_windows = next.num_windows,
+        .strings_size = next.strings_size,
+    };
+    size_t size = sizeof(i3_snapshot_header);
+    header.outputs_offset = size;
+    size += next.num_outputs * sizeof(i3_snapshot_output);
+    header.workspaces_offset = size;
+    size += next.num_workspaces * sizeof(i3_snapshot_workspace);
+    header.windows_offset = size;
+    size += next.num_windows * sizeof(i3_snapshot_window);
+    header.strings_offset = size;
+    size += next.strings_size;
+    header.size = size;
+
+    if (!reserve_segment(size)) {
+        return;
+    }
+
+    i3_snapshot_header *shared = (i3_snapshot_header *)snapshot_map;
+    const uint32_t sequence = shared->sequence;
+    header.sequence = sequence + 1;
+    __atomic_store_n(&(shared->sequence), sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    /* Everything but the sequence, which is the first member. */
+    memcpy(snapshot_map + sizeof(uint32_t), ((uint8_t *)&header) + sizeof(uint32_t),
+           sizeof(i3_snapshot_header) - sizeof(uint32_t));
+    memcpy(snapshot_map + header.outputs_offset, next.outputs,
+           next.num_outputs * sizeof(i3_snapshot_output));
+    memcpy(snapshot_map + header.workspaces_offset, next.workspaces,
+           next.num_workspaces * sizeof(i3_snapshot_workspace));
+    memcpy(snapshot_map + header.windows_offset, next.windows,
+           next.num_windows * sizeof(i3_snapshot_window));
+    memcpy(snapshot_map + header.strings_offset, next.strings, next.strings_size);
+
+    __atomic_store_n(&(shared->sequence), sequence + 2, __ATOMIC_RELEASE);
+}
+
+/*
+ * Removes the shared memory segment, e.g. when exiting.
+ *
+ */
+void snapshot_close(void) {
+    if (snapshot_map != NULL) {
+        munmap(snapshot_map, snapshot_map_size);
+        snapshot_map = NULL;
+        snapshot_map_size = 0;
+    }
+    if (snapshot_fd != -1) {
+        close(snapshot_fd);
+        snapshot_fd = -1;
+    }
+    if (snapshot_path != NULL) {
+        shm_unlink(snapshot_path);
+        FREE(snapshot_path);
+    }
+}
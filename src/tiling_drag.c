@@ -100,7 +100,8 @@ typedef enum { DT_SIBLING,
 
 struct callback_params {
     xcb_window_t *indicator;
-    Con **target;
+    /* A handle, since the target might be closed during the drag. */
+    con_handle_t *target;
     direction_t *direction;
     drop_type_t *drop_type;
 };
@@ -259,7 +260,7 @@ create_indicator:
     x_mask_event_mask(~XCB_EVENT_MASK_ENTER_WINDOW);
     xcb_flush(conn);
 
-    *(params->target) = target;
+    *(params->target) = target->handle;
     *(params->direction) = direction;
     *(params->drop_type) = drop_type;
 }
@@ -305,27 +306,29 @@ void tiling_drag(Con *con, xcb_button_press_event_t *event, bool use_threshold)
     DLOG("Start dragging tiled container: con = %p\n", con);
     bool set_focus = (con == focused);
     bool set_fs = con->fullscreen_mode != CF_NONE;
+    const con_handle_t handle = con->handle;
 
     /* Don't change focus while dragging. */
     x_mask_event_mask(~XCB_EVENT_MASK_ENTER_WINDOW);
     xcb_flush(conn);
 
     /* Indicate drop location while dragging. This blocks until the drag is completed. */
-    Con *target = NULL;
+    con_handle_t target_handle = {0};
     direction_t direction;
     drop_type_t drop_type;
     xcb_window_t indicator = 0;
-    const struct callback_params params = {&indicator, &target, &direction, &drop_type};
+    const struct callback_params params = {&indicator, &target_handle, &direction, &drop_type};
 
     drag_result_t drag_result = drag_pointer(con, event, XCB_NONE, XCURSOR_CURSOR_MOVE, use_threshold, drag_callback, &params);
 
     /* Dragging is done. We don't need the indicator window any more. */
     xcb_destroy_window(conn, indicator);
 
+    Con *target = con_by_handle(target_handle);
     if (drag_result == DRAG_REVERT ||
+        con_by_handle(handle) == NULL ||
         target == NULL ||
-        (target == con && drop_type != DT_PARENT) ||
-        !con_exists(target)) {
+        (target == con && drop_type != DT_PARENT)) {
         DLOG("drop aborted\n");
         return;
     }
@@ -415,5 +418,5 @@ void tiling_drag(Con *con, xcb_button_press_event_t *event, bool use_threshold)
         workspace_show(con_get_workspace(con));
         con_focus(con);
     }
-    tree_render();
+    tree_render_later();
 }
@@ -0,0 +1,149 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * trace.c: Records spans (e.g. handling an X11 event or rendering the tree)
+ *          in a ring buffer, which can be dumped as a Chrome trace (see the
+ *          trace command and the GET_TRACE IPC message).
+ *
+ */
+#include "all.h"
+#include "yajl_utils.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+bool trace_enabled = false;
+
+struct trace_span {
+    const char *category;
+    const char *name;
+    uint64_t start;
+    uint64_t duration;
+};
+
+/* Allocated when tracing is enabled for the first time. */
+static struct trace_span *ring = NULL;
+/* The total number of recorded spans, the next one goes to
+ * ring[recorded % TRACE_RING_SIZE]. */
+static uint64_t recorded = 0;
+
+/*
+ * Returns the current time (CLOCK_MONOTONIC) in nanoseconds.
+ *
+ */
+uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Stores the span which started at start and ends now in the ring buffer.
+ * Use TRACE_END() instead of calling this function directly.
+ *
+ */
+void trace_record(uint64_t start, const char *category, const char *name) {
+    /* Spans which end after tracing was disabled are dropped. */
+    if (!trace_enabled) {
+        return;
+    }
+
+    struct trace_span *span = &ring[recorded % TRACE_RING_SIZE];
+    span->category = category;
+    span->name = name;
+    span->start = start;
+    span->duration = trace_now() - start;
+    recorded++;
+}
+
+/*
+ * Enables or disables recording spans. Enabling discards the spans recorded
+ * before, disabling keeps them, so that they can still be dumped.
+ *
+ */
+void set_tracing(bool enabled) {
+    if (enabled && ring == NULL) {
+        ring = smalloc(TRACE_RING_SIZE * sizeof(struct trace_span));
+    }
+    if (enabled) {
+        recorded = 0;
+    }
+    trace_enabled = enabled;
+}
+
+/*
+ * Timestamps in the Chrome trace format are in microseconds. Fractions keep
+ * the nanosecond resolution.
+ *
+ */
+static void dump_usec(ipc_gen gen, uint64_t nsec) {
+    char buffer[32];
+    const int len = snprintf(buffer, sizeof(buffer), "%" PRIu64 ".%03" PRIu64,
+                             nsec / 1000, nsec % 1000);
+    y(number, buffer, len);
+}
+
+/*
+ * Dumps the recorded spans in the Chrome trace event format (a JSON object
+ * with a "traceEvents" array), which chrome://tracing and Perfetto can load.
+ *
+ */
+void trace_dump(ipc_gen gen) {
+    const uint64_t first = (recorded > TRACE_RING_SIZE ? recorded - TRACE_RING_SIZE : 0);
+
+    y(map_open);
+    ystr("traceEvents");
+    y(array_open);
+
+    y(map_open);
+    ystr("name");
+    ystr("process_name");
+    ystr("ph");
+    ystr("M");
+    ystr("pid");
+    y(integer, getpid());
+    ystr("args");
+    y(map_open);
+    ystr("name");
+    ystr("i3");
+    y(map_close);
+    y(map_close);
+
+    for (uint64_t i = first; i < recorded; i++) {
+        const struct trace_span *span = &ring[i % TRACE_RING_SIZE];
+        y(map_open);
+        ystr("name");
+        ystr(span->name);
+        ystr("cat");
+        ystr(span->category);
+        ystr("ph");
+        ystr("X");
+        ystr("ts");
+        dump_usec(gen, span->start);
+        ystr("dur");
+        dump_usec(gen, span->duration);
+        ystr("pid");
+        y(integer, getpid());
+        ystr("tid");
+        y(integer, getpid());
+        y(map_close);
+    }
+    y(array_close);
+
+    ystr("displayTimeUnit");
+    ystr("ns");
+    ystr("otherData");
+    y(map_open);
+    ystr("enabled");
+    y(bool, trace_enabled);
+    ystr("recorded_spans");
+    y(integer, recorded);
+    ystr("overwritten_spans");
+    y(integer, first);
+    y(map_close);
+
+    y(map_close);
+}
@@ -14,6 +14,13 @@ struct Con *focused;
 
 struct all_cons_head all_cons = TAILQ_HEAD_INITIALIZER(all_cons);
 
+struct tree_render_stats tree_render_stats;
+
+uint64_t tree_generation = 1;
+
+/* Whether tree_render_later() was called since the last render. */
+static bool render_requested = false;
+
 /*
  * Create the pseudo-output __i3. Output-independent workspaces such as
  * __i3_scratch will live there.
@@ -259,8 +266,9 @@ bool tree_close_internal(Con *con, kill_window_t kill_window, bool dont_kill_par
             add_ignore_event(cookie.sequence, 0);
         }
         ipc_send_window_event("close", con);
-        window_free(con->window);
-        con->window = NULL;
+        i3Window *window = con->window;
+        con_set_window(con, NULL);
+        window_free(window);
     }
 
     Con *ws = con_get_workspace(con);
@@ -286,16 +294,17 @@ bool tree_close_internal(Con *con, kill_window_t kill_window, bool dont_kill_par
         con_fix_percent(parent);
     }
 
-    /* Render the tree so that the surrounding containers take up the space
-     * which 'con' does no longer occupy. If we don’t render here, there will
-     * be a gap in our containers and that could trigger an EnterNotify for an
-     * underlying container, see ticket #660.
+    /* Request a render so that the surrounding containers take up the space
+     * which 'con' does no longer occupy. Until then, there is a gap in our
+     * containers and destroying the frame could trigger an EnterNotify for an
+     * underlying container (see ticket #660), so x_con_kill() ignores the
+     * EnterNotify events caused by destroying it.
      *
      * Rendering has to be avoided when dont_kill_parent is set (when
      * tree_close_internal calls itself recursively) because the tree is in a
      * non-renderable state during that time. */
     if (!dont_kill_parent) {
-        tree_render();
+        tree_render_later();
     }
 
     /* kill the X11 part of this container */
@@ -341,6 +350,7 @@ void tree_split(Con *con, orientation_t orientation) {
             }
             DLOG("Changing orientation of workspace\n");
             con->layout = (orientation == HORIZ) ? L_SPLITH : L_SPLITV;
+            render_con_changed(con);
             return;
         } else {
             /* if there is more than one container on the workspace
@@ -361,6 +371,7 @@ void tree_split(Con *con, orientation_t orientation) {
         (parent->layout == L_SPLITH ||
          parent->layout == L_SPLITV)) {
         parent->layout = (orientation == HORIZ) ? L_SPLITH : L_SPLITV;
+        render_con_changed(parent);
         DLOG("Just changing orientation of existing container\n");
         return;
     }
@@ -431,22 +442,6 @@ bool level_down(void) {
     return true;
 }
 
-static void mark_unmapped(Con *con) {
-    Con *current;
-
-    con->mapped = false;
-    TAILQ_FOREACH (current, &(con->nodes_head), nodes) {
-        mark_unmapped(current);
-    }
-    if (con->type == CT_WORKSPACE) {
-        /* We need to call mark_unmapped on floating nodes as well since we can
-         * make containers floating. */
-        TAILQ_FOREACH (current, &(con->floating_head), floating_windows) {
-            mark_unmapped(current);
-        }
-    }
-}
-
 /*
  * Renders the tree, that is rendering all outputs using render_con() and
  * pushing the changes to X11 using x_push_changes().
@@ -458,17 +453,72 @@ void tree_render(void) {
     }
 
     DLOG("-- BEGIN RENDERING --\n");
-    /* Reset map state for all nodes in tree */
-    /* TODO: a nicer method to walk all nodes would be good, maybe? */
+    const uint64_t start = monotonic_usec();
+    const uint64_t trace_start = TRACE_BEGIN();
+    render_requested = false;
+    /* Changes of the tree bump tree_generation where they happen. Rendering
+     * itself only changes the tree if it lays out a workspace, which
+     * render_con() reports. */
+    tree_render_stats.renders++;
+    /* Reset map state for all nodes in tree (except for the workspaces which
+     * did not change, see mark_unmapped()) */
     mark_unmapped(croot);
     croot->mapped = true;
 
     render_con(croot);
 
     x_push_changes(croot);
+
+    TRACE_END(trace_start, "render", "tree_render");
+    latency_histogram_add(&(tree_render_stats.durations), monotonic_usec() - start);
+
+    /* Development builds cross-check the container indexes against a walk
+     * over all containers, so that a missed update shows up immediately. */
+    if (is_debug_build()) {
+        con_check_indexes();
+    }
     DLOG("-- END RENDERING --\n");
 }
 
+/*
+ * Marks the tree as changed by incrementing tree_generation, which invalidates
+ * everything derived from the tree (like cached IPC replies). The changed
+ * containers themselves are reported to tree_patch_con_changed() where they
+ * change.
+ *
+ */
+void tree_bump_generation(void) {
+    tree_generation++;
+}
+
+/*
+ * Requests a render of the tree. Instead of rendering immediately, the tree is
+ * rendered once before i3 waits for new events (or at the next sync point, see
+ * tree_render_if_requested()), so that a burst of events or commands only
+ * renders the tree once.
+ *
+ */
+void tree_render_later(void) {
+    tree_render_stats.requested++;
+    render_requested = true;
+}
+
+/*
+ * Renders the tree if tree_render_later() was called since the last render.
+ * Called from the event loop and wherever the rendered state has to be
+ * visible (i3 sync requests, IPC messages). Returns true if the tree was
+ * rendered.
+ *
+ */
+bool tree_render_if_requested(void) {
+    if (!render_requested) {
+        return false;
+    }
+    tree_render_stats.deferred++;
+    tree_render();
+    return true;
+}
+
 static Con *get_tree_next_workspace(Con *con, direction_t direction) {
     if (con_get_fullscreen_con(con, CF_GLOBAL)) {
         DLOG("Cannot change workspace while in global fullscreen mode.\n");
@@ -0,0 +1,288 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * tree_patch.c: Incremental updates of the tree for IPC clients (the
+ *               GET_TREE_PATCH message and the tree_patch event).
+ *
+ * Every change of a container is reported to tree_patch_con_changed() where it
+ * happens, which marks the workspace of the container. Most changes are
+ * reported by render_con_changed() (the container was attached, detached or
+ * its layout changed), the others by commands (for the containers they
+ * operate on), property handlers, ClientMessages, ConfigureRequests, marks,
+ * urgency changes and renders (for the workspaces which were laid out again).
+ *
+ * Whenever a patch is requested (at most once per tree_generation), the
+ * containers on the marked workspaces are serialized with dump_node_shallow()
+ * and the hash of the serialization is compared to the hash from the previous
+ * scan. Containers which differ are stamped with the current tree_generation.
+ * Since a client receives the generation of a scan along with each patch, and
+ * since the tree cannot change without tree_generation being incremented,
+ * every container which changed after that scan has a greater stamp. Root,
+ * outputs, dock areas and workspaces themselves are always compared, as are
+ * the workspaces which gained or lost the focus. Only changes which might
+ * affect any container (like reloading the configuration) make the next scan
+ * compare the whole tree, see tree_patch_invalidate().
+ *
+ * With --verify-render, the containers on the other workspaces are compared
+ * as well, and i3 aborts if any of them changed without being reported.
+ *
+ */
+#define LOG_CATEGORY LOG_IPC
+#include "all.h"
+#include "yajl_utils.h"
+
+#include <locale.h>
+
+/* The number of removed containers which are remembered. Patches since a
+ * generation before the oldest one are full patches. */
+#define MAX_REMOVED 4096
+
+struct removed_con {
+    uintptr_t id;
+    uint64_t generation;
+};
+
+static struct removed_con removed[MAX_REMOVED];
+static uint32_t removed_next = 0;
+
+/* Containers which were freed since the last scan (only those which were seen
+ * by a scan, the others were never sent to any client). */
+static uintptr_t *freed;
+static uint32_t freed_count;
+static uint32_t freed_capacity;
+
+/* The generation of the last scan (0 if there was none yet). */
+static uint64_t last_scan = 0;
+
+/* Patches can only be computed since this generation or later, because
+ * removals before it were forgotten. */
+static uint64_t horizon = 0;
+
+/* Whether the next scan has to compare all containers. */
+static bool scan_all = true;
+
+/* The focused container at the last scan, whose workspace has to be compared
+ * by the next scan because it lost the focus. */
+static con_handle_t last_focused;
+
+/*
+ * 64-bit FNV-1a, which is good enough to detect changes in the serialization
+ * of a container.
+ *
+ */
+static uint64_t fingerprint(const unsigned char *data, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static void forget_removed_before(uint64_t generation) {
+    if (generation > horizon) {
+        horizon = generation;
+    }
+}
+
+/*
+ * Compares the given container and its children to the previous scan. With
+ * 'verify' set, the containers must not have changed, since their workspace
+ * was not reported to tree_patch_con_changed().
+ *
+ */
+static void scan_con(ipc_gen gen, Con *con, bool all, bool verify) {
+    const unsigned char *buf;
+    ylength before;
+    y(get_buf, &buf, &before);
+
+    dump_node_shallow(gen, con);
+
+    ylength after;
+    y(get_buf, &buf, &after);
+    const uint64_t hash = fingerprint(buf + before, after - before);
+    if (con->patch_generation == 0 || con->patch_fingerprint != hash) {
+        if (verify) {
+            ELOG("BUG: con %p / %s changed, but its workspace was not reported to tree_patch_con_changed()\n",
+                 con, con->name);
+            assert(false);
+        }
+        con->patch_generation = tree_generation;
+        con->patch_fingerprint = hash;
+    }
+
+    if (con->type == CT_WORKSPACE) {
+        const bool dirty = con->patch_dirty;
+        con->patch_dirty = false;
+        if (!all && !dirty) {
+            if (!render_verify) {
+                return;
+            }
+            verify = true;
+        }
+    }
+
+    Con *child;
+    TAILQ_FOREACH (child, &(con->nodes_head), nodes) {
+        scan_con(gen, child, all, verify);
+    }
+    TAILQ_FOREACH (child, &(con->floating_head), floating_windows) {
+        scan_con(gen, child, all, verify);
+    }
+}
+
+static void scan(void) {
+    if (last_scan == tree_generation) {
+        return;
+    }
+    if (last_scan == 0) {
+        /* Nothing is known about containers removed before the first scan. */
+        forget_removed_before(tree_generation);
+    }
+    last_scan = tree_generation;
+
+    /* Focus changes are not reported to tree_patch_con_changed(), but they
+     * change the "focused" and "focus" properties of both workspaces. */
+    Con *previous = con_by_handle(last_focused);
+    if (previous != NULL) {
+        tree_patch_con_changed(previous);
+    }
+    if (focused != NULL) {
+        tree_patch_con_changed(focused);
+        last_focused = focused->handle;
+    }
+    const bool all = scan_all;
+    scan_all = false;
+
+    /* Serialize all containers as elements of one array, so that a single
+     * buffer is used. The serialization of each container is preceded by the
+     * same separator on each scan (root is always the first element). */
+    setlocale(LC_NUMERIC, "C");
+    ipc_gen gen = ygenalloc();
+    y(array_open);
+    scan_con(gen, croot, all, false);
+    y(array_close);
+    y(free);
+    setlocale(LC_NUMERIC, "");
+
+    for (uint32_t i = 0; i < freed_count; i++) {
+        struct removed_con *entry = &removed[removed_next];
+        if (entry->generation != 0) {
+            forget_removed_before(entry->generation);
+        }
+        entry->id = freed[i];
+        entry->generation = tree_generation;
+        removed_next = (removed_next + 1) % MAX_REMOVED;
+    }
+    freed_count = 0;
+}
+
+/*
+ * Remembers that the given container was freed, so that patches report it as
+ * removed. Called by con_free().
+ *
+ */
+void tree_patch_con_freed(Con *con) {
+    if (con->patch_generation == 0) {
+        return;
+    }
+    if (freed_count == MAX_REMOVED) {
+        /* No patches were requested for a long time, so there is no point in
+         * remembering even more removals. */
+        freed_count = 0;
+        forget_removed_before(tree_generation + 1);
+        return;
+    }
+    if (freed_count == freed_capacity) {
+        freed_capacity = (freed_capacity == 0 ? 64 : freed_capacity * 2);
+        freed = srealloc(freed, freed_capacity * sizeof(uintptr_t));
+    }
+    freed[freed_count++] = (uintptr_t)con;
+}
+
+/*
+ * Makes the next scan compare all containers, because the tree might have
+ * changed anywhere (e.g. after reloading the configuration).
+ *
+ */
+void tree_patch_invalidate(void) {
+    scan_all = true;
+}
+
+/*
+ * Makes the next scan compare the containers on the workspace of the given
+ * container. Called wherever a container changes.
+ *
+ */
+void tree_patch_con_changed(Con *con) {
+    Con *ws = con_get_workspace(con);
+    if (ws != NULL) {
+        ws->patch_dirty = true;
+    }
+}
+
+static void dump_changed(ipc_gen gen, Con *con, uint64_t since, uint32_t *count) {
+    if (con->patch_generation > since) {
+        dump_node_shallow(gen, con);
+        (*count)++;
+    }
+
+    Con *child;
+    TAILQ_FOREACH (child, &(con->nodes_head), nodes) {
+        dump_changed(gen, child, since, count);
+    }
+    TAILQ_FOREACH (child, &(con->floating_head), floating_windows) {
+        dump_changed(gen, child, since, count);
+    }
+}
+
+/*
+ * Writes a patch containing all containers which changed or were removed
+ * since the given generation (see GET_TREE_PATCH in docs/ipc). If removals
+ * since that generation are no longer known, the patch contains all
+ * containers and is marked as "full". Returns false if the patch is empty.
+ *
+ */
+bool tree_patch_dump(ipc_gen gen, uint64_t since) {
+    scan();
+
+    const bool full = (since < horizon || since > tree_generation);
+    if (full) {
+        since = 0;
+    }
+    uint32_t count = 0;
+
+    setlocale(LC_NUMERIC, "C");
+    y(map_open);
+
+    ystr("generation");
+    y(integer, tree_generation);
+
+    ystr("full");
+    y(bool, full);
+
+    ystr("removed");
+    y(array_open);
+    if (!full) {
+        for (uint32_t i = 0; i < MAX_REMOVED; i++) {
+            if (removed[i].generation > since) {
+                y(integer, removed[i].id);
+                count++;
+            }
+        }
+    }
+    y(array_close);
+
+    ystr("changed");
+    y(array_open);
+    dump_changed(gen, croot, since, &count);
+    y(array_close);
+
+    y(map_close);
+    setlocale(LC_NUMERIC, "");
+
+    return (count > 0);
+}
@@ -9,6 +9,7 @@
  *
  */
 #include "all.h"
+#include "yajl_utils.h"
 
 #include <ctype.h>
 #include <fcntl.h>
@@ -16,6 +17,7 @@
 #include <libgen.h>
 #include <locale.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 #if defined(__OpenBSD__)
 #include <sys/cdefs.h>
@@ -213,12 +215,9 @@ static char **add_argument(char **original, char *opt_char, char *opt_arg, char
     return result;
 }
 
-#define y(x, ...) yajl_gen_##x(gen, ##__VA_ARGS__)
-#define ystr(str) yajl_gen_string(gen, (unsigned char *)str, strlen(str))
-
 static char *store_restart_layout(void) {
     setlocale(LC_NUMERIC, "C");
-    yajl_gen gen = yajl_gen_alloc(NULL);
+    ipc_gen gen = ygenalloc();
 
     dump_node(gen, croot, true);
 
@@ -518,3 +517,34 @@ const char *position_to_string(position_t position) {
     }
     return "invalid";
 }
+
+const uint64_t latency_bucket_bounds[LATENCY_BUCKETS - 1] = {
+    10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000};
+
+/*
+ * Returns the time of the monotonic clock in microseconds.
+ *
+ */
+uint64_t monotonic_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Counts a duration (in microseconds) in the given histogram.
+ *
+ */
+void latency_histogram_add(struct latency_histogram *histogram, uint64_t usec) {
+    histogram->count++;
+    histogram->total_usec += usec;
+    if (usec > histogram->max_usec) {
+        histogram->max_usec = usec;
+    }
+
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && usec > latency_bucket_bounds[bucket]) {
+        bucket++;
+    }
+    histogram->buckets[bucket]++;
+}
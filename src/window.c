@@ -7,6 +7,7 @@
  * window.c: Updates window attributes (X11 hints/properties).
  *
  */
+#define LOG_CATEGORY LOG_MANAGE
 #include "all.h"
 
 #include <math.h>
@@ -168,6 +169,9 @@ void window_update_leader(i3Window *win, xcb_get_property_reply_t *prop) {
 void window_update_transient_for(i3Window *win, xcb_get_property_reply_t *prop) {
     if (prop == NULL || xcb_get_property_value_length(prop) == 0) {
         DLOG("TRANSIENT_FOR not set on window 0x%08x.\n", win->id);
+        if (win->transient_for != XCB_NONE) {
+            render_invalidate_all();
+        }
         win->transient_for = XCB_NONE;
         FREE(prop);
         return;
@@ -181,6 +185,11 @@ void window_update_transient_for(i3Window *win, xcb_get_property_reply_t *prop)
 
     DLOG("Transient for changed to 0x%08x (window 0x%08x)\n", transient_for, win->id);
 
+    if (win->transient_for != transient_for) {
+        /* Decides whether a floating window is shown above a fullscreen
+         * window, possibly on another workspace. */
+        render_invalidate_all();
+    }
     win->transient_for = transient_for;
 
     free(prop);
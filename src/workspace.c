@@ -394,9 +394,10 @@ static void workspace_reassign_sticky(Con *con) {
         }
 
         x_move_win(src, current);
-        current->window = src->window;
+        i3Window *window = src->window;
+        con_set_window(src, NULL);
+        con_set_window(current, window);
         current->mapped = true;
-        src->window = NULL;
         src->mapped = false;
 
         x_reparent_child(current, src);
@@ -423,11 +424,13 @@ static void workspace_defer_update_urgent_hint_cb(EV_P_ ev_timer *w, int revents
 
     if (con->urgent) {
         DLOG("Resetting urgency flag of con %p by timer\n", con);
+        tree_bump_generation();
+        tree_patch_con_changed(con);
         con_set_urgency(con, false);
         con_update_parents_urgency(con);
         workspace_update_urgent_flag(con_get_workspace(con));
         ipc_send_window_event("urgent", con);
-        tree_render();
+        tree_render_later();
     }
 }
 
@@ -531,15 +534,17 @@ void workspace_show(Con *workspace) {
         /* check if this workspace is currently visible */
         if (!workspace_is_visible(old)) {
             LOG("Closing old workspace (%p / %s), it is empty\n", old, old->name);
-            yajl_gen gen = ipc_marshal_workspace_event("empty", old, NULL);
+            /* The event has to be built before the workspace is freed. */
+            ipc_gen gen = NULL;
+            if (ipc_wants_event(I3_IPC_EVENT_WORKSPACE)) {
+                gen = ipc_marshal_workspace_event("empty", old, NULL);
+            }
             tree_close_internal(old, DONT_KILL_WINDOW, false);
 
-            const unsigned char *payload;
-            ylength length;
-            y(get_buf, &payload, &length);
-            ipc_send_event("workspace", I3_IPC_EVENT_WORKSPACE, (const char *)payload);
-
-            y(free);
+            if (gen != NULL) {
+                ipc_send_event("workspace", I3_IPC_EVENT_WORKSPACE, gen);
+                y(free);
+            }
 
             /* Avoid calling output_push_sticky_windows later with a freed container. */
             if (old == old_focus) {
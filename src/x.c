@@ -8,6 +8,7 @@
  *      render.c). Basically a big state machine.
  *
  */
+#define LOG_CATEGORY LOG_X
 #include "all.h"
 
 #include <unistd.h>
@@ -79,6 +80,14 @@ CIRCLEQ_HEAD(old_state_head, con_state) old_state_head =
 TAILQ_HEAD(initial_mapping_head, con_state) initial_mapping_head =
     TAILQ_HEAD_INITIALIZER(initial_mapping_head);
 
+/* Maps frame window IDs to their con_state. x_push_node() looks up the state
+ * of every container on every render, so walking state_head would make
+ * pushing the tree quadratic in the number of containers. */
+static struct hashmap states_by_frame = HASHMAP_INITIALIZER(false);
+
+/* Statistics about x_push_changes(), see GET_STATS. */
+struct x_push_stats x_push_stats;
+
 /*
  * Returns the container state for the given frame. This function always
  * returns a container state (otherwise, there is a bug in the code and the
@@ -87,11 +96,9 @@ TAILQ_HEAD(initial_mapping_head, con_state) initial_mapping_head =
  *
  */
 static con_state *state_for_frame(xcb_window_t window) {
-    con_state *state;
-    CIRCLEQ_FOREACH (state, &state_head, state) {
-        if (state->id == window) {
-            return state;
-        }
+    con_state *state = hashmap_get(&states_by_frame, HASHMAP_INT_KEY(window));
+    if (state != NULL) {
+        return state;
     }
 
     /* TODO: better error handling? */
@@ -170,6 +177,7 @@ void x_con_init(Con *con) {
     Rect dims = {-15, -15, 10, 10};
     xcb_window_t frame_id = create_window(conn, dims, con->depth, visual, XCB_WINDOW_CLASS_INPUT_OUTPUT, XCURSOR_CURSOR_POINTER, false, mask, values);
     draw_util_surface_init(conn, &(con->frame), frame_id, get_visualtype_by_id(visual), dims.width, dims.height);
+    con_index_frame(con);
     xcb_change_property(conn,
                         XCB_PROP_MODE_REPLACE,
                         con->frame.id,
@@ -187,6 +195,7 @@ void x_con_init(Con *con) {
     CIRCLEQ_INSERT_HEAD(&state_head, state, state);
     CIRCLEQ_INSERT_HEAD(&old_state_head, state, old_state);
     TAILQ_INSERT_TAIL(&initial_mapping_head, state, initial_mapping_order);
+    hashmap_put(&states_by_frame, HASHMAP_INT_KEY(state->id), state);
     DLOG("adding new state for window id 0x%08x\n", state->id);
 }
 
@@ -260,6 +269,8 @@ static void _x_con_kill(Con *con) {
         xcb_free_colormap(conn, con->colormap);
     }
 
+    con_unindex_frame(con);
+
     draw_util_surface_free(conn, &(con->frame));
     draw_util_surface_free(conn, &(con->frame_buffer));
     xcb_free_pixmap(conn, con->frame_buffer.id);
@@ -268,6 +279,7 @@ static void _x_con_kill(Con *con) {
     CIRCLEQ_REMOVE(&state_head, state, state);
     CIRCLEQ_REMOVE(&old_state_head, state, old_state);
     TAILQ_REMOVE(&initial_mapping_head, state, initial_mapping_order);
+    hashmap_remove(&states_by_frame, HASHMAP_INT_KEY(state->id));
     FREE(state->name);
     free(state);
 
@@ -281,12 +293,16 @@ static void _x_con_kill(Con *con) {
 }
 
 /*
- * Kills the window decoration associated with the given container.
+ * Kills the window decoration associated with the given container. The
+ * EnterNotify events caused by destroying it are ignored.
  *
  */
 void x_con_kill(Con *con) {
     _x_con_kill(con);
-    xcb_destroy_window(conn, con->frame.id);
+    xcb_void_cookie_t cookie = xcb_destroy_window(conn, con->frame.id);
+    /* The surrounding containers only take up the space of the frame with
+     * the next render, so the pointer might enter whatever is below. */
+    add_ignore_event(cookie.sequence, XCB_ENTER_NOTIFY);
 }
 
 /*
@@ -492,6 +508,8 @@ void x_draw_decoration(Con *con) {
         return;
     }
 
+    const uint64_t trace_start = TRACE_BEGIN();
+
     /* 1: build deco_params and compare with cache */
     struct deco_render_params *p = scalloc(1, sizeof(struct deco_render_params));
 
@@ -745,6 +763,7 @@ void x_draw_decoration(Con *con) {
             break;
         default:
             ELOG("BUG: invalid config.title_align value %d\n", config.title_align);
+            TRACE_END(trace_start, "x", "x_draw_decoration");
             return;
     }
 
@@ -770,6 +789,7 @@ void x_draw_decoration(Con *con) {
     x_draw_decoration_after_title(con, p, dest_surface);
 copy_pixmaps:
     draw_util_copy_surface(&(con->frame_buffer), &(con->frame), 0, 0, 0, 0, con->rect.width, con->rect.height);
+    TRACE_END(trace_start, "x", "x_draw_decoration");
 }
 
 /*
@@ -933,6 +953,30 @@ static void set_shape_state(Con *con, bool need_reshape) {
     }
 }
 
+/*
+ * Returns the rect of the frame of the given container. For stacked or tabbed
+ * split containers, the frame only holds the decorations of the children.
+ *
+ */
+static Rect frame_rect(Con *con) {
+    Rect rect = con->rect;
+    if (con->window == NULL && (con->layout == L_STACKED || con->layout == L_TABBED)) {
+        /* Calculate the height of all window decorations which will be drawn on to
+         * this frame. */
+        uint32_t max_y = 0, max_height = 0;
+        Con *current;
+        TAILQ_FOREACH (current, &(con->nodes_head), nodes) {
+            Rect *dr = &(current->deco_rect);
+            if (dr->y >= max_y && dr->height >= max_height) {
+                max_y = dr->y;
+                max_height = dr->height;
+            }
+        }
+        rect.height = max_y + max_height;
+    }
+    return rect;
+}
+
 /*
  * This function pushes the properties of each node of the layout tree to
  * X11 if they have changed (like the map state, position of the window, …).
@@ -942,7 +986,7 @@ static void set_shape_state(Con *con, bool need_reshape) {
 void x_push_node(Con *con) {
     Con *current;
     con_state *state;
-    Rect rect = con->rect;
+    Rect rect = frame_rect(con);
 
     state = state_for_frame(con->frame.id);
 
@@ -955,17 +999,6 @@ void x_push_node(Con *con) {
     }
 
     if (con->window == NULL && (con->layout == L_STACKED || con->layout == L_TABBED)) {
-        /* Calculate the height of all window decorations which will be drawn on to
-         * this frame. */
-        uint32_t max_y = 0, max_height = 0;
-        TAILQ_FOREACH (current, &(con->nodes_head), nodes) {
-            Rect *dr = &(current->deco_rect);
-            if (dr->y >= max_y && dr->height >= max_height) {
-                max_y = dr->y;
-                max_height = dr->height;
-            }
-        }
-        rect.height = max_y + max_height;
         if (rect.height == 0) {
             con->mapped = false;
         }
@@ -1256,6 +1289,56 @@ static bool is_con_attached(Con *con) {
     return false;
 }
 
+/*
+ * Returns true if x_push_node() will move, resize, map, reparent or reshape
+ * the frame of the given container state. Only these changes can make the
+ * pointer enter a different window.
+ *
+ */
+static bool state_changes_geometry(con_state *state) {
+    Con *con = state->con;
+    if (state->need_reparent || state->initial) {
+        return true;
+    }
+    if (state->was_floating != con_is_floating(con)) {
+        return true;
+    }
+    if (con->window != NULL && !rect_equals(state->window_rect, con->window_rect)) {
+        return true;
+    }
+
+    /* Like x_push_node(), only map split containers which hold decorations. */
+    const Rect rect = frame_rect(con);
+    bool mapped = con->mapped;
+    if (con->window == NULL && (rect.height == 0 || (con->layout != L_STACKED && con->layout != L_TABBED))) {
+        mapped = false;
+    }
+    if (state->mapped != mapped || (mapped && con->window != NULL && !state->child_mapped)) {
+        return true;
+    }
+
+    return !rect_equals(state->rect, rect) && rect.height > 0;
+}
+
+/* Set when the event masks of the frames were changed from FRAME_EVENT_MASK,
+ * so that the next push restores them. */
+static bool frame_event_masks_changed = false;
+
+/*
+ * Sets the event mask of all mapped frames.
+ *
+ */
+static void set_frame_event_masks(uint32_t mask) {
+    frame_event_masks_changed = (mask != FRAME_EVENT_MASK);
+
+    con_state *state;
+    CIRCLEQ_FOREACH_REVERSE (state, &state_head, state) {
+        if (state->mapped) {
+            xcb_change_window_attributes(conn, state->id, XCB_CW_EVENT_MASK, (uint32_t[]){mask});
+        }
+    }
+}
+
 /*
  * Pushes all changes (state of each node, see x_push_node() and the window
  * stack) to X11.
@@ -1271,51 +1354,50 @@ void x_push_changes(Con *con) {
     con_state *state;
     xcb_query_pointer_cookie_t pointercookie;
 
+    /* The sequence numbers of two NoOperation requests enclosing everything
+     * this function sends tell us how many requests it issued. These requests
+     * are only sent with debug logging, since they only feed the statistics. */
+    const bool count_requests = get_debug_logging();
+    const unsigned int first_sequence = (count_requests ? xcb_no_operation(conn).sequence : 0);
+    const uint64_t trace_start = TRACE_BEGIN();
+
     /* If we need to warp later, we request the pointer position as soon as possible */
     if (warp_to) {
         pointercookie = xcb_query_pointer(conn, root);
     }
 
     DLOG("-- PUSHING WINDOW STACK --\n");
-    /* We need to keep SubstructureRedirect around, otherwise clients can send
-     * ConfigureWindow requests and get them applied directly instead of having
-     * them become ConfigureRequests that i3 handles. */
-    uint32_t values[1] = {XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT};
-    CIRCLEQ_FOREACH_REVERSE (state, &state_head, state) {
-        if (state->mapped) {
-            xcb_change_window_attributes(conn, state->id, XCB_CW_EVENT_MASK, values);
-        }
-    }
-    bool order_changed = false;
-    bool stacking_changed = false;
 
-    /* count first, necessary to (re)allocate memory for the bottom-to-top
-     * stack afterwards */
-    int cnt = 0;
+    /* Find out whether the stacking order changed and whether any frame will
+     * be moved, resized or (un)mapped. Only in that case, the pointer might
+     * end up in a different window, so only then we need to disable
+     * EnterNotify events on the frames while pushing the changes. */
+    bool order_changed = false;
+    bool geometry_changed = false;
     CIRCLEQ_FOREACH_REVERSE (state, &state_head, state) {
-        if (con_has_managed_window(state->con)) {
-            cnt++;
+        if (CIRCLEQ_PREV(state, state) != CIRCLEQ_PREV(state, old_state)) {
+            order_changed = true;
+        }
+        if (!geometry_changed && state_changes_geometry(state)) {
+            geometry_changed = true;
         }
     }
+    const bool mask_frames = (order_changed || geometry_changed || warp_to != NULL);
 
-    /* The bottom-to-top window stack of all windows which are managed by i3.
-     * Used for x_get_window_stack(). */
-    static xcb_window_t *client_list_windows = NULL;
-    static int client_list_count = 0;
-
-    if (cnt != client_list_count) {
-        client_list_windows = srealloc(client_list_windows, sizeof(xcb_window_t) * cnt);
-        client_list_count = cnt;
+    /* We need to keep SubstructureRedirect around, otherwise clients can send
+     * ConfigureWindow requests and get them applied directly instead of having
+     * them become ConfigureRequests that i3 handles. */
+    uint32_t values[1];
+    if (mask_frames) {
+        set_frame_event_masks(XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT);
     }
+    bool stacking_changed = false;
 
-    xcb_window_t *walk = client_list_windows;
-
-    /* X11 correctly represents the stack if we push it from bottom to top */
+    /* X11 correctly represents the stack if we push it from bottom to top.
+     * Every frame above the lowest one whose neighbour changed needs to be
+     * restacked. */
+    order_changed = false;
     CIRCLEQ_FOREACH_REVERSE (state, &state_head, state) {
-        if (con_has_managed_window(state->con)) {
-            memcpy(walk++, &(state->con->window->id), sizeof(xcb_window_t));
-        }
-
         con_state *prev = CIRCLEQ_PREV(state, state);
         con_state *old_prev = CIRCLEQ_PREV(state, old_state);
         if (prev != old_prev) {
@@ -1336,6 +1418,32 @@ void x_push_changes(Con *con) {
     /* If we re-stacked something (or a new window appeared), we need to update
      * the _NET_CLIENT_LIST and _NET_CLIENT_LIST_STACKING hints */
     if (stacking_changed) {
+        /* The bottom-to-top window stack of all windows which are managed by i3.
+         * Used for x_get_window_stack(). */
+        static xcb_window_t *client_list_windows = NULL;
+        static int client_list_count = 0;
+
+        /* count first, necessary to (re)allocate memory for the bottom-to-top
+         * stack afterwards */
+        int cnt = 0;
+        CIRCLEQ_FOREACH_REVERSE (state, &state_head, state) {
+            if (con_has_managed_window(state->con)) {
+                cnt++;
+            }
+        }
+
+        if (cnt != client_list_count) {
+            client_list_windows = srealloc(client_list_windows, sizeof(xcb_window_t) * cnt);
+            client_list_count = cnt;
+        }
+
+        xcb_window_t *walk = client_list_windows;
+        CIRCLEQ_FOREACH_REVERSE (state, &state_head, state) {
+            if (con_has_managed_window(state->con)) {
+                *walk++ = state->con->window->id;
+            }
+        }
+
         DLOG("Client list changed (%i clients)\n", cnt);
         ewmh_update_client_list_stacking(client_list_windows, client_list_count);
 
@@ -1376,11 +1484,11 @@ void x_push_changes(Con *con) {
         warp_to = NULL;
     }
 
-    values[0] = FRAME_EVENT_MASK;
-    CIRCLEQ_FOREACH_REVERSE (state, &state_head, state) {
-        if (state->mapped) {
-            xcb_change_window_attributes(conn, state->id, XCB_CW_EVENT_MASK, values);
-        }
+    /* Restore the frame event masks if they were masked above or elsewhere
+     * (see x_mask_event_mask()), so that the frames get their EnterNotify,
+     * Expose and ButtonPress events back. */
+    if (frame_event_masks_changed) {
+        set_frame_event_masks(FRAME_EVENT_MASK);
     }
 
     x_deco_recurse(con);
@@ -1466,13 +1574,26 @@ void x_push_changes(Con *con) {
     /* Push all pending unmaps */
     x_push_node_unmaps(con);
 
-    /* save the current stack as old stack */
-    CIRCLEQ_FOREACH (state, &state_head, state) {
-        CIRCLEQ_REMOVE(&old_state_head, state, old_state);
-        CIRCLEQ_INSERT_TAIL(&old_state_head, state, old_state);
+    /* save the current stack as old stack (unless it is the same already) */
+    if (order_changed) {
+        CIRCLEQ_FOREACH (state, &state_head, state) {
+            CIRCLEQ_REMOVE(&old_state_head, state, old_state);
+            CIRCLEQ_INSERT_TAIL(&old_state_head, state, old_state);
+        }
+    }
+
+    x_push_stats.pushes++;
+    if (count_requests) {
+        const unsigned int last_sequence = xcb_no_operation(conn).sequence;
+        x_push_stats.last_requests = last_sequence - first_sequence - 1;
+        x_push_stats.requests += x_push_stats.last_requests;
+        DLOG("Pushing the changes took %u X11 requests\n", x_push_stats.last_requests);
     }
 
     xcb_flush(conn);
+
+    snapshot_publish_later();
+    TRACE_END(trace_start, "x", "x_push_changes");
 }
 
 /*
@@ -1520,6 +1641,20 @@ void update_shmlog_atom(void) {
     }
 }
 
+/*
+ * Set up the I3_SNAPSHOT_PATH atom.
+ *
+ */
+static void update_snapshot_atom(void) {
+    if (snapshot_path == NULL) {
+        xcb_delete_property(conn, root, A_I3_SNAPSHOT_PATH);
+    } else {
+        xcb_change_property(conn, XCB_PROP_MODE_REPLACE, root,
+                            A_I3_SNAPSHOT_PATH, A_UTF8_STRING, 8,
+                            strlen(snapshot_path), snapshot_path);
+    }
+}
+
 /*
  * Sets up i3 specific atoms (I3_SOCKET_PATH and I3_CONFIG_PATH)
  *
@@ -1535,6 +1670,7 @@ void x_set_i3_atoms(void) {
     xcb_change_property(conn, XCB_PROP_MODE_REPLACE, root, A_I3_LOG_STREAM_SOCKET_PATH, A_UTF8_STRING, 8,
                         strlen(current_log_stream_socket_path), current_log_stream_socket_path);
     update_shmlog_atom();
+    update_snapshot_atom();
 }
 
 /*
@@ -1555,14 +1691,7 @@ void x_set_warp_to(Rect *rect) {
  *
  */
 void x_mask_event_mask(uint32_t mask) {
-    uint32_t values[] = {FRAME_EVENT_MASK & mask};
-
-    con_state *state;
-    CIRCLEQ_FOREACH_REVERSE (state, &state_head, state) {
-        if (state->mapped) {
-            xcb_change_window_attributes(conn, state->id, XCB_CW_EVENT_MASK, values);
-        }
-    }
+    set_frame_event_masks(FRAME_EVENT_MASK & mask);
 }
 
 /*
@@ -7,6 +7,7 @@
  * xcb.c: Helper functions for easier usage of XCB
  *
  */
+#define LOG_CATEGORY LOG_X
 #include "all.h"
 
 unsigned int xcb_numlock_mask;
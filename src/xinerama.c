@@ -9,6 +9,7 @@
  * driver which does not support RandR in 2011 *sigh*.
  *
  */
+#define LOG_CATEGORY LOG_RANDR
 #include "all.h"
 
 #include <xcb/xinerama.h>
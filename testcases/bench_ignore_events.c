@@ -0,0 +1,158 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * bench_ignore_events.c: Replays a stream of add_ignore_event() and
+ * event_is_ignored() calls against src/ignore_events.c, verifies the results
+ * and reports how long each call took on average.
+ *
+ * Without arguments, a stream modeled after switching back and forth between
+ * two workspaces with many windows is generated: for every window on the old
+ * workspace, i3 unmaps it (and ignores EnterNotify events with the sequence of
+ * the UnmapNotify), for every window on the new workspace, i3 configures it
+ * (and ignores all events with the sequence of the ConfigureWindow request).
+ * The sequence numbers start close to 65535, so they wrap around.
+ *
+ * Alternatively, the calls of a real session can be replayed by passing an i3
+ * debug log (e.g. from i3-dump-log) recorded with the "sequences" category
+ * enabled (debuglog categories +sequences), in which ignore_events.c logs
+ * every call:
+ *
+ *     ignore_events: add <sequence> <response_type>
+ *     ignore_events: check <sequence> <response_type> <result (0 or 1)>
+ *
+ * Other lines are skipped. Entries expire after 5 seconds, which a replay does
+ * not reproduce, so results which differ from the recorded ones are counted
+ * instead of being treated as errors.
+ *
+ */
+#include "all.h"
+
+#include <err.h>
+#include <time.h>
+
+#define NUM_SWITCHES 5000
+#define WINDOWS_PER_WORKSPACE 100
+
+/* Replaying does not measure logging. */
+uint32_t log_active_categories = 0;
+
+void debuglog_category(log_category_t category, char *fmt, ...) {
+}
+
+struct call {
+    bool check;
+    int sequence;
+    int response_type;
+    bool expected;
+};
+
+static struct call *calls;
+static size_t num_calls;
+static size_t calls_capacity;
+
+static void append(bool check, int sequence, int response_type, bool expected) {
+    if (num_calls == calls_capacity) {
+        calls_capacity = (calls_capacity == 0 ? 1024 : calls_capacity * 2);
+        calls = srealloc(calls, calls_capacity * sizeof(struct call));
+    }
+    calls[num_calls++] = (struct call){check, sequence, response_type, expected};
+}
+
+static void generate_workspace_switches(void) {
+    unsigned int sequence = 65000;
+    for (int i = 0; i < NUM_SWITCHES; i++) {
+        /* x_push_changes() first unmaps the windows of the old workspace,
+         * then configures the windows of the new one. */
+        const unsigned int unmap_start = sequence;
+        sequence += WINDOWS_PER_WORKSPACE;
+        const unsigned int configure_start = sequence;
+        for (int w = 0; w < WINDOWS_PER_WORKSPACE; w++) {
+            append(false, configure_start + w, -1, false);
+        }
+        sequence += WINDOWS_PER_WORKSPACE;
+
+        /* Then, the UnmapNotify events arrive (with older sequence numbers
+         * than the requests we just sent), followed by EnterNotify events
+         * and errors for windows which were destroyed in the meantime. */
+        for (int w = 0; w < WINDOWS_PER_WORKSPACE; w++) {
+            append(false, unmap_start + w, XCB_ENTER_NOTIFY, false);
+        }
+        for (int w = 0; w < WINDOWS_PER_WORKSPACE; w++) {
+            append(true, unmap_start + w, XCB_ENTER_NOTIFY, true);
+            append(true, unmap_start + w, 0, false);
+            append(true, configure_start + w, XCB_ENTER_NOTIFY, true);
+            append(true, configure_start + w, 0, true);
+        }
+        /* An EnterNotify caused by the user moving the pointer. */
+        append(true, sequence, XCB_ENTER_NOTIFY, false);
+    }
+}
+
+static void read_log(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        err(EXIT_FAILURE, "fopen(%s)", path);
+    }
+
+    const char *marker = "ignore_events: ";
+    char *line = NULL;
+    size_t length = 0;
+    while (getline(&line, &length, f) != -1) {
+        const char *call = strstr(line, marker);
+        if (call == NULL) {
+            continue;
+        }
+        call += strlen(marker);
+
+        int sequence, response_type, result;
+        if (sscanf(call, "add %d %d", &sequence, &response_type) == 2) {
+            append(false, sequence, response_type, false);
+        } else if (sscanf(call, "check %d %d %d", &sequence, &response_type, &result) == 3) {
+            append(true, sequence, response_type, result);
+        }
+    }
+    free(line);
+    fclose(f);
+
+    if (num_calls == 0) {
+        errx(EXIT_FAILURE, "%s: no ignore_events calls found", path);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const bool recorded = (argc > 1);
+    if (recorded) {
+        read_log(argv[1]);
+    } else {
+        generate_workspace_switches();
+    }
+
+    size_t differing = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < num_calls; i++) {
+        const struct call *c = &calls[i];
+        if (!c->check) {
+            add_ignore_event(c->sequence, c->response_type);
+        } else if (event_is_ignored(c->sequence, c->response_type) != c->expected) {
+            if (!recorded) {
+                errx(EXIT_FAILURE, "call %zu: event_is_ignored(%d, %d) != %d",
+                     i, c->sequence, c->response_type, c->expected);
+            }
+            differing++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    const double nsec = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("%zu calls in %.3f ms, %.1f ns per call\n", num_calls, nsec / 1e6, nsec / num_calls);
+    if (recorded) {
+        printf("%zu results differ from the recording\n", differing);
+    }
+
+    free(calls);
+    return EXIT_SUCCESS;
+}
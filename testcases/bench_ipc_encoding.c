@@ -0,0 +1,351 @@
+/*
+ * vim:ts=4:sw=4:expandtab
+ *
+ * i3 - an improved dynamic tiling window manager
+ * © 2009 Michael Stapelberg and contributors (see also: LICENSE)
+ *
+ * bench_ipc_encoding.c: Compares the JSON and the CBOR encoding of IPC
+ * messages (see I3_IPC_MESSAGE_TYPE_SET_ENCODING) for a GET_TREE reply.
+ *
+ * A tree with 500 containers (10 workspaces with 49 windows each, on one
+ * output) is serialized like dump_node() does. Encoding measures generating
+ * either encoding with an ipc_gen (which is what i3 does for the clients
+ * which selected it). Decoding measures parsing either encoding with the same
+ * yajl callbacks, which also verifies that both encodings yield the same
+ * values.
+ *
+ */
+#include "libi3.h"
+#include "yajl_utils.h"
+
+#include <err.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_WORKSPACES 10
+#define WINDOWS_PER_WORKSPACE 49
+#define ITERATIONS 200
+
+static uintptr_t next_id = 0x55d0c0de0000;
+
+static void dump_rect(ipc_gen gen, const char *name, int rx, int ry, int width, int height) {
+    ystr(name);
+    y(map_open);
+    ystr("x");
+    y(integer, rx);
+    ystr("y");
+    y(integer, ry);
+    ystr("width");
+    y(integer, width);
+    ystr("height");
+    y(integer, height);
+    y(map_close);
+}
+
+/*
+ * Dumps a container with the properties dump_node() includes for every
+ * container. Leaf containers get a window.
+ *
+ */
+static void dump_con(ipc_gen gen, const char *type, const char *name, int num, int children) {
+    const uintptr_t id = next_id;
+    next_id += 0x200;
+
+    y(map_open);
+    ystr("id");
+    y(integer, id);
+    ystr("type");
+    ystr(type);
+    ystr("orientation");
+    ystr("horizontal");
+    ystr("scratchpad_state");
+    ystr("none");
+    ystr("percent");
+    if (children == 0) {
+        y(double, 1.0 / WINDOWS_PER_WORKSPACE);
+    } else {
+        y(null);
+    }
+    ystr("urgent");
+    y(bool, false);
+    ystr("marks");
+    y(array_open);
+    y(array_close);
+    ystr("focused");
+    y(bool, false);
+    ystr("output");
+    ystr("HDMI-1");
+    ystr("layout");
+    ystr("splith");
+    ystr("workspace_layout");
+    ystr("default");
+    ystr("last_split_layout");
+    ystr("splith");
+    ystr("border");
+    ystr("normal");
+    ystr("current_border_width");
+    y(integer, 2);
+    dump_rect(gen, "rect", 39 * num, 20, 39, 1060);
+    dump_rect(gen, "deco_rect", 0, 0, 39, 20);
+    dump_rect(gen, "window_rect", 2, 0, 35, 1058);
+    dump_rect(gen, "geometry", 0, 0, 800, 600);
+    ystr("name");
+    ystr(name);
+    ystr("window_icon_padding");
+    y(integer, -1);
+    if (strcmp(type, "workspace") == 0) {
+        ystr("num");
+        y(integer, num);
+    }
+    ystr("window");
+    if (children == 0) {
+        y(integer, 0x1e00003 + num);
+        ystr("window_type");
+        ystr("normal");
+        ystr("window_properties");
+        y(map_open);
+        ystr("class");
+        ystr("Alacritty");
+        ystr("instance");
+        ystr("Alacritty");
+        ystr("title");
+        ystr(name);
+        ystr("transient_for");
+        y(null);
+        y(map_close);
+    } else {
+        y(null);
+        ystr("window_type");
+        y(null);
+    }
+
+    ystr("nodes");
+    y(array_open);
+    for (int i = 0; i < children; i++) {
+        char child_name[64];
+        snprintf(child_name, sizeof(child_name), "user@host: ~/src/i3 (%d)", i);
+        dump_con(gen, "con", child_name, i, 0);
+    }
+    y(array_close);
+    ystr("floating_nodes");
+    y(array_open);
+    y(array_close);
+    ystr("focus");
+    y(array_open);
+    y(array_close);
+    ystr("fullscreen_mode");
+    y(integer, 0);
+    ystr("sticky");
+    y(bool, false);
+    ystr("floating");
+    ystr("auto_off");
+    ystr("swallows");
+    y(array_open);
+    y(array_close);
+    y(map_close);
+}
+
+/*
+ * Generates the GET_TREE reply: root, output, content container and the
+ * workspaces with their windows, in the given encodings.
+ *
+ */
+static ipc_gen dump_tree(bool json, bool cbor) {
+    next_id = 0x55d0c0de0000;
+    ipc_gen gen = ipc_gen_alloc(json, cbor);
+    y(map_open);
+    ystr("id");
+    y(integer, next_id++);
+    ystr("type");
+    ystr("root");
+    ystr("name");
+    ystr("root");
+    ystr("nodes");
+    y(array_open);
+    y(map_open);
+    ystr("id");
+    y(integer, next_id++);
+    ystr("type");
+    ystr("output");
+    ystr("name");
+    ystr("HDMI-1");
+    ystr("nodes");
+    y(array_open);
+    for (int i = 0; i < NUM_WORKSPACES; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "%d", i + 1);
+        dump_con(gen, "workspace", name, i + 1, WINDOWS_PER_WORKSPACE);
+    }
+    y(array_close);
+    y(map_close);
+    y(array_close);
+    y(map_close);
+    return gen;
+}
+
+/* Sums up everything the parser reports, so that the decoded values of both
+ * encodings can be compared. */
+struct checksum {
+    uint64_t items;
+    uint64_t sum;
+};
+
+static void add(struct checksum *c, uint64_t value) {
+    c->items++;
+    c->sum = c->sum * 31 + value;
+}
+
+static int null_cb(void *ctx) {
+    add(ctx, 1);
+    return 1;
+}
+
+static int boolean_cb(void *ctx, int value) {
+    add(ctx, 2 + value);
+    return 1;
+}
+
+static int integer_cb(void *ctx, long long value) {
+    add(ctx, (uint64_t)value);
+    return 1;
+}
+
+static int double_cb(void *ctx, double value) {
+    add(ctx, (uint64_t)(value * 1e6));
+    return 1;
+}
+
+static int string_cb(void *ctx, const unsigned char *value, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        add(ctx, value[i]);
+    }
+    return 1;
+}
+
+static int map_key_cb(void *ctx, const unsigned char *key, size_t len) {
+    add(ctx, 4);
+    return string_cb(ctx, key, len);
+}
+
+static int start_map_cb(void *ctx) {
+    add(ctx, 5);
+    return 1;
+}
+
+static int end_map_cb(void *ctx) {
+    add(ctx, 6);
+    return 1;
+}
+
+static int start_array_cb(void *ctx) {
+    add(ctx, 7);
+    return 1;
+}
+
+static int end_array_cb(void *ctx) {
+    add(ctx, 8);
+    return 1;
+}
+
+static yajl_callbacks callbacks = {
+    .yajl_null = null_cb,
+    .yajl_boolean = boolean_cb,
+    .yajl_integer = integer_cb,
+    .yajl_double = double_cb,
+    .yajl_string = string_cb,
+    .yajl_map_key = map_key_cb,
+    .yajl_start_map = start_map_cb,
+    .yajl_end_map = end_map_cb,
+    .yajl_start_array = start_array_cb,
+    .yajl_end_array = end_array_cb,
+};
+
+static struct checksum decode_json(const unsigned char *json, size_t size) {
+    struct checksum c = {0};
+    yajl_handle handle = yalloc(&callbacks, &c);
+    if (yajl_parse(handle, json, size) != yajl_status_ok ||
+        yajl_complete_parse(handle) != yajl_status_ok) {
+        errx(EXIT_FAILURE, "could not parse the JSON tree");
+    }
+    yajl_free(handle);
+    return c;
+}
+
+static struct checksum decode_cbor(const uint8_t *cbor, size_t size) {
+    struct checksum c = {0};
+    if (cbor_parse(&callbacks, &c, cbor, size) != yajl_status_ok) {
+        errx(EXIT_FAILURE, "could not parse the CBOR tree");
+    }
+    return c;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *what, double nsec, size_t size) {
+    const double per_call = nsec / ITERATIONS;
+    printf("%-12s %8.1f µs per tree, %7.1f MB/s\n",
+           what, per_call / 1e3, (size / 1e6) / (per_call / 1e9));
+}
+
+int main(int argc, char *argv[]) {
+    const unsigned char *json;
+    ylength json_size;
+    const unsigned char *cbor;
+    size_t cbor_size;
+    double start;
+
+    /* Encoding */
+    start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        ipc_gen gen = dump_tree(true, false);
+        y(get_buf, &json, &json_size);
+        y(free);
+    }
+    const double json_encode = now_ns() - start;
+
+    start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        ipc_gen gen = dump_tree(false, true);
+        y(get_cbor, &cbor, &cbor_size);
+        y(free);
+    }
+    const double cbor_encode = now_ns() - start;
+
+    ipc_gen gen = dump_tree(true, true);
+    y(get_buf, &json, &json_size);
+    y(get_cbor, &cbor, &cbor_size);
+
+    /* Decoding */
+    struct checksum json_checksum = {0}, cbor_checksum = {0};
+    start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        json_checksum = decode_json(json, json_size);
+    }
+    const double json_decode = now_ns() - start;
+
+    start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        cbor_checksum = decode_cbor(cbor, cbor_size);
+    }
+    const double cbor_decode = now_ns() - start;
+
+    if (json_checksum.items != cbor_checksum.items || json_checksum.sum != cbor_checksum.sum) {
+        errx(EXIT_FAILURE, "the CBOR encoding differs from the JSON encoding");
+    }
+
+    printf("GET_TREE reply with %d containers: %zu bytes JSON, %zu bytes CBOR\n",
+           2 + NUM_WORKSPACES * (1 + WINDOWS_PER_WORKSPACE), (size_t)json_size, cbor_size);
+    report("JSON encode", json_encode, json_size);
+    report("CBOR encode", cbor_encode, cbor_size);
+    report("JSON decode", json_decode, json_size);
+    report("CBOR decode", cbor_decode, cbor_size);
+
+    y(free);
+    return EXIT_SUCCESS;
+}
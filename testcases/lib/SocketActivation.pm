@@ -94,6 +94,11 @@ sub activate_i3 {
         # Also disable logging to SHM since we redirect the logs anyways.
         # Force Xinerama because we use Xdmx for multi-monitor tests.
         my $i3cmd = q|i3 --shmlog-size=0 --disable-signalhandler|;
+        # Compare each incremental render to a full render (enabled for all
+        # tests by launch_with_config).
+        if ($args{verify_render}) {
+            $i3cmd .= q| --verify-render|;
+        }
         if (!defined($args{inject_randr15})) {
             $i3cmd .= q| --force-xinerama|;
         }
@@ -550,6 +550,7 @@ my $expected_all_tokens = "ERROR: CONFIG: Expected one of these tokens: <end>, '
         ipc_socket
         ipc-socket
         ipc_kill_timeout
+        ipc_queue_limit
         restart_state
         popup_during_fullscreen
 	tiling_drag
@@ -0,0 +1,65 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that PropertyNotify events which arrive in quick succession are
+# coalesced, but that the last value of each property is always applied.
+use i3test;
+
+sub property_stats {
+    return $i3->message(TYPE_GET_STATS, "")->recv->{properties};
+}
+
+my $ws = fresh_workspace;
+my $window = open_window(name => 'Window 0');
+
+my $before = property_stats;
+
+my @events = events_for(
+    sub {
+        $window->name("Window $_") for (1..20);
+        $x->flush;
+        sync_with_i3;
+    },
+    'window');
+
+my $after = property_stats;
+my $notifies = $after->{notifies} - $before->{notifies};
+my $batches = $after->{batches} - $before->{batches};
+my $requests = $after->{requests} - $before->{requests};
+
+# How many batches the changes end up in depends on how the events arrive, but
+# only _NET_WM_NAME of a single window changed, so each batch must request
+# exactly one property, no matter how many changes it contains.
+is($notifies, 20, 'one property notify per title change');
+cmp_ok($batches, '>=', 1, 'at least one batch handled');
+is($requests, $batches, 'the title is requested once per batch');
+
+my @titles = grep { $_->{change} eq 'title' } @events;
+cmp_ok(scalar @titles, '>=', 1, 'at least one title event received');
+cmp_ok(scalar @titles, '<=', $batches, 'at most one title event per batch');
+is($titles[-1]->{container}->{name}, 'Window 20', 'last title event has the last title');
+
+my @nodes = @{get_ws($ws)->{nodes}};
+is($nodes[0]->{name}, 'Window 20', 'window has the last title');
+
+# A change which is followed by another event (here: the sync client message)
+# is handled before that event.
+$window->name('Final');
+sync_with_i3;
+@nodes = @{get_ws($ws)->{nodes}};
+is($nodes[0]->{name}, 'Final', 'title updated before the sync reply');
+
+done_testing;
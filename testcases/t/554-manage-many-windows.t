@@ -0,0 +1,56 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Maps many windows at once and verifies that all of them get managed, even
+# when some of them disappear while i3 is still waiting for their properties.
+# Reports how long it took until all windows were managed.
+use i3test;
+use Time::HiRes qw(time);
+
+my $num_windows = 200;
+
+my $ws = fresh_workspace;
+
+my @windows = map { open_window(dont_map => 1, name => "Window $_") } (1..$num_windows);
+
+my $start = time;
+$_->map for @windows;
+$x->flush;
+sync_with_i3;
+my $elapsed = time - $start;
+
+diag(sprintf('managing %d windows took %.1f ms', $num_windows, $elapsed * 1000));
+
+is(scalar @{get_ws_content($ws)}, $num_windows, 'all windows managed');
+
+# Windows which are destroyed right after mapping them must not be managed.
+my $ws2 = fresh_workspace;
+my @survivors;
+for my $i (1..20) {
+    my $window = open_window(dont_map => 1);
+    $window->map;
+    if ($i % 2) {
+        $window->destroy;
+    } else {
+        push @survivors, $window;
+    }
+}
+$x->flush;
+sync_with_i3;
+
+is(scalar @{get_ws_content($ws2)}, scalar @survivors, 'destroyed windows not managed');
+
+done_testing;
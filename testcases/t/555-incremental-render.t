@@ -0,0 +1,110 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that workspaces which did not change keep their layout, and that
+# every change which influences the layout still re-renders the workspace.
+# Like in all tests, i3 runs with --verify-render, so it also compares each
+# incremental render to a full render.
+use i3test i3_autostart => 0;
+use AnyEvent::I3 qw(:all);
+
+my $config = <<EOT;
+# i3 config file (v4)
+font -misc-fixed-medium-r-normal--13-120-75-75-iso10646-1
+
+fake-outputs 1024x768+0+0,1024x768+1024+0
+gaps inner 10
+EOT
+
+my $pid = launch_with_config($config);
+
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+
+sub rects {
+    my ($ws) = @_;
+    return [ map { $_->{rect} } @{get_ws_content($ws)} ];
+}
+
+sub render_stats {
+    return $i3->message(TYPE_GET_STATS, "")->recv->{render};
+}
+
+cmd 'focus output fake-1';
+my $other = fresh_workspace;
+my $other_window = open_window;
+
+cmd 'focus output fake-0';
+my $ws = fresh_workspace;
+my $first = open_window(name => 'first');
+my $second = open_window(name => 'second');
+my $floating = open_floating_window;
+
+my $before = rects($ws);
+is($before->[0]->{width}, $before->[1]->{width}, 'windows share the workspace');
+
+# A title change does not influence the layout.
+$first->name('first, renamed');
+sync_with_i3;
+is_deeply(rects($ws), $before, 'layout unchanged after a title change');
+
+# Neither does a change on the other output. Every render keeps the layout of
+# this workspace instead of laying it out again.
+my $stats = render_stats;
+cmd '[id="' . $other_window->id . '"] focus';
+cmd 'split v';
+open_window;
+my $after = render_stats;
+cmd 'focus output fake-0';
+is_deeply(rects($ws), $before, 'layout unchanged after a change on the other output');
+my $renders = $after->{renders} - $stats->{renders};
+cmp_ok($renders, '>', 0, 'tree rendered');
+cmp_ok($after->{workspaces_rendered} - $stats->{workspaces_rendered}, '>', 0,
+       'the changed workspace was laid out');
+cmp_ok($after->{workspaces_replayed} - $stats->{workspaces_replayed}, '>=', $renders,
+       'the unchanged workspace was skipped in every render');
+
+# Resizing changes the layout of the workspace.
+cmd '[id="' . $first->id . '"] focus';
+cmd 'resize grow width 10 px or 10 ppt';
+my $resized = rects($ws);
+cmp_ok($resized->[0]->{width}, '>', $resized->[1]->{width}, 'first window grew');
+
+# Switching away and back keeps the layout.
+fresh_workspace;
+cmd "workspace $ws";
+is_deeply(rects($ws), $resized, 'layout unchanged after switching workspaces');
+
+# Changing the gaps of the workspace re-renders it.
+cmd 'gaps inner current set 30';
+my $gaps = rects($ws);
+isnt($gaps->[0]->{x}, $resized->[0]->{x}, 'new gaps applied');
+
+# So does changing the layout.
+cmd 'layout tabbed';
+my $tabbed = rects($ws);
+is($tabbed->[0]->{width}, $tabbed->[1]->{width}, 'tabbed windows have the same width');
+
+# And closing a window.
+$second->unmap;
+wait_for_unmap($second);
+is(scalar @{get_ws_content($ws)}, 1, 'one tiling window left');
+
+does_i3_live;
+
+exit_gracefully($pid);
+
+done_testing;
@@ -0,0 +1,64 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that pushing the tree to X11 only sends requests for what actually
+# changed, using the X11 request counter of the GET_STATS IPC message.
+use i3test i3_config => <<EOT;
+# i3 config file (v4)
+font -misc-fixed-medium-r-normal--13-120-75-75-C-70-iso10646-1
+
+default_border pixel 1
+EOT
+use AnyEvent::I3 qw(:all);
+
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+
+sub x_push_stats {
+    return $i3->message(TYPE_GET_STATS, "")->recv->{x_push};
+}
+
+my $ws = fresh_workspace;
+my $windows = 30;
+my @windows = map { open_window } (1..$windows);
+
+my $stats = x_push_stats;
+cmp_ok($stats->{pushes}, '>', 0, 'the tree was pushed');
+cmp_ok($stats->{requests}, '>=', $stats->{last_requests}, 'total includes the last push');
+
+# Moving the focus between tiling windows neither moves nor restacks any
+# frame, so the frames are left alone.
+cmd 'focus left';
+$stats = x_push_stats;
+cmp_ok($stats->{last_requests}, '<', $windows, 'focus change does not touch every frame');
+
+# Neither does a title change.
+$windows[0]->name('changed title');
+sync_with_i3;
+$stats = x_push_stats;
+cmp_ok($stats->{last_requests}, '<', $windows, 'title change does not touch every frame');
+
+# Switching workspaces unmaps every window, of course.
+my $pushes = $stats->{pushes};
+fresh_workspace;
+$stats = x_push_stats;
+cmp_ok($stats->{pushes}, '>', $pushes, 'switching workspaces pushed the tree');
+cmp_ok($stats->{last_requests}, '>=', $windows, 'switching workspaces unmaps every window');
+
+cmd "workspace $ws";
+is(scalar @{get_ws_content($ws)}, $windows, 'all windows still there');
+
+done_testing;
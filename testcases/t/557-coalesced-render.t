@@ -0,0 +1,76 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that a burst of X11 events renders the tree less often than once
+# per event, and that the rendered state is visible at sync points and in the
+# reply to a command.
+use i3test;
+use AnyEvent::I3 qw(:all);
+
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+
+sub render_stats {
+    return $i3->message(TYPE_GET_STATS, "")->recv->{render};
+}
+
+my $ws = fresh_workspace;
+my $count = 20;
+my @windows = map { open_window } (1..$count);
+is(scalar @{get_ws_content($ws)}, $count, 'all windows opened');
+
+my $before = render_stats;
+
+# Destroy all windows at once: i3 receives all UnmapNotify events in a single
+# burst.
+$_->unmap for @windows;
+$x->flush;
+sync_with_i3;
+
+# The sync request is a sync point, so the tree has been rendered already.
+is(scalar @{get_ws_content($ws)}, 0, 'all windows closed');
+
+my $after = render_stats;
+my $renders = $after->{renders} - $before->{renders};
+cmp_ok($renders, '>', 0, 'tree was rendered');
+cmp_ok($renders, '<', $count, 'fewer renders than closed windows');
+cmp_ok($after->{deferred}, '>', $before->{deferred}, 'render was deferred');
+
+my $events = $after->{events} - $before->{events};
+cmp_ok($renders, '<', $events, 'fewer renders than handled events');
+
+# Before renders were coalesced, every request was a render of its own (closing
+# a window rendered the tree once in tree_close_internal() and once more in the
+# UnmapNotify handler). Renders which were not requested happen either way.
+my $requested = $after->{requested} - $before->{requested};
+my $deferred = $after->{deferred} - $before->{deferred};
+my $uncoalesced = $requested + ($renders - $deferred);
+cmp_ok($uncoalesced, '>=', 2 * $count, 'two render requests per closed window');
+cmp_ok($renders, '<', $uncoalesced, 'fewer renders than without coalescing');
+diag(sprintf('renders per event: %.2f without coalescing (%d renders), ' .
+             '%.2f with coalescing (%d renders), %d events',
+             $uncoalesced / $events, $uncoalesced,
+             $renders / $events, $renders, $events));
+
+# Commands request a render as well, but their reply is only sent once the
+# result is visible.
+my $left = open_window;
+my $right = open_window;
+is($x->input_focus, $right->id, 'right window focused');
+cmd 'focus left';
+is($x->input_focus, $left->id, 'focus pushed to X11 before the reply');
+
+done_testing;
@@ -0,0 +1,55 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that subscribing to an event more than once (in any spelling)
+# delivers each event only once, and that unknown event names are ignored.
+use i3test;
+use AnyEvent::I3 qw(:all);
+
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+
+my @ticks;
+my $first = AnyEvent->condvar;
+my $reply = $i3->subscribe({
+    tick => sub {
+        my ($event) = @_;
+        if ($event->{first}) {
+            $first->send(1);
+        } else {
+            push @ticks, $event;
+        }
+    },
+})->recv;
+ok($reply->{success}, 'subscribed to tick events');
+ok($first->recv, 'first tick event received');
+
+$reply = $i3->message(TYPE_SUBSCRIBE, [ 'TICK', 'tick', 'no-such-event' ])->recv;
+ok($reply->{success}, 'subscribed again');
+
+my $tick = $i3->message(TYPE_SEND_TICK, 'payload')->recv;
+ok($tick->{success}, 'tick sent');
+
+$i3->message(TYPE_SEND_TICK, 'last')->recv;
+
+# Give i3 some time to deliver any duplicate events.
+my $timer = AnyEvent->condvar;
+my $w = AnyEvent->timer(after => 0.5, cb => sub { $timer->send(1) });
+$timer->recv;
+
+is_deeply([ map { $_->{payload} } @ticks ], [ 'payload', 'last' ], 'every tick event delivered once');
+
+done_testing;
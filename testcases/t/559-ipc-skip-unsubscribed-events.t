@@ -0,0 +1,51 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that events are only serialized when a client is subscribed to
+# them, using the counters of the GET_STATS IPC message.
+use i3test;
+use AnyEvent::I3 qw(:all);
+
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+
+sub window_event_stats {
+    return $i3->message(TYPE_GET_STATS, "")->recv->{events}->{window};
+}
+
+fresh_workspace;
+
+my $before = window_event_stats;
+my $window = open_window;
+$window->name('new title');
+sync_with_i3;
+my $after = window_event_stats;
+
+cmp_ok($after->{skipped}, '>', $before->{skipped}, 'unsubscribed window events skipped');
+is($after->{serialized}, $before->{serialized}, 'no window event serialized');
+
+my @events = events_for(
+    sub {
+        $window->name('another title');
+        sync_with_i3;
+    },
+    'window');
+is(scalar @events, 1, 'subscribers still get window events');
+is($events[0]->{change}, 'title', 'title event received');
+
+cmp_ok(window_event_stats->{serialized}, '>', $after->{serialized}, 'subscribed window event serialized');
+
+done_testing;
@@ -0,0 +1,76 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that events queued for a client which does not read for a while
+# (so that its socket buffer fills up) are delivered completely and in order
+# once the client reads again.
+use i3test;
+use AnyEvent::I3 qw(:all);
+use IO::Socket::UNIX;
+use IO::Select;
+use JSON::XS qw(decode_json);
+
+# Two subscribers, so that the queued events are shared between clients.
+my @socks = map { IO::Socket::UNIX->new(Peer => get_socket_path()) } (1..2);
+my $payload = '["window"]';
+for my $sock (@socks) {
+    print $sock "i3-ipc" . pack("LL", length($payload), TYPE_SUBSCRIBE) . $payload;
+}
+
+fresh_workspace;
+my $window = open_window;
+
+# Long titles make each event large, so that the socket buffers fill up.
+my $count = 300;
+my $padding = 'x' x 1000;
+for my $i (1..$count) {
+    $window->name("title $i $padding");
+    sync_with_i3;
+}
+
+sub read_message {
+    my ($sock) = @_;
+    my $header;
+    return undef if read($sock, $header, 14) != 14;
+    my ($magic, $size, $type) = unpack("a6LL", $header);
+    my $data = '';
+    while (length($data) < $size) {
+        return undef if read($sock, $data, $size - length($data), length($data)) <= 0;
+    }
+    return { type => $type, data => $data };
+}
+
+for my $sock (@socks) {
+    my $reply = read_message($sock);
+    is($reply->{data}, '{"success":true}', 'subscription reply received first');
+
+    my @titles;
+    my $s = IO::Select->new($sock);
+    while (@titles < $count && $s->can_read(2)) {
+        my $message = read_message($sock);
+        last unless defined($message);
+        my $event = decode_json($message->{data});
+        next unless $event->{change} eq 'title';
+        push @titles, $event->{container}->{name};
+    }
+
+    is(scalar @titles, $count, 'all title events received');
+    is_deeply(\@titles, [ map { "title $_ $padding" } (1..$count) ], 'title events received in order');
+}
+
+close $_ for @socks;
+
+done_testing;
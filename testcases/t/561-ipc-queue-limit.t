@@ -0,0 +1,149 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies the ipc_queue_limit policies for clients which do not read their
+# events: coalescing superseded events, dropping events (followed by a resync
+# event) and disconnecting the client.
+use i3test i3_autostart => 0;
+use AnyEvent::I3 qw(:all);
+use IO::Socket::UNIX;
+use IO::Select;
+use JSON::XS qw(decode_json);
+
+my $count = 300;
+my $padding = 'x' x 4000;
+
+sub subscribe_without_reading {
+    my $sock = IO::Socket::UNIX->new(Peer => get_socket_path());
+    my $payload = '["window"]';
+    print $sock "i3-ipc" . pack("LL", length($payload), TYPE_SUBSCRIBE) . $payload;
+    return $sock;
+}
+
+# Long titles make each event large, so that the socket buffer fills up.
+sub change_titles {
+    my ($window) = @_;
+    for my $i (1..$count) {
+        $window->name("title $i $padding");
+        sync_with_i3;
+    }
+}
+
+sub client_stats {
+    my $i3 = i3(get_socket_path());
+    $i3->connect->recv;
+    my $stats = $i3->message(TYPE_GET_STATS, "")->recv;
+    my @clients = grep { join(',', @{$_->{events}}) eq 'window' } @{$stats->{clients}};
+    return $clients[0];
+}
+
+# Returns all messages received until the connection is closed or no message
+# arrives for a second.
+sub read_messages {
+    my ($sock) = @_;
+    my $s = IO::Select->new($sock);
+    my @messages;
+    while ($s->can_read(1)) {
+        my $header;
+        last if read($sock, $header, 14) != 14;
+        my ($magic, $size, $type) = unpack("a6LL", $header);
+        my $data = '';
+        while (length($data) < $size) {
+            last if read($sock, $data, $size - length($data), length($data)) <= 0;
+        }
+        push @messages, decode_json($data);
+    }
+    return @messages;
+}
+
+################################################################################
+# coalesce: only the latest title of a window is queued.
+################################################################################
+
+my $pid = launch_with_config(<<EOT);
+# i3 config file (v4)
+font -misc-fixed-medium-r-normal--13-120-75-75-C-70-iso10646-1
+ipc_queue_limit 20 coalesce
+EOT
+
+my $sock = subscribe_without_reading;
+fresh_workspace;
+my $window = open_window;
+change_titles($window);
+
+my $client = client_stats;
+cmp_ok($client->{queued_messages}, '<=', 20, 'queue within the limit');
+cmp_ok($client->{coalesced}, '>', 0, 'title events were coalesced');
+is($client->{dropped}, 0, 'no events were dropped');
+
+my @titles = map { $_->{container}->{name} } grep { ($_->{change} // '') eq 'title' } read_messages($sock);
+cmp_ok(scalar @titles, '<', $count, 'fewer title events than title changes');
+is($titles[-1], "title $count $padding", 'latest title received last');
+
+close $sock;
+exit_gracefully($pid);
+
+################################################################################
+# drop: queued events are replaced by a resync event.
+################################################################################
+
+$pid = launch_with_config(<<EOT);
+# i3 config file (v4)
+font -misc-fixed-medium-r-normal--13-120-75-75-C-70-iso10646-1
+ipc_queue_limit 20 drop
+EOT
+
+$sock = subscribe_without_reading;
+fresh_workspace;
+$window = open_window;
+change_titles($window);
+
+$client = client_stats;
+cmp_ok($client->{queued_messages}, '<=', 20, 'queue within the limit');
+cmp_ok($client->{dropped}, '>', 0, 'events were dropped');
+
+my @events = grep { defined($_->{change}) } read_messages($sock);
+my @resyncs = grep { $_->{change} eq 'resync' } @events;
+ok(@resyncs > 0, 'resync event received');
+my $dropped = 0;
+$dropped += $_->{dropped} for @resyncs;
+my $received = grep { $_->{change} eq 'title' } @events;
+is($received + $dropped, $count, 'every title change was either received or counted as dropped');
+
+close $sock;
+exit_gracefully($pid);
+
+################################################################################
+# kill: the client is disconnected as soon as its queue overflows.
+################################################################################
+
+$pid = launch_with_config(<<EOT);
+# i3 config file (v4)
+font -misc-fixed-medium-r-normal--13-120-75-75-C-70-iso10646-1
+ipc_queue_limit 20 kill
+EOT
+
+$sock = subscribe_without_reading;
+fresh_workspace;
+$window = open_window;
+change_titles($window);
+
+ok(!defined(client_stats), 'client disconnected');
+
+close $sock;
+exit_gracefully($pid);
+
+done_testing;
@@ -0,0 +1,77 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that replies to GET_TREE, GET_WORKSPACES and GET_MARKS are served
+# from a cache while the tree does not change, and that every change of the
+# tree shows up in the replies.
+use i3test;
+use AnyEvent::I3 qw(:all);
+use List::Util qw(first);
+
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+
+sub cache_stats {
+    return $i3->message(TYPE_GET_STATS, "")->recv->{reply_cache};
+}
+
+my $ws = fresh_workspace;
+my $window = open_window(name => 'original');
+
+sync_with_i3;
+my $tree = $i3->get_tree->recv;
+my $before = cache_stats;
+is_deeply($i3->get_tree->recv, $tree, 'same tree returned again');
+my $after = cache_stats;
+is($after->{hits}, $before->{hits} + 1, 'second GET_TREE answered from the cache');
+is($after->{misses}, $before->{misses}, 'no reply generated');
+
+# A title change does not render the tree, but must invalidate the cache.
+$window->name('changed');
+sync_with_i3;
+my @nodes = @{get_ws_content($ws)};
+is($nodes[0]->{name}, 'changed', 'new title in GET_TREE reply');
+
+cmd 'mark foo';
+is_deeply($i3->get_marks->recv, [ 'foo' ], 'new mark in GET_MARKS reply');
+$before = cache_stats;
+is_deeply($i3->get_marks->recv, [ 'foo' ], 'same marks returned again');
+$after = cache_stats;
+is($after->{hits}, $before->{hits} + 1, 'second GET_MARKS answered from the cache');
+
+# Events which do not change anything keep the cache: i3 sync requests, and
+# the focus moving to the root window (i3 gives it back to the focused window
+# and receives a FocusIn event for both).
+$tree = $i3->get_tree->recv;
+$before = cache_stats;
+sync_with_i3;
+# RevertToPointerRoot (1), CurrentTime (0)
+$x->set_input_focus(1, $x->get_root_window(), 0);
+$x->flush;
+sync_with_i3;
+is($x->input_focus, $window->id, 'focus given back to the window');
+sync_with_i3;
+is_deeply($i3->get_tree->recv, $tree, 'same tree after idle events');
+$after = cache_stats;
+is($after->{hits}, $before->{hits} + 1, 'GET_TREE answered from the cache after idle events');
+is($after->{misses}, $before->{misses}, 'no reply generated after idle events');
+
+my $other = fresh_workspace;
+my $workspaces = $i3->get_workspaces->recv;
+my $focused = first { $_->{focused} } @$workspaces;
+is($focused->{name}, $other, 'new workspace focused in GET_WORKSPACES reply');
+
+done_testing;
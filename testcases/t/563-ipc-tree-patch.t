@@ -0,0 +1,161 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that GET_TREE_PATCH returns only the containers which changed since
+# a given generation, and that tree_patch events carry the same changes.
+use i3test;
+use AnyEvent::I3 qw(:all);
+use List::Util qw(first);
+
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+
+sub tree_patch {
+    my ($since) = @_;
+    return $i3->message(TYPE_GET_TREE_PATCH, $since)->recv;
+}
+
+sub changed_window {
+    my ($patch, $window) = @_;
+    return first { defined($_->{window}) && $_->{window} == $window->id } @{$patch->{changed}};
+}
+
+my $ws = fresh_workspace;
+sync_with_i3;
+
+my $full = tree_patch('');
+ok($full->{full}, 'patch without a generation is full');
+is($full->{changed}->[0]->{type}, 'root', 'root container comes first');
+my $total = scalar @{$full->{changed}};
+
+my $window = open_window(name => 'first');
+sync_with_i3;
+
+my $patch = tree_patch($full->{generation});
+ok(!$patch->{full}, 'patch is not full');
+cmp_ok($patch->{generation}, '>', $full->{generation}, 'generation increased');
+my $con = changed_window($patch, $window);
+ok(defined($con), 'new window in the patch');
+is_deeply($con->{nodes}, [], 'nodes contains IDs only');
+my $workspace = first { $_->{type} eq 'workspace' } @{$patch->{changed}};
+is($workspace->{name}, $ws, 'workspace of the new window in the patch');
+is_deeply($workspace->{nodes}, [ $con->{id} ], 'workspace lists the new window by ID');
+cmp_ok(scalar @{$patch->{changed}}, '<', $total, 'not all containers changed');
+
+# Nothing changes between two patches.
+sync_with_i3;
+my $before = tree_patch($patch->{generation});
+my $after = tree_patch($before->{generation});
+is_deeply($after->{changed}, [], 'no containers changed');
+is_deeply($after->{removed}, [], 'no containers removed');
+
+$window->unmap;
+wait_for_unmap($window);
+
+$patch = tree_patch($after->{generation});
+ok((grep { $_ == $con->{id} } @{$patch->{removed}}), 'closed window removed');
+
+# A generation from the future cannot be served incrementally.
+ok(tree_patch($patch->{generation} + 1000)->{full}, 'unknown generation results in a full patch');
+
+################################################################################
+# Container IDs are addresses, so a container created right after another one
+# was freed often gets the same ID. The patch then contains the ID in both
+# "removed" and "changed" (clients apply "removed" first).
+################################################################################
+
+sub con_id {
+    my ($window) = @_;
+    my $con = first { defined($_->{window}) && $_->{window} == $window->id } @{get_ws_content($ws)};
+    return $con->{id};
+}
+
+my ($reused_patch, $reused_id);
+for (1..10) {
+    my $old = open_window;
+    my $old_id = con_id($old);
+    my $since = tree_patch('')->{generation};
+
+    $old->unmap;
+    wait_for_unmap($old);
+    my $new = open_window;
+    my $new_id = con_id($new);
+    my $reuse_patch = tree_patch($since);
+
+    $new->unmap;
+    wait_for_unmap($new);
+
+    if ($new_id == $old_id) {
+        ($reused_patch, $reused_id) = ($reuse_patch, $new_id);
+        last;
+    }
+}
+
+SKIP: {
+    skip 'no container ID was reused', 3 unless defined($reused_id);
+
+    ok(!$reused_patch->{full}, 'patch with a reused ID is not full');
+    ok((grep { $_ == $reused_id } @{$reused_patch->{removed}}), 'reused ID removed');
+    ok((grep { $_->{id} == $reused_id } @{$reused_patch->{changed}}), 'reused ID changed');
+}
+
+################################################################################
+# tree_patch events carry the changes, once per event loop iteration.
+################################################################################
+
+$window = open_window(name => 'before');
+my $title = AnyEvent->condvar;
+my $first_full;
+$i3->subscribe({
+    tree_patch => sub {
+        my ($event) = @_;
+        $first_full //= $event->{full};
+        my $con = changed_window($event, $window);
+        $title->send($con->{name}) if defined($con) && $con->{name} eq 'after';
+    }
+})->recv;
+
+$window->name('after');
+sync_with_i3;
+
+my $t = AnyEvent->timer(after => 2, cb => sub { $title->send(undef) });
+is($title->recv, 'after', 'tree_patch event with the new title received');
+ok($first_full, 'first event of the first subscriber is full');
+
+# A client which subscribes later gets a full patch first as well, while the
+# other subscriber keeps getting the changes only.
+my $second_i3 = i3(get_socket_path());
+$second_i3->connect->recv;
+my $second_event = AnyEvent->condvar;
+$second_i3->subscribe({
+    tree_patch => sub { $second_event->send($_[0]) },
+})->recv;
+
+my $first_event = AnyEvent->condvar;
+$i3->subscribe({
+    tree_patch => sub { $first_event->send($_[0]) },
+})->recv;
+
+$window->name('again');
+sync_with_i3;
+
+$t = AnyEvent->timer(after => 2, cb => sub { $first_event->send(undef); $second_event->send(undef) });
+my $event = $second_event->recv;
+ok(defined($event) && $event->{full}, 'first event of a later subscriber is full');
+$event = $first_event->recv;
+ok(defined($event) && !$event->{full}, 'earlier subscriber gets a partial patch');
+
+done_testing;
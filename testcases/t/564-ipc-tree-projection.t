@@ -0,0 +1,101 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that GET_TREE can restrict the reply to some properties of each
+# container and to the containers matching criteria.
+use i3test;
+use AnyEvent::I3 qw(:all);
+use List::Util qw(first);
+
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+
+sub get_tree {
+    my ($request) = @_;
+    return $i3->message(TYPE_GET_TREE, $request)->recv;
+}
+
+# Returns all containers of the given (possibly partial) tree.
+sub all_nodes {
+    my ($node) = @_;
+    return ($node, map { all_nodes($_) } (@{$node->{nodes}}, @{$node->{floating_nodes}}));
+}
+
+my $ws = fresh_workspace;
+my $first = open_window(wm_class => 'projection-first', name => 'first');
+my $second = open_window(wm_class => 'projection-second', name => 'second');
+my $other_ws = fresh_workspace;
+my $third = open_window(wm_class => 'projection-first', name => 'third');
+
+################################################################################
+# Field projection.
+################################################################################
+
+my $tree = get_tree({ fields => [ 'id', 'name' ] });
+my @nodes = all_nodes($tree);
+cmp_ok(scalar @nodes, '>', 1, 'whole tree returned');
+my @keys = sort keys %{$nodes[0]};
+is_deeply(\@keys, [ 'floating_nodes', 'id', 'name', 'nodes' ], 'only the requested fields');
+ok((first { defined($_->{name}) && $_->{name} eq 'second' } @nodes), 'window found');
+
+################################################################################
+# Criteria filtering.
+################################################################################
+
+$tree = get_tree({ criteria => '[class="^projection-first$"]' });
+my @windows = grep { defined($_->{window}) } all_nodes($tree);
+is_deeply([ sort map { $_->{name} } @windows ], [ 'first', 'third' ], 'only matching windows');
+my @workspaces = grep { $_->{type} eq 'workspace' } all_nodes($tree);
+is_deeply([ sort map { $_->{name} } @workspaces ], [ sort ($ws, $other_ws) ], 'ancestors included');
+
+$tree = get_tree({ criteria => "[class=\"^projection-first\$\" workspace=\"^$ws\$\"]", fields => [ 'name', 'focused' ] });
+@windows = grep { defined($_->{name}) && $_->{name} eq 'first' } all_nodes($tree);
+is(scalar @windows, 1, 'criteria are combined');
+ok(!(first { defined($_->{name}) && $_->{name} eq 'third' } all_nodes($tree)), 'window on other workspace excluded');
+ok(!exists($windows[0]->{window}), 'fields and criteria combined');
+
+$tree = get_tree({ criteria => '[con_id="' . get_focused($other_ws) . '"]' });
+@windows = grep { defined($_->{window}) } all_nodes($tree);
+is_deeply([ map { $_->{name} } @windows ], [ 'third' ], 'con_id criterion');
+
+$tree = get_tree({ criteria => '[class="^does-not-exist$"]' });
+is(scalar @{$tree->{nodes}}, 0, 'nothing matched');
+
+# Escaped quotes work like in command criteria.
+my $quoted = open_window(name => 'say "hi"');
+$tree = get_tree({ criteria => '[title="^say \\"hi\\"$"]' });
+@windows = grep { defined($_->{window}) } all_nodes($tree);
+is_deeply([ map { $_->{window} } @windows ], [ $quoted->id ], 'escaped quotes in criteria');
+
+################################################################################
+# Invalid requests.
+################################################################################
+
+my $reply = get_tree({ fields => [ 'no-such-field' ] });
+ok(!$reply->{success}, 'unknown field rejected');
+like($reply->{error}, qr/no-such-field/, 'error names the field');
+
+$reply = get_tree({ criteria => '[con_id="foo"]' });
+ok(!$reply->{success}, 'invalid criteria rejected');
+
+$reply = get_tree({ criteria => '[no_such_key="foo"]' });
+ok(!$reply->{success}, 'unknown criterion rejected');
+like($reply->{error}, qr/Expected one of these tokens/, 'error lists the known criteria');
+
+$reply = get_tree({ criteria => 'class="foo"' });
+ok(!$reply->{success}, 'criteria without brackets rejected');
+
+done_testing;
@@ -0,0 +1,182 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that clients can select the CBOR encoding for replies and events,
+# and that it encodes the same data as the JSON encoding.
+use i3test;
+use AnyEvent::I3 qw(:all);
+use IO::Socket::UNIX;
+use JSON::XS qw(decode_json);
+
+# A CBOR decoder for the subset of CBOR which i3 generates.
+sub decode_cbor_item {
+    my ($data, $pos) = @_;
+    my $initial = ord(substr($$data, $$pos++, 1));
+    return (undef, 1) if $initial == 0xff;
+    my $major = $initial >> 5;
+    my $info = $initial & 0x1f;
+
+    if ($major == 7) {
+        return JSON::XS::false if $initial == 0xf4;
+        return JSON::XS::true if $initial == 0xf5;
+        return undef if $initial == 0xf6;
+        if ($initial == 0xfb) {
+            my $value = unpack('d>', substr($$data, $$pos, 8));
+            $$pos += 8;
+            return $value;
+        }
+        die sprintf('unexpected simple value 0x%02x', $initial);
+    }
+
+    my $argument = $info;
+    if ($info >= 24 && $info <= 27) {
+        my $bytes = 1 << ($info - 24);
+        $argument = 0;
+        $argument = ($argument << 8) | ord(substr($$data, $$pos++, 1)) for (1..$bytes);
+    }
+
+    return $argument if $major == 0;
+    return -1 - $argument if $major == 1;
+    if ($major == 3) {
+        my $str = substr($$data, $$pos, $argument);
+        $$pos += $argument;
+        utf8::decode($str);
+        return $str;
+    }
+    if ($major == 4) {
+        my @array;
+        while (1) {
+            my ($item, $break) = decode_cbor_item($data, $pos);
+            last if $break;
+            push @array, $item;
+        }
+        return \@array;
+    }
+    if ($major == 5) {
+        my %map;
+        while (1) {
+            my ($key, $break) = decode_cbor_item($data, $pos);
+            last if $break;
+            ($map{$key}) = decode_cbor_item($data, $pos);
+        }
+        return \%map;
+    }
+    die "unexpected major type $major";
+}
+
+sub decode_cbor {
+    my ($data) = @_;
+    my $pos = 0;
+    my ($item) = decode_cbor_item(\$data, \$pos);
+    is($pos, length($data), 'whole CBOR message decoded');
+    return $item;
+}
+
+sub send_message {
+    my ($sock, $type, $payload) = @_;
+    print $sock "i3-ipc" . pack("LL", length($payload), $type) . $payload;
+}
+
+sub read_message {
+    my ($sock) = @_;
+    my $header;
+    return undef if read($sock, $header, 14) != 14;
+    my ($magic, $size, $type) = unpack("a6LL", $header);
+    my $data = '';
+    while (length($data) < $size) {
+        return undef if read($sock, $data, $size - length($data), length($data)) <= 0;
+    }
+    return { type => $type, data => $data };
+}
+
+# Returns the reply to the given message in both encodings.
+sub both_encodings {
+    my ($type, $payload) = @_;
+
+    my $json = IO::Socket::UNIX->new(Peer => get_socket_path());
+    send_message($json, $type, $payload);
+    my $json_reply = read_message($json);
+
+    my $cbor = IO::Socket::UNIX->new(Peer => get_socket_path());
+    send_message($cbor, TYPE_SET_ENCODING, 'cbor');
+    my $reply = read_message($cbor);
+    is($reply->{type}, TYPE_SET_ENCODING, 'ENCODING reply received');
+    is_deeply(decode_json($reply->{data}), { success => JSON::XS::true }, 'CBOR encoding selected (reply in JSON)');
+    send_message($cbor, $type, $payload);
+    my $cbor_reply = read_message($cbor);
+    is($cbor_reply->{type}, $type, 'reply type unchanged');
+
+    close($json);
+    close($cbor);
+    return (decode_json($json_reply->{data}), decode_cbor($cbor_reply->{data}));
+}
+
+fresh_workspace;
+open_window(name => "ünïcödé window");
+open_floating_window;
+sync_with_i3;
+
+my ($json, $cbor) = both_encodings(TYPE_GET_VERSION, '');
+is_deeply($cbor, $json, 'GET_VERSION: same data in both encodings');
+
+($json, $cbor) = both_encodings(TYPE_GET_WORKSPACES, '');
+is_deeply($cbor, $json, 'GET_WORKSPACES: same data in both encodings');
+
+($json, $cbor) = both_encodings(TYPE_GET_TREE, '');
+is_deeply($cbor, $json, 'GET_TREE: same data in both encodings');
+
+################################################################################
+# Events use the selected encoding, too.
+################################################################################
+
+my $sock = IO::Socket::UNIX->new(Peer => get_socket_path());
+send_message($sock, TYPE_SET_ENCODING, 'cbor');
+read_message($sock);
+send_message($sock, TYPE_SUBSCRIBE, '["tick"]');
+my $reply = read_message($sock);
+is_deeply(decode_cbor($reply->{data}), { success => JSON::XS::true }, 'SUBSCRIBE reply in CBOR');
+my $event = read_message($sock);
+is_deeply(decode_cbor($event->{data}), { first => JSON::XS::true, payload => '' }, 'first tick event in CBOR');
+
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+$i3->message(TYPE_SEND_TICK, 'hello')->recv;
+$event = read_message($sock);
+is_deeply(decode_cbor($event->{data}), { first => JSON::XS::false, payload => 'hello' }, 'tick event in CBOR');
+
+my $stats = $i3->message(TYPE_GET_STATS, '')->recv;
+my @cbor_clients = grep { $_->{encoding} eq 'cbor' } @{$stats->{clients}};
+is(scalar @cbor_clients, 1, 'client listed with the CBOR encoding');
+
+# Switching back to JSON.
+send_message($sock, TYPE_SET_ENCODING, 'json');
+$reply = read_message($sock);
+is_deeply(decode_cbor($reply->{data}), { success => JSON::XS::true }, 'ENCODING reply in the previous encoding');
+$i3->message(TYPE_SEND_TICK, 'json again')->recv;
+$event = read_message($sock);
+is(decode_json($event->{data})->{payload}, 'json again', 'tick event in JSON again');
+
+################################################################################
+# Unknown encodings are rejected.
+################################################################################
+
+send_message($sock, TYPE_SET_ENCODING, 'xml');
+$reply = decode_json(read_message($sock)->{data});
+ok(!$reply->{success}, 'unknown encoding rejected');
+
+close($sock);
+
+done_testing;
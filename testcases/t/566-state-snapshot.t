@@ -0,0 +1,121 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that i3 publishes a snapshot of the workspaces and windows in shared
+# memory (advertised in the I3_SNAPSHOT_PATH atom) after rendering.
+use i3test;
+use X11::XCB qw(GET_PROPERTY_TYPE_ANY);
+
+my $atom = $x->atom(name => 'I3_SNAPSHOT_PATH');
+my $cookie = $x->get_property(0, $x->get_root_window(), $atom->id, GET_PROPERTY_TYPE_ANY, 0, 256);
+my $reply = $x->get_property_reply($cookie->{sequence});
+my $name = $reply->{value};
+ok(defined($name) && length($name) > 0, 'I3_SNAPSHOT_PATH is set');
+
+SKIP: {
+    skip 'shared memory is not mounted at /dev/shm', 17 unless -d '/dev/shm';
+
+    # Reads the snapshot and decodes the header, workspaces and windows (see
+    # include/i3/snapshot.h).
+    sub read_snapshot {
+        open(my $fh, '<:raw', "/dev/shm$name") or die "open: $!";
+        local $/;
+        my $data = <$fh>;
+        close($fh);
+
+        my ($sequence, $magic, $version, $size, $generation, $focused,
+            $num_outputs, $num_workspaces, $num_windows, $strings_size,
+            $outputs_offset, $workspaces_offset, $windows_offset, $strings_offset) =
+            unpack('LLLLQQLLLLLLLL', $data);
+        my $string = sub {
+            my $offset = $strings_offset + shift;
+            return unpack('Z*', substr($data, $offset));
+        };
+
+        my @workspaces;
+        for my $i (0 .. $num_workspaces - 1) {
+            my ($id, $name, $num, $output, $flags) =
+                unpack('QLlLL', substr($data, $workspaces_offset + 40 * $i, 40));
+            push @workspaces, { id => $id, name => $string->($name), num => $num, flags => $flags };
+        }
+
+        my @windows;
+        for my $i (0 .. $num_windows - 1) {
+            my ($id, $window, $workspace, $class, $instance, $title, $flags) =
+                unpack('QLLLLLL', substr($data, $windows_offset + 48 * $i, 48));
+            push @windows, {
+                id => $id,
+                window => $window,
+                workspace => $workspace == 0xffffffff ? undef : $workspaces[$workspace]->{name},
+                class => $string->($class),
+                title => $string->($title),
+                flags => $flags,
+            };
+        }
+
+        return {
+            sequence => $sequence,
+            magic => $magic,
+            version => $version,
+            focused => $focused,
+            num_outputs => $num_outputs,
+            workspaces => \@workspaces,
+            windows => \@windows,
+        };
+    }
+
+    my $tmp = fresh_workspace;
+    my $window = open_window(name => 'snapshot title', wm_class => 'snapshot-class');
+    sync_with_i3;
+
+    my $snapshot = read_snapshot;
+    is($snapshot->{magic}, 0x6e733369, 'magic matches');
+    is($snapshot->{version}, 1, 'version 1');
+    is($snapshot->{sequence} % 2, 0, 'snapshot is not being written');
+    cmp_ok($snapshot->{num_outputs}, '>=', 1, 'at least one output');
+
+    my ($ws) = grep { $_->{name} eq $tmp } @{$snapshot->{workspaces}};
+    ok(defined($ws), 'workspace is in the snapshot');
+    ok($ws->{flags} & 1, 'workspace is focused');
+    ok($ws->{flags} & 4, 'workspace is visible');
+
+    my ($win) = grep { $_->{window} == $window->id } @{$snapshot->{windows}};
+    ok(defined($win), 'window is in the snapshot');
+    is($win->{title}, 'snapshot title', 'title matches');
+    is($win->{class}, 'snapshot-class', 'class matches');
+    is($win->{workspace}, $tmp, 'workspace matches');
+    ok($win->{flags} & 1, 'window is focused');
+    is($snapshot->{focused}, get_focused($tmp), 'focused container matches GET_TREE');
+
+    # A change of the title is visible in the next snapshot.
+    $window->name('changed title');
+    sync_with_i3;
+
+    my $next = read_snapshot;
+    cmp_ok($next->{sequence}, '>', $snapshot->{sequence}, 'sequence increased');
+    ($win) = grep { $_->{window} == $window->id } @{$next->{windows}};
+    is($win->{title}, 'changed title', 'changed title in the snapshot');
+
+    # Windows in the scratchpad are on no workspace.
+    cmd 'move scratchpad';
+    sync_with_i3;
+
+    ($win) = grep { $_->{window} == $window->id } @{read_snapshot()->{windows}};
+    ok(defined($win), 'scratchpad window is in the snapshot');
+    ok(!defined($win->{workspace}), 'scratchpad window is on no workspace');
+}
+
+done_testing;
@@ -0,0 +1,112 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies the per-client, per-handler and per-event counters of GET_STATS,
+# also when requested with i3-msg -t get_stats.
+use i3test;
+use AnyEvent::I3 qw(:all);
+use IO::Socket::UNIX;
+use JSON::XS qw(decode_json);
+
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+
+sub stats {
+    return $i3->message(TYPE_GET_STATS, "")->recv;
+}
+
+# Reads one message from the raw socket.
+sub read_message {
+    my ($sock) = @_;
+    my $header;
+    read($sock, $header, 14) == 14 or die "short read";
+    my ($magic, $size, $type) = unpack("a6LL", $header);
+    my $data = '';
+    read($sock, $data, $size) == $size or die "short read";
+    return ($type, decode_json($data));
+}
+
+# A client identified by its (otherwise unused) subscription to tick events.
+my $time_before = time;
+my $sock = IO::Socket::UNIX->new(Peer => get_socket_path());
+my $payload = '["tick"]';
+print $sock "i3-ipc" . pack("LL", length($payload), TYPE_SUBSCRIBE) . $payload;
+read_message($sock);
+my ($type, $tick) = read_message($sock);
+is($tick->{first}, 1, 'first tick event received');
+
+sub tick_client {
+    my @clients = grep { join(',', @{$_->{events}}) eq 'tick' } @{stats()->{clients}};
+    return $clients[0];
+}
+
+my $client = tick_client;
+ok(defined($client), 'client found');
+is($client->{received_messages}, 1, 'one message received from the client');
+is($client->{delivered_events}, 1, 'first tick event delivered');
+cmp_ok($client->{sent_bytes}, '>', 2 * 14, 'reply and event sent');
+is($client->{total_queued_bytes}, 0, 'nothing had to be queued');
+cmp_ok($client->{connect_time}, '>=', $time_before, 'connect time is plausible');
+cmp_ok($client->{connect_time}, '<=', time, 'connect time is not in the future');
+
+################################################################################
+# Event fan-out and delivery.
+################################################################################
+
+my $before = stats->{events}->{tick};
+$i3->message(TYPE_SEND_TICK, "stats")->recv;
+($type, $tick) = read_message($sock);
+is($tick->{payload}, 'stats', 'tick event received');
+
+my $after = stats->{events}->{tick};
+is($after->{serialized}, $before->{serialized} + 1, 'one tick event serialized');
+is($after->{recipients}, $before->{recipients} + 1, 'sent to one client');
+is(tick_client->{delivered_events}, 2, 'second tick event delivered');
+
+################################################################################
+# Handler and render durations.
+################################################################################
+
+my $stats = stats;
+my $handler = $stats->{handlers}->{get_stats};
+cmp_ok($handler->{count}, '>=', 3, 'GET_STATS handled at least three times');
+is(scalar @{$handler->{buckets}}, 10, 'ten buckets');
+ok(!defined($handler->{buckets}->[-1]->{le_usec}), 'last bucket is unbounded');
+my $sum = 0;
+$sum += $_->{count} for @{$handler->{buckets}};
+is($sum, $handler->{count}, 'buckets add up to the count');
+cmp_ok($handler->{max_usec}, '<=', $handler->{total_usec}, 'maximum within the total');
+is($stats->{handlers}->{send_tick}->{count}, 1, 'SEND_TICK handled once');
+
+fresh_workspace;
+open_window;
+my $render = stats->{render};
+cmp_ok($render->{durations}->{count}, '>', 0, 'render durations measured');
+is($render->{durations}->{count}, $render->{renders}, 'every render measured');
+
+################################################################################
+# i3-msg -t get_stats
+################################################################################
+
+my $socket_path = get_socket_path();
+my $output = qx(i3-msg -s '$socket_path' -t get_stats);
+is($?, 0, 'i3-msg exited successfully');
+my $reply = decode_json($output);
+ok(exists($reply->{handlers}->{get_stats}), 'i3-msg printed the statistics');
+
+close($sock);
+
+done_testing;
@@ -0,0 +1,76 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that i3-dump-log formats the binary records of the SHM log like i3
+# formatted log messages before, and that readers of the old text format get
+# a notice instead of garbage.
+use i3test;
+use AnyEvent::I3 qw(:all);
+use IPC::Run qw(run);
+use File::Temp;
+use X11::XCB qw(GET_PROPERTY_TYPE_ANY);
+
+cmd 'shmlog on';
+
+my $random_nop = mktemp('nop.XXXXXX');
+cmd "nop $random_nop";
+# %.4000s truncates the argument when formatting.
+my $long_nop = 'y' x 5000;
+cmd "nop $long_nop";
+# The name of an unknown event is logged as a %.*s slice of the payload, which
+# is not NUL-terminated there. Only the slice must end up in the log.
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+$i3->message(TYPE_SUBSCRIBE, '["bogus_event","window"]')->recv;
+
+my ($stdout, $stderr);
+run [ 'i3-dump-log' ],
+    '>', \$stdout,
+    '2>', \$stderr;
+
+like($stdout, qr#^\S+ \S+ -   NOP: $random_nop$#m, 'nop formatted with time prefix');
+like($stdout, qr#^\S+ \S+ - [^ ]+\.c:[a-z_]+:\d+ - #m, 'DLOG prefix formatted');
+like($stdout, qr#^\S+ \S+ -   NOP: y{4000}$#m, 'precision applied to string argument');
+like($stdout, qr#unknown event bogus_event$#m, 'only the precision of a string argument is stored');
+unlike($stdout, qr#malformed log record#, 'no malformed records');
+is($stderr, '', 'stderr empty');
+
+################################################################################
+# Readers of the text format (version 1) print the legacy notice.
+################################################################################
+
+SKIP: {
+    skip 'shared memory is not mounted at /dev/shm', 3 unless -d '/dev/shm';
+
+    my $atom = $x->atom(name => 'I3_SHMLOG_PATH');
+    my $cookie = $x->get_property(0, $x->get_root_window(), $atom->id, GET_PROPERTY_TYPE_ANY, 0, 256);
+    my $name = $x->get_property_reply($cookie->{sequence})->{value};
+
+    open(my $fh, '<:raw', "/dev/shm$name") or die "open: $!";
+    my $data;
+    read($fh, $data, 176);
+    close($fh);
+
+    my ($next_write, $last_wrap, $size, $wrap_count) = unpack('LLLL', $data);
+    my $text = substr($data, 16, $next_write - 16);
+    like($text, qr#newer format#, 'old readers print the notice');
+    is($wrap_count, 0, 'old readers do not see a wrap');
+    is(unpack('L', substr($data, 128, 4)), 3, 'version 3');
+}
+
+cmd 'shmlog off';
+
+done_testing;
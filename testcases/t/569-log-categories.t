@@ -0,0 +1,82 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that the debuglog categories command enables and disables debug
+# log categories and that messages of disabled categories are not logged.
+use i3test;
+use AnyEvent::I3 qw(:all);
+use IPC::Run qw(run);
+use File::Temp;
+
+sub log_categories {
+    my $i3 = i3(get_socket_path());
+    $i3->connect->recv;
+    return join(',', @{$i3->message(TYPE_GET_STATS, "")->recv->{log_categories}});
+}
+
+sub dump_log {
+    my ($stdout, $stderr);
+    run [ 'i3-dump-log' ],
+        '>', \$stdout,
+        '2>', \$stderr;
+    return $stdout;
+}
+
+is(log_categories, 'general,x,render,ipc,manage,bindings,randr,match,commands',
+   'all categories but sequences enabled by default');
+
+my $result = cmd 'debuglog categories manage,match';
+ok($result->[0]->{success}, 'debuglog categories succeeded');
+is(log_categories, 'manage,match', 'categories replaced');
+
+cmd 'debuglog categories +ipc,-match';
+is(log_categories, 'ipc,manage', 'categories added and removed');
+
+cmd 'debuglog categories none';
+is(log_categories, '', 'no categories enabled');
+
+$result = cmd 'debuglog categories all,-x';
+is(log_categories, 'general,render,ipc,manage,bindings,randr,match,commands,sequences',
+   'all categories but x enabled');
+
+$result = cmd 'debuglog categories manage,bogus';
+ok(!$result->[0]->{success}, 'unknown category rejected');
+is(log_categories, 'general,render,ipc,manage,bindings,randr,match,commands,sequences',
+   'categories unchanged after an error');
+
+################################################################################
+# Messages of disabled categories are not written to the SHM log.
+################################################################################
+
+cmd 'shmlog on';
+
+cmd 'debuglog categories -commands';
+my $first_nop = mktemp('nop.XXXXXX');
+cmd "nop $first_nop";
+
+cmd 'debuglog categories +commands';
+my $second_nop = mktemp('nop.XXXXXX');
+cmd "nop $second_nop";
+
+my $log = dump_log;
+like($log, qr#NOP: $first_nop$#m, 'verbose message logged regardless of the categories');
+unlike($log, qr#COMMAND: \*nop $first_nop\*#, 'command not logged while disabled');
+like($log, qr#COMMAND: \*nop $second_nop\*#, 'command logged while enabled');
+
+cmd 'shmlog off';
+cmd 'debuglog categories all,-sequences';
+
+done_testing;
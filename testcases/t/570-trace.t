@@ -0,0 +1,62 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that the trace command records spans and that GET_TRACE returns
+# them in the Chrome trace event format.
+use i3test;
+use AnyEvent::I3 qw(:all);
+
+sub get_trace {
+    my $i3 = i3(get_socket_path());
+    $i3->connect->recv;
+    return $i3->message(TYPE_GET_TRACE, "")->recv;
+}
+
+my $trace = get_trace;
+is(scalar grep({ $_->{ph} eq 'X' } @{$trace->{traceEvents}}), 0, 'no spans before tracing was enabled');
+ok(!$trace->{otherData}->{enabled}, 'tracing disabled by default');
+
+cmd 'trace on';
+
+fresh_workspace;
+open_window;
+cmd 'nop traced';
+sync_with_i3;
+
+cmd 'trace off';
+
+$trace = get_trace;
+ok(!$trace->{otherData}->{enabled}, 'tracing disabled again');
+
+my @spans = grep { $_->{ph} eq 'X' } @{$trace->{traceEvents}};
+my %names = map { ($_->{name} => 1) } @spans;
+for my $name (qw(run_command parse_command tree_render render_con x_push_changes manage_window MapRequest)) {
+    ok($names{$name}, "$name span recorded");
+}
+
+is(scalar grep({ !defined($_->{ts}) || !defined($_->{dur}) || $_->{dur} < 0 } @spans), 0,
+   'all spans have a start and a duration');
+is($trace->{otherData}->{recorded_spans}, scalar @spans, 'all recorded spans returned');
+
+my ($render) = grep { $_->{name} eq 'render_con' } @spans;
+my ($tree_render) = grep { $_->{name} eq 'tree_render' && $_->{ts} <= $render->{ts} } @spans;
+ok(defined($tree_render), 'render_con nested in tree_render');
+
+# Spans are not recorded while tracing is disabled.
+cmd 'nop untraced';
+is(get_trace->{otherData}->{recorded_spans}, scalar @spans, 'no spans recorded while disabled');
+
+done_testing;
@@ -0,0 +1,72 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies that log clients which do not read (like a stalled i3-dump-log -f)
+# do not block i3: their messages are buffered, then dropped, and a marker
+# tells them how many messages are missing.
+use i3test;
+use AnyEvent::I3 qw(:all);
+use IO::Socket::UNIX;
+use IO::Select;
+use X11::XCB qw(GET_PROPERTY_TYPE_ANY);
+
+sub log_clients {
+    my $i3 = i3(get_socket_path());
+    $i3->connect->recv;
+    return $i3->message(TYPE_GET_STATS, "")->recv->{log_clients};
+}
+
+cmd 'shmlog on';
+cmd 'debuglog on';
+
+my $atom = $x->atom(name => 'I3_LOG_STREAM_SOCKET_PATH');
+my $cookie = $x->get_property(0, $x->get_root_window(), $atom->id, GET_PROPERTY_TYPE_ANY, 0, 256);
+my $path = $x->get_property_reply($cookie->{sequence})->{value};
+
+my $sock = IO::Socket::UNIX->new(Peer => $path);
+ok(defined($sock), 'connected to the log stream socket');
+sync_with_i3;
+
+# Each command is logged with its (long) argument a few times, so that the
+# socket buffer and the client buffer overflow quickly.
+my $padding = 'x' x 3000;
+my $result;
+for my $i (1..500) {
+    $result = cmd "nop $i $padding";
+}
+ok($result->[0]->{success}, 'i3 still handles commands');
+
+my @clients = @{log_clients()};
+is(scalar @clients, 1, 'one log client');
+cmp_ok($clients[0]->{buffered_bytes}, '>', 0, 'messages buffered');
+cmp_ok($clients[0]->{dropped}, '>', 0, 'messages dropped');
+
+# Read everything, which makes i3 flush the buffer and append the marker.
+my $s = IO::Select->new($sock);
+my $log = '';
+while ($s->can_read(1)) {
+    last if sysread($sock, $log, 65536, length($log)) <= 0;
+    last if $log =~ /messages dropped/ && $log =~ /\n\z/;
+}
+
+like($log, qr#^\[i3\] \d+ messages dropped#m, 'dropped marker received');
+like($log, qr#NOP: 1 x+$#m, 'first messages received');
+
+close $sock;
+cmd 'debuglog off';
+cmd 'shmlog off';
+
+done_testing;
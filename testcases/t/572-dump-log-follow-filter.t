@@ -0,0 +1,97 @@
+#!perl
+# vim:ts=4:sw=4:expandtab
+#
+# Please read the following documents before working on tests:
+# • https://build.i3wm.org/docs/testsuite.html
+#   (or docs/testsuite)
+#
+# • https://build.i3wm.org/docs/lib-i3test.html
+#   (alternatively: perldoc ./testcases/lib/i3test.pm)
+#
+# • https://build.i3wm.org/docs/ipc.html
+#   (or docs/ipc)
+#
+# • https://i3wm.org/downloads/modern_perl_a4.pdf
+#   (unless you are already familiar with Perl)
+#
+# Verifies the level and category filters of i3-dump-log, dumping and reading
+# back the binary log (-r/-i), and that i3-dump-log -f follows the SHM log
+# itself instead of asking i3 for formatted messages.
+use i3test;
+use AnyEvent::I3 qw(:all);
+use IPC::Run qw(run start pump timeout);
+use File::Temp qw(tempfile);
+
+sub dump_log {
+    my ($stdout, $stderr);
+    run [ 'i3-dump-log', @_ ],
+        '>', \$stdout,
+        '2>', \$stderr;
+    return $stdout;
+}
+
+cmd 'shmlog on';
+cmd 'debuglog on';
+
+my $nop = 'marker-' . int(rand(1_000_000));
+cmd "nop $nop";
+
+my $debug_line = qr#^\S+ \S+ - [^ ]+\.c:[a-z_]+:\d+ - #m;
+
+################################################################################
+# Filters
+################################################################################
+
+my $log = dump_log;
+like($log, qr#NOP: $nop$#m, 'info message dumped');
+like($log, $debug_line, 'debug messages dumped');
+
+$log = dump_log('-l', 'info');
+like($log, qr#NOP: $nop$#m, 'info message dumped with -l info');
+unlike($log, $debug_line, 'no debug messages with -l info');
+
+$log = dump_log('-l', 'error');
+unlike($log, qr#NOP: $nop$#m, 'no info message with -l error');
+
+$log = dump_log('-c', 'commands');
+like($log, qr#commands_parser\.c:parse_command:\d+ - COMMAND: \*nop $nop\*#, 'commands debug message dumped');
+unlike($log, qr# - [^ ]+/x\.c:#, 'no x debug messages');
+like($log, qr#NOP: $nop$#m, 'info message dumped regardless of the categories');
+
+################################################################################
+# Raw dump, formatted later
+################################################################################
+
+my ($fh, $filename) = tempfile(UNLINK => 1);
+close($fh);
+run [ 'i3-dump-log', '-r' ], '>', $filename;
+cmp_ok(-s $filename, '>', 0, 'raw log written');
+like(dump_log('-i', $filename), qr#NOP: $nop$#m, 'message found in the raw log');
+
+################################################################################
+# Follow mode
+################################################################################
+
+my $out = '';
+my $follower = start [ 'i3-dump-log', '-f', '-l', 'info' ], '>', \$out, timeout(10);
+# Give i3-dump-log time to print the log so far.
+pump $follower until $out =~ /NOP: $nop$/m;
+
+my $followed = 'followed-' . int(rand(1_000_000));
+cmd "nop $followed";
+pump $follower until $out =~ /NOP: $followed$/m;
+like($out, qr#NOP: $followed$#m, 'new message printed by the follower');
+
+my $i3 = i3(get_socket_path());
+$i3->connect->recv;
+is(scalar @{$i3->message(TYPE_GET_STATS, "")->recv->{log_clients}}, 0,
+   'the follower does not use the log stream socket');
+
+# Disabling the SHM log ends the follower.
+cmd 'shmlog off';
+$follower->finish;
+is($follower->result, 0, 'follower exited after the log was closed');
+
+cmd 'debuglog off';
+
+done_testing;